@@ -14,6 +14,7 @@ namespace spvgentwo
 		// get can only be called after read was successful
 		bool get(unsigned int& _word) final;
 
+		// byte swapped SPIR-V is converted to native byte order
 		bool read(const char* _path, sgt_size_t _offset = 0u, sgt_size_t _length = 0u);
 		operator bool() const { return m_buffer.empty() == false; }
 
@@ -0,0 +1,36 @@
+#pragma once
+
+#include "spvgentwo/Reader.h"
+#include "spvgentwo/stdreplacement.h"
+
+namespace spvgentwo
+{
+	template <typename U32Vector>
+	class BinaryVectorReader : public IReader
+	{
+	public:
+		BinaryVectorReader(const U32Vector& _vector) : m_vector(_vector) {};
+		virtual ~BinaryVectorReader() = default;
+
+		bool get(unsigned int& _word) final;
+
+		// start reading from the first word again
+		void reset() { m_pos = 0u; }
+
+	private:
+		const U32Vector& m_vector;
+		sgt_size_t m_pos = 0u;
+	};
+
+	template<typename U32Vector>
+	inline bool BinaryVectorReader<U32Vector>::get(unsigned int& _word)
+	{
+		if (m_pos < m_vector.size())
+		{
+			_word = m_vector[m_pos++];
+			return true;
+		}
+
+		return false;
+	}
+} //!spvgentwo
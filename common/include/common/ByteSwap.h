@@ -0,0 +1,15 @@
+#pragma once
+
+#include "spvgentwo/stdreplacement.h"
+
+namespace spvgentwo
+{
+	namespace ByteSwap
+	{
+		// reverse the byte order of _count words in place, uses AVX2, SSE2 or NEON if enabled for the target
+		void swap(unsigned int* _pWords, sgt_size_t _count);
+
+		// swap _pWords to native byte order if it starts with a byte swapped SPIR-V magic number, returns true if the words were swapped
+		bool toNative(unsigned int* _pWords, sgt_size_t _count);
+	} // !ByteSwap
+} // !spvgentwo
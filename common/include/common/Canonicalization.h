@@ -0,0 +1,27 @@
+#pragma once
+
+#include "spvgentwo/stdreplacement.h"
+
+namespace spvgentwo
+{
+	// forward decls
+	class Module;
+	class IAllocator;
+
+	namespace Canonicalization
+	{
+		struct Result
+		{
+			unsigned int movedTypesAndConstants = 0u; // instructions of Module::getTypesAndConstants() not at their previous position
+			unsigned int movedDecorations = 0u;
+			unsigned int movedNames = 0u;
+		};
+
+		// order the module independent of the order instructions were added in, identical modules produce identical binaries:
+		// types and constants are sorted topologically by a structural key (opcode, literals, rank of operands, then their names and decorations),
+		// decorations by (target, member, decoration, operands) and names by (target, member, name). result ids are reassigned in serialization
+		// order afterwards (see Module::assignIDs). decorations are kept in order if the module uses decoration groups.
+		// global variables and functions keep their order
+		Result canonicalize(Module& _module, IAllocator* _pAllocator = nullptr);
+	} // !Canonicalization
+} // !spvgentwo
@@ -0,0 +1,85 @@
+#pragma once
+
+#include "spvgentwo/Reader.h"
+#include "spvgentwo/Writer.h"
+#include "spvgentwo/Vector.h"
+
+namespace spvgentwo
+{
+	// forward decls
+	class Grammar;
+
+	// compact lossless encoding of SPIR-V binaries, one byte stream packed into little endian words:
+	// - the SPIR-V magic is replaced by CompressedWriter::Magic, the other 4 header words are varints
+	// - each instruction starts with varint (opcode << 4 | wordCount), wordCount >= 15 is stored in an additional varint
+	// - operand words are encoded according to their grammar operand kind: result ids as zigzag varint delta to the previous result id + 1,
+	//   other ids as zigzag varint delta to the previous result id, literal strings as raw bytes and everything else as varint
+	// - a zero byte (or the end of the underlying stream) terminates the binary
+	//
+	// CompressedWriter encodes the SPIR-V words put into this writer and writes the compressed words to _writer.
+	// flush() needs to be called after the last word was put
+	class CompressedWriter : public IWriter
+	{
+	public:
+		static constexpr unsigned int Magic = 0x5a544753u; // 'SGTZ'
+
+		CompressedWriter(IWriter& _writer, const Grammar& _grammar, IAllocator* _pAllocator);
+
+		bool put(unsigned int _word) final;
+
+		// write out the last partial word, no more words may be put afterwards
+		bool flush();
+
+		// number of SPIR-V words put
+		sgt_size_t getInputWords() const { return m_inputWords; }
+
+		// number of compressed bytes written so far (excluding padding)
+		sgt_size_t getOutputBytes() const { return m_outputBytes; }
+
+	private:
+		bool encode();
+		bool byte(unsigned char _byte);
+		bool varint(unsigned int _value);
+
+		IWriter& m_writer;
+		const Grammar& m_grammar;
+		Vector<unsigned int> m_instr;
+		unsigned int m_pending = 0u; // bytes not written yet
+		unsigned int m_pendingBytes = 0u;
+		unsigned int m_lastResult = 0u;
+		sgt_size_t m_inputWords = 0u;
+		sgt_size_t m_outputBytes = 0u;
+		bool m_flushed = false;
+	};
+
+	// decodes compressed words read from _reader back to SPIR-V words, uncompressed SPIR-V is passed through unchanged
+	class CompressedReader : public IReader
+	{
+	public:
+		CompressedReader(IReader& _reader, const Grammar& _grammar, IAllocator* _pAllocator);
+
+		bool get(unsigned int& _word) final;
+
+	private:
+		bool decode();
+		bool byte(unsigned char& _byte);
+		bool varint(unsigned int& _value);
+
+		enum class State : unsigned char
+		{
+			Start,
+			Compressed,
+			PassThrough,
+			End
+		};
+
+		IReader& m_reader;
+		const Grammar& m_grammar;
+		Vector<unsigned int> m_instr; // decoded words
+		sgt_size_t m_pos = 0u; // next word of m_instr to return
+		unsigned int m_word = 0u; // current compressed word
+		unsigned int m_wordBytes = 0u; // bytes left in m_word
+		unsigned int m_lastResult = 0u;
+		State m_state = State::Start;
+	};
+} // !spvgentwo
@@ -0,0 +1,25 @@
+#pragma once
+
+#include "spvgentwo/stdreplacement.h"
+
+namespace spvgentwo
+{
+	// forward decls
+	class Module;
+	class IAllocator;
+
+	namespace DeadCodeElimination
+	{
+		struct Result
+		{
+			unsigned int removedFunctions = 0u;
+			unsigned int removedInstructions = 0u; // types, constants, global variables, undefs, names and decorations (excluding function bodies)
+			sgt_size_t savedBytes = 0u;
+		};
+
+		// mark & sweep: entry points (with their call graphs), execution modes, linkage decorated symbols and the preamble are live,
+		// every instruction referenced by a live instruction becomes live. unreferenced functions, types, constants, global variables and undefs
+		// are removed together with their names, decorations and lookup map entries
+		Result eliminate(Module& _module, IAllocator* _pAllocator = nullptr);
+	} // !DeadCodeElimination
+} // !spvgentwo
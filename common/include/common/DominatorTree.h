@@ -0,0 +1,59 @@
+#pragma once
+
+#include "spvgentwo/Vector.h"
+#include "spvgentwo/HashMap.h"
+
+namespace spvgentwo
+{
+	// forward decls
+	class Function;
+	class BasicBlock;
+
+	// dominator tree and dominance frontiers of the reachable basic blocks of a function (Cooper, Harvey & Kennedy: A Simple, Fast Dominance Algorithm)
+	class DominatorTree
+	{
+	public:
+		DominatorTree(const Function& _func, IAllocator* _pAllocator = nullptr);
+
+		DominatorTree(const DominatorTree&) = delete;
+		DominatorTree& operator=(const DominatorTree&) = delete;
+
+		// reachable blocks in reverse post order, the entry block comes first
+		const Vector<BasicBlock*>& getBlocks() const { return m_blocks; }
+
+		bool isReachable(const BasicBlock* _pBB) const { return m_indices.get(_pBB) != nullptr; }
+
+		// returns nullptr for the entry block and unreachable blocks
+		BasicBlock* getImmediateDominator(const BasicBlock* _pBB) const;
+
+		// true if every path from the entry block to _pB passes _pA, a block dominates itself
+		bool dominates(const BasicBlock* _pA, const BasicBlock* _pB) const;
+
+		// blocks immediately dominated by _pBB, nullptr if _pBB is not reachable
+		const List<BasicBlock*>* getChildren(const BasicBlock* _pBB) const;
+
+		// blocks where the dominance of _pBB ends, nullptr if _pBB is not reachable
+		const List<BasicBlock*>* getFrontier(const BasicBlock* _pBB) const;
+
+		// reachable predecessors of _pBB, nullptr if _pBB is not reachable
+		const List<BasicBlock*>* getPredecessors(const BasicBlock* _pBB) const;
+
+	private:
+		struct Node
+		{
+			Node(IAllocator* _pAllocator) : predecessors(_pAllocator), children(_pAllocator), frontier(_pAllocator) {}
+
+			unsigned int idom = ~0u; // index of the immediate dominator in m_blocks
+			List<BasicBlock*> predecessors;
+			List<BasicBlock*> children;
+			List<BasicBlock*> frontier;
+		};
+
+		const Node* getNode(const BasicBlock* _pBB) const;
+
+	private:
+		Vector<BasicBlock*> m_blocks; // reverse post order
+		HashMap<const BasicBlock*, unsigned int> m_indices; // index in m_blocks
+		Vector<Node> m_nodes;
+	};
+} // !spvgentwo
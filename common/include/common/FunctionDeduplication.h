@@ -0,0 +1,34 @@
+#pragma once
+
+#include "spvgentwo/FNV1aHasher.h"
+#include "spvgentwo/stdreplacement.h"
+
+namespace spvgentwo
+{
+	// forward decls
+	class Module;
+	class Function;
+	class IAllocator;
+
+	namespace FunctionDeduplication
+	{
+		struct Result
+		{
+			unsigned int removedFunctions = 0u;
+			unsigned int rounds = 0u; // merging callees can make callers identical, each round rescans the module
+			sgt_size_t savedBytes = 0u; // of removed functions, OpNames and OpDecorates
+		};
+
+		// structural hash of opcodes and operands of all instructions of _func (OpFunction to OpFunctionEnd), independent of result ids.
+		// operands referencing instructions of _func are hashed by their position in the function, others (types, constants, globals, callees) by handle.
+		// OpDecorate and OpMemberDecorate targeting an instruction of _func (e.g. NoContraction, RelaxedPrecision) are part of the hash
+		Hash64 hash(const Function& _func, IAllocator* _pAllocator = nullptr);
+
+		// true if both functions have the same structure as described for hash()
+		bool equal(const Function& _left, const Function& _right, IAllocator* _pAllocator = nullptr);
+
+		// merge identical non-entry point functions of _module: calls to duplicates are redirected to the first function of each group,
+		// duplicates and their OpNames and OpDecorates are removed. declarations and functions targeted by decorations (linkage) are kept.
+		Result deduplicate(Module& _module, IAllocator* _pAllocator = nullptr);
+	} // !FunctionDeduplication
+} // !spvgentwo
@@ -0,0 +1,32 @@
+#pragma once
+
+namespace spvgentwo
+{
+	// forward decls
+	class Module;
+	class IAllocator;
+
+	namespace FunctionInlining
+	{
+		struct Options
+		{
+			// callees with more instructions (after their own calls have been inlined) are not inlined, 0 only inlines FunctionControlMask::Inline callees
+			unsigned int maxCost = 64u;
+
+			// FunctionControlMask::Inline callees are inlined regardless of their cost, DontInline callees are never inlined
+			bool honourFunctionControl = true;
+		};
+
+		struct Result
+		{
+			unsigned int inlinedCalls = 0u;
+		};
+
+		// callees are processed bottom-up along the FunctionCallGraph of each function: the basic blocks of the callee are cloned into the caller
+		// at each OpFunctionCall (parameters replaced by the arguments, function variables moved to the callers entry block) and returns become
+		// branches to a new block holding the instructions that followed the call, multiple return values are merged with an OpPhi.
+		// callees with more than one return are not inlined in modules with the Shader capability (early returns would break structured control flow),
+		// neither are calls in loop headers. inlined functions are not removed, use DeadCodeElimination afterwards
+		Result inlineCalls(Module& _module, const Options& _options = {}, IAllocator* _pAllocator = nullptr);
+	} // !FunctionInlining
+} // !spvgentwo
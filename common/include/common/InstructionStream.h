@@ -0,0 +1,146 @@
+#pragma once
+
+#include "spvgentwo/Grammar.h"
+
+namespace spvgentwo
+{
+	// forward decls
+	class IReader;
+	class IWriter;
+	class ILogger;
+
+	// one instruction of a SPIR-V word stream
+	struct StreamInstruction
+	{
+		unsigned int* pWords = nullptr; // pWords[0] holds word count and opcode, may be modified in place
+		unsigned int wordCount = 0u;
+
+		spv::Op getOperation() const { return static_cast<spv::Op>(pWords[0] & spv::OpCodeMask); }
+		void setOperation(spv::Op _op) { pWords[0] = (wordCount << spv::WordCountShift) | static_cast<unsigned int>(_op); }
+
+		unsigned int* getOperands() const { return pWords + 1u; }
+		unsigned int getOperandCount() const { return wordCount - 1u; }
+	};
+
+	// next stage of an InstructionStream
+	class IInstructionSink
+	{
+	public:
+		// _pWords[0] must contain the word count, subsequent filters may modify the words in place
+		virtual bool emit(unsigned int* _pWords, unsigned int _wordCount) = 0;
+		bool emit(StreamInstruction& _instr) { return emit(_instr.pWords, _instr.wordCount); }
+	};
+
+	class IInstructionFilter
+	{
+	public:
+		virtual ~IInstructionFilter() = default;
+
+		// called with the 5 header words (magic, version, generator, bound, schema) before the first instruction, may modify them
+		virtual bool begin([[maybe_unused]] unsigned int* _pHeader) { return true; }
+
+		// forward _instr (possibly modified) to _next, drop it by not emitting it, or emit additional instructions.
+		// stateful filters may keep copies of instructions and emit them later
+		virtual bool filter(StreamInstruction& _instr, IInstructionSink& _next) = 0;
+
+		// called after the last instruction to flush buffered instructions
+		virtual bool end([[maybe_unused]] IInstructionSink& _next) { return true; }
+	};
+
+	// yields the operand kind of an instruction's operand words one word at a time, the kind of a word only depends on the words before it.
+	// operands of unknown opcodes or beyond the grammar yield LiteralInteger and invalidate the cursor
+	class OperandKindCursor
+	{
+	public:
+		OperandKindCursor(const Grammar& _grammar, spv::Op _op);
+
+		// kind of the next operand word, literal strings yield one LiteralString per word
+		Grammar::OperandKind getKind() const;
+
+		// consume the next operand word
+		void advance(unsigned int _word);
+
+		bool isValid() const { return m_valid; }
+
+		// consumed words form a complete operand list
+		bool isComplete() const;
+
+	private:
+		const Grammar::Operand* current() const;
+		void next(); // current operand was consumed
+		void enter(); // m_it became the current top level operand
+
+		const Grammar& m_grammar;
+		const Grammar::Operand* m_it = nullptr;
+		const Grammar::Operand* m_end = nullptr;
+		const Vector<Grammar::Operand>* m_pParams = nullptr; // of the enum value at m_it
+		const Vector<Grammar::Operand>* m_pBases = nullptr; // of the composite at m_it
+		unsigned int m_index = 0u; // into m_pParams or m_pBases
+		bool m_inString = false;
+		bool m_rest = false; // remaining words are of kind m_restKind
+		Grammar::OperandKind m_restKind = Grammar::OperandKind::IdRef;
+		bool m_valid = true;
+	};
+
+	// reads a SPIR-V binary one instruction at a time and passes it through a chain of filters to an IWriter without building a Module.
+	// memory use is bounded by the largest instruction (plus whatever stateful filters buffer)
+	class InstructionStream
+	{
+	public:
+		// _pGrammar is only required by filters decoding operand kinds
+		InstructionStream(IAllocator* _pAllocator, const Grammar* _pGrammar = nullptr, ILogger* _pLogger = nullptr);
+
+		// filters are applied in the order they were added and not owned by the stream
+		InstructionStream& add(IInstructionFilter* _pFilter);
+
+		void clear() { m_filters.clear(); }
+
+		bool run(IReader& _reader, IWriter& _writer);
+
+		const Grammar* getGrammar() const { return m_pGrammar; }
+		ILogger* getLogger() const { return m_pLogger; }
+
+		// fill _outKinds with the operand kind of each operand word of _instr (excluding the opcode word), literal strings yield one entry per word.
+		// returns false if the opcode is unknown or the operands don't match the grammar
+		static bool decodeOperandKinds(const Grammar& _grammar, const StreamInstruction& _instr, Vector<Grammar::OperandKind>& _outKinds);
+
+		static constexpr bool isIdKind(Grammar::OperandKind _kind)
+		{
+			return _kind == Grammar::OperandKind::IdResultType || _kind == Grammar::OperandKind::IdResult || _kind == Grammar::OperandKind::IdMemorySemantics ||
+				_kind == Grammar::OperandKind::IdScope || _kind == Grammar::OperandKind::IdRef;
+		}
+
+	private:
+		IAllocator* m_pAllocator = nullptr;
+		const Grammar* m_pGrammar = nullptr;
+		ILogger* m_pLogger = nullptr;
+
+		Vector<IInstructionFilter*> m_filters;
+		Vector<unsigned int> m_buffer;
+	};
+
+	// drops OpSource*, OpName, OpMemberName, OpLine, OpNoLine and OpModuleProcessed
+	class StripDebugFilter : public IInstructionFilter
+	{
+	public:
+		bool filter(StreamInstruction& _instr, IInstructionSink& _next) final;
+	};
+
+	// renames result ids and all references to them, needs a grammar. ids not covered by the table are kept
+	class IdRemapFilter : public IInstructionFilter
+	{
+	public:
+		// _pTable[oldId] = newId, _newBound is written to the header if not 0
+		IdRemapFilter(IAllocator* _pAllocator, const Grammar* _pGrammar, const unsigned int* _pTable, unsigned int _tableSize, unsigned int _newBound = 0u);
+
+		bool begin(unsigned int* _pHeader) final;
+		bool filter(StreamInstruction& _instr, IInstructionSink& _next) final;
+
+	private:
+		const Grammar* m_pGrammar = nullptr;
+		const unsigned int* m_pTable = nullptr;
+		unsigned int m_tableSize = 0u;
+		unsigned int m_newBound = 0u;
+		Vector<Grammar::OperandKind> m_kinds;
+	};
+} // !spvgentwo
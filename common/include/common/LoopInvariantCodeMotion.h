@@ -0,0 +1,31 @@
+#pragma once
+
+namespace spvgentwo
+{
+	// forward decls
+	class Module;
+	class Function;
+	class IAllocator;
+	class FunctionAnalyses;
+
+	namespace LoopInvariantCodeMotion
+	{
+		struct Result
+		{
+			unsigned int hoistedInstructions = 0u; // including hoistedLoads
+			unsigned int hoistedLoads = 0u;
+		};
+
+		// hoist loop invariant instructions of structured loops (OpLoopMerge headers) to the pre-header of the loop, innermost loops first:
+		// pure instructions (see isPureOp) and access chains whose operands are defined outside of the loop, and OpLoads from UniformConstant variables
+		// or Uniform variables decorated NonWritable (or with NonWritable on all members) if the loop has no instruction that might write to the variable.
+		// loops without a single pre-header (unconditional branch to the header, no merge instruction) are skipped
+		Result hoist(Function& _func, IAllocator* _pAllocator = nullptr);
+
+		// same as above, reusing the dominator tree of _analyses (see PassManager). analyses depending on the instructions are invalidated
+		Result hoist(Function& _func, FunctionAnalyses& _analyses, IAllocator* _pAllocator = nullptr);
+
+		// hoist loop invariant instructions of all functions and entry points of _module
+		Result hoist(Module& _module, IAllocator* _pAllocator = nullptr);
+	} // !LoopInvariantCodeMotion
+} // !spvgentwo
@@ -0,0 +1,40 @@
+#pragma once
+
+namespace spvgentwo
+{
+	// forward decls
+	class Module;
+	class Function;
+	class IAllocator;
+	class FunctionAnalyses;
+
+	namespace LoopUnrolling
+	{
+		struct Options
+		{
+			unsigned int maxSize = 512u; // max number of instructions of the unrolled loop (trip count x loop size)
+			unsigned int maxTripCount = 256u; // loops with more iterations are not analyzed further
+			unsigned int maxFactor = 8u; // max number of loop body copies of a partially unrolled loop
+			bool markUnroll = false; // add LoopControlMask::Unroll to loops with a constant trip count which are not fully unrolled
+		};
+
+		struct Result
+		{
+			unsigned int fullyUnrolled = 0u;
+			unsigned int partiallyUnrolled = 0u;
+			unsigned int markedLoops = 0u;
+		};
+
+		// unroll structured loops (see BasicBlock::Loop) with a constant trip count, innermost loops first. The loop condition must be evaluated before the body
+		// (in the header or its successor) and compare an induction variable with an integer constant, loops with other exits, continue branches or DontUnroll are skipped.
+		// the induction variable is either an OpPhi of the header (see VariablePromotion) or a function variable stored once in the continue block, each with a constant start value and step.
+		// loops are fully unrolled if trip count x loop size <= maxSize, otherwise the body is repeated by the largest factor dividing the trip count (partial unrolling)
+		Result unroll(Function& _func, const Options& _options = {}, IAllocator* _pAllocator = nullptr);
+
+		// same as above, using the dominator tree of _analyses (see PassManager) which is invalidated after each unrolled loop
+		Result unroll(Function& _func, FunctionAnalyses& _analyses, const Options& _options = {}, IAllocator* _pAllocator = nullptr);
+
+		// unroll loops of all functions and entry points of _module
+		Result unroll(Module& _module, const Options& _options = {}, IAllocator* _pAllocator = nullptr);
+	} // !LoopUnrolling
+} // !spvgentwo
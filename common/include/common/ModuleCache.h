@@ -0,0 +1,97 @@
+#pragma once
+
+#include "spvgentwo/HashMap.h"
+#include "spvgentwo/String.h"
+#include "spvgentwo/FNV1aHasher.h"
+
+namespace spvgentwo
+{
+	// forward decls
+	class Module;
+	class Grammar;
+	class IWriter;
+
+	struct ModuleCacheStats
+	{
+		unsigned int hits = 0u;
+		unsigned int misses = 0u;
+		unsigned int stores = 0u;
+		unsigned int evictions = 0u; // entries dropped to stay below the size limit
+		unsigned int entries = 0u;
+		sgt_size_t packBytes = 0u; // size of the pack file
+	};
+
+	// content addressed on-disk cache for SPIR-V binaries. all entries are stored in a single append-only pack file,
+	// the index (key -> record) is rebuilt when the pack is opened. records are committed by writing their magic last,
+	// a record torn by a crash is ignored and overwritten by the next store().
+	// if the pack grows beyond _maxBytes, the least recently used entries are dropped by rewriting the pack to 3/4 of the limit.
+	// all functions are thread safe, but only one process may open the same pack file at a time
+	class ModuleCache
+	{
+	public:
+		// _maxBytes == 0 never evicts entries
+		ModuleCache(IAllocator* _pAllocator, const char* _pPath = nullptr, sgt_size_t _maxBytes = 0u);
+		~ModuleCache();
+
+		ModuleCache(const ModuleCache&) = delete;
+		ModuleCache& operator=(const ModuleCache&) = delete;
+
+		// open or create pack file _pPath, an incompatible file is discarded
+		bool open(const char* _pPath);
+		bool isOpen() const;
+		void close();
+
+		bool contains(Hash64 _key) const;
+
+		// write the binary stored for _key to _writer, returns false if _key is not resident or the record is corrupt
+		bool load(Hash64 _key, IWriter& _writer);
+
+		// append binary _pWords if _key is not resident yet
+		bool store(Hash64 _key, const unsigned int* _pWords, sgt_size_t _count);
+
+		// combines _inputHash with the structural hash of the NOT yet finalized _module. on a hit the cached binary is written to _writer
+		// and _module is neither finalized nor written. otherwise _module.finalizeAndWrite() is called and the binary is stored.
+		// callers which can derive a key from their generator inputs alone can skip generating the module by calling load() first.
+		bool finalizeAndWrite(Module& _module, Hash64 _inputHash, IWriter& _writer, const Grammar* _pGrammar = nullptr);
+
+		// hash of opcodes and operands of all instructions in serialization order, instruction references are hashed by their position
+		// so the result does not depend on instruction addresses or result ids. should be called before finalize() which adds
+		// capabilities and entry point interfaces
+		static Hash64 hashModule(const Module& _module, Hash64 _seed = detail::Offset);
+
+		ModuleCacheStats getStats() const;
+
+		sgt_size_t getMaxBytes() const { return m_maxBytes; }
+
+	private:
+		struct Entry
+		{
+			sgt_size_t offset = 0u; // of the record header in the pack file
+			unsigned int words = 0u;
+			Hash64 checksum = 0u;
+			sgt_uint64_t lastUse = 0u;
+		};
+
+		// all private functions expect the mutex to be locked
+		bool create();
+		bool scan();
+		bool append(Hash64 _key, const unsigned int* _pWords, sgt_size_t _count);
+		bool readRecord(const Entry& _entry);
+		bool evict();
+
+		struct Pack;
+
+	private:
+		IAllocator* m_pAllocator = nullptr;
+		sgt_size_t m_maxBytes = 0u;
+
+		Pack* m_pPack = nullptr;
+		String m_path;
+		HashMap<Hash64, Entry> m_index;
+		Vector<unsigned int> m_scratch;
+
+		sgt_size_t m_end = 0u; // end of the last committed record
+		sgt_uint64_t m_useCounter = 0u;
+		ModuleCacheStats m_stats{};
+	};
+} // !spvgentwo
@@ -0,0 +1,171 @@
+#pragma once
+
+#include "spvgentwo/Module.h"
+
+namespace spvgentwo
+{
+	// forward decls
+	class Grammar;
+
+	// chunked arena with size-class free lists, memory returned via deallocate() is kept for reuse until release() is called
+	class ModuleArena : public IAllocator
+	{
+	public:
+		ModuleArena(IAllocator* _pBackingAllocator = nullptr, sgt_size_t _chunkSize = DefaultChunkSize);
+		~ModuleArena() override;
+
+		ModuleArena(const ModuleArena&) = delete;
+		ModuleArena& operator=(const ModuleArena&) = delete;
+
+		// blocks are aligned to MinAlignment, larger alignment hints are ignored
+		void* allocate(sgt_size_t _bytes, unsigned int _alignmentHint) final;
+
+		// _bytes must match the size passed to allocate(), blocks deallocated with _bytes == 0 are only reclaimed by release()
+		void deallocate(void* _ptr, sgt_size_t _bytes = 0u) final;
+
+		// return all chunks to the backing allocator, invalidates all allocations made from this arena
+		void release();
+
+		// bytes requested from the backing allocator
+		sgt_size_t getReservedBytes() const { return m_reservedBytes; }
+
+		// bytes currently handed out by allocate()
+		sgt_size_t getUsedBytes() const { return m_usedBytes; }
+
+		// highest getUsedBytes() since construction or last release()
+		sgt_size_t getPeakUsedBytes() const { return m_peakUsedBytes; }
+
+		static constexpr sgt_size_t DefaultChunkSize = 64u * 1024u;
+		static constexpr sgt_size_t MinAlignment = 16u;
+
+	private:
+		struct Chunk { Chunk* next; sgt_size_t size; };
+		struct FreeBlock { FreeBlock* next; };
+
+		// 16 byte steps up to 1KiB, then powers of two up to 1MiB, anything larger goes straight to the backing allocator
+		static constexpr unsigned int SmallClassCount = 64u;
+		static constexpr unsigned int LargeClassCount = 10u;
+		static constexpr sgt_size_t MaxSmallSize = SmallClassCount * MinAlignment;
+		static constexpr sgt_size_t MaxLargeSize = MaxSmallSize << LargeClassCount;
+		static constexpr unsigned int InvalidClass = ~0u;
+
+		static unsigned int getSizeClass(sgt_size_t _bytes, sgt_size_t& _outBlockSize);
+
+		void* carve(sgt_size_t _blockSize);
+
+	private:
+		IAllocator* m_pBackingAllocator = nullptr;
+		sgt_size_t m_chunkSize = DefaultChunkSize;
+
+		Chunk* m_pChunks = nullptr;
+		char* m_pCurrent = nullptr;
+		char* m_pEnd = nullptr;
+
+		FreeBlock* m_pFreeLists[SmallClassCount + LargeClassCount]{};
+
+		sgt_size_t m_reservedBytes = 0u;
+		sgt_size_t m_usedBytes = 0u;
+		sgt_size_t m_peakUsedBytes = 0u;
+	};
+
+	struct ModulePoolStats
+	{
+		unsigned int acquired = 0u; // number of acquire() calls
+		unsigned int reused = 0u; // acquire() calls served by an idle slot
+		unsigned int slots = 0u; // slots currently owned by the pool
+		unsigned int peakSlotsInUse = 0u;
+		sgt_size_t reservedBytes = 0u; // sum of all slot arenas
+		sgt_size_t peakReservedBytes = 0u;
+		sgt_size_t peakModuleBytes = 0u; // highest memory consumption of a single module
+
+		float getReuseRate() const { return acquired != 0u ? static_cast<float>(reused) / static_cast<float>(acquired) : 0.f; }
+	};
+
+	// hands out empty modules bound to a per-slot arena, modules are reset() and returned to the pool when their handle goes out of scope.
+	// the module keeps its hash map buckets and the arena keeps freed instruction, operand and list memory for the next acquire().
+	// not thread safe, use one pool per thread
+	class ModulePool
+	{
+		struct Slot
+		{
+			Slot(IAllocator* _pBackingAllocator, sgt_size_t _chunkSize, ILogger* _pLogger, ITypeInferenceAndVailation* _pTypeInferenceAndVailation);
+
+			ModuleArena arena; // must be constructed before module
+			Module module;
+			Slot* nextIdle = nullptr;
+		};
+
+	public:
+		class Handle
+		{
+			friend class ModulePool;
+			Handle(ModulePool* _pPool, Slot* _pSlot) : m_pPool(_pPool), m_pSlot(_pSlot) {}
+
+		public:
+			Handle() = default;
+			Handle(Handle&& _other) noexcept;
+			~Handle();
+
+			Handle(const Handle&) = delete;
+			Handle& operator=(const Handle&) = delete;
+			Handle& operator=(Handle&& _other) noexcept;
+
+			// reset the module and return it to the pool, handle becomes empty
+			void release();
+
+			Module* get() const { return m_pSlot != nullptr ? &m_pSlot->module : nullptr; }
+			Module* operator->() const { return get(); }
+			Module& operator*() const { return *get(); }
+
+			// per-slot arena the module allocates from, can be used for Lists, Vectors etc. with the same lifetime as the module
+			IAllocator* getAllocator() const { return m_pSlot != nullptr ? &m_pSlot->arena : nullptr; }
+
+			// grammar the pool was created with (might be nullptr)
+			const Grammar* getGrammar() const { return m_pPool != nullptr ? m_pPool->getGrammar() : nullptr; }
+
+			operator bool() const { return m_pSlot != nullptr; }
+
+		private:
+			ModulePool* m_pPool = nullptr;
+			Slot* m_pSlot = nullptr;
+		};
+
+		// _pAllocator backs the slot arenas and the pools own bookkeeping, HeapAllocator::instance() is NOT used implicitly
+		ModulePool(IAllocator* _pAllocator, const Grammar* _pGrammar = nullptr, ILogger* _pLogger = nullptr, ITypeInferenceAndVailation* _pTypeInferenceAndVailation = nullptr, sgt_size_t _arenaChunkSize = ModuleArena::DefaultChunkSize);
+		~ModulePool();
+
+		ModulePool(const ModulePool&) = delete;
+		ModulePool& operator=(const ModulePool&) = delete;
+
+		// get an empty module, reusing an idle slot if available
+		Handle acquire();
+
+		// create idle slots until the pool owns at least _slots modules
+		void reserve(unsigned int _slots);
+
+		// destroy all idle slots and return their memory to the backing allocator
+		void shrink();
+
+		const Grammar* getGrammar() const { return m_pGrammar; }
+		IAllocator* getAllocator() const { return m_pAllocator; }
+
+		// updates reservedBytes from the slot arenas before returning
+		const ModulePoolStats& getStats();
+
+	private:
+		void release(Slot* _pSlot);
+
+	private:
+		IAllocator* m_pAllocator = nullptr;
+		const Grammar* m_pGrammar = nullptr;
+		ILogger* m_pLogger = nullptr;
+		ITypeInferenceAndVailation* m_pTypeInferenceAndVailation = nullptr;
+		sgt_size_t m_arenaChunkSize = ModuleArena::DefaultChunkSize;
+
+		List<Slot> m_slots;
+		Slot* m_pIdle = nullptr; // LIFO, most recently used slot is handed out first
+		unsigned int m_slotsInUse = 0u;
+
+		ModulePoolStats m_stats{};
+	};
+} // !spvgentwo
@@ -0,0 +1,162 @@
+#pragma once
+
+#include "spvgentwo/Flag.h"
+#include "spvgentwo/HashMap.h"
+#include "spvgentwo/Vector.h"
+
+namespace spvgentwo
+{
+	// forward decls
+	class Module;
+	class Function;
+	class Instruction;
+	class DominatorTree;
+	class FunctionCallGraph;
+	struct EmptyEdge;
+	template <class E> class ControlFlowGraph;
+
+	enum class AnalysisBits : unsigned int
+	{
+		ControlFlow = 1 << 0, // ControlFlowGraph of a function
+		Dominators = 1 << 1, // DominatorTree of a function
+		DefUse = 1 << 2, // users of the instructions of a function
+		CallGraph = 1 << 3, // FunctionCallGraph rooted at a function
+		All = CallGraph | (CallGraph - 1)
+	};
+
+	using Analyses = Flag<AnalysisBits>;
+
+	// analyses of one function, built on first use and cached by the PassManager until a pass changes the function without preserving them
+	class FunctionAnalyses
+	{
+	public:
+		FunctionAnalyses(Function& _func, IAllocator* _pAllocator);
+		~FunctionAnalyses();
+
+		FunctionAnalyses(const FunctionAnalyses&) = delete;
+		FunctionAnalyses& operator=(const FunctionAnalyses&) = delete;
+
+		Function& getFunction() const { return m_func; }
+
+		// unshare the function (see Module::unshare), analyses built while it was shared reference the blocks of the module it was cloned from
+		bool unshare();
+
+		const ControlFlowGraph<EmptyEdge>& getControlFlowGraph();
+		const DominatorTree& getDominatorTree();
+		const FunctionCallGraph& getCallGraph();
+
+		// instructions of the function using _pInstr as operand (including OpPhi and branch operands), nullptr if there are none
+		const List<Instruction*>* getUses(const Instruction* _pInstr);
+
+		// destroy all analyses not contained in _preserved
+		void invalidate(Analyses _preserved = {});
+
+		// analyses currently built
+		Analyses getValid() const;
+
+	private:
+		Function& m_func;
+		IAllocator* m_pAllocator = nullptr;
+
+		ControlFlowGraph<EmptyEdge>* m_pControlFlowGraph = nullptr;
+		DominatorTree* m_pDominatorTree = nullptr;
+		FunctionCallGraph* m_pCallGraph = nullptr;
+		HashMap<const Instruction*, List<Instruction*>>* m_pUses = nullptr;
+	};
+
+	class PassManager;
+
+	// returns true if the function or module was changed
+	using FunctionPass = bool(*)(Function& _func, FunctionAnalyses& _analyses, IAllocator* _pAllocator, void* _pUserData);
+	using ModulePass = bool(*)(Module& _module, PassManager& _manager, IAllocator* _pAllocator, void* _pUserData);
+
+	struct Pass
+	{
+		const char* name = nullptr; // not copied
+		FunctionPass function = nullptr; // run for all functions and entry points of the module
+		ModulePass module = nullptr; // run once, function is ignored if set
+		Analyses preserved{}; // analyses which stay valid if a function pass reports a change, module passes reporting a change drop all cached analyses
+		// function pass only changes its own function and allocates from _pAllocator or thread safe module allocators.
+		// it must not add or remove types, constants, global variables, names or decorations. these passes run in parallel
+		bool threadSafe = false;
+		void* userData = nullptr;
+	};
+
+	struct PassStatistics
+	{
+		const char* name = nullptr;
+		double milliseconds = 0.0; // wall time
+		unsigned int allocations = 0u; // through the IAllocator passed to the pass, including analyses built for the pass
+		sgt_size_t allocatedBytes = 0u;
+		unsigned int instructionsBefore = 0u; // all instructions of the module (see Module::iterateInstructions)
+		unsigned int instructionsAfter = 0u;
+		bool changed = false;
+	};
+
+	// called after each pass
+	using Instrumentation = void(*)(const PassStatistics& _statistics, void* _pUserData);
+
+	// runs a pipeline of module and function passes in the order they were added. function passes are run on all functions and entry points,
+	// thread safe function passes on up to _threadCount functions at a time. analyses of functions are cached across passes (see FunctionAnalyses)
+	// and invalidated if a pass reports a change without preserving them. run() must not be called concurrently
+	class PassManager
+	{
+	public:
+		// _threadCount == 0 uses the number of hardware threads, all allocations of the manager and the passes' _pAllocator are serialized
+		PassManager(IAllocator* _pAllocator, unsigned int _threadCount = 0u);
+		~PassManager();
+
+		PassManager(const PassManager&) = delete;
+		PassManager& operator=(const PassManager&) = delete;
+
+		void add(const Pass& _pass);
+
+		void addFunctionPass(const char* _pName, FunctionPass _pass, Analyses _preserved = {}, bool _threadSafe = false, void* _pUserData = nullptr);
+		void addModulePass(const char* _pName, ModulePass _pass, Analyses _preserved = {}, void* _pUserData = nullptr);
+
+		const Vector<Pass>& getPasses() const { return m_passes; }
+
+		void setInstrumentation(Instrumentation _callback, void* _pUserData = nullptr) { m_instrumentation = _callback; m_pInstrumentationUserData = _pUserData; }
+
+		// cached analyses of _func, valid until the next pass changes _func
+		FunctionAnalyses& getAnalyses(Function& _func);
+
+		// destroy analyses of all functions not contained in _preserved, must be called by module passes that change functions
+		// (the manager only invalidates after the pass returned)
+		void invalidate(Analyses _preserved = {});
+
+		// run all passes on _module, returns true if any pass changed it
+		bool run(Module& _module);
+
+		unsigned int getThreadCount() const { return m_threadCount; }
+
+	private:
+		bool runFunctionPass(Module& _module, const Pass& _pass);
+
+		// destroy the analyses of all functions, module passes might remove functions and add new ones at the same address
+		void clear();
+
+		struct SharedAllocator;
+
+	private:
+		SharedAllocator* m_pShared = nullptr;
+		IAllocator* m_pAllocator = nullptr; // m_pShared
+		unsigned int m_threadCount = 1u;
+
+		Vector<Pass> m_passes;
+		HashMap<const Function*, FunctionAnalyses*> m_analyses;
+
+		Instrumentation m_instrumentation = nullptr;
+		void* m_pInstrumentationUserData = nullptr;
+	};
+
+	namespace Pipelines
+	{
+		// -O: inline calls, promote variables, fold constants, peephole, hoist loop invariants, unroll loops, peephole, deduplicate functions, eliminate dead code
+		// -Os: deduplicate functions, promote variables, fold constants, peephole, hoist loop invariants, eliminate dead code (no inlining and unrolling)
+		// single passes: inline, promote, fold, peephole, licm, unroll, dedup, dce, strip (removes names, OpLine, OpSource and OpModuleProcessed)
+		// and canonicalize (deterministic order of types, constants, decorations and names, see Canonicalization).
+		// returns false if _pName is not a known pipeline or pass, leading dashes are ignored
+		bool add(PassManager& _manager, const char* _pName);
+	} // !Pipelines
+} // !spvgentwo
@@ -0,0 +1,72 @@
+#pragma once
+
+#include "spvgentwo/Vector.h"
+#include "spvgentwo/Spv.h"
+
+namespace spvgentwo
+{
+	// word offsets of DescriptorSet, Binding, Location and SpecId decorations and spec constant values of a serialized SPIR-V binary.
+	// the binary is scanned once, afterwards values can be changed by direct word stores without constructing a Module.
+	// patches only stay valid as long as the layout of the binary does not change (same instructions, same word counts)
+	class PatchTable
+	{
+	public:
+		static constexpr unsigned int InvalidIndex = ~0u;
+		static constexpr unsigned int InvalidSpecId = ~0u;
+
+		enum class Slot : unsigned char
+		{
+			DescriptorSet,
+			Binding,
+			Location,
+			SpecId,
+			SpecConstant, // OpSpecConstant literal, 1 or 2 words
+			SpecConstantBool // OpSpecConstantTrue / False, patched by replacing the opcode
+		};
+
+		struct Patch
+		{
+			unsigned int target = 0u; // decorated id or result id of the spec constant
+			unsigned int specId = InvalidSpecId; // only set for spec constants with a SpecId decoration
+			unsigned int offset = 0u; // word offset of the value, offset of the opcode for SpecConstantBool
+			unsigned int wordCount = 0u; // number of value words
+			Slot slot = Slot::Binding;
+		};
+
+		PatchTable(IAllocator* _pAllocator) : m_patches(_pAllocator) {}
+
+		// discard previous patches and collect new ones from _pWords. stops at the first OpFunction since
+		// decorations and constants can't appear after it. returns false if the binary is malformed
+		bool scan(const unsigned int* _pWords, sgt_size_t _wordCount);
+
+		const Vector<Patch>& getPatches() const { return m_patches; }
+
+		void clear() { m_patches.clear(); }
+
+		// returns InvalidIndex if _target has no such decoration / is no patchable spec constant
+		unsigned int find(Slot _slot, unsigned int _target) const;
+
+		// index of the spec constant decorated with _specId or InvalidIndex
+		unsigned int findSpecConstant(unsigned int _specId) const;
+
+		const Patch& operator[](unsigned int _index) const { return m_patches[_index]; }
+
+		// store _value in the (first) value word of _patch, bool spec constants are set to true if _value != 0
+		static void apply(unsigned int* _pWords, const Patch& _patch, unsigned int _value);
+
+		// store _value in both words of a 64 bit spec constant, the high word is ignored for 32 bit values
+		static void apply64(unsigned int* _pWords, const Patch& _patch, sgt_uint64_t _value);
+
+		// value of the (first) value word of _patch, 1 or 0 for bool spec constants
+		static unsigned int get(const unsigned int* _pWords, const Patch& _patch);
+
+		// find() + apply(), returns false if there is no matching patch
+		bool set(unsigned int* _pWords, Slot _slot, unsigned int _target, unsigned int _value) const;
+
+		// findSpecConstant() + apply(), returns false if there is no matching patch
+		bool setSpecConstant(unsigned int* _pWords, unsigned int _specId, unsigned int _value) const;
+
+	private:
+		Vector<Patch> m_patches;
+	};
+} // !spvgentwo
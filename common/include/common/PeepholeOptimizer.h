@@ -0,0 +1,101 @@
+#pragma once
+
+#include "spvgentwo/HashMap.h"
+#include "spvgentwo/Spv.h"
+
+namespace spvgentwo
+{
+	// forward decls
+	class Module;
+	class Function;
+	class Instruction;
+	class Constant;
+
+	namespace PeepholeOptimizer
+	{
+		class Context;
+
+		// a rule matches an opcode tree rooted at _instr, it returns the instruction replacing _instr (all uses are redirected and _instr is removed),
+		// &_instr if _instr was rewritten in place (e.g. strength reduction) or nullptr if the rule does not apply
+		using Rule = Instruction* (*)(Context& _context, Instruction& _instr);
+
+		// opcode indexed dispatch table, rules of an opcode are tried in the order they were added
+		class Rules
+		{
+		public:
+			Rules(IAllocator* _pAllocator) : m_pAllocator(_pAllocator), m_rules(_pAllocator) {}
+
+			void add(spv::Op _op, Rule _rule);
+
+			const List<Rule>* get(spv::Op _op) const { return m_rules.get(_op); }
+
+		private:
+			IAllocator* m_pAllocator = nullptr;
+			HashMap<spv::Op, List<Rule>> m_rules;
+		};
+
+		// initial rule set:
+		// x * 2^n -> x << n, x / 2^n -> x >> n (unsigned), x % 2^n -> x & (2^n - 1) (unsigned), x * 1, x / 1, x + 0, x - 0 -> x (integers, scalar and splat vector constants)
+		// x * 1.0, x / 1.0, x - 0.0, x + -0.0 -> x (floats, x + 0.0 is kept because of signed zeros)
+		// -(-x), ~~x, !!x -> x, OpSelect with constant condition or equal objects -> object, OpBitcast(OpBitcast(x)) -> OpBitcast(x) or x,
+		// OpCompositeExtract(OpCompositeConstruct(a, b, ...)) -> constituent (or OpCompositeExtract of the constituent)
+		void addDefaultRules(Rules& _rules);
+
+		// replace pure instructions (see isPureOp) with constant operands by their result, evaluated by the modules IConstantFolder or the default folder
+		void addFoldingRules(Rules& _rules);
+
+		struct Result
+		{
+			unsigned int replaced = 0u;
+			unsigned int rewritten = 0u;
+		};
+
+		// state of the optimizer for one function, passed to the rules
+		class Context
+		{
+		public:
+			Context(Function& _func, IAllocator* _pAllocator);
+
+			Module& getModule() const { return m_module; }
+
+			// instructions of the function using _pInstr as operand, nullptr if there are none
+			const List<Instruction*>* getUses(const Instruction* _pInstr) const { return m_uses.get(_pInstr); }
+
+			// add an empty instruction before _instr in its block, the new instruction is visited by the rules after the current rule returns
+			Instruction* insertBefore(Instruction& _instr);
+
+			// _index-th operand following result type and id, nullptr if it's not an instruction
+			static Instruction* getOperand(const Instruction& _instr, unsigned int _index);
+
+			// OpConstant, OpConstantTrue, OpConstantFalse, OpConstantNull or OpConstantComposite info of _pInstr, nullptr for spec constants and non constants
+			const Constant* getConstant(const Instruction* _pInstr) const;
+
+			// run _rules until no rule applies anymore
+			Result run(const Rules& _rules);
+
+		private:
+			void addUses(Instruction* _pInstr);
+			void enqueue(Instruction* _pInstr);
+			void replace(Instruction* _pInstr, Instruction* _pReplacement);
+			void removeDead();
+
+		private:
+			Function& m_func;
+			Module& m_module;
+			IAllocator* m_pAllocator = nullptr;
+
+			HashMap<const Instruction*, List<Instruction*>> m_uses;
+			List<Instruction*> m_worklist;
+			HashMap<const Instruction*, bool> m_queued;
+			HashMap<const Instruction*, bool> m_dead; // replaced, removed after the last rule was applied
+			List<Instruction*> m_inserted;
+		};
+
+		// apply _rules to all instructions of _func until a fixed point is reached, replaced instructions are removed.
+		// operands which are not used anymore are left to DeadCodeElimination
+		Result optimize(Function& _func, const Rules& _rules, IAllocator* _pAllocator = nullptr);
+
+		// optimize all functions and entry points of _module
+		Result optimize(Module& _module, const Rules& _rules, IAllocator* _pAllocator = nullptr);
+	} // !PeepholeOptimizer
+} // !spvgentwo
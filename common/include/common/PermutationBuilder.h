@@ -0,0 +1,145 @@
+#pragma once
+
+#include "spvgentwo/Vector.h"
+#include "spvgentwo/HashMap.h"
+
+namespace spvgentwo
+{
+	// forward decls
+	class Module;
+	class Grammar;
+	class ILogger;
+	class ITypeInferenceAndVailation;
+
+	struct PermutationValue
+	{
+		enum class Kind : unsigned char
+		{
+			Switch, // bool / int feature switch read by the generator
+			SpecConstant // default value of the OpSpecConstant named 'name', patched after generation
+		};
+
+		const char* name = nullptr; // not copied, must outlive the key
+		unsigned int value = 0u; // 0 or 1 for bools, bit pattern for 32 bit spec constants
+		Kind kind = Kind::Switch;
+	};
+
+	// specialisation key of one variant
+	class PermutationKey
+	{
+	public:
+		PermutationKey(IAllocator* _pAllocator = nullptr) : m_values(_pAllocator) {}
+
+		// add or overwrite feature switch _pName
+		PermutationKey& set(const char* _pName, bool _value) { return add(_pName, _value ? 1u : 0u, PermutationValue::Kind::Switch); }
+		PermutationKey& set(const char* _pName, int _value) { return add(_pName, static_cast<unsigned int>(_value), PermutationValue::Kind::Switch); }
+		PermutationKey& set(const char* _pName, unsigned int _value) { return add(_pName, _value, PermutationValue::Kind::Switch); }
+
+		// add or overwrite the default value of OpSpecConstant / OpSpecConstantTrue / OpSpecConstantFalse _pName
+		PermutationKey& specConstant(const char* _pName, bool _value) { return add(_pName, _value ? 1u : 0u, PermutationValue::Kind::SpecConstant); }
+
+		template <class T> // 32 bit scalar (int, unsigned int, float)
+		PermutationKey& specConstant(const char* _pName, const T& _value);
+
+		// switch and spec constant names are separate, the getters read switches
+		const PermutationValue* find(const char* _pName, PermutationValue::Kind _kind = PermutationValue::Kind::Switch) const;
+
+		bool getBool(const char* _pName, bool _default = false) const;
+		int getInt(const char* _pName, int _default = 0) const;
+		unsigned int getUInt(const char* _pName, unsigned int _default = 0u) const;
+
+		const Vector<PermutationValue>& getValues() const { return m_values; }
+
+	private:
+		PermutationKey& add(const char* _pName, unsigned int _value, PermutationValue::Kind _kind);
+
+	private:
+		Vector<PermutationValue> m_values;
+	};
+
+	template<class T>
+	inline PermutationKey& PermutationKey::specConstant(const char* _pName, const T& _value)
+	{
+		static_assert(sizeof(T) == sizeof(unsigned int), "Only 32 bit spec constants are supported");
+
+		unsigned int bits = 0u;
+		const void* pErased = &_value;
+		void* pBits = &bits;
+		for (sgt_size_t i = 0u; i < sizeof(T); ++i)
+		{
+			static_cast<unsigned char*>(pBits)[i] = static_cast<const unsigned char*>(pErased)[i];
+		}
+
+		return add(_pName, bits, PermutationValue::Kind::SpecConstant);
+	}
+
+	struct PermutationResult
+	{
+		Hash64 hash = 0u; // content hash of the binary
+		const Vector<unsigned int>* pBinary = nullptr; // shared by all keys producing the same binary, nullptr if the variant failed
+	};
+
+	// runs a generator for each PermutationKey on a pool of worker threads. each worker owns a Module backed by a reusable arena,
+	// the module is reset() before each variant, then finalized and written. Identical binaries are stored once.
+	// the logger, grammar and type inference are shared by all workers and must be thread safe for concurrent use.
+	// build() must not be called concurrently
+	class PermutationBuilder
+	{
+	public:
+		// fill _module for _key, return false if the variant could not be generated
+		using Generator = bool(*)(Module& _module, const PermutationKey& _key, void* _pUserData);
+
+		// _threadCount == 0 uses the number of hardware threads
+		PermutationBuilder(IAllocator* _pAllocator, const Grammar* _pGrammar = nullptr, ILogger* _pLogger = nullptr, ITypeInferenceAndVailation* _pTypeInferenceAndVailation = nullptr, unsigned int _threadCount = 0u);
+		~PermutationBuilder();
+
+		PermutationBuilder(const PermutationBuilder&) = delete;
+		PermutationBuilder& operator=(const PermutationBuilder&) = delete;
+
+		// generate all _keys, results are appended to getResults() in the order of _keys. returns true if all variants were built
+		bool build(const PermutationKey* _pKeys, unsigned int _count, Generator _generator, void* _pUserData = nullptr);
+
+		// _generator: bool(Module&, const PermutationKey&)
+		template <class Func>
+		bool build(const Vector<PermutationKey>& _keys, Func _generator);
+
+		// one result per key passed to build()
+		const Vector<PermutationResult>& getResults() const { return m_results; }
+
+		// unique binaries by content hash
+		const HashMap<Hash64, Vector<unsigned int>>& getBinaries() const { return m_binaries; }
+
+		unsigned int getThreadCount() const { return m_threadCount; }
+
+		// remove all results and binaries
+		void clear();
+
+	private:
+		// store _binary if no identical binary exists, called by workers
+		const Vector<unsigned int>* insert(Hash64 _hash, const Vector<unsigned int>& _binary);
+
+		struct Pool;
+		friend struct Pool;
+
+	private:
+		IAllocator* m_pAllocator = nullptr;
+		const Grammar* m_pGrammar = nullptr;
+		unsigned int m_threadCount = 1u;
+
+		Vector<PermutationResult> m_results;
+		HashMap<Hash64, Vector<unsigned int>> m_binaries;
+
+		Pool* m_pPool = nullptr;
+	};
+
+	template<class Func>
+	inline bool PermutationBuilder::build(const Vector<PermutationKey>& _keys, Func _generator)
+	{
+		auto generate = [](Module& _module, const PermutationKey& _key, void* _pUserData) -> bool
+		{
+			return (*static_cast<Func*>(_pUserData))(_module, _key);
+		};
+
+		return build(_keys.data(), static_cast<unsigned int>(_keys.size()), generate, &_generator);
+	}
+} // !spvgentwo
@@ -0,0 +1,30 @@
+#pragma once
+
+#include "spvgentwo/HashMap.h"
+
+namespace spvgentwo
+{
+	// forward decls
+	class Module;
+	class IConstantFolder;
+
+	namespace SpecConstantFreezing
+	{
+		// SpecId -> value, 32 bit types use the lower word, float values are passed as bits (e.g. bitcast<unsigned int>(1.f)), bools are false for 0
+		using Values = HashMap<unsigned int, sgt_uint64_t>;
+
+		struct Result
+		{
+			unsigned int frozenConstants = 0u; // OpSpecConstant/True/False replaced by a value of _values
+			unsigned int foldedConstants = 0u; // OpSpecConstantComposite and OpSpecConstantOp evaluated to a constant
+			unsigned int foldedBranches = 0u; // OpBranchConditional and OpSwitch with a constant condition replaced by OpBranch
+			unsigned int removedBlocks = 0u; // basic blocks that became unreachable
+		};
+
+		// replace all scalar spec constants decorated with a SpecId in _values by regular constants, evaluate dependent OpSpecConstantComposite and
+		// OpSpecConstantOp instructions with _pFolder (module folder or IConstantFolder default if nullptr), then fold conditional branches and switches
+		// on constant conditions and remove unreachable blocks. Names and decorations of replaced instructions are removed,
+		// spec constants without a value in _values are left as they are
+		Result freeze(Module& _module, const Values& _values, const IConstantFolder* _pFolder = nullptr, IAllocator* _pAllocator = nullptr);
+	} // !SpecConstantFreezing
+} // !spvgentwo
@@ -0,0 +1,34 @@
+#pragma once
+
+namespace spvgentwo
+{
+	// forward decls
+	class Module;
+	class Function;
+	class IAllocator;
+	class FunctionAnalyses;
+
+	// mem2reg
+	namespace VariablePromotion
+	{
+		struct Result
+		{
+			unsigned int promotedVariables = 0u;
+			unsigned int removedLoads = 0u;
+			unsigned int removedStores = 0u;
+			unsigned int insertedPhis = 0u;
+		};
+
+		// promote Function storage class OpVariables of scalar or vector type which are only used as pointer operand of OpLoad and OpStore
+		// (no OpAccessChain, OpFunctionCall or other escapes, no decorations and no volatile access) to SSA values:
+		// OpPhis are placed on the iterated dominance frontiers of the stores (see DominatorTree), unused OpPhis are removed again.
+		// loads are replaced by the value reaching them (the initializer or OpUndef if there is no store), loads, stores and variables are removed
+		Result promote(Function& _func, IAllocator* _pAllocator = nullptr);
+
+		// same as above, reusing the dominator tree of _analyses (see PassManager). analyses depending on the instructions are invalidated
+		Result promote(Function& _func, FunctionAnalyses& _analyses, IAllocator* _pAllocator = nullptr);
+
+		// promote variables of all functions and entry points of _module
+		Result promote(Module& _module, IAllocator* _pAllocator = nullptr);
+	} // !VariablePromotion
+} // !spvgentwo
@@ -1,4 +1,5 @@
 #include "common/BinaryFileReader.h"
+#include "common/ByteSwap.h"
 #include <cstdio>
 
 spvgentwo::BinaryFileReader::BinaryFileReader(IAllocator& _allocator, const char* _path, sgt_size_t _offset, sgt_size_t _length) :
@@ -78,7 +79,14 @@ bool spvgentwo::BinaryFileReader::read(const char* _path, sgt_size_t _offset, sg
 				return false;
 			}
 
-			return fread(m_buffer.data(), sizeof(sgt_uint32_t), count, file) == count;
+			if (fread(m_buffer.data(), sizeof(sgt_uint32_t), count, file) != count)
+			{
+				return false;
+			}
+
+			// SPIR-V written with the opposite endianness is swapped in bulk here instead of word by word in Module::read
+			ByteSwap::toNative(m_buffer.data(), count);
+			return true;
 		}
 	}
 
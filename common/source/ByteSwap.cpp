@@ -0,0 +1,64 @@
+#include "common/ByteSwap.h"
+
+#include "spvgentwo/SpvDefines.h"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define SPVGENTWO_BYTESWAP_AVX2
+#elif defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#include <emmintrin.h>
+#define SPVGENTWO_BYTESWAP_SSE2
+#elif defined(__ARM_NEON) || defined(_M_ARM64)
+#include <arm_neon.h>
+#define SPVGENTWO_BYTESWAP_NEON
+#endif
+
+void spvgentwo::ByteSwap::swap(unsigned int* _pWords, sgt_size_t _count)
+{
+	sgt_size_t i = 0u;
+
+#if defined(SPVGENTWO_BYTESWAP_AVX2)
+	const __m256i shuffle = _mm256_setr_epi8(
+		3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+		3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+
+	for (; i + 8u <= _count; i += 8u)
+	{
+		__m256i* p = reinterpret_cast<__m256i*>(_pWords + i);
+		_mm256_storeu_si256(p, _mm256_shuffle_epi8(_mm256_loadu_si256(p), shuffle));
+	}
+#elif defined(SPVGENTWO_BYTESWAP_SSE2)
+	const __m128i mask = _mm_set1_epi32(0x00FF00FF);
+
+	for (; i + 4u <= _count; i += 4u)
+	{
+		__m128i* p = reinterpret_cast<__m128i*>(_pWords + i);
+		__m128i v = _mm_loadu_si128(p);
+		v = _mm_or_si128(_mm_slli_epi32(v, 16), _mm_srli_epi32(v, 16)); // swap 16 bit halves
+		v = _mm_or_si128(_mm_slli_epi16(_mm_and_si128(v, mask), 8), _mm_and_si128(_mm_srli_epi16(v, 8), mask)); // swap bytes in halves
+		_mm_storeu_si128(p, v);
+	}
+#elif defined(SPVGENTWO_BYTESWAP_NEON)
+	for (; i + 4u <= _count; i += 4u)
+	{
+		unsigned char* p = reinterpret_cast<unsigned char*>(_pWords + i);
+		vst1q_u8(p, vrev32q_u8(vld1q_u8(p)));
+	}
+#endif
+
+	for (; i < _count; ++i)
+	{
+		_pWords[i] = byteSwap(_pWords[i]);
+	}
+}
+
+bool spvgentwo::ByteSwap::toNative(unsigned int* _pWords, sgt_size_t _count)
+{
+	if (_pWords == nullptr || _count == 0u || _pWords[0] != byteSwap(spv::MagicNumber))
+	{
+		return false;
+	}
+
+	swap(_pWords, _count);
+	return true;
+}
@@ -0,0 +1,403 @@
+#include "common/Canonicalization.h"
+
+#include "spvgentwo/Module.h"
+#include "spvgentwo/FNV1aHasher.h"
+#include "spvgentwo/ModuleTemplate.inl"
+
+namespace
+{
+	using namespace spvgentwo;
+
+	constexpr unsigned int Unranked = ~0u;
+
+	// order independent hash of the names and decorations targeting an instruction
+	using Annotations = HashMap<const Instruction*, sgt_uint64_t>;
+
+	// position of every instruction with a result id in serialization order
+	using Positions = HashMap<const Instruction*, unsigned int>;
+
+	int compare(unsigned int _left, unsigned int _right)
+	{
+		return _left < _right ? -1 : (_left > _right ? 1 : 0);
+	}
+
+	// stable merge sort of [_pBegin, _pEnd), _pScratch must hold _pEnd - _pBegin elements
+	template <class T, class Less>
+	void mergeSort(T* _pBegin, T* _pEnd, T* _pScratch, const Less& _less)
+	{
+		const sgt_size_t count = static_cast<sgt_size_t>(_pEnd - _pBegin);
+		if (count < 2u)
+		{
+			return;
+		}
+
+		T* mid = _pBegin + count / 2u;
+		mergeSort(_pBegin, mid, _pScratch, _less);
+		mergeSort(mid, _pEnd, _pScratch, _less);
+
+		T* l = _pBegin;
+		T* r = mid;
+		T* out = _pScratch;
+
+		while (l != mid && r != _pEnd)
+		{
+			*out++ = _less(*r, *l) ? *r++ : *l++;
+		}
+		while (l != mid)
+		{
+			*out++ = *l++;
+		}
+		while (r != _pEnd)
+		{
+			*out++ = *r++;
+		}
+
+		for (sgt_size_t i = 0u; i < count; ++i)
+		{
+			_pBegin[i] = _pScratch[i];
+		}
+	}
+
+	template <class T, class Less>
+	void sort(Vector<T>& _elements, sgt_size_t _begin, sgt_size_t _end, IAllocator* _pAllocator, const Less& _less)
+	{
+		Vector<T> scratch(_pAllocator);
+		scratch.resize(_end - _begin);
+		mergeSort(_elements.data() + _begin, _elements.data() + _end, scratch.data(), _less);
+	}
+
+	// compares opcode and operands, the result id is ignored and referenced instructions are compared by _rank(instr)
+	template <class Rank>
+	int compareInstructions(const Instruction& _left, const Instruction& _right, const Rank& _rank)
+	{
+		if (int c = compare(static_cast<unsigned int>(_left.getOperation()), static_cast<unsigned int>(_right.getOperation())); c != 0)
+		{
+			return c;
+		}
+
+		if (int c = compare(static_cast<unsigned int>(_left.size()), static_cast<unsigned int>(_right.size())); c != 0)
+		{
+			return c;
+		}
+
+		auto value = [&_rank](const Operand& _op) -> unsigned int
+		{
+			switch (_op.type)
+			{
+			case Operand::Type::Literal: return _op.literal.value;
+			case Operand::Type::Instruction: return _rank(_op.instruction);
+			case Operand::Type::Id: return static_cast<unsigned int>(_op.id);
+			default: return 0u;
+			}
+		};
+
+		const auto resultId = _left.getResultIdOperand(); // same position in _right
+		for (auto l = _left.begin(), r = _right.begin(); l != _left.end(); ++l, ++r)
+		{
+			if (l == resultId)
+			{
+				continue;
+			}
+
+			if (int c = compare(static_cast<unsigned int>(l->type), static_cast<unsigned int>(r->type)); c != 0)
+			{
+				return c;
+			}
+
+			if (int c = compare(value(*l), value(*r)); c != 0)
+			{
+				return c;
+			}
+		}
+
+		return 0;
+	}
+
+	bool isMemberAnnotation(const Instruction& _instr)
+	{
+		switch (_instr.getOperation())
+		{
+		case spv::Op::OpMemberName:
+		case spv::Op::OpMemberDecorate:
+		case spv::Op::OpMemberDecorateString:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	void addAnnotations(Annotations& _annotations, const List<Instruction>& _list)
+	{
+		for (const Instruction& instr : _list)
+		{
+			const Instruction* target = instr.empty() ? nullptr : instr.front().getInstruction();
+			if (target == nullptr)
+			{
+				continue;
+			}
+
+			FNV1aHasher h;
+			h << instr.getOperation();
+			for (auto it = instr.begin().next(); it != instr.end(); ++it)
+			{
+				if (it->isLiteral())
+				{
+					h << it->literal.value;
+				}
+				else if (it->isInstruction())
+				{
+					h << it->instruction->getOperation();
+				}
+			}
+
+			_annotations.emplaceUnique(target, 0ull).kv.value += h.get().value;
+		}
+	}
+
+	// relinks the entries of _list in _order, returns the number of instructions that changed position
+	unsigned int relink(List<Instruction>& _list, const Vector<Entry<Instruction>*>& _order)
+	{
+		unsigned int moved = 0u;
+		sgt_size_t index = 0u;
+		for (auto it = _list.begin(); it != _list.end(); ++it, ++index)
+		{
+			moved += it.entry() != _order[index] ? 1u : 0u;
+		}
+
+		if (moved == 0u)
+		{
+			return 0u;
+		}
+
+		for (auto it = _list.begin(); it != _list.end();)
+		{
+			it = _list.erase(it, false);
+		}
+
+		for (Entry<Instruction>* entry : _order)
+		{
+			_list.append_entry(entry);
+		}
+
+		return moved;
+	}
+
+	unsigned int sortTypesAndConstants(Module& _module, const Annotations& _annotations, IAllocator* _pAllocator)
+	{
+		List<Instruction>& list = _module.getTypesAndConstants();
+
+		HashMap<const Instruction*, unsigned int> indices(_pAllocator, static_cast<unsigned int>(list.size() / 2u + 1u));
+		HashMap<const Instruction*, bool> forwardDeclared(_pAllocator);
+		Vector<Entry<Instruction>*> entries(_pAllocator, list.size());
+
+		for (auto it = list.begin(); it != list.end(); ++it)
+		{
+			indices.emplaceUnique(it.operator->(), static_cast<unsigned int>(entries.size()));
+			entries.emplace_back(it.entry());
+
+			if (*it == spv::Op::OpTypeForwardPointer && it->empty() == false)
+			{
+				forwardDeclared.emplaceUnique(it->front().getInstruction(), true);
+			}
+		}
+
+		// calls _func(index) for every operand defined in list, pointers declared by OpTypeForwardPointer can be used before their definition
+		auto forEachDependency = [&](const Instruction& _instr, auto _func)
+		{
+			if (_instr == spv::Op::OpTypeForwardPointer)
+			{
+				return;
+			}
+
+			for (const Operand& op : _instr)
+			{
+				const Instruction* dependency = op.getInstruction();
+				if (const unsigned int* pIndex = indices.get(dependency); pIndex != nullptr && forwardDeclared.get(dependency) == nullptr)
+				{
+					_func(*pIndex);
+				}
+			}
+		};
+
+		// 0 for instructions without dependencies, 1 + maximum depth of the dependencies otherwise
+		Vector<unsigned int> depth(_pAllocator);
+		depth.resize(entries.size(), &Unranked);
+
+		auto getDepth = [&](auto& _self, unsigned int _index) -> unsigned int
+		{
+			if (depth[_index] == Unranked)
+			{
+				depth[_index] = 0u; // invalid cycles
+				unsigned int d = 0u;
+				forEachDependency(**entries[_index], [&](unsigned int _dependency)
+				{
+					const unsigned int dd = _self(_self, _dependency) + 1u;
+					d = dd > d ? dd : d;
+				});
+				depth[_index] = d;
+			}
+			return depth[_index];
+		};
+
+		Vector<unsigned int> order(_pAllocator, entries.size());
+		for (unsigned int i = 0u; i < entries.size(); ++i)
+		{
+			getDepth(getDepth, i);
+			order.emplace_back(i);
+		}
+
+		sort(order, 0u, order.size(), _pAllocator, [&depth](unsigned int _l, unsigned int _r) { return depth[_l] < depth[_r]; });
+
+		// instructions of one depth don't depend on each other, sort them structurally once all lower depths are ranked
+		Vector<unsigned int> rank(_pAllocator);
+		rank.resize(entries.size(), &Unranked);
+
+		auto rankOf = [&](const Instruction* _pInstr) -> unsigned int
+		{
+			const unsigned int* pIndex = indices.get(_pInstr);
+			return pIndex != nullptr ? rank[*pIndex] : Unranked;
+		};
+
+		auto annotationsOf = [&_annotations](const Instruction* _pInstr) -> sgt_uint64_t
+		{
+			const sgt_uint64_t* pHash = _annotations.get(_pInstr);
+			return pHash != nullptr ? *pHash : 0ull;
+		};
+
+		auto less = [&](unsigned int _l, unsigned int _r) -> bool
+		{
+			const Instruction& l = **entries[_l];
+			const Instruction& r = **entries[_r];
+
+			if (int c = compareInstructions(l, r, rankOf); c != 0)
+			{
+				return c < 0;
+			}
+
+			// structurally equal, e.g. structs with different member offsets
+			return annotationsOf(&l) < annotationsOf(&r);
+		};
+
+		for (sgt_size_t begin = 0u; begin < order.size();)
+		{
+			sgt_size_t end = begin + 1u;
+			while (end < order.size() && depth[order[end]] == depth[order[begin]])
+			{
+				++end;
+			}
+
+			sort(order, begin, end, _pAllocator, less);
+
+			for (sgt_size_t i = begin; i < end; ++i)
+			{
+				rank[order[i]] = static_cast<unsigned int>(i);
+			}
+
+			begin = end;
+		}
+
+		Vector<Entry<Instruction>*> sorted(_pAllocator, entries.size());
+		for (unsigned int index : order)
+		{
+			sorted.emplace_back(entries[index]);
+		}
+
+		return relink(list, sorted);
+	}
+
+	// sorts by (target, member, opcode, operands), OpDecorate and OpName are ordered before member annotations of the same target
+	unsigned int sortAnnotations(List<Instruction>& _list, const Positions& _positions, IAllocator* _pAllocator)
+	{
+		Vector<Entry<Instruction>*> entries(_pAllocator, _list.size());
+		for (auto it = _list.begin(); it != _list.end(); ++it)
+		{
+			entries.emplace_back(it.entry());
+		}
+
+		auto positionOf = [&_positions](const Instruction* _pInstr) -> unsigned int
+		{
+			const unsigned int* pPos = _positions.get(_pInstr);
+			return pPos != nullptr ? *pPos : Unranked;
+		};
+
+		auto key = [&](const Instruction& _instr, unsigned int& _target, unsigned int& _member)
+		{
+			auto it = _instr.begin();
+			_target = it != nullptr && it->isInstruction() ? positionOf(it->instruction) : (it != nullptr ? static_cast<unsigned int>(it->getId()) : 0u);
+			_member = isMemberAnnotation(_instr) && it.next() != nullptr ? it.next()->getLiteral().value + 1u : 0u;
+		};
+
+		sort(entries, 0u, entries.size(), _pAllocator, [&](Entry<Instruction>* _pLeft, Entry<Instruction>* _pRight) -> bool
+		{
+			const Instruction& l = **_pLeft;
+			const Instruction& r = **_pRight;
+
+			unsigned int lTarget = 0u, lMember = 0u, rTarget = 0u, rMember = 0u;
+			key(l, lTarget, lMember);
+			key(r, rTarget, rMember);
+
+			if (lTarget != rTarget)
+			{
+				return lTarget < rTarget;
+			}
+			if (lMember != rMember)
+			{
+				return lMember < rMember;
+			}
+
+			return compareInstructions(l, r, positionOf) < 0;
+		});
+
+		return relink(_list, entries);
+	}
+
+	bool hasDecorationGroups(const List<Instruction>& _decorations)
+	{
+		for (const Instruction& instr : _decorations)
+		{
+			if (instr == spv::Op::OpDecorationGroup || instr == spv::Op::OpGroupDecorate || instr == spv::Op::OpGroupMemberDecorate)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+}
+
+spvgentwo::Canonicalization::Result spvgentwo::Canonicalization::canonicalize(Module& _module, IAllocator* _pAllocator)
+{
+	IAllocator* pAllocator = _pAllocator == nullptr ? _module.getAllocator() : _pAllocator;
+
+	// shared instructions reference the types and constants of the module they were cloned from by id
+	_module.unshareAll();
+
+	Result result;
+
+	Annotations annotations(pAllocator);
+	addAnnotations(annotations, _module.getNames());
+	addAnnotations(annotations, _module.getDecorations());
+
+	result.movedTypesAndConstants = sortTypesAndConstants(_module, annotations, pAllocator);
+
+	// targets of names and decorations by their final result id, decorations and names don't define ids themselves (except decoration groups)
+	Positions positions(pAllocator);
+	unsigned int position = 0u;
+	_module.iterateInstructions([&positions, &position](const Instruction& _instr)
+	{
+		if (_instr.getResultIdOperand() != nullptr)
+		{
+			positions.emplaceUnique(&_instr, position++);
+		}
+	});
+
+	if (hasDecorationGroups(_module.getDecorations()) == false)
+	{
+		result.movedDecorations = sortAnnotations(_module.getDecorations(), positions, pAllocator);
+	}
+
+	result.movedNames = sortAnnotations(_module.getNames(), positions, pAllocator);
+
+	_module.assignIDs();
+
+	return result;
+}
@@ -0,0 +1,361 @@
+#include "common/CompressedBinary.h"
+#include "common/InstructionStream.h"
+
+#include "spvgentwo/SpvDefines.h"
+
+namespace
+{
+	constexpr unsigned int WordCountBits = 4u;
+	constexpr unsigned int WordCountEscape = (1u << WordCountBits) - 1u;
+	constexpr unsigned int HeaderWords = 5u;
+
+	constexpr unsigned int zigzag(unsigned int _delta)
+	{
+		return (_delta << 1u) ^ (0u - (_delta >> 31u));
+	}
+
+	constexpr unsigned int unzigzag(unsigned int _value)
+	{
+		return (_value >> 1u) ^ (0u - (_value & 1u));
+	}
+}
+
+spvgentwo::CompressedWriter::CompressedWriter(IWriter& _writer, const Grammar& _grammar, IAllocator* _pAllocator) :
+	m_writer(_writer),
+	m_grammar(_grammar),
+	m_instr(_pAllocator)
+{
+	m_instr.reserve(16u);
+}
+
+bool spvgentwo::CompressedWriter::put(unsigned int _word)
+{
+	if (m_flushed)
+	{
+		return false;
+	}
+
+	m_instr.emplace_back(_word);
+
+	if (++m_inputWords <= HeaderWords)
+	{
+		if (m_inputWords < HeaderWords)
+		{
+			return true;
+		}
+
+		if (m_instr[0] != spv::MagicNumber || m_writer.put(Magic) == false)
+		{
+			return false;
+		}
+
+		m_outputBytes += sizeof(unsigned int);
+
+		for (unsigned int i = 1u; i < HeaderWords; ++i)
+		{
+			if (varint(m_instr[i]) == false)
+			{
+				return false;
+			}
+		}
+
+		m_instr.clear();
+		return true;
+	}
+
+	const unsigned int wordCount = m_instr[0] >> spv::WordCountShift;
+	if (wordCount == 0u)
+	{
+		return false;
+	}
+
+	if (m_instr.size() == wordCount)
+	{
+		const bool success = encode();
+		m_instr.clear();
+		return success;
+	}
+
+	return true;
+}
+
+bool spvgentwo::CompressedWriter::flush()
+{
+	m_flushed = true;
+
+	if (m_pendingBytes != 0u)
+	{
+		// remaining bytes are zero which terminates the stream
+		if (m_writer.put(m_pending) == false)
+		{
+			return false;
+		}
+		m_pending = 0u;
+		m_pendingBytes = 0u;
+	}
+
+	return m_instr.empty(); // incomplete instruction
+}
+
+bool spvgentwo::CompressedWriter::encode()
+{
+	const unsigned int wordCount = static_cast<unsigned int>(m_instr.size());
+	const spv::Op op = static_cast<spv::Op>(m_instr[0] & spv::OpCodeMask);
+
+	if (varint((static_cast<unsigned int>(op) << WordCountBits) | (wordCount < WordCountEscape ? wordCount : WordCountEscape)) == false)
+	{
+		return false;
+	}
+
+	if (wordCount >= WordCountEscape && varint(wordCount - WordCountEscape) == false)
+	{
+		return false;
+	}
+
+	OperandKindCursor cursor(m_grammar, op);
+
+	for (unsigned int i = 1u; i < wordCount; ++i)
+	{
+		const unsigned int word = m_instr[i];
+		const Grammar::OperandKind kind = cursor.getKind();
+		bool success = true;
+
+		if (kind == Grammar::OperandKind::IdResult)
+		{
+			success = varint(zigzag(word - (m_lastResult + 1u)));
+			m_lastResult = word;
+		}
+		else if (InstructionStream::isIdKind(kind))
+		{
+			success = varint(zigzag(m_lastResult - word));
+		}
+		else if (kind == Grammar::OperandKind::LiteralString)
+		{
+			for (unsigned int b = 0u; b < sizeof(unsigned int) && success; ++b)
+			{
+				success = byte(static_cast<unsigned char>(word >> (b * 8u)));
+			}
+		}
+		else
+		{
+			success = varint(word);
+		}
+
+		if (success == false)
+		{
+			return false;
+		}
+
+		cursor.advance(word);
+	}
+
+	return true;
+}
+
+bool spvgentwo::CompressedWriter::byte(unsigned char _byte)
+{
+	++m_outputBytes;
+	m_pending |= static_cast<unsigned int>(_byte) << (m_pendingBytes * 8u);
+
+	if (++m_pendingBytes == sizeof(unsigned int))
+	{
+		const unsigned int word = m_pending;
+		m_pending = 0u;
+		m_pendingBytes = 0u;
+		return m_writer.put(word);
+	}
+
+	return true;
+}
+
+bool spvgentwo::CompressedWriter::varint(unsigned int _value)
+{
+	while (_value >= 0x80u)
+	{
+		if (byte(static_cast<unsigned char>(_value | 0x80u)) == false)
+		{
+			return false;
+		}
+		_value >>= 7u;
+	}
+
+	return byte(static_cast<unsigned char>(_value));
+}
+
+spvgentwo::CompressedReader::CompressedReader(IReader& _reader, const Grammar& _grammar, IAllocator* _pAllocator) :
+	m_reader(_reader),
+	m_grammar(_grammar),
+	m_instr(_pAllocator)
+{
+	m_instr.reserve(16u);
+}
+
+bool spvgentwo::CompressedReader::get(unsigned int& _word)
+{
+	if (m_pos < m_instr.size())
+	{
+		_word = m_instr[m_pos++];
+		return true;
+	}
+
+	switch (m_state)
+	{
+	case State::Start:
+		if (m_reader.get(_word) == false)
+		{
+			return false;
+		}
+
+		if (_word == spv::MagicNumber)
+		{
+			m_state = State::PassThrough;
+			return true;
+		}
+		else if (_word != CompressedWriter::Magic)
+		{
+			m_state = State::End;
+			return false;
+		}
+
+		m_instr.clear();
+		m_instr.emplace_back(spv::MagicNumber);
+
+		for (unsigned int i = 1u; i < HeaderWords; ++i)
+		{
+			unsigned int value = 0u;
+			if (varint(value) == false)
+			{
+				m_state = State::End;
+				return false;
+			}
+			m_instr.emplace_back(value);
+		}
+
+		m_state = State::Compressed;
+		m_pos = 1u;
+		_word = m_instr[0];
+		return true;
+	case State::PassThrough:
+		return m_reader.get(_word);
+	case State::Compressed:
+		if (decode() == false)
+		{
+			m_state = State::End;
+			return false;
+		}
+		m_pos = 1u;
+		_word = m_instr[0];
+		return true;
+	default:
+		return false;
+	}
+}
+
+bool spvgentwo::CompressedReader::decode()
+{
+	unsigned int head = 0u;
+	if (varint(head) == false || head == 0u) // end of stream
+	{
+		return false;
+	}
+
+	unsigned int wordCount = head & WordCountEscape;
+	const spv::Op op = static_cast<spv::Op>(head >> WordCountBits);
+
+	if (wordCount == WordCountEscape)
+	{
+		unsigned int extra = 0u;
+		if (varint(extra) == false)
+		{
+			return false;
+		}
+		wordCount += extra;
+	}
+
+	if (wordCount == 0u || wordCount > spv::OpCodeMask || static_cast<unsigned int>(op) > spv::OpCodeMask)
+	{
+		return false;
+	}
+
+	m_instr.clear();
+	m_instr.emplace_back((wordCount << spv::WordCountShift) | static_cast<unsigned int>(op));
+
+	OperandKindCursor cursor(m_grammar, op);
+
+	for (unsigned int i = 1u; i < wordCount; ++i)
+	{
+		const Grammar::OperandKind kind = cursor.getKind();
+		unsigned int word = 0u;
+
+		if (kind == Grammar::OperandKind::LiteralString)
+		{
+			for (unsigned int b = 0u; b < sizeof(unsigned int); ++b)
+			{
+				unsigned char c = 0u;
+				if (byte(c) == false)
+				{
+					return false;
+				}
+				word |= static_cast<unsigned int>(c) << (b * 8u);
+			}
+		}
+		else if (varint(word) == false)
+		{
+			return false;
+		}
+		else if (kind == Grammar::OperandKind::IdResult)
+		{
+			word = m_lastResult + 1u + unzigzag(word);
+			m_lastResult = word;
+		}
+		else if (InstructionStream::isIdKind(kind))
+		{
+			word = m_lastResult - unzigzag(word);
+		}
+
+		m_instr.emplace_back(word);
+		cursor.advance(word);
+	}
+
+	return true;
+}
+
+bool spvgentwo::CompressedReader::byte(unsigned char& _byte)
+{
+	if (m_wordBytes == 0u)
+	{
+		if (m_reader.get(m_word) == false)
+		{
+			return false;
+		}
+		m_wordBytes = sizeof(unsigned int);
+	}
+
+	_byte = static_cast<unsigned char>(m_word);
+	m_word >>= 8u;
+	--m_wordBytes;
+	return true;
+}
+
+bool spvgentwo::CompressedReader::varint(unsigned int& _value)
+{
+	_value = 0u;
+
+	for (unsigned int shift = 0u; shift < 35u; shift += 7u)
+	{
+		unsigned char b = 0u;
+		if (byte(b) == false)
+		{
+			return false;
+		}
+
+		_value |= static_cast<unsigned int>(b & 0x7fu) << shift;
+
+		if ((b & 0x80u) == 0u)
+		{
+			return true;
+		}
+	}
+
+	return false; // more than 5 bytes
+}
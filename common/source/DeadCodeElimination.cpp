@@ -0,0 +1,297 @@
+#include "common/DeadCodeElimination.h"
+#include "common/FunctionCallGraph.h"
+
+#include "spvgentwo/Module.h"
+#include "spvgentwo/ModuleTemplate.inl"
+
+namespace
+{
+	using namespace spvgentwo;
+
+	// OpFunction, OpFunctionParameters, labels and instructions of all basic blocks, OpFunctionEnd
+	template <class Func>
+	void forEachInstruction(const Function& _func, Func _f)
+	{
+		_f(*_func.getFunction());
+
+		for (const Instruction& param : _func.getParameters())
+		{
+			_f(param);
+		}
+
+		for (const BasicBlock& bb : _func)
+		{
+			_f(*bb.getLabel());
+
+			for (const Instruction& instr : bb)
+			{
+				_f(instr);
+			}
+		}
+
+		_f(*_func.getFunctionEnd());
+	}
+
+	sgt_size_t byteSize(const Instruction& _instr)
+	{
+		return (1u + _instr.size()) * sizeof(unsigned int);
+	}
+
+	class Marker
+	{
+	public:
+		Marker(IAllocator* _pAllocator, unsigned int _buckets) :
+			m_live(_pAllocator, _buckets), m_functions(_pAllocator), m_decorations(_pAllocator), m_worklist(_pAllocator)
+		{
+			m_worklist.reserve(_buckets);
+		}
+
+		bool isLive(const Instruction* _pInstr) const { return m_live.get(_pInstr) != nullptr; }
+		bool isLive(const Function* _pFunc) const { return m_functions.get(_pFunc) != nullptr; }
+
+		// returns true if _pInstr was not live before
+		bool mark(const Instruction* _pInstr)
+		{
+			if (_pInstr == nullptr || isLive(_pInstr))
+			{
+				return false;
+			}
+
+			m_live.emplaceUnique(_pInstr, true);
+			m_worklist.emplace_back(_pInstr);
+
+			// referencing any instruction of a function (e.g. OpFunction by OpFunctionCall) keeps the whole function
+			if (const Function* func = _pInstr->getFunction(); func != nullptr)
+			{
+				mark(*func);
+			}
+
+			return true;
+		}
+
+		void mark(const Function& _func)
+		{
+			if (isLive(&_func) == false)
+			{
+				m_functions.emplaceUnique(&_func, true);
+				forEachInstruction(_func, [this](const Instruction& _instr) { mark(&_instr); });
+			}
+		}
+
+		void markOperands(const Instruction& _instr)
+		{
+			for (const Operand& op : _instr)
+			{
+				if (op.isInstruction())
+				{
+					mark(op.getInstruction());
+				}
+				else if (op.isBranchTarget())
+				{
+					mark(op.getBranchTarget()->getLabel());
+				}
+			}
+		}
+
+		// operands of _decoration become live with _pTarget, call before propagate()
+		void addDecoration(const Instruction* _pTarget, const Instruction& _decoration)
+		{
+			m_decorations.emplace(_pTarget, &_decoration);
+		}
+
+		// mark operands of all instructions (and their decorations) added since the last call, returns true if any instruction was added
+		bool propagate()
+		{
+			const sgt_size_t begin = m_next;
+
+			// m_worklist grows while iterating
+			for (; m_next < m_worklist.size(); ++m_next)
+			{
+				const Instruction* instr = m_worklist[m_next];
+				markOperands(*instr);
+
+				for (const auto& node : m_decorations.getRange(instr))
+				{
+					if (node.kv.key == instr)
+					{
+						markOperands(*node.kv.value);
+					}
+				}
+			}
+
+			return begin != m_next;
+		}
+
+	private:
+		HashMap<const Instruction*, bool> m_live;
+		HashMap<const Function*, bool> m_functions;
+		HashMap<const Instruction*, const Instruction*> m_decorations; // target -> decoration referencing other instructions
+		Vector<const Instruction*> m_worklist;
+		sgt_size_t m_next = 0u;
+	};
+
+	const Instruction* getTarget(const Instruction& _instr)
+	{
+		return _instr.empty() ? nullptr : _instr.front().getInstruction();
+	}
+
+	// true if an operand following the target is an instruction
+	bool hasInstructionOperands(const Instruction& _decoration)
+	{
+		if (_decoration.empty())
+		{
+			return false;
+		}
+
+		for (auto it = _decoration.begin().next(); it != nullptr; ++it)
+		{
+			if (it->isInstruction())
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	bool isLinkageDecoration(const Instruction& _decoration)
+	{
+		if (_decoration.getOperation() != spv::Op::OpDecorate || _decoration.size() < 2u)
+		{
+			return false;
+		}
+
+		const Operand& decoration = *_decoration.begin().next();
+		return decoration.isLiteral() && decoration.getLiteral().value == static_cast<unsigned int>(spv::Decoration::LinkageAttributes);
+	}
+}
+
+spvgentwo::DeadCodeElimination::Result spvgentwo::DeadCodeElimination::eliminate(Module& _module, IAllocator* _pAllocator)
+{
+	IAllocator* pAllocator = _pAllocator == nullptr ? _module.getAllocator() : _pAllocator;
+
+	// shared instructions reference the types and constants of the module they were cloned from
+	_module.unshareAll();
+
+	unsigned int count = 0u;
+	_module.iterateInstructions([&count](const Instruction&) { ++count; });
+
+	Marker marker(pAllocator, count / 2u + 1u);
+
+	// roots
+	for (const auto& [cap, instr] : _module.getCapabilities())
+	{
+		marker.mark(&instr);
+	}
+	for (const auto& [name, instr] : _module.getExtensions())
+	{
+		marker.mark(&instr);
+	}
+	for (const auto& [name, instr] : _module.getExtInstrImports())
+	{
+		marker.mark(&instr);
+	}
+
+	marker.mark(&_module.getMemoryModel());
+
+	auto markAll = [&marker](const List<Instruction>& _container)
+	{
+		for (const Instruction& instr : _container)
+		{
+			marker.mark(&instr);
+		}
+	};
+
+	markAll(_module.getExecutionModes());
+	markAll(_module.getSourceStrings());
+	markAll(_module.getModulesProcessed());
+	markAll(_module.getLines());
+
+	for (const EntryPoint& ep : _module.getEntryPoints())
+	{
+		marker.mark(ep.getEntryPoint());
+
+		const FunctionCallGraph callGraph(ep, pAllocator);
+		for (const FunctionCallGraph::NodeType& node : callGraph)
+		{
+			marker.mark(*node.data());
+		}
+	}
+
+	for (const Instruction& decoration : _module.getDecorations())
+	{
+		switch (decoration.getOperation())
+		{
+		case spv::Op::OpDecorationGroup:
+		case spv::Op::OpGroupDecorate: // conservatively keep all targets of decoration groups
+		case spv::Op::OpGroupMemberDecorate:
+			marker.mark(&decoration);
+			break;
+		default:
+			if (isLinkageDecoration(decoration)) // exported or imported symbol
+			{
+				marker.mark(getTarget(decoration));
+			}
+			else if (hasInstructionOperands(decoration)) // OpDecorateId
+			{
+				marker.addDecoration(getTarget(decoration), decoration);
+			}
+			break;
+		}
+	}
+
+	marker.propagate();
+
+	// sweep
+	Result result;
+
+	auto sweep = [&](List<Instruction>& _container, bool _debug)
+	{
+		for (auto it = _container.begin(); it != _container.end();)
+		{
+			const Instruction* instr = it.operator->();
+			if (marker.isLive(instr) || (_debug && marker.isLive(getTarget(*instr))))
+			{
+				++it;
+				continue;
+			}
+
+			++result.removedInstructions;
+			result.savedBytes += byteSize(*instr);
+
+			if (_debug == false)
+			{
+				_module.removeFromLookupMaps(instr);
+			}
+
+			it = _container.erase(it);
+		}
+	};
+
+	// names and decorations of dead instructions first, they reference them
+	sweep(_module.getNames(), true);
+	sweep(_module.getDecorations(), true);
+
+	for (auto it = _module.getFunctions().begin(); it != _module.getFunctions().end();)
+	{
+		if (marker.isLive(static_cast<const Function*>(it.operator->())))
+		{
+			++it;
+			continue;
+		}
+
+		forEachInstruction(*it, [&_module, &result](const Instruction& _instr)
+		{
+			result.savedBytes += byteSize(_instr);
+			_module.removeFromLookupMaps(&_instr);
+		});
+
+		it = _module.getFunctions().erase(it);
+		++result.removedFunctions;
+	}
+
+	sweep(_module.getGlobalVariables(), false);
+	sweep(_module.getUndefs(), false);
+	sweep(_module.getTypesAndConstants(), false);
+
+	return result;
+}
@@ -0,0 +1,181 @@
+#include "common/DominatorTree.h"
+
+#include "spvgentwo/Function.h"
+
+namespace
+{
+	using namespace spvgentwo;
+
+	void postOrder(BasicBlock* _pBB, HashMap<const BasicBlock*, bool>& _visited, Vector<BasicBlock*>& _outOrder)
+	{
+		_visited.emplaceUnique(_pBB, true);
+
+		List<BasicBlock*> successors(_outOrder.getAllocator());
+		_pBB->getBranchTargets(successors);
+
+		// visit the last successor first, the reverse post order then keeps the true block of a branch before the false block
+		for (auto it = successors.last(); it != nullptr; --it)
+		{
+			if (BasicBlock* successor = *it; successor != nullptr && _visited.get(static_cast<const BasicBlock*>(successor)) == nullptr)
+			{
+				postOrder(successor, _visited, _outOrder);
+			}
+		}
+
+		_outOrder.emplace_back(_pBB);
+	}
+}
+
+spvgentwo::DominatorTree::DominatorTree(const Function& _func, IAllocator* _pAllocator) :
+	m_blocks(_pAllocator != nullptr ? _pAllocator : _func.getAllocator()),
+	m_indices(m_blocks.getAllocator()),
+	m_nodes(m_blocks.getAllocator())
+{
+	if (_func.empty())
+	{
+		return;
+	}
+
+	IAllocator* pAllocator = m_blocks.getAllocator();
+
+	Vector<BasicBlock*> order(pAllocator, _func.size());
+	{
+		HashMap<const BasicBlock*, bool> visited(pAllocator, static_cast<unsigned int>(_func.size()));
+		postOrder(const_cast<BasicBlock*>(&_func.front()), visited, order);
+	}
+
+	const unsigned int count = static_cast<unsigned int>(order.size());
+	m_blocks.reserve(count);
+	m_nodes.reserve(count);
+	m_indices = HashMap<const BasicBlock*, unsigned int>(pAllocator, count);
+
+	for (unsigned int i = 0u; i < count; ++i)
+	{
+		BasicBlock* bb = order[count - 1u - i];
+		m_blocks.emplace_back(bb);
+		m_nodes.emplace_back(pAllocator);
+		m_indices.emplaceUnique(bb, i);
+	}
+
+	for (unsigned int i = 0u; i < count; ++i)
+	{
+		List<BasicBlock*> successors(pAllocator);
+		m_blocks[i]->getBranchTargets(successors);
+
+		for (BasicBlock* successor : successors)
+		{
+			if (const unsigned int* index = m_indices.get(static_cast<const BasicBlock*>(successor)); index != nullptr)
+			{
+				m_nodes[*index].predecessors.emplace_back(m_blocks[i]);
+			}
+		}
+	}
+
+	auto intersect = [this](unsigned int _a, unsigned int _b) -> unsigned int
+	{
+		while (_a != _b)
+		{
+			while (_a > _b) _a = m_nodes[_a].idom;
+			while (_b > _a) _b = m_nodes[_b].idom;
+		}
+		return _a;
+	};
+
+	m_nodes[0].idom = 0u;
+
+	for (bool changed = true; changed;)
+	{
+		changed = false;
+		for (unsigned int i = 1u; i < count; ++i)
+		{
+			unsigned int idom = ~0u;
+			for (const BasicBlock* pred : m_nodes[i].predecessors)
+			{
+				const unsigned int p = *m_indices.get(pred);
+				if (m_nodes[p].idom != ~0u) // already processed
+				{
+					idom = idom == ~0u ? p : intersect(p, idom);
+				}
+			}
+
+			if (m_nodes[i].idom != idom)
+			{
+				m_nodes[i].idom = idom;
+				changed = true;
+			}
+		}
+	}
+
+	for (unsigned int i = 1u; i < count; ++i)
+	{
+		Node& node = m_nodes[i];
+		m_nodes[node.idom].children.emplace_back(m_blocks[i]);
+
+		if (node.predecessors.size() < 2u)
+		{
+			continue;
+		}
+
+		for (const BasicBlock* pred : node.predecessors)
+		{
+			for (unsigned int runner = *m_indices.get(pred); runner != node.idom; runner = m_nodes[runner].idom)
+			{
+				List<BasicBlock*>& frontier = m_nodes[runner].frontier;
+				if (frontier.contains(m_blocks[i]) == false)
+				{
+					frontier.emplace_back(m_blocks[i]);
+				}
+			}
+		}
+	}
+}
+
+const spvgentwo::DominatorTree::Node* spvgentwo::DominatorTree::getNode(const BasicBlock* _pBB) const
+{
+	const unsigned int* index = m_indices.get(_pBB);
+	return index != nullptr ? &m_nodes[*index] : nullptr;
+}
+
+spvgentwo::BasicBlock* spvgentwo::DominatorTree::getImmediateDominator(const BasicBlock* _pBB) const
+{
+	const unsigned int* index = m_indices.get(_pBB);
+	return index != nullptr && *index != 0u ? m_blocks[m_nodes[*index].idom] : nullptr;
+}
+
+bool spvgentwo::DominatorTree::dominates(const BasicBlock* _pA, const BasicBlock* _pB) const
+{
+	const unsigned int* a = m_indices.get(_pA);
+	const unsigned int* b = m_indices.get(_pB);
+
+	if (a == nullptr || b == nullptr)
+	{
+		return false;
+	}
+
+	// dominators have a lower reverse post order index
+	unsigned int runner = *b;
+	while (runner > *a)
+	{
+		runner = m_nodes[runner].idom;
+	}
+
+	return runner == *a;
+}
+
+const spvgentwo::List<spvgentwo::BasicBlock*>* spvgentwo::DominatorTree::getChildren(const BasicBlock* _pBB) const
+{
+	const Node* node = getNode(_pBB);
+	return node != nullptr ? &node->children : nullptr;
+}
+
+const spvgentwo::List<spvgentwo::BasicBlock*>* spvgentwo::DominatorTree::getFrontier(const BasicBlock* _pBB) const
+{
+	const Node* node = getNode(_pBB);
+	return node != nullptr ? &node->frontier : nullptr;
+}
+
+const spvgentwo::List<spvgentwo::BasicBlock*>* spvgentwo::DominatorTree::getPredecessors(const BasicBlock* _pBB) const
+{
+	const Node* node = getNode(_pBB);
+	return node != nullptr ? &node->predecessors : nullptr;
+}
@@ -0,0 +1,423 @@
+#include "common/FunctionDeduplication.h"
+
+#include "spvgentwo/Module.h"
+#include "spvgentwo/ModuleTemplate.inl"
+#include "spvgentwo/WordHasher.h"
+
+namespace
+{
+	using namespace spvgentwo;
+
+	using Positions = HashMap<const Instruction*, unsigned int>;
+	using Decorations = HashMap<const Instruction*, const Instruction*>; // target -> OpDecorate / OpMemberDecorate, multiple per target
+
+	constexpr unsigned int External = ~0u; // instruction not part of the function
+
+	// OpFunction, OpFunctionParameters, labels and instructions of all basic blocks, OpFunctionEnd
+	template <class Func>
+	void forEachInstruction(const Function& _func, Func _f)
+	{
+		_f(*_func.getFunction());
+
+		for (const Instruction& param : _func.getParameters())
+		{
+			_f(param);
+		}
+
+		for (const BasicBlock& bb : _func)
+		{
+			_f(*bb.getLabel());
+
+			for (const Instruction& instr : bb)
+			{
+				_f(instr);
+			}
+		}
+
+		_f(*_func.getFunctionEnd());
+	}
+
+	void number(const Function& _func, Positions& _positions)
+	{
+		_positions.clear();
+
+		unsigned int pos = 0u;
+		forEachInstruction(_func, [&_positions, &pos](const Instruction& _instr) { _positions.emplaceUnique(&_instr, pos++); });
+	}
+
+	unsigned int position(const Positions& _positions, const Instruction* _pInstr)
+	{
+		const unsigned int* pos = _positions.get(_pInstr);
+		return pos != nullptr ? *pos : External;
+	}
+
+	void collect(const Module& _module, Decorations& _decorations)
+	{
+		for (const Instruction& decoration : _module.getDecorations())
+		{
+			if (const Instruction* target = decoration.empty() ? nullptr : decoration.front().getInstruction(); target != nullptr)
+			{
+				_decorations.emplace(target, &decoration);
+			}
+		}
+	}
+
+	// decoration, member index and decoration operands, the target is not hashed
+	Hash64 hashDecoration(const Instruction& _decoration)
+	{
+		WordHasher hasher;
+		hasher << _decoration.getOperation() << static_cast<unsigned int>(_decoration.size());
+
+		for (auto it = _decoration.begin().next(), end = _decoration.end(); it != end; ++it)
+		{
+			hasher << it->type;
+
+			if (it->isLiteral())
+			{
+				hasher << it->literal.value;
+			}
+			else if (it->isInstruction()) // OpDecorateId
+			{
+				hasher << reinterpret_cast<sgt_size_t>(it->instruction);
+			}
+		}
+
+		return hasher.get();
+	}
+
+	// order independent
+	sgt_uint64_t hashDecorations(const Decorations& _decorations, const Instruction* _pTarget)
+	{
+		sgt_uint64_t h = 0u;
+		for (auto& node : _decorations.getRange(_pTarget))
+		{
+			if (node.kv.key == _pTarget)
+			{
+				h += hashDecoration(*node.kv.value);
+			}
+		}
+		return h;
+	}
+
+	bool equalDecoration(const Instruction& _left, const Instruction& _right)
+	{
+		if (_left.getOperation() != _right.getOperation() || _left.size() != _right.size())
+		{
+			return false;
+		}
+
+		for (auto l = _left.begin().next(), r = _right.begin().next(), end = _left.end(); l != end; ++l, ++r)
+		{
+			if (l->type != r->type ||
+				(l->isLiteral() && l->literal.value != r->literal.value) ||
+				(l->isInstruction() && l->instruction != r->instruction))
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	// every decoration of _pLeft has an equal decoration on _pRight and vice versa
+	bool equalDecorations(const Decorations& _decorations, const Instruction* _pLeft, const Instruction* _pRight)
+	{
+		auto contained = [&_decorations](const Instruction* _pTarget, const Instruction& _decoration) -> bool
+		{
+			for (auto& node : _decorations.getRange(_pTarget))
+			{
+				if (node.kv.key == _pTarget && equalDecoration(*node.kv.value, _decoration))
+				{
+					return true;
+				}
+			}
+			return false;
+		};
+
+		auto subset = [&](const Instruction* _pSub, const Instruction* _pSuper) -> bool
+		{
+			for (auto& node : _decorations.getRange(_pSub))
+			{
+				if (node.kv.key == _pSub && contained(_pSuper, *node.kv.value) == false)
+				{
+					return false;
+				}
+			}
+			return true;
+		};
+
+		return subset(_pLeft, _pRight) && subset(_pRight, _pLeft);
+	}
+
+	Hash64 hashFunction(const Function& _func, const Decorations& _decorations, Positions& _positions)
+	{
+		number(_func, _positions);
+
+		WordHasher hasher;
+
+		forEachInstruction(_func, [&hasher, &_positions, &_decorations](const Instruction& _instr)
+		{
+			hasher << _instr.getOperation() << static_cast<unsigned int>(_instr.size()) << hashDecorations(_decorations, &_instr);
+
+			for (const Operand& op : _instr)
+			{
+				hasher << op.type;
+
+				switch (op.type)
+				{
+				case Operand::Type::Instruction:
+					if (const unsigned int pos = position(_positions, op.instruction); pos != External)
+					{
+						hasher << pos;
+					}
+					else // type, constant, global variable or callee handle
+					{
+						hasher << External << reinterpret_cast<sgt_size_t>(op.instruction);
+					}
+					break;
+				case Operand::Type::BranchTarget:
+					hasher << position(_positions, op.branchTarget->getLabel());
+					break;
+				case Operand::Type::Literal:
+					hasher << op.literal.value;
+					break;
+				case Operand::Type::Id: // result ids are not part of the structure
+					break;
+				}
+			}
+		});
+
+		return hasher.get();
+	}
+
+	bool equalOperand(const Operand& _left, const Operand& _right, const Positions& _leftPos, const Positions& _rightPos)
+	{
+		if (_left.type != _right.type)
+		{
+			return false;
+		}
+
+		switch (_left.type)
+		{
+		case Operand::Type::Instruction:
+		{
+			const unsigned int pos = position(_leftPos, _left.instruction);
+			return pos == position(_rightPos, _right.instruction) && (pos != External || _left.instruction == _right.instruction);
+		}
+		case Operand::Type::BranchTarget:
+			return position(_leftPos, _left.branchTarget->getLabel()) == position(_rightPos, _right.branchTarget->getLabel());
+		case Operand::Type::Literal:
+			return _left.literal.value == _right.literal.value;
+		default:
+			return true;
+		}
+	}
+
+	bool equalFunctions(const Function& _left, const Function& _right, const Decorations& _decorations, Positions& _leftPos, Positions& _rightPos, IAllocator* _pAllocator)
+	{
+		if (_left.size() != _right.size() || _left.getParameters().size() != _right.getParameters().size())
+		{
+			return false;
+		}
+
+		number(_left, _leftPos);
+		number(_right, _rightPos);
+
+		if (_leftPos.elements() != _rightPos.elements())
+		{
+			return false;
+		}
+
+		Vector<const Instruction*> right(_pAllocator);
+		right.reserve(_rightPos.elements());
+		forEachInstruction(_right, [&right](const Instruction& _instr) { right.emplace_back(&_instr); });
+
+		bool equal = true;
+		sgt_size_t i = 0u;
+
+		forEachInstruction(_left, [&](const Instruction& _instr)
+		{
+			if (equal == false)
+			{
+				return;
+			}
+
+			const Instruction& other = *right[i++];
+			if (_instr.getOperation() != other.getOperation() || _instr.size() != other.size() || equalDecorations(_decorations, &_instr, &other) == false)
+			{
+				equal = false;
+				return;
+			}
+
+			for (auto l = _instr.begin(), r = other.begin(), end = _instr.end(); l != end && equal; ++l, ++r)
+			{
+				equal = equalOperand(*l, *r, _leftPos, _rightPos);
+			}
+		});
+
+		return equal;
+	}
+
+	sgt_size_t byteSize(const Instruction& _instr)
+	{
+		return (1u + _instr.size()) * sizeof(unsigned int);
+	}
+}
+
+spvgentwo::Hash64 spvgentwo::FunctionDeduplication::hash(const Function& _func, IAllocator* _pAllocator)
+{
+	IAllocator* pAllocator = _pAllocator == nullptr ? _func.getModule()->getAllocator() : _pAllocator;
+
+	Decorations decorations(pAllocator);
+	collect(*_func.getModule(), decorations);
+
+	Positions positions(pAllocator);
+	return hashFunction(_func, decorations, positions);
+}
+
+bool spvgentwo::FunctionDeduplication::equal(const Function& _left, const Function& _right, IAllocator* _pAllocator)
+{
+	IAllocator* pAllocator = _pAllocator == nullptr ? _left.getModule()->getAllocator() : _pAllocator;
+
+	Decorations decorations(pAllocator);
+	collect(*_left.getModule(), decorations);
+	if (_right.getModule() != _left.getModule())
+	{
+		collect(*_right.getModule(), decorations);
+	}
+
+	Positions left(pAllocator), right(pAllocator);
+	return equalFunctions(_left, _right, decorations, left, right, pAllocator);
+}
+
+spvgentwo::FunctionDeduplication::Result spvgentwo::FunctionDeduplication::deduplicate(Module& _module, IAllocator* _pAllocator)
+{
+	IAllocator* pAllocator = _pAllocator == nullptr ? _module.getAllocator() : _pAllocator;
+
+	Result result;
+
+	// calls to removed functions are rewritten, no shared instruction may be modified
+	_module.unshareAll();
+
+	Decorations decorations(pAllocator);
+
+	Positions positions(pAllocator), other(pAllocator);
+	HashMap<Hash64, Function*> groups(pAllocator); // structural hash -> all distinct functions with this hash
+	HashMap<const Instruction*, Instruction*> replacements(pAllocator); // OpFunction of duplicate -> OpFunction to call instead
+	HashMap<const Function*, bool> duplicates(pAllocator);
+
+	for (;;)
+	{
+		decorations.clear();
+		collect(_module, decorations);
+
+		groups.clear();
+		replacements.clear();
+		duplicates.clear();
+
+		for (Function& func : _module.getFunctions())
+		{
+			if (func.empty() || decorations.get(static_cast<const Instruction*>(func.getFunction())) != nullptr)
+			{
+				continue;
+			}
+
+			const Hash64 h = hashFunction(func, decorations, positions);
+
+			Function* original = nullptr;
+			for (auto& node : groups.getRange(h)) // hash collisions are not merged
+			{
+				if (node.kv.key == h && equalFunctions(*node.kv.value, func, decorations, positions, other, pAllocator))
+				{
+					original = node.kv.value;
+					break;
+				}
+			}
+
+			if (original == nullptr)
+			{
+				groups.emplace(h, &func);
+			}
+			else
+			{
+				replacements.emplaceUnique(func.getFunction(), original->getFunction());
+				duplicates.emplaceUnique(&func, true);
+			}
+		}
+
+		if (replacements.elements() == 0u)
+		{
+			break;
+		}
+
+		++result.rounds;
+
+		auto isDuplicate = [&duplicates](const Instruction& _instr) -> bool
+		{
+			for (const Operand& op : _instr)
+			{
+				if (const Instruction* ref = op.getInstruction(); ref != nullptr && ref->getFunction() != nullptr && duplicates.get(static_cast<const Function*>(ref->getFunction())) != nullptr)
+				{
+					return true;
+				}
+			}
+			return false;
+		};
+
+		// names and decorations of removed instructions
+		auto erase = [&isDuplicate, &result](List<Instruction>& _container)
+		{
+			for (auto it = _container.begin(); it != _container.end();)
+			{
+				if (isDuplicate(*it))
+				{
+					result.savedBytes += byteSize(*it);
+					it = _container.erase(it);
+				}
+				else
+				{
+					++it;
+				}
+			}
+		};
+
+		erase(_module.getNames());
+		erase(_module.getDecorations());
+
+		// redirect calls (and any other use) in a single pass
+		_module.iterateInstructions([&replacements](Instruction& _instr)
+		{
+			for (Operand& op : _instr)
+			{
+				if (op.isInstruction())
+				{
+					if (Instruction** replacement = replacements.get(static_cast<const Instruction*>(op.instruction)); replacement != nullptr)
+					{
+						op.instruction = *replacement;
+					}
+				}
+			}
+		});
+
+		for (auto it = _module.getFunctions().begin(); it != _module.getFunctions().end();)
+		{
+			if (duplicates.get(static_cast<const Function*>(it.operator->())) != nullptr)
+			{
+				forEachInstruction(*it, [&_module, &result](const Instruction& _instr)
+				{
+					result.savedBytes += byteSize(_instr);
+					_module.removeFromLookupMaps(&_instr);
+				});
+
+				it = _module.getFunctions().erase(it);
+				++result.removedFunctions;
+			}
+			else
+			{
+				++it;
+			}
+		}
+	}
+
+	return result;
+}
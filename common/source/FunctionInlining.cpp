@@ -0,0 +1,348 @@
+#include "common/FunctionInlining.h"
+#include "common/FunctionCallGraph.h"
+
+#include "spvgentwo/Module.h"
+#include "spvgentwo/InstructionTemplate.inl"
+#include "spvgentwo/ModuleTemplate.inl"
+
+namespace
+{
+	using namespace spvgentwo;
+
+	using InstrMap = HashMap<const Instruction*, Instruction*>;
+
+	struct ReturnValue
+	{
+		Instruction* value = nullptr;
+		BasicBlock* parent = nullptr;
+	};
+
+	const Instruction* getTarget(const Instruction& _instr)
+	{
+		return _instr.empty() ? nullptr : _instr.front().getInstruction();
+	}
+
+	Function* getCallee(const Instruction& _call)
+	{
+		auto it = _call.getFirstActualOperand();
+		return it != nullptr && it->isInstruction() ? it->getInstruction()->getFunction() : nullptr;
+	}
+
+	unsigned int getCost(const Function& _func)
+	{
+		unsigned int cost = 0u;
+		for (const BasicBlock& bb : _func)
+		{
+			cost += static_cast<unsigned int>(bb.size());
+		}
+		return cost;
+	}
+
+	unsigned int countReturns(const Function& _func)
+	{
+		unsigned int returns = 0u;
+		for (const BasicBlock& bb : _func)
+		{
+			if (const Instruction* term = bb.getTerminator(); term != nullptr && (*term == spv::Op::OpReturn || *term == spv::Op::OpReturnValue))
+			{
+				++returns;
+			}
+		}
+		return returns;
+	}
+
+	bool isLoopHeader(const BasicBlock& _bb)
+	{
+		return _bb.find_if([](const Instruction& _instr) { return _instr == spv::Op::OpLoopMerge; }) != _bb.end();
+	}
+
+	bool shouldInline(const Function& _caller, const Function& _callee, const FunctionInlining::Options& _options, bool _structured)
+	{
+		if (&_caller == &_callee || _callee.empty()) // recursion or imported function
+		{
+			return false;
+		}
+
+		const Flag<spv::FunctionControlMask> control = _callee.getFunctionControl();
+
+		if (_options.honourFunctionControl && control.any(spv::FunctionControlMask::DontInline))
+		{
+			return false;
+		}
+
+		const unsigned int returns = countReturns(_callee);
+
+		if ((returns == 0u && _callee.getReturnType().isVoid() == false) || (_structured && returns > 1u))
+		{
+			return false;
+		}
+
+		if (_options.honourFunctionControl && control.any(spv::FunctionControlMask::Inline))
+		{
+			return true;
+		}
+
+		return getCost(_callee) <= _options.maxCost;
+	}
+
+	// post order: callees before callers
+	void addCallees(const FunctionCallGraph::NodeType& _node, HashMap<const Function*, bool>& _visited, List<Function*>& _outOrder)
+	{
+		if (_visited.get(static_cast<const Function*>(_node.data())) != nullptr)
+		{
+			return;
+		}
+
+		_visited.emplaceUnique(_node.data(), true);
+
+		for (const auto& edge : _node.outputs())
+		{
+			addCallees(*edge.pTarget, _visited, _outOrder);
+		}
+
+		_outOrder.emplace_back(_node.data());
+	}
+
+	void inlineCall(Module& _module, Function& _caller, BasicBlock& _bb, Instruction& _call, const Function& _callee, IAllocator* _pAllocator)
+	{
+		BasicBlock* cont = _bb.split(&_call);
+
+		InstrMap map(_pAllocator, 64u);
+
+		// 1. insert a block for every callee block after _bb, before the continuation
+		auto pos = _caller.find_if([&_bb](const BasicBlock& bb) { return &bb == &_bb; });
+		List<BasicBlock*> clones(_pAllocator);
+
+		for (const BasicBlock& src : _callee)
+		{
+			pos = _caller.insert_after(pos, &_caller);
+			clones.emplace_back(pos.operator->());
+			map.emplaceUnique(src.getLabel(), pos->getLabel());
+		}
+
+		// 2. copy instructions, function variables go to the entry block of the caller
+		BasicBlock& entry = _caller.front();
+		auto lastVar = entry.end();
+		for (auto it = entry.begin(); it != entry.end() && *it == spv::Op::OpVariable; ++it)
+		{
+			lastVar = it;
+		}
+
+		List<Instruction*> copies(_pAllocator);
+		List<Instruction*> initializers(_pAllocator); // variable, initializer
+
+		auto clone = clones.begin();
+		for (const BasicBlock& src : _callee)
+		{
+			BasicBlock& dst = **clone;
+			++clone;
+
+			for (const Instruction& instr : src)
+			{
+				Instruction* copy = nullptr;
+				if (instr == spv::Op::OpVariable)
+				{
+					lastVar = lastVar == entry.end() ? entry.emplace_front_entry(&entry, spv::Op::OpNop) : entry.insert_after(lastVar, &entry, spv::Op::OpNop);
+					copy = lastVar.operator->();
+				}
+				else
+				{
+					copy = &dst.emplace_back(&dst, spv::Op::OpNop);
+				}
+
+				copy->setOperation(instr.getOperation());
+				for (const Operand& op : instr)
+				{
+					copy->addOperand(op);
+				}
+
+				if (auto id = copy->getResultIdOperand(); id != nullptr)
+				{
+					*id = InvalidId;
+				}
+
+				map.emplaceUnique(&instr, copy);
+				copies.emplace_back(copy);
+			}
+		}
+
+		// decorations of the copied instructions (NoContraction, RelaxedPrecision etc), before arguments are mapped
+		_module.copyDecorations(map);
+
+		// parameters -> arguments
+		auto arg = _call.getFirstActualOperand().next();
+		for (const Instruction& param : _callee.getParameters())
+		{
+			if (arg == nullptr)
+			{
+				break;
+			}
+			map.emplaceUnique(&param, arg->getInstruction());
+			++arg;
+		}
+
+		// 3. remap operands to the copies
+		for (Instruction* copy : copies)
+		{
+			for (Operand& op : *copy)
+			{
+				if (op.isInstruction())
+				{
+					if (Instruction* const* mapped = map.get(static_cast<const Instruction*>(op.getInstruction())); mapped != nullptr)
+					{
+						op = *mapped;
+					}
+				}
+				else if (op.isBranchTarget())
+				{
+					if (Instruction* const* mapped = map.get(static_cast<const Instruction*>(op.getBranchTarget()->getLabel())); mapped != nullptr)
+					{
+						op = (*mapped)->getBasicBlock();
+					}
+				}
+			}
+
+			// storage class, initializer: the initializer is stored each time the inlined body is entered
+			if (*copy == spv::Op::OpVariable && copy->size() > 3u)
+			{
+				initializers.emplace_back(copy);
+				initializers.emplace_back(copy->back().getInstruction());
+				copy->erase(copy->last());
+			}
+		}
+
+		BasicBlock& first = *clones.front();
+		for (auto it = initializers.begin(); it != initializers.end() && it.next() != nullptr; it = it.next().next())
+		{
+			first.emplace_front(&first, spv::Op::OpNop).opStore(*it, *it.next());
+		}
+
+		// 4. returns branch to the continuation
+		List<ReturnValue> values(_pAllocator);
+		for (BasicBlock* bb : clones)
+		{
+			Instruction* term = bb->getTerminator();
+			if (term == nullptr || (*term != spv::Op::OpReturn && *term != spv::Op::OpReturnValue))
+			{
+				continue;
+			}
+
+			if (*term == spv::Op::OpReturnValue)
+			{
+				values.emplace_back(ReturnValue{ term->getFirstActualOperand()->getInstruction(), bb });
+			}
+
+			term->reset();
+			term->opBranch(cont);
+		}
+
+		// 5. uses of the call result
+		auto sweep = [&_call](List<Instruction>& _container)
+		{
+			for (auto it = _container.begin(); it != _container.end();)
+			{
+				if (getTarget(*it) == &_call)
+				{
+					it = _container.erase(it);
+				}
+				else
+				{
+					++it;
+				}
+			}
+		};
+
+		sweep(_module.getNames());
+		sweep(_module.getDecorations());
+		_module.removeFromLookupMaps(&_call);
+
+		Instruction* resultType = _call.getResultTypeInstr();
+
+		// the call becomes the terminator of _bb, its address stays valid for replaceUses
+		_call.reset();
+		_call.opBranch(&first);
+
+		if (values.empty() == false)
+		{
+			Instruction* result = values.front().value;
+
+			if (values.size() > 1u)
+			{
+				result = &cont->emplace_front(cont, spv::Op::OpNop);
+				result->setOperation(spv::Op::OpPhi);
+				result->addOperand(resultType);
+				result->addOperand(InvalidId);
+
+				for (const ReturnValue& ret : values)
+				{
+					result->addOperand(ret.value);
+					result->addOperand(ret.parent);
+				}
+			}
+
+			_module.replaceUses(&_call, result);
+		}
+	}
+}
+
+spvgentwo::FunctionInlining::Result spvgentwo::FunctionInlining::inlineCalls(Module& _module, const Options& _options, IAllocator* _pAllocator)
+{
+	IAllocator* pAllocator = _pAllocator == nullptr ? _module.getAllocator() : _pAllocator;
+
+	// shared instructions can't be cloned with new operands
+	_module.unshareAll();
+
+	const bool structured = _module.getCapabilities().get(spv::Capability::Shader) != nullptr;
+
+	HashMap<const Function*, bool> visited(pAllocator);
+	List<Function*> order(pAllocator);
+
+	auto addGraph = [&](const Function& _func)
+	{
+		const FunctionCallGraph callGraph(_func, pAllocator);
+		if (callGraph.empty() == false)
+		{
+			addCallees(callGraph.front(), visited, order);
+		}
+	};
+
+	for (const EntryPoint& ep : _module.getEntryPoints())
+	{
+		addGraph(ep);
+	}
+	for (const Function& func : _module.getFunctions())
+	{
+		addGraph(func);
+	}
+
+	Result result;
+
+	for (Function* caller : order)
+	{
+		// inlined blocks follow the block of the call, calls in the continuation are visited next
+		for (BasicBlock& bb : *caller)
+		{
+			if (isLoopHeader(bb))
+			{
+				continue;
+			}
+
+			for (Instruction& instr : bb)
+			{
+				if (instr != spv::Op::OpFunctionCall)
+				{
+					continue;
+				}
+
+				if (const Function* callee = getCallee(instr); callee != nullptr && shouldInline(*caller, *callee, _options, structured))
+				{
+					inlineCall(_module, *caller, bb, instr, *callee, pAllocator);
+					++result.inlinedCalls;
+					break;
+				}
+			}
+		}
+	}
+
+	return result;
+}
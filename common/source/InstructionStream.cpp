@@ -0,0 +1,412 @@
+#include "common/InstructionStream.h"
+
+#include "spvgentwo/Reader.h"
+#include "spvgentwo/Writer.h"
+#include "spvgentwo/Logger.h"
+#include "spvgentwo/SpvDefines.h"
+
+namespace
+{
+	using namespace spvgentwo;
+
+	// chains filter i to filter i + 1, the last stage writes to the IWriter
+	class Stage : public IInstructionSink
+	{
+	public:
+		Stage(IInstructionFilter* const* _ppFilters, unsigned int _remaining, IWriter& _writer) :
+			m_ppFilters(_ppFilters), m_remaining(_remaining), m_writer(_writer) {}
+
+		bool emit(unsigned int* _pWords, unsigned int _wordCount) final
+		{
+			if (_pWords == nullptr || _wordCount == 0u || (_pWords[0] >> spv::WordCountShift) != _wordCount)
+			{
+				return false;
+			}
+
+			if (m_remaining == 0u)
+			{
+				for (unsigned int i = 0u; i < _wordCount; ++i)
+				{
+					if (m_writer.put(_pWords[i]) == false)
+					{
+						return false;
+					}
+				}
+				return true;
+			}
+
+			StreamInstruction instr{ _pWords, _wordCount };
+			return m_ppFilters[0]->filter(instr, *m_pNext);
+		}
+
+		bool end()
+		{
+			return m_remaining == 0u || (m_ppFilters[0]->end(*m_pNext) && m_pNext->end());
+		}
+
+		Stage* m_pNext = nullptr;
+
+	private:
+		IInstructionFilter* const* m_ppFilters = nullptr;
+		unsigned int m_remaining = 0u;
+		IWriter& m_writer;
+	};
+}
+
+spvgentwo::InstructionStream::InstructionStream(IAllocator* _pAllocator, const Grammar* _pGrammar, ILogger* _pLogger) :
+	m_pAllocator(_pAllocator),
+	m_pGrammar(_pGrammar),
+	m_pLogger(_pLogger),
+	m_filters(_pAllocator),
+	m_buffer(_pAllocator)
+{
+}
+
+spvgentwo::InstructionStream& spvgentwo::InstructionStream::add(IInstructionFilter* _pFilter)
+{
+	if (_pFilter != nullptr)
+	{
+		m_filters.emplace_back(_pFilter);
+	}
+	return *this;
+}
+
+bool spvgentwo::InstructionStream::run(IReader& _reader, IWriter& _writer)
+{
+	unsigned int header[5]{};
+	for (unsigned int& word : header)
+	{
+		if (_reader.get(word) == false)
+		{
+			if (m_pLogger != nullptr) m_pLogger->logError("Unexpected end of SPIR-V header");
+			return false;
+		}
+	}
+
+	if (header[0] != spv::MagicNumber)
+	{
+		if (m_pLogger != nullptr) m_pLogger->logError("Invalid SPIR-V magic number %x", header[0]);
+		return false;
+	}
+
+	for (IInstructionFilter* filter : m_filters)
+	{
+		if (filter->begin(header) == false)
+		{
+			return false;
+		}
+	}
+
+	for (unsigned int word : header)
+	{
+		if (_writer.put(word) == false)
+		{
+			return false;
+		}
+	}
+
+	const unsigned int filterCount = static_cast<unsigned int>(m_filters.size());
+
+	Vector<Stage> stages(m_pAllocator);
+	if (stages.reserve(filterCount + 1u) == false)
+	{
+		return false;
+	}
+
+	for (unsigned int i = 0u; i <= filterCount; ++i)
+	{
+		stages.emplace_back(m_filters.data() + i, filterCount - i, _writer);
+	}
+
+	for (unsigned int i = 0u; i < filterCount; ++i)
+	{
+		stages[i].m_pNext = &stages[i + 1u];
+	}
+
+	// instructions can be at most 0xffff words long
+	if (m_buffer.reserve(spv::OpCodeMask) == false)
+	{
+		return false;
+	}
+
+	for (unsigned int first = 0u; _reader.get(first);)
+	{
+		const unsigned int wordCount = first >> spv::WordCountShift;
+		if (wordCount == 0u)
+		{
+			if (m_pLogger != nullptr) m_pLogger->logError("Invalid instruction word count 0 for opcode %u", first & spv::OpCodeMask);
+			return false;
+		}
+
+		m_buffer.clear();
+		m_buffer.emplace_back(first);
+
+		for (unsigned int i = 1u, word = 0u; i < wordCount; ++i)
+		{
+			if (_reader.get(word) == false)
+			{
+				if (m_pLogger != nullptr) m_pLogger->logError("Unexpected end of instruction stream for opcode %u", first & spv::OpCodeMask);
+				return false;
+			}
+			m_buffer.emplace_back(word);
+		}
+
+		if (stages[0].emit(m_buffer.data(), wordCount) == false)
+		{
+			if (m_pLogger != nullptr) m_pLogger->logError("Failed to filter instruction with opcode %u", first & spv::OpCodeMask);
+			return false;
+		}
+	}
+
+	return stages[0].end();
+}
+
+bool spvgentwo::InstructionStream::decodeOperandKinds(const Grammar& _grammar, const StreamInstruction& _instr, Vector<Grammar::OperandKind>& _outKinds)
+{
+	_outKinds.clear();
+
+	const unsigned int operandCount = _instr.getOperandCount();
+	if (operandCount == 0u)
+	{
+		return true;
+	}
+
+	OperandKindCursor cursor(_grammar, _instr.getOperation());
+	const unsigned int* pOperands = _instr.getOperands();
+
+	for (unsigned int i = 0u; i < operandCount && cursor.isValid(); ++i)
+	{
+		_outKinds.emplace_back(cursor.getKind());
+		cursor.advance(pOperands[i]);
+	}
+
+	return cursor.isComplete();
+}
+
+spvgentwo::OperandKindCursor::OperandKindCursor(const Grammar& _grammar, spv::Op _op) :
+	m_grammar(_grammar)
+{
+	if (const Grammar::Instruction* info = _grammar.getInfo(static_cast<unsigned int>(_op)); info != nullptr)
+	{
+		m_it = info->operands.begin();
+		m_end = info->operands.end();
+		enter();
+	}
+	else
+	{
+		m_valid = false;
+	}
+}
+
+const spvgentwo::Grammar::Operand* spvgentwo::OperandKindCursor::current() const
+{
+	if (m_pParams != nullptr)
+	{
+		return &(*m_pParams)[m_index];
+	}
+	else if (m_pBases != nullptr)
+	{
+		return &(*m_pBases)[m_index];
+	}
+	return m_it != m_end ? m_it : nullptr;
+}
+
+spvgentwo::Grammar::OperandKind spvgentwo::OperandKindCursor::getKind() const
+{
+	if (m_inString)
+	{
+		return Grammar::OperandKind::LiteralString;
+	}
+	else if (m_rest)
+	{
+		return m_restKind;
+	}
+
+	const Grammar::Operand* op = current();
+	if (op == nullptr)
+	{
+		return Grammar::OperandKind::LiteralInteger;
+	}
+
+	// this is a simplified categorization, only top level operands keep their id kind
+	if (op->category == Grammar::OperandCategory::Id && (m_pParams != nullptr || m_pBases != nullptr))
+	{
+		return Grammar::OperandKind::IdRef;
+	}
+
+	return op->kind;
+}
+
+void spvgentwo::OperandKindCursor::advance(unsigned int _word)
+{
+	if (m_inString)
+	{
+		if (hasStringTerminator(_word))
+		{
+			m_inString = false;
+			next();
+		}
+		return;
+	}
+	else if (m_rest)
+	{
+		return;
+	}
+
+	const Grammar::Operand* op = current();
+	if (op == nullptr)
+	{
+		m_valid = false;
+		return;
+	}
+
+	if (op->kind == Grammar::OperandKind::LiteralString)
+	{
+		if (hasStringTerminator(_word))
+		{
+			next();
+		}
+		else
+		{
+			m_inString = true;
+		}
+		return;
+	}
+
+	if (m_pParams == nullptr && m_pBases == nullptr) // top level
+	{
+		if (op->kind == Grammar::OperandKind::LiteralSpecConstantOpInteger) // OpSpecConstantOp, followed by ids
+		{
+			m_rest = true;
+			m_restKind = Grammar::OperandKind::IdRef;
+			return;
+		}
+		else if (op->kind == Grammar::OperandKind::LiteralContextDependentNumber) // OpConstant
+		{
+			m_rest = true;
+			m_restKind = op->kind;
+			return;
+		}
+		else if ((op->category == Grammar::OperandCategory::ValueEnum || op->category == Grammar::OperandCategory::BitEnum) && Grammar::hasOperandParameters(op->kind))
+		{
+			if (const Vector<Grammar::Operand>* params = m_grammar.getOperandParameters(op->kind, _word); params != nullptr && params->empty() == false)
+			{
+				m_pParams = params;
+				m_index = 0u;
+				return;
+			}
+		}
+	}
+
+	next();
+}
+
+void spvgentwo::OperandKindCursor::next()
+{
+	if (m_pParams != nullptr)
+	{
+		if (++m_index < m_pParams->size())
+		{
+			return;
+		}
+		m_pParams = nullptr; // enum and its parameters are done
+		m_index = 0u;
+	}
+	else if (m_pBases != nullptr) // composites repeat until the end of the instruction
+	{
+		if (++m_index == m_pBases->size())
+		{
+			m_index = 0u;
+		}
+		return;
+	}
+
+	if (m_it->quantifier != Grammar::Quantifier::ZeroOrAny) // not trailing args
+	{
+		++m_it;
+		enter();
+	}
+}
+
+void spvgentwo::OperandKindCursor::enter()
+{
+	if (m_it != m_end && m_it->category == Grammar::OperandCategory::Composite)
+	{
+		m_pBases = m_grammar.getOperandBases(m_it->kind);
+		m_index = 0u;
+
+		if (m_pBases == nullptr || m_pBases->empty())
+		{
+			m_pBases = nullptr;
+			m_it = m_end;
+		}
+	}
+}
+
+bool spvgentwo::OperandKindCursor::isComplete() const
+{
+	if (m_valid == false || m_inString || m_pParams != nullptr)
+	{
+		return false;
+	}
+	else if (m_pBases != nullptr)
+	{
+		return m_index == 0u;
+	}
+	return m_rest || m_it == m_end || m_it->quantifier != Grammar::Quantifier::One;
+}
+
+bool spvgentwo::StripDebugFilter::filter(StreamInstruction& _instr, IInstructionSink& _next)
+{
+	switch (_instr.getOperation())
+	{
+	case spv::Op::OpSourceContinued:
+	case spv::Op::OpSource:
+	case spv::Op::OpSourceExtension:
+	case spv::Op::OpName:
+	case spv::Op::OpMemberName:
+	case spv::Op::OpLine:
+	case spv::Op::OpNoLine:
+	case spv::Op::OpModuleProcessed:
+		return true; // drop
+	default:
+		return _next.emit(_instr);
+	}
+}
+
+spvgentwo::IdRemapFilter::IdRemapFilter(IAllocator* _pAllocator, const Grammar* _pGrammar, const unsigned int* _pTable, unsigned int _tableSize, unsigned int _newBound) :
+	m_pGrammar(_pGrammar),
+	m_pTable(_pTable),
+	m_tableSize(_tableSize),
+	m_newBound(_newBound),
+	m_kinds(_pAllocator)
+{
+}
+
+bool spvgentwo::IdRemapFilter::begin(unsigned int* _pHeader)
+{
+	if (m_newBound != 0u)
+	{
+		_pHeader[3] = m_newBound;
+	}
+	return m_pGrammar != nullptr;
+}
+
+bool spvgentwo::IdRemapFilter::filter(StreamInstruction& _instr, IInstructionSink& _next)
+{
+	if (InstructionStream::decodeOperandKinds(*m_pGrammar, _instr, m_kinds) == false)
+	{
+		return false;
+	}
+
+	unsigned int* pOperands = _instr.getOperands();
+	for (sgt_size_t i = 0u; i < m_kinds.size(); ++i)
+	{
+		if (InstructionStream::isIdKind(m_kinds[i]) && pOperands[i] < m_tableSize)
+		{
+			pOperands[i] = m_pTable[pOperands[i]];
+		}
+	}
+
+	return _next.emit(_instr);
+}
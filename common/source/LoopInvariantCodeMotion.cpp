@@ -0,0 +1,514 @@
+#include "common/LoopInvariantCodeMotion.h"
+#include "common/DominatorTree.h"
+#include "common/PassManager.h"
+
+#include "spvgentwo/Module.h"
+#include "spvgentwo/InstructionTemplate.inl"
+
+namespace
+{
+	using namespace spvgentwo;
+
+	using InstrMap = HashMap<const Instruction*, Instruction*>;
+
+	const Instruction* getTarget(const Instruction& _instr)
+	{
+		return _instr.empty() ? nullptr : _instr.front().getInstruction();
+	}
+
+	bool isAccessChain(const Instruction& _instr)
+	{
+		return _instr == spv::Op::OpAccessChain || _instr == spv::Op::OpInBoundsAccessChain;
+	}
+
+	bool isPointer(const Instruction* _pInstr)
+	{
+		const Instruction* type = _pInstr != nullptr ? _pInstr->getResultTypeInstr() : nullptr;
+		return type != nullptr && *type == spv::Op::OpTypePointer;
+	}
+
+	// OpVariable the pointer _pInstr is derived from, nullptr if unknown (e.g. function parameter)
+	const Instruction* getRootVariable(const Instruction* _pInstr)
+	{
+		while (_pInstr != nullptr && (isAccessChain(*_pInstr) || *_pInstr == spv::Op::OpCopyObject))
+		{
+			auto base = _pInstr->getFirstActualOperand();
+			_pInstr = base != nullptr ? base->getInstruction() : nullptr;
+		}
+		return _pInstr != nullptr && *_pInstr == spv::Op::OpVariable ? _pInstr : nullptr;
+	}
+
+	bool isVolatile(const Instruction::Iterator& _memoryAccess)
+	{
+		return _memoryAccess != nullptr && _memoryAccess->isLiteral() && (_memoryAccess->getLiteral().value & static_cast<unsigned int>(spv::MemoryAccessMask::Volatile)) != 0u;
+	}
+
+	// instructions reading pointers (or passing them on) without writing to memory
+	bool isPointerRead(const Instruction& _instr)
+	{
+		switch (_instr.getOperation())
+		{
+		case spv::Op::OpLoad:
+		case spv::Op::OpAccessChain:
+		case spv::Op::OpInBoundsAccessChain:
+		case spv::Op::OpCopyObject:
+		case spv::Op::OpPhi:
+		case spv::Op::OpSelect:
+		case spv::Op::OpArrayLength:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	class ReadOnlyVariables
+	{
+	public:
+		ReadOnlyVariables(const Module& _module, IAllocator* _pAllocator) :
+			m_nonWritable(_pAllocator),
+			m_nonWritableMembers(_pAllocator)
+		{
+			for (const Instruction& decoration : _module.getDecorations())
+			{
+				auto it = decoration.begin();
+				if (decoration == spv::Op::OpDecorate && it.next() != nullptr && it.next()->getLiteral().value == static_cast<unsigned int>(spv::Decoration::NonWritable))
+				{
+					m_nonWritable.emplaceUnique(getTarget(decoration), true);
+				}
+				else if (decoration == spv::Op::OpMemberDecorate && it.next() != nullptr && it.next().next() != nullptr && it.next().next()->getLiteral().value == static_cast<unsigned int>(spv::Decoration::NonWritable))
+				{
+					++m_nonWritableMembers.emplaceUnique(getTarget(decoration), 0u).kv.value;
+				}
+			}
+		}
+
+		bool isReadOnly(const Instruction* _pVar) const
+		{
+			if (_pVar == nullptr)
+			{
+				return false;
+			}
+
+			const spv::StorageClass storage = _pVar->getStorageClass();
+
+			if (storage == spv::StorageClass::UniformConstant)
+			{
+				return true;
+			}
+			else if (storage != spv::StorageClass::Uniform)
+			{
+				return false;
+			}
+
+			if (m_nonWritable.get(_pVar) != nullptr)
+			{
+				return true;
+			}
+
+			// pointer: storage class, pointee type
+			const Instruction* ptrType = _pVar->getResultTypeInstr();
+			auto pointee = ptrType != nullptr ? ptrType->getFirstActualOperand().next() : Instruction::Iterator(nullptr);
+			const Instruction* type = pointee != nullptr ? pointee->getInstruction() : nullptr;
+
+			if (type == nullptr || *type != spv::Op::OpTypeStruct)
+			{
+				return false;
+			}
+
+			const unsigned int* members = m_nonWritableMembers.get(type);
+			unsigned int count = 0u;
+			for (auto it = type->getFirstActualOperand(); it != nullptr; ++it)
+			{
+				++count;
+			}
+
+			return members != nullptr && *members >= count;
+		}
+
+	private:
+		HashMap<const Instruction*, bool> m_nonWritable;
+		HashMap<const Instruction*, unsigned int> m_nonWritableMembers; // struct type -> number of NonWritable members
+	};
+
+	struct Loop
+	{
+		Loop(IAllocator* _pAllocator) : blocks(_pAllocator), exiting(_pAllocator), written(_pAllocator) {}
+
+		BasicBlock* header = nullptr;
+		BasicBlock* preHeader = nullptr;
+		HashMap<const BasicBlock*, bool> blocks;
+		List<const BasicBlock*> exiting; // latches and blocks branching out of the loop
+		HashMap<const Instruction*, bool> written; // root variables written in the loop
+		bool unknownWrites = false;
+
+		bool contains(const Instruction* _pInstr) const
+		{
+			const BasicBlock* bb = _pInstr != nullptr ? _pInstr->getBasicBlock() : nullptr;
+			return bb != nullptr && blocks.get(bb) != nullptr;
+		}
+	};
+
+	// natural loop of _header: all blocks reaching a back edge without passing _header
+	bool getLoop(const DominatorTree& _domTree, BasicBlock& _header, Loop& _outLoop, IAllocator* _pAllocator)
+	{
+		_outLoop.header = &_header;
+		_outLoop.blocks.emplaceUnique(&_header, true);
+
+		List<BasicBlock*> worklist(_pAllocator);
+
+		for (BasicBlock* pred : *_domTree.getPredecessors(&_header))
+		{
+			if (_domTree.dominates(&_header, pred))
+			{
+				worklist.emplace_back(pred);
+				_outLoop.exiting.emplace_back(pred);
+			}
+			else if (_outLoop.preHeader == nullptr)
+			{
+				_outLoop.preHeader = pred;
+			}
+			else
+			{
+				return false; // multiple entries
+			}
+		}
+
+		if (_outLoop.preHeader == nullptr || _outLoop.preHeader->empty())
+		{
+			return false;
+		}
+
+		// pre-header must only branch to the header (a lone OpBranch is fine) and can't be a merge instruction target
+		const Instruction* term = _outLoop.preHeader->getTerminator();
+		if (term == nullptr || *term != spv::Op::OpBranch)
+		{
+			return false;
+		}
+
+		if (_outLoop.preHeader->size() >= 2u)
+		{
+			const Instruction& merge = *_outLoop.preHeader->last().prev();
+			if (merge == spv::Op::OpLoopMerge || merge == spv::Op::OpSelectionMerge)
+			{
+				return false;
+			}
+		}
+
+		while (worklist.empty() == false)
+		{
+			BasicBlock* bb = worklist.pop_back();
+			if (_outLoop.blocks.get(static_cast<const BasicBlock*>(bb)) != nullptr)
+			{
+				continue;
+			}
+
+			_outLoop.blocks.emplaceUnique(bb, true);
+			for (BasicBlock* pred : *_domTree.getPredecessors(bb))
+			{
+				worklist.emplace_back(pred);
+			}
+		}
+
+		for (BasicBlock* bb : _domTree.getBlocks())
+		{
+			if (_outLoop.blocks.get(static_cast<const BasicBlock*>(bb)) != nullptr)
+			{
+				continue;
+			}
+
+			for (BasicBlock* pred : *_domTree.getPredecessors(bb))
+			{
+				if (_outLoop.blocks.get(static_cast<const BasicBlock*>(pred)) != nullptr)
+				{
+					_outLoop.exiting.emplace_back(pred);
+				}
+			}
+		}
+
+		return true;
+	}
+
+	// true if _pBB runs on every iteration that reaches a latch or leaves the loop
+	bool isUnconditional(const DominatorTree& _domTree, const Loop& _loop, const BasicBlock* _pBB)
+	{
+		for (const BasicBlock* bb : _loop.exiting)
+		{
+			if (_domTree.dominates(_pBB, bb) == false)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// instructions that may be undefined if executed on a path that did not execute them before (e.g. a guarded division or index)
+	bool isUnsafeToSpeculate(const Instruction& _instr)
+	{
+		switch (_instr.getOperation())
+		{
+		case spv::Op::OpUDiv:
+		case spv::Op::OpSDiv:
+		case spv::Op::OpUMod:
+		case spv::Op::OpSRem:
+		case spv::Op::OpSMod:
+		case spv::Op::OpFRem:
+		case spv::Op::OpFMod:
+		case spv::Op::OpAccessChain:
+		case spv::Op::OpInBoundsAccessChain:
+			return true;
+		case spv::Op::OpLoad:
+		{
+			// loading a whole variable is always in bounds
+			auto ptr = _instr.getFirstActualOperand();
+			return ptr == nullptr || ptr->getInstruction() == nullptr || *ptr->getInstruction() != spv::Op::OpVariable;
+		}
+		default:
+			return false;
+		}
+	}
+
+	void gatherWrites(const Function& _func, Loop& _loop)
+	{
+		for (const BasicBlock& bb : _func)
+		{
+			if (_loop.blocks.get(&bb) == nullptr)
+			{
+				continue;
+			}
+
+			for (const Instruction& instr : bb)
+			{
+				if (isPointerRead(instr))
+				{
+					continue;
+				}
+
+				for (auto it = instr.getFirstActualOperand(); it != nullptr; ++it)
+				{
+					if (it->isInstruction() && isPointer(it->getInstruction()))
+					{
+						if (const Instruction* var = getRootVariable(it->getInstruction()); var != nullptr)
+						{
+							_loop.written.emplaceUnique(var, true);
+						}
+						else
+						{
+							_loop.unknownWrites = true;
+						}
+					}
+				}
+			}
+		}
+	}
+
+	bool isInvariant(const Loop& _loop, const Instruction& _instr, const InstrMap& _hoisted)
+	{
+		for (auto it = _instr.getFirstActualOperand(); it != nullptr; ++it)
+		{
+			if (it->isBranchTarget())
+			{
+				return false;
+			}
+			else if (it->isInstruction() && _loop.contains(it->getInstruction()) && _hoisted.get(static_cast<const Instruction*>(it->getInstruction())) == nullptr)
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// returns true if _instr is a load that can be hoisted
+	bool isInvariantLoad(const Loop& _loop, const Instruction& _instr, const ReadOnlyVariables& _readOnly)
+	{
+		if (_instr != spv::Op::OpLoad || _loop.unknownWrites)
+		{
+			return false;
+		}
+
+		auto ptr = _instr.getFirstActualOperand();
+		if (ptr == nullptr || isVolatile(ptr.next()))
+		{
+			return false;
+		}
+
+		const Instruction* var = getRootVariable(ptr->getInstruction());
+		return _readOnly.isReadOnly(var) && _loop.written.get(var) == nullptr;
+	}
+
+	void remap(Module& _module, Function& _func, const InstrMap& _hoisted)
+	{
+		auto remapOperands = [&_hoisted](Instruction& _instr)
+		{
+			for (Operand& op : _instr)
+			{
+				if (op.isInstruction())
+				{
+					if (Instruction* const* copy = _hoisted.get(static_cast<const Instruction*>(op.getInstruction())); copy != nullptr)
+					{
+						op = *copy;
+					}
+				}
+			}
+		};
+
+		for (BasicBlock& bb : _func)
+		{
+			for (Instruction& instr : bb)
+			{
+				remapOperands(instr);
+			}
+		}
+
+		for (Instruction& name : _module.getNames())
+		{
+			remapOperands(name);
+		}
+		for (Instruction& decoration : _module.getDecorations())
+		{
+			remapOperands(decoration);
+		}
+	}
+
+	LoopInvariantCodeMotion::Result hoistLoop(Module& _module, Function& _func, const DominatorTree& _domTree, BasicBlock& _header, const ReadOnlyVariables& _readOnly, IAllocator* _pAllocator)
+	{
+		LoopInvariantCodeMotion::Result result;
+
+		Loop loop(_pAllocator);
+		if (getLoop(_domTree, _header, loop, _pAllocator) == false)
+		{
+			return result;
+		}
+
+		gatherWrites(_func, loop);
+
+		BasicBlock& preHeader = *loop.preHeader;
+		InstrMap hoisted(_pAllocator);
+
+		// reverse post order: operands are visited before their uses
+		for (BasicBlock* bb : _domTree.getBlocks())
+		{
+			if (loop.blocks.get(static_cast<const BasicBlock*>(bb)) == nullptr)
+			{
+				continue;
+			}
+
+			// conditionally executed blocks only hoist what can't fault
+			const bool unconditional = isUnconditional(_domTree, loop, bb);
+
+			for (Instruction& instr : *bb)
+			{
+				const bool load = isInvariantLoad(loop, instr, _readOnly);
+				if ((load == false && isPureOp(instr.getOperation()) == false && isAccessChain(instr) == false) || isInvariant(loop, instr, hoisted) == false)
+				{
+					continue;
+				}
+
+				if (unconditional == false && isUnsafeToSpeculate(instr))
+				{
+					continue;
+				}
+
+				// copy to the end of the pre-header
+				Instruction& copy = preHeader.insert_before(preHeader.last(), &preHeader, spv::Op::OpNop)->inner();
+				copy.setOperation(instr.getOperation());
+				for (const Operand& op : instr)
+				{
+					copy.addOperand(op);
+				}
+
+				if (auto id = copy.getResultIdOperand(); id != nullptr)
+				{
+					*id = InvalidId;
+				}
+
+				hoisted.emplaceUnique(&instr, &copy);
+
+				++result.hoistedInstructions;
+				result.hoistedLoads += load ? 1u : 0u;
+			}
+		}
+
+		if (result.hoistedInstructions != 0u)
+		{
+			remap(_module, _func, hoisted);
+
+			for (const auto& [instr, copy] : hoisted)
+			{
+				instr->getBasicBlock()->remove(instr);
+			}
+		}
+
+		return result;
+	}
+}
+
+spvgentwo::LoopInvariantCodeMotion::Result spvgentwo::LoopInvariantCodeMotion::hoist(Function& _func, IAllocator* _pAllocator)
+{
+	IAllocator* pAllocator = _pAllocator != nullptr ? _pAllocator : _func.getAllocator();
+	FunctionAnalyses analyses(_func, pAllocator);
+	return hoist(_func, analyses, pAllocator);
+}
+
+spvgentwo::LoopInvariantCodeMotion::Result spvgentwo::LoopInvariantCodeMotion::hoist(Function& _func, FunctionAnalyses& _analyses, IAllocator* _pAllocator)
+{
+	Result result;
+
+	if (_func.empty())
+	{
+		return result;
+	}
+
+	_analyses.unshare();
+
+	IAllocator* pAllocator = _pAllocator != nullptr ? _pAllocator : _func.getAllocator();
+	Module& module = *_func.getModule();
+
+	const DominatorTree& domTree = _analyses.getDominatorTree();
+	const ReadOnlyVariables readOnly(module, pAllocator);
+
+	// inner loop headers come after their outer loop headers in reverse post order
+	const Vector<BasicBlock*>& blocks = domTree.getBlocks();
+	for (sgt_size_t i = blocks.size(); i > 0u; --i)
+	{
+		BasicBlock& bb = *blocks[i - 1u];
+		if (bb.find_if([](const Instruction& _instr) { return _instr == spv::Op::OpLoopMerge; }) == bb.end())
+		{
+			continue;
+		}
+
+		const Result r = hoistLoop(module, _func, domTree, bb, readOnly, pAllocator);
+		result.hoistedInstructions += r.hoistedInstructions;
+		result.hoistedLoads += r.hoistedLoads;
+	}
+
+	// instructions only moved to existing blocks
+	if (result.hoistedInstructions != 0u)
+	{
+		_analyses.invalidate({ AnalysisBits::ControlFlow, AnalysisBits::Dominators, AnalysisBits::CallGraph });
+	}
+
+	return result;
+}
+
+spvgentwo::LoopInvariantCodeMotion::Result spvgentwo::LoopInvariantCodeMotion::hoist(Module& _module, IAllocator* _pAllocator)
+{
+	Result result;
+
+	auto add = [&](Function& _func)
+	{
+		const Result r = hoist(_func, _pAllocator);
+		result.hoistedInstructions += r.hoistedInstructions;
+		result.hoistedLoads += r.hoistedLoads;
+	};
+
+	for (Function& func : _module.getFunctions())
+	{
+		add(func);
+	}
+	for (EntryPoint& ep : _module.getEntryPoints())
+	{
+		add(ep);
+	}
+
+	return result;
+}
@@ -0,0 +1,779 @@
+#include "common/LoopUnrolling.h"
+#include "common/DominatorTree.h"
+#include "common/PassManager.h"
+
+#include "spvgentwo/Module.h"
+#include "spvgentwo/InstructionTemplate.inl"
+
+namespace
+{
+	using namespace spvgentwo;
+
+	using InstrMap = HashMap<const Instruction*, Instruction*>;
+
+	BasicBlock* getBlock(const Operand& _operand)
+	{
+		if (_operand.isBranchTarget())
+		{
+			return _operand.getBranchTarget();
+		}
+		else if (const Instruction* label = _operand.getInstruction(); label != nullptr && *label == spv::Op::OpLabel)
+		{
+			return label->getBasicBlock();
+		}
+		return nullptr;
+	}
+
+	const Instruction* getTarget(const Instruction& _instr)
+	{
+		return _instr.empty() ? nullptr : _instr.front().getInstruction();
+	}
+
+	Instruction* resolve(const InstrMap& _map, Instruction* _pInstr)
+	{
+		Instruction* const* mapped = _map.get(static_cast<const Instruction*>(_pInstr));
+		return mapped != nullptr ? *mapped : _pInstr;
+	}
+
+	BasicBlock* resolve(const InstrMap& _map, BasicBlock* _pBB)
+	{
+		Instruction* const* label = _map.get(static_cast<const Instruction*>(_pBB->getLabel()));
+		return label != nullptr ? (*label)->getBasicBlock() : _pBB;
+	}
+
+	bool getConstant(Module& _module, const Instruction* _pInstr, unsigned int& _outValue)
+	{
+		const Constant* info = _pInstr != nullptr ? _module.getConstantInfo(_pInstr) : nullptr;
+		if (info == nullptr || info->getOperation() != spv::Op::OpConstant || info->getType().isInt(32u) == false || info->getData().empty())
+		{
+			return false;
+		}
+		_outValue = info->getData()[0];
+		return true;
+	}
+
+	// integer comparison of 32 bit values, returns false if _op is not supported
+	bool compare(spv::Op _op, unsigned int _left, unsigned int _right, bool& _outResult)
+	{
+		const int sl = static_cast<int>(_left);
+		const int sr = static_cast<int>(_right);
+
+		switch (_op)
+		{
+		case spv::Op::OpIEqual: _outResult = _left == _right; return true;
+		case spv::Op::OpINotEqual: _outResult = _left != _right; return true;
+		case spv::Op::OpULessThan: _outResult = _left < _right; return true;
+		case spv::Op::OpULessThanEqual: _outResult = _left <= _right; return true;
+		case spv::Op::OpUGreaterThan: _outResult = _left > _right; return true;
+		case spv::Op::OpUGreaterThanEqual: _outResult = _left >= _right; return true;
+		case spv::Op::OpSLessThan: _outResult = sl < sr; return true;
+		case spv::Op::OpSLessThanEqual: _outResult = sl <= sr; return true;
+		case spv::Op::OpSGreaterThan: _outResult = sl > sr; return true;
+		case spv::Op::OpSGreaterThanEqual: _outResult = sl >= sr; return true;
+		default: return false;
+		}
+	}
+
+	struct HeaderPhi
+	{
+		Instruction* phi = nullptr;
+		Instruction* init = nullptr; // value entering the loop
+		Instruction* next = nullptr; // value of the back edge
+	};
+
+	struct Loop
+	{
+		Loop(IAllocator* _pAllocator) : blocks(_pAllocator), ordered(_pAllocator), phis(_pAllocator) {}
+
+		BasicBlock* preHeader = nullptr;
+		BasicBlock* header = nullptr;
+		BasicBlock* condition = nullptr; // block with the exit branch
+		BasicBlock* body = nullptr; // loop successor of condition
+		BasicBlock* continueTarget = nullptr;
+		BasicBlock* merge = nullptr;
+		Instruction* loopMerge = nullptr;
+
+		HashMap<const BasicBlock*, bool> blocks;
+		List<BasicBlock*> ordered; // loop blocks in function order
+		List<HeaderPhi> phis;
+		unsigned int size = 0u; // number of instructions
+
+		bool contains(const BasicBlock* _pBB) const { return _pBB != nullptr && blocks.get(_pBB) != nullptr; }
+		bool contains(const Instruction* _pInstr) const { return _pInstr != nullptr && contains(_pInstr->getBasicBlock()); }
+	};
+
+	bool isExit(const Instruction& _terminator)
+	{
+		switch (_terminator.getOperation())
+		{
+		case spv::Op::OpReturn:
+		case spv::Op::OpReturnValue:
+		case spv::Op::OpKill:
+		case spv::Op::OpUnreachable:
+		case spv::Op::OpTerminateInvocation:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	// match the structure of BasicBlock::Loop: header -> condition -> body ... -> continue target -> header, the condition is the only exit to merge
+	bool getLoop(const Function& _func, const DominatorTree& _domTree, BasicBlock& _header, Loop& _outLoop, IAllocator* _pAllocator)
+	{
+		_outLoop.header = &_header;
+
+		auto merge = _header.find_if([](const Instruction& _instr) { return _instr == spv::Op::OpLoopMerge; });
+		if (merge == _header.end())
+		{
+			return false;
+		}
+
+		// merge block, continue target, loop control
+		_outLoop.loopMerge = merge.operator->();
+		auto it = _outLoop.loopMerge->getFirstActualOperand();
+		if (it == nullptr || it.next() == nullptr || it.next().next() == nullptr)
+		{
+			return false;
+		}
+
+		_outLoop.merge = getBlock(*it);
+		_outLoop.continueTarget = getBlock(*it.next());
+
+		if ((it.next().next()->getLiteral().value & static_cast<unsigned int>(spv::LoopControlMask::DontUnroll)) != 0u)
+		{
+			return false;
+		}
+
+		const List<BasicBlock*>* preds = _domTree.getPredecessors(&_header);
+		const List<BasicBlock*>* continuePreds = _domTree.getPredecessors(_outLoop.continueTarget);
+		if (preds == nullptr || preds->size() != 2u || continuePreds == nullptr || continuePreds->size() != 1u || preds->contains(_outLoop.continueTarget) == false)
+		{
+			return false;
+		}
+
+		_outLoop.preHeader = preds->front() == _outLoop.continueTarget ? preds->back() : preds->front();
+
+		// natural loop
+		List<BasicBlock*> worklist(_pAllocator);
+		_outLoop.blocks.emplaceUnique(&_header, true);
+		worklist.emplace_back(_outLoop.continueTarget);
+
+		while (worklist.empty() == false)
+		{
+			BasicBlock* bb = worklist.pop_back();
+			if (_outLoop.contains(bb))
+			{
+				continue;
+			}
+
+			_outLoop.blocks.emplaceUnique(bb, true);
+			for (BasicBlock* pred : *_domTree.getPredecessors(bb))
+			{
+				worklist.emplace_back(pred);
+			}
+		}
+
+		// the condition is evaluated before the body
+		const Instruction* term = _header.getTerminator();
+		_outLoop.condition = term != nullptr && *term == spv::Op::OpBranch ? getBlock(*term->getFirstActualOperand()) : &_header;
+
+		if (_outLoop.contains(_outLoop.condition) == false || _outLoop.condition == _outLoop.continueTarget)
+		{
+			return false;
+		}
+
+		term = _outLoop.condition->getTerminator();
+		if (term == nullptr || *term != spv::Op::OpBranchConditional)
+		{
+			return false;
+		}
+
+		// condition, true label, false label
+		auto cond = term->getFirstActualOperand();
+		BasicBlock* trueBB = getBlock(*cond.next());
+		BasicBlock* falseBB = getBlock(*cond.next().next());
+
+		_outLoop.body = trueBB == _outLoop.merge ? falseBB : trueBB;
+		if ((trueBB != _outLoop.merge && falseBB != _outLoop.merge) || _outLoop.contains(_outLoop.body) == false)
+		{
+			return false;
+		}
+
+		if (_outLoop.condition != &_header && _outLoop.condition->size() > 1u && *_outLoop.condition->last().prev() == spv::Op::OpSelectionMerge)
+		{
+			return false;
+		}
+
+		// no other exits
+		for (const BasicBlock& bb : _func)
+		{
+			if (_outLoop.contains(&bb) == false)
+			{
+				continue;
+			}
+
+			_outLoop.ordered.emplace_back(const_cast<BasicBlock*>(&bb));
+			_outLoop.size += static_cast<unsigned int>(bb.size());
+
+			if (bb.getTerminator() == nullptr || isExit(*bb.getTerminator()))
+			{
+				return false;
+			}
+
+			if (&bb == _outLoop.condition)
+			{
+				continue;
+			}
+
+			List<BasicBlock*> successors(_pAllocator);
+			bb.getBranchTargets(successors);
+			for (BasicBlock* successor : successors)
+			{
+				if (_outLoop.contains(successor) == false)
+				{
+					return false;
+				}
+			}
+		}
+
+		// result type, id, (value, parent) pairs
+		for (Instruction& instr : _header)
+		{
+			if (instr != spv::Op::OpPhi)
+			{
+				continue;
+			}
+
+			HeaderPhi phi{ &instr };
+			for (auto op = instr.getFirstActualOperand(); op != nullptr && op.next() != nullptr; op = op.next().next())
+			{
+				(getBlock(*op.next()) == _outLoop.continueTarget ? phi.next : phi.init) = op->getInstruction();
+			}
+
+			if (phi.init == nullptr || phi.next == nullptr)
+			{
+				return false;
+			}
+
+			_outLoop.phis.emplace_back(phi);
+		}
+
+		return true;
+	}
+
+	// returns the constant operand of the increment _pInstr of _pBase or false
+	bool getStep(Module& _module, const Instruction* _pInstr, const Instruction* _pBase, unsigned int& _outStep)
+	{
+		if (_pInstr == nullptr || (*_pInstr != spv::Op::OpIAdd && *_pInstr != spv::Op::OpISub))
+		{
+			return false;
+		}
+
+		auto left = _pInstr->getFirstActualOperand();
+		const Instruction* l = left->getInstruction();
+		const Instruction* r = left.next()->getInstruction();
+
+		if (*_pInstr == spv::Op::OpIAdd && l != _pBase && r == _pBase)
+		{
+			const Instruction* tmp = l;
+			l = r;
+			r = tmp;
+		}
+
+		if (l != _pBase || getConstant(_module, r, _outStep) == false)
+		{
+			return false;
+		}
+
+		if (*_pInstr == spv::Op::OpISub)
+		{
+			_outStep = 0u - _outStep;
+		}
+
+		return true;
+	}
+
+	bool isLoadOf(const Instruction* _pInstr, const Instruction* _pVar)
+	{
+		return _pInstr != nullptr && *_pInstr == spv::Op::OpLoad && _pInstr->getFirstActualOperand()->getInstruction() == _pVar;
+	}
+
+	// start value and step of the induction variable read by _pValue
+	bool getInduction(Module& _module, const Loop& _loop, const Instruction* _pValue, unsigned int& _outInit, unsigned int& _outStep)
+	{
+		// OpPhi of the header
+		for (const HeaderPhi& phi : _loop.phis)
+		{
+			if (phi.phi == _pValue)
+			{
+				return getConstant(_module, phi.init, _outInit) && getStep(_module, phi.next, phi.phi, _outStep);
+			}
+		}
+
+		if (_pValue == nullptr || *_pValue != spv::Op::OpLoad || _loop.contains(_pValue) == false)
+		{
+			return false;
+		}
+
+		// function variable only loaded and stored once in the continue block
+		const Instruction* var = _pValue->getFirstActualOperand()->getInstruction();
+		if (var == nullptr || *var != spv::Op::OpVariable || var->getStorageClass() != spv::StorageClass::Function)
+		{
+			return false;
+		}
+
+		const Instruction* store = nullptr;
+		for (const BasicBlock* bb : _loop.ordered)
+		{
+			for (const Instruction& instr : *bb)
+			{
+				unsigned int i = 0u;
+				for (auto it = instr.getFirstActualOperand(); it != nullptr; ++it, ++i)
+				{
+					if (it->getInstruction() != var || (instr == spv::Op::OpLoad && i == 0u))
+					{
+						continue;
+					}
+					else if (instr == spv::Op::OpStore && i == 0u && store == nullptr && bb == _loop.continueTarget)
+					{
+						store = &instr;
+						continue;
+					}
+					return false;
+				}
+			}
+		}
+
+		if (store == nullptr)
+		{
+			return false;
+		}
+
+		// pointer, object
+		const Instruction* next = store->getFirstActualOperand().next()->getInstruction();
+		auto base = next != nullptr && next->getFirstActualOperand() != nullptr ? next->getFirstActualOperand()->getInstruction() : nullptr;
+		if (isLoadOf(base, var) == false || getStep(_module, next, base, _outStep) == false)
+		{
+			return false;
+		}
+
+		// last store in the pre-header
+		const Instruction* init = nullptr;
+		for (const Instruction& instr : *_loop.preHeader)
+		{
+			if (instr == spv::Op::OpStore && instr.getFirstActualOperand()->getInstruction() == var)
+			{
+				init = instr.getFirstActualOperand().next()->getInstruction();
+			}
+		}
+
+		return getConstant(_module, init, _outInit);
+	}
+
+	// returns ~0u if the trip count is not constant or exceeds _maxTripCount
+	unsigned int getTripCount(Module& _module, const Loop& _loop, unsigned int _maxTripCount)
+	{
+		const Instruction* branch = _loop.condition->getTerminator();
+		const Instruction* cond = branch->getFirstActualOperand()->getInstruction();
+
+		if (cond == nullptr || _loop.contains(cond) == false || cond->getFirstActualOperand() == nullptr || cond->getFirstActualOperand().next() == nullptr)
+		{
+			return ~0u;
+		}
+
+		const Instruction* left = cond->getFirstActualOperand()->getInstruction();
+		const Instruction* right = cond->getFirstActualOperand().next()->getInstruction();
+
+		unsigned int init = 0u, step = 0u, bound = 0u;
+		bool inductionLeft = true;
+
+		if (getConstant(_module, right, bound) && getInduction(_module, _loop, left, init, step))
+		{
+			inductionLeft = true;
+		}
+		else if (getConstant(_module, left, bound) && getInduction(_module, _loop, right, init, step))
+		{
+			inductionLeft = false;
+		}
+		else
+		{
+			return ~0u;
+		}
+
+		// the loop continues while the condition is true if the body is the true target
+		const bool continueOn = getBlock(*branch->getFirstActualOperand().next()) == _loop.body;
+
+		unsigned int i = init;
+		for (unsigned int count = 0u; count <= _maxTripCount; ++count)
+		{
+			bool result = false;
+			if (compare(cond->getOperation(), inductionLeft ? i : bound, inductionLeft ? bound : i, result) == false)
+			{
+				return ~0u;
+			}
+
+			if (result != continueOn)
+			{
+				return count;
+			}
+
+			i += step;
+		}
+
+		return ~0u;
+	}
+
+	// copy loop blocks for one iteration, header phis are replaced by the values of the previous iteration (_prev).
+	// the copy of the condition branches to the body or to the merge block (_exit), only the header and condition are copied for the exit
+	void copyIteration(Function& _func, const Loop& _loop, const InstrMap& _prev, InstrMap& _map, bool _exit)
+	{
+		List<Instruction*> copies(_func.getAllocator());
+
+		for (BasicBlock* bb : _loop.ordered)
+		{
+			if (_exit && bb != _loop.header && bb != _loop.condition)
+			{
+				continue;
+			}
+
+			BasicBlock& dst = _func.addBasicBlock();
+			_map.emplaceUnique(bb->getLabel(), dst.getLabel());
+
+			for (const Instruction& instr : *bb)
+			{
+				if ((bb == _loop.header && instr == spv::Op::OpPhi) || &instr == _loop.loopMerge)
+				{
+					continue;
+				}
+
+				Instruction* copy = &dst.emplace_back(&dst, spv::Op::OpNop);
+				copy->setOperation(instr.getOperation());
+				for (const Operand& op : instr)
+				{
+					copy->addOperand(op);
+				}
+
+				if (auto id = copy->getResultIdOperand(); id != nullptr)
+				{
+					*id = InvalidId;
+				}
+
+				_map.emplaceUnique(&instr, copy);
+				copies.emplace_back(copy);
+			}
+		}
+
+		// decorations of the copies, header phis are mapped to values of the previous iteration afterwards
+		_func.getModule()->copyDecorations(_map);
+
+		for (const HeaderPhi& phi : _loop.phis)
+		{
+			_map.emplaceUnique(phi.phi, resolve(_prev, phi.next));
+		}
+
+		for (Instruction* copy : copies)
+		{
+			for (Operand& op : *copy)
+			{
+				if (op.isInstruction())
+				{
+					op = resolve(_map, op.getInstruction());
+				}
+				else if (op.isBranchTarget())
+				{
+					op = resolve(_map, op.getBranchTarget());
+				}
+			}
+		}
+
+		Instruction* term = resolve(_map, _loop.condition)->getTerminator();
+		term->reset();
+		term->opBranch(_exit ? _loop.merge : resolve(_map, _loop.body));
+	}
+
+	void setBranch(BasicBlock* _pFrom, BasicBlock* _pTo)
+	{
+		Instruction* term = _pFrom->getTerminator();
+		term->reset();
+		term->opBranch(_pTo);
+	}
+
+	void fullyUnroll(Module& _module, Function& _func, const Loop& _loop, unsigned int _tripCount, IAllocator* _pAllocator)
+	{
+		InstrMap prev(_pAllocator);
+		for (const HeaderPhi& phi : _loop.phis)
+		{
+			prev.emplaceUnique(phi.phi, phi.init);
+		}
+
+		// iteration 0 uses the original blocks
+		const InstrMap first(stdrep::move(prev));
+		prev = InstrMap(_pAllocator);
+
+		BasicBlock* continueTarget = _loop.continueTarget;
+
+		for (unsigned int k = 1u; k <= _tripCount; ++k)
+		{
+			InstrMap map(_pAllocator);
+			copyIteration(_func, _loop, k == 1u ? first : prev, map, k == _tripCount);
+
+			setBranch(continueTarget, resolve(map, _loop.header));
+			continueTarget = resolve(map, _loop.continueTarget);
+
+			prev = stdrep::move(map);
+		}
+
+		// prev is the exit iteration: uses after the loop
+		BasicBlock* exitCondition = resolve(prev, _loop.condition);
+
+		for (BasicBlock& bb : _func)
+		{
+			if (_loop.contains(&bb))
+			{
+				// the original blocks are the first iteration
+				for (Instruction& instr : bb)
+				{
+					for (Operand& op : instr)
+					{
+						if (op.isInstruction())
+						{
+							op = resolve(first, op.getInstruction());
+						}
+					}
+				}
+				continue;
+			}
+
+			for (Instruction& instr : bb)
+			{
+				for (Operand& op : instr)
+				{
+					if (op.isInstruction() && _loop.contains(op.getInstruction()))
+					{
+						op = resolve(prev, op.getInstruction());
+					}
+					else if (instr == spv::Op::OpPhi && getBlock(op) == _loop.condition)
+					{
+						op = op.isBranchTarget() ? Operand(exitCondition) : Operand(exitCondition->getLabel());
+					}
+				}
+			}
+		}
+
+		// remove the loop construct from the original blocks
+		auto sweep = [&_loop](List<Instruction>& _container)
+		{
+			for (auto it = _container.begin(); it != _container.end();)
+			{
+				const Instruction* target = getTarget(*it);
+				if (_loop.phis.find_if([target](const HeaderPhi& _phi) { return _phi.phi == target; }) != _loop.phis.end())
+				{
+					it = _container.erase(it);
+				}
+				else
+				{
+					++it;
+				}
+			}
+		};
+
+		sweep(_module.getNames());
+		sweep(_module.getDecorations());
+
+		for (const HeaderPhi& phi : _loop.phis)
+		{
+			_loop.header->remove(phi.phi);
+		}
+		_loop.header->remove(_loop.loopMerge);
+
+		setBranch(_loop.condition, _loop.body);
+	}
+
+	void partiallyUnroll(Function& _func, const Loop& _loop, unsigned int _factor, IAllocator* _pAllocator)
+	{
+		// header phis stay in place for the original iteration
+		InstrMap prev(_pAllocator);
+		BasicBlock* continueTarget = _loop.continueTarget;
+
+		for (unsigned int k = 1u; k < _factor; ++k)
+		{
+			InstrMap map(_pAllocator);
+			copyIteration(_func, _loop, prev, map, false);
+
+			setBranch(continueTarget, resolve(map, _loop.header));
+			continueTarget = resolve(map, _loop.continueTarget);
+
+			prev = stdrep::move(map);
+		}
+
+		setBranch(continueTarget, _loop.header);
+
+		// back edge values come from the last copy
+		for (const HeaderPhi& phi : _loop.phis)
+		{
+			for (auto op = phi.phi->getFirstActualOperand(); op != nullptr && op.next() != nullptr; op = op.next().next())
+			{
+				if (getBlock(*op.next()) == _loop.continueTarget)
+				{
+					*op = resolve(prev, phi.next);
+					*op.next() = continueTarget;
+				}
+			}
+		}
+
+		// merge block, continue target
+		*_loop.loopMerge->getFirstActualOperand().next() = continueTarget;
+	}
+
+	void markUnroll(Instruction* _pLoopMerge)
+	{
+		auto control = _pLoopMerge->getFirstActualOperand().next().next();
+		*control = literal_t{ control->getLiteral().value | static_cast<unsigned int>(spv::LoopControlMask::Unroll) };
+	}
+
+	// blocks have to appear after their dominators
+	void sortBlocks(Function& _func, const DominatorTree& _domTree, IAllocator* _pAllocator)
+	{
+
+		HashMap<const BasicBlock*, Entry<BasicBlock>*> entries(_pAllocator);
+		List<Entry<BasicBlock>*> unreachable(_pAllocator);
+
+		for (auto it = _func.begin(); it != _func.end(); ++it)
+		{
+			entries.emplaceUnique(it.operator->(), it.entry());
+			if (_domTree.isReachable(it.operator->()) == false)
+			{
+				unreachable.emplace_back(it.entry());
+			}
+		}
+
+		auto moveToEnd = [&_func](Entry<BasicBlock>* _pEntry)
+		{
+			_func.erase(Function::Iterator(_pEntry), false);
+			_func.append_entry(_pEntry);
+		};
+
+		for (const BasicBlock* bb : _domTree.getBlocks())
+		{
+			moveToEnd(*entries.get(bb));
+		}
+		for (Entry<BasicBlock>* entry : unreachable)
+		{
+			moveToEnd(entry);
+		}
+	}
+}
+
+spvgentwo::LoopUnrolling::Result spvgentwo::LoopUnrolling::unroll(Function& _func, const Options& _options, IAllocator* _pAllocator)
+{
+	IAllocator* pAllocator = _pAllocator != nullptr ? _pAllocator : _func.getAllocator();
+	FunctionAnalyses analyses(_func, pAllocator);
+	return unroll(_func, analyses, _options, pAllocator);
+}
+
+spvgentwo::LoopUnrolling::Result spvgentwo::LoopUnrolling::unroll(Function& _func, FunctionAnalyses& _analyses, const Options& _options, IAllocator* _pAllocator)
+{
+	Result result;
+
+	if (_func.empty())
+	{
+		return result;
+	}
+
+	_analyses.unshare();
+
+	IAllocator* pAllocator = _pAllocator != nullptr ? _pAllocator : _func.getAllocator();
+	Module& module = *_func.getModule();
+
+	// inner loop headers come after their outer loop headers in reverse post order
+	List<BasicBlock*> headers(pAllocator);
+	{
+		const DominatorTree& domTree = _analyses.getDominatorTree();
+		for (BasicBlock* bb : domTree.getBlocks())
+		{
+			if (bb->find_if([](const Instruction& _instr) { return _instr == spv::Op::OpLoopMerge; }) != bb->end())
+			{
+				headers.emplace_front(bb);
+			}
+		}
+	}
+
+	bool changed = false;
+
+	for (BasicBlock* header : headers)
+	{
+		const DominatorTree& domTree = _analyses.getDominatorTree();
+
+		Loop loop(pAllocator);
+		if (domTree.isReachable(header) == false || getLoop(_func, domTree, *header, loop, pAllocator) == false)
+		{
+			continue;
+		}
+
+		const unsigned int tripCount = getTripCount(module, loop, _options.maxTripCount);
+		if (tripCount == ~0u || tripCount == 0u)
+		{
+			continue;
+		}
+
+		if (tripCount * loop.size <= _options.maxSize)
+		{
+			fullyUnroll(module, _func, loop, tripCount, pAllocator);
+			_analyses.invalidate(); // the control flow changes with every unrolled loop
+			++result.fullyUnrolled;
+			changed = true;
+			continue;
+		}
+
+		unsigned int factor = _options.maxFactor < tripCount ? _options.maxFactor : tripCount - 1u;
+		while (factor > 1u && (tripCount % factor != 0u || factor * loop.size > _options.maxSize))
+		{
+			--factor;
+		}
+
+		if (factor > 1u)
+		{
+			partiallyUnroll(_func, loop, factor, pAllocator);
+			_analyses.invalidate();
+			++result.partiallyUnrolled;
+			changed = true;
+		}
+
+		if (_options.markUnroll)
+		{
+			markUnroll(loop.loopMerge);
+			++result.markedLoops;
+		}
+	}
+
+	if (changed)
+	{
+		sortBlocks(_func, _analyses.getDominatorTree(), pAllocator);
+	}
+
+	return result;
+}
+
+spvgentwo::LoopUnrolling::Result spvgentwo::LoopUnrolling::unroll(Module& _module, const Options& _options, IAllocator* _pAllocator)
+{
+	Result result;
+
+	auto add = [&](Function& _func)
+	{
+		const Result r = unroll(_func, _options, _pAllocator);
+		result.fullyUnrolled += r.fullyUnrolled;
+		result.partiallyUnrolled += r.partiallyUnrolled;
+		result.markedLoops += r.markedLoops;
+	};
+
+	for (Function& func : _module.getFunctions())
+	{
+		add(func);
+	}
+	for (EntryPoint& ep : _module.getEntryPoints())
+	{
+		add(ep);
+	}
+
+	return result;
+}
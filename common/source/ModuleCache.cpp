@@ -0,0 +1,587 @@
+#include "common/ModuleCache.h"
+#include "common/BinaryVectorWriter.h"
+
+#include "spvgentwo/Module.h"
+#include "spvgentwo/ModuleTemplate.inl"
+
+#include <cstdio>
+#include <mutex>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <Windows.h> // MoveFileExA
+#else
+#include <sys/types.h> // off_t
+#endif
+
+namespace
+{
+	using namespace spvgentwo;
+
+	constexpr sgt_uint32_t PackMagic = 0x43544753u; // 'SGTC'
+	constexpr sgt_uint32_t PackVersion = 1u;
+	constexpr sgt_uint32_t RecordMagic = 0x52544753u; // 'SGTR'
+
+	struct PackHeader
+	{
+		sgt_uint32_t magic = PackMagic;
+		sgt_uint32_t version = PackVersion;
+	};
+
+	struct RecordHeader
+	{
+		sgt_uint32_t magic = 0u; // RecordMagic once the record is committed
+		sgt_uint32_t words = 0u;
+		sgt_uint64_t key = 0u;
+		sgt_uint64_t checksum = 0u; // FNV1a of the payload
+	};
+
+	static_assert(sizeof(RecordHeader) == 24u, "RecordHeader padded");
+
+	constexpr sgt_size_t recordBytes(unsigned int _words)
+	{
+		return sizeof(RecordHeader) + _words * sizeof(sgt_uint32_t);
+	}
+
+	FILE* openFile(const char* _path, const char* _mode)
+	{
+		FILE* file = nullptr;
+#ifdef _CRT_INSECURE_DEPRECATE
+		if (fopen_s(&file, _path, _mode) != 0)
+		{
+			return nullptr;
+		}
+#else
+		file = fopen(_path, _mode);
+#endif
+		return file;
+	}
+
+	// long is 32 bit on LLP64, use the 64 bit variants to address packs above 2 GB
+	bool seek(FILE* _pFile, sgt_size_t _offset, int _origin = SEEK_SET)
+	{
+#ifdef _WIN32
+		return _fseeki64(_pFile, static_cast<__int64>(_offset), _origin) == 0;
+#else
+		return fseeko(_pFile, static_cast<off_t>(_offset), _origin) == 0;
+#endif
+	}
+
+	// returns false if the position is unknown
+	bool tell(FILE* _pFile, sgt_size_t& _outOffset)
+	{
+#ifdef _WIN32
+		const __int64 offset = _ftelli64(_pFile);
+#else
+		const off_t offset = ftello(_pFile);
+#endif
+		_outOffset = static_cast<sgt_size_t>(offset);
+		return offset >= 0;
+	}
+
+	// atomically replace _target by _source, _target stays untouched on failure
+	bool replaceFile(const char* _source, const char* _target)
+	{
+#ifdef _WIN32
+		return MoveFileExA(_source, _target, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+		return rename(_source, _target) == 0; // POSIX rename replaces _target atomically
+#endif
+	}
+
+	// payload and a zero terminator word are written first, the record becomes visible when its magic is written
+	bool writeRecord(FILE* _pFile, sgt_size_t _offset, Hash64 _key, const unsigned int* _pWords, unsigned int _count, Hash64 _checksum)
+	{
+		RecordHeader header{};
+		header.words = _count;
+		header.key = _key.value;
+		header.checksum = _checksum.value;
+
+		const sgt_uint32_t terminator = 0u;
+
+		if (seek(_pFile, _offset) == false ||
+			fwrite(&header, sizeof(header), 1u, _pFile) != 1u ||
+			fwrite(_pWords, sizeof(sgt_uint32_t), _count, _pFile) != _count ||
+			fwrite(&terminator, sizeof(terminator), 1u, _pFile) != 1u ||
+			fflush(_pFile) != 0)
+		{
+			return false;
+		}
+
+		return seek(_pFile, _offset) &&
+			fwrite(&RecordMagic, sizeof(RecordMagic), 1u, _pFile) == 1u &&
+			fflush(_pFile) == 0;
+	}
+
+	struct Survivor
+	{
+		Hash64 key;
+		sgt_size_t offset;
+		unsigned int words;
+		Hash64 checksum;
+		sgt_uint64_t lastUse;
+	};
+
+	// sort by lastUse, oldest first
+	void sortByUse(Survivor* _pData, sgt_size_t _count)
+	{
+		auto sift = [_pData](sgt_size_t _root, sgt_size_t _end)
+		{
+			for (sgt_size_t child = 2u * _root + 1u; child < _end; child = 2u * _root + 1u)
+			{
+				if (child + 1u < _end && _pData[child].lastUse < _pData[child + 1u].lastUse)
+				{
+					++child;
+				}
+
+				if (_pData[_root].lastUse >= _pData[child].lastUse)
+				{
+					return;
+				}
+
+				const Survivor tmp = _pData[_root];
+				_pData[_root] = _pData[child];
+				_pData[child] = tmp;
+				_root = child;
+			}
+		};
+
+		for (sgt_size_t i = _count / 2u; i-- > 0u;)
+		{
+			sift(i, _count);
+		}
+
+		for (sgt_size_t end = _count; end-- > 1u;)
+		{
+			const Survivor tmp = _pData[0];
+			_pData[0] = _pData[end];
+			_pData[end] = tmp;
+			sift(0u, end);
+		}
+	}
+}
+
+struct spvgentwo::ModuleCache::Pack
+{
+	FILE* file = nullptr;
+	mutable std::mutex mutex;
+};
+
+spvgentwo::ModuleCache::ModuleCache(IAllocator* _pAllocator, const char* _pPath, sgt_size_t _maxBytes) :
+	m_pAllocator(_pAllocator),
+	m_maxBytes(_maxBytes),
+	m_pPack(_pAllocator->construct<Pack>()),
+	m_path(_pAllocator),
+	m_index(_pAllocator),
+	m_scratch(_pAllocator)
+{
+	if (_pPath != nullptr)
+	{
+		open(_pPath);
+	}
+}
+
+spvgentwo::ModuleCache::~ModuleCache()
+{
+	close();
+	m_pAllocator->destruct(m_pPack);
+}
+
+bool spvgentwo::ModuleCache::open(const char* _pPath)
+{
+	std::lock_guard<std::mutex> lock(m_pPack->mutex);
+
+	if (m_pPack->file != nullptr || _pPath == nullptr)
+	{
+		return false;
+	}
+
+	m_path = _pPath;
+	m_pPack->file = openFile(_pPath, "r+b");
+
+	if (m_pPack->file == nullptr)
+	{
+		return create();
+	}
+
+	PackHeader header{};
+	if (fread(&header, sizeof(header), 1u, m_pPack->file) != 1u || header.magic != PackMagic || header.version != PackVersion)
+	{
+		fclose(m_pPack->file);
+		m_pPack->file = nullptr;
+		return create();
+	}
+
+	return scan() && (m_maxBytes == 0u || m_end <= m_maxBytes || evict());
+}
+
+bool spvgentwo::ModuleCache::isOpen() const
+{
+	std::lock_guard<std::mutex> lock(m_pPack->mutex);
+	return m_pPack->file != nullptr;
+}
+
+void spvgentwo::ModuleCache::close()
+{
+	std::lock_guard<std::mutex> lock(m_pPack->mutex);
+
+	if (m_pPack->file != nullptr)
+	{
+		fclose(m_pPack->file);
+		m_pPack->file = nullptr;
+	}
+
+	m_index.clear();
+	m_end = 0u;
+}
+
+bool spvgentwo::ModuleCache::contains(Hash64 _key) const
+{
+	std::lock_guard<std::mutex> lock(m_pPack->mutex);
+	return m_index.get(_key) != nullptr;
+}
+
+bool spvgentwo::ModuleCache::load(Hash64 _key, IWriter& _writer)
+{
+	std::lock_guard<std::mutex> lock(m_pPack->mutex);
+
+	Entry* entry = m_index.get(_key);
+	if (entry == nullptr || m_pPack->file == nullptr)
+	{
+		++m_stats.misses;
+		return false;
+	}
+
+	if (readRecord(*entry) == false)
+	{
+		// corrupt record is skipped, the space is reclaimed by the next eviction
+		m_index.erase(m_index.find(_key));
+		++m_stats.misses;
+		return false;
+	}
+
+	entry->lastUse = m_useCounter++;
+	++m_stats.hits;
+
+	for (unsigned int word : m_scratch)
+	{
+		if (_writer.put(word) == false)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool spvgentwo::ModuleCache::store(Hash64 _key, const unsigned int* _pWords, sgt_size_t _count)
+{
+	std::lock_guard<std::mutex> lock(m_pPack->mutex);
+
+	if (m_pPack->file == nullptr || _pWords == nullptr || _count == 0u || _count > 0xffffffffu)
+	{
+		return false;
+	}
+
+	if (m_index.get(_key) != nullptr)
+	{
+		return true;
+	}
+
+	if (append(_key, _pWords, _count) == false)
+	{
+		return false;
+	}
+
+	++m_stats.stores;
+
+	return m_maxBytes == 0u || m_end <= m_maxBytes || evict();
+}
+
+bool spvgentwo::ModuleCache::finalizeAndWrite(Module& _module, Hash64 _inputHash, IWriter& _writer, const Grammar* _pGrammar)
+{
+	const Hash64 key = hashModule(_module, _inputHash);
+
+	if (load(key, _writer))
+	{
+		return true;
+	}
+
+	Vector<unsigned int> binary(m_pAllocator);
+	BinaryVectorWriter<Vector<unsigned int>> writer(binary);
+
+	if (_module.finalizeAndWrite(writer, _pGrammar) == false)
+	{
+		return false;
+	}
+
+	store(key, binary.data(), binary.size()); // failing to cache the binary is not an error
+
+	for (unsigned int word : binary)
+	{
+		if (_writer.put(word) == false)
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+spvgentwo::Hash64 spvgentwo::ModuleCache::hashModule(const Module& _module, Hash64 _seed)
+{
+	unsigned int count = 0u;
+	_module.iterateInstructions([&count](const Instruction&) { ++count; });
+
+	HashMap<const Instruction*, unsigned int> positions(_module.getAllocator(), count / 2u + 1u);
+
+	unsigned int pos = 0u;
+	_module.iterateInstructions([&positions, &pos](const Instruction& _instr) { positions.emplaceUnique(&_instr, pos++); });
+
+	auto position = [&positions](const Instruction* _pInstr) -> unsigned int
+	{
+		const unsigned int* p = positions.get(_pInstr);
+		return p != nullptr ? *p : ~0u;
+	};
+
+	FNV1aHasher hasher(_seed);
+	hasher << _module.getSpvVersion();
+
+	_module.iterateInstructions([&hasher, &position](const Instruction& _instr)
+	{
+		hasher << _instr.getOperation() << static_cast<unsigned int>(_instr.size());
+
+		for (const Operand& op : _instr)
+		{
+			hasher << op.type;
+
+			switch (op.type)
+			{
+			case Operand::Type::Instruction:
+				hasher << position(op.instruction);
+				break;
+			case Operand::Type::BranchTarget:
+				hasher << position(op.branchTarget->getLabel());
+				break;
+			case Operand::Type::Literal:
+				hasher << op.literal.value;
+				break;
+			case Operand::Type::Id:
+				hasher << op.id;
+				break;
+			}
+		}
+	});
+
+	return hasher.get();
+}
+
+spvgentwo::ModuleCacheStats spvgentwo::ModuleCache::getStats() const
+{
+	std::lock_guard<std::mutex> lock(m_pPack->mutex);
+
+	ModuleCacheStats stats = m_stats;
+	stats.entries = m_index.elements();
+	stats.packBytes = m_end;
+	return stats;
+}
+
+bool spvgentwo::ModuleCache::create()
+{
+	m_pPack->file = openFile(m_path.c_str(), "w+b");
+	if (m_pPack->file == nullptr)
+	{
+		return false;
+	}
+
+	const PackHeader header{};
+	const sgt_uint32_t terminator = 0u;
+	m_end = sizeof(PackHeader);
+
+	return fwrite(&header, sizeof(header), 1u, m_pPack->file) == 1u &&
+		fwrite(&terminator, sizeof(terminator), 1u, m_pPack->file) == 1u &&
+		fflush(m_pPack->file) == 0;
+}
+
+bool spvgentwo::ModuleCache::scan()
+{
+	FILE* file = m_pPack->file;
+
+	sgt_size_t fileSize = 0u;
+	if (seek(file, 0u, SEEK_END) == false || tell(file, fileSize) == false)
+	{
+		return false;
+	}
+
+	// record order is the order of use
+	sgt_size_t offset = sizeof(PackHeader);
+	for (RecordHeader header{}; offset + sizeof(RecordHeader) <= fileSize; offset += recordBytes(header.words))
+	{
+		if (seek(file, offset) == false ||
+			fread(&header, sizeof(header), 1u, file) != 1u ||
+			header.magic != RecordMagic ||
+			offset + recordBytes(header.words) > fileSize)
+		{
+			break; // uncommitted or torn record
+		}
+
+		Entry* entry = m_index.get(Hash64{ header.key });
+		if (entry == nullptr)
+		{
+			entry = &m_index.emplaceWithHash(Hash64{ header.key }, Hash64{ header.key }).kv.value;
+		}
+
+		entry->offset = offset;
+		entry->words = header.words;
+		entry->checksum = header.checksum;
+		entry->lastUse = m_useCounter++;
+	}
+
+	m_end = offset;
+
+	return true;
+}
+
+bool spvgentwo::ModuleCache::append(Hash64 _key, const unsigned int* _pWords, sgt_size_t _count)
+{
+	const unsigned int words = static_cast<unsigned int>(_count);
+
+	FNV1aHasher hasher;
+	const Hash64 checksum = hasher.add(_pWords, words * sizeof(sgt_uint32_t));
+
+	if (writeRecord(m_pPack->file, m_end, _key, _pWords, words, checksum) == false)
+	{
+		return false;
+	}
+
+	Entry& entry = m_index.emplaceWithHash(_key, _key).kv.value;
+	entry.offset = m_end;
+	entry.words = words;
+	entry.checksum = checksum;
+	entry.lastUse = m_useCounter++;
+
+	m_end += recordBytes(words);
+
+	return true;
+}
+
+bool spvgentwo::ModuleCache::readRecord(const Entry& _entry)
+{
+	m_scratch.clear();
+
+	if (m_scratch.reserve(_entry.words) == false || seek(m_pPack->file, _entry.offset + sizeof(RecordHeader)) == false)
+	{
+		return false;
+	}
+
+	unsigned int chunk[256];
+	for (unsigned int remaining = _entry.words; remaining != 0u;)
+	{
+		const unsigned int n = remaining < 256u ? remaining : 256u;
+		if (fread(chunk, sizeof(sgt_uint32_t), n, m_pPack->file) != n)
+		{
+			return false;
+		}
+
+		for (unsigned int i = 0u; i < n; ++i)
+		{
+			m_scratch.emplace_back(chunk[i]);
+		}
+
+		remaining -= n;
+	}
+
+	FNV1aHasher hasher;
+	return hasher.add(m_scratch.data(), m_scratch.size() * sizeof(sgt_uint32_t)) == _entry.checksum;
+}
+
+bool spvgentwo::ModuleCache::evict()
+{
+	Vector<Survivor> survivors(m_pAllocator);
+	if (survivors.reserve(m_index.elements()) == false)
+	{
+		return false;
+	}
+
+	for (const auto& [key, entry] : m_index)
+	{
+		survivors.emplace_back(Survivor{ key, entry.offset, entry.words, entry.checksum, entry.lastUse });
+	}
+
+	sortByUse(survivors.data(), survivors.size());
+
+	// keep the most recently used entries which fit into 3/4 of the limit to not rewrite the pack on every store
+	const sgt_size_t budget = m_maxBytes / 4u * 3u;
+	sgt_size_t first = survivors.size();
+	for (sgt_size_t bytes = sizeof(PackHeader); first > 0u && bytes + recordBytes(survivors[first - 1u].words) <= budget; --first)
+	{
+		bytes += recordBytes(survivors[first - 1u].words);
+	}
+
+	const String tmpPath = m_path + ".tmp";
+	FILE* tmp = openFile(tmpPath.c_str(), "wb");
+	if (tmp == nullptr)
+	{
+		return false;
+	}
+
+	const PackHeader header{};
+	bool success = fwrite(&header, sizeof(header), 1u, tmp) == 1u;
+
+	HashMap<Hash64, Entry> index(m_pAllocator, m_index.getBucketCount());
+	sgt_size_t end = sizeof(PackHeader);
+
+	for (sgt_size_t i = first; i < survivors.size() && success; ++i)
+	{
+		const Survivor& s = survivors[i];
+		Entry entry{ s.offset, s.words, s.checksum, s.lastUse };
+
+		if (readRecord(entry) == false)
+		{
+			continue; // drop corrupt record
+		}
+
+		success = writeRecord(tmp, end, s.key, m_scratch.data(), s.words, s.checksum);
+
+		entry.offset = end;
+		index.emplaceWithHash(s.key, s.key, entry);
+		end += recordBytes(s.words);
+	}
+
+	fclose(tmp);
+
+	if (success == false)
+	{
+		remove(tmpPath.c_str());
+		return false;
+	}
+
+	// the pack can't be replaced while it is open on Windows
+	fclose(m_pPack->file);
+	m_pPack->file = nullptr;
+
+	if (replaceFile(tmpPath.c_str(), m_path.c_str()) == false)
+	{
+		// keep using the old pack
+		remove(tmpPath.c_str());
+		m_pPack->file = openFile(m_path.c_str(), "r+b");
+		if (m_pPack->file == nullptr)
+		{
+			m_index.clear();
+		}
+		return false;
+	}
+
+	m_pPack->file = openFile(m_path.c_str(), "r+b");
+	if (m_pPack->file == nullptr)
+	{
+		m_index.clear();
+		return false;
+	}
+
+	m_stats.evictions += m_index.elements() - index.elements();
+	m_index = stdrep::move(index);
+	m_end = end;
+
+	return true;
+}
@@ -0,0 +1,321 @@
+#include "common/ModulePool.h"
+
+spvgentwo::ModuleArena::ModuleArena(IAllocator* _pBackingAllocator, sgt_size_t _chunkSize) :
+	IAllocator(),
+	m_pBackingAllocator(_pBackingAllocator),
+	m_chunkSize(_chunkSize < MaxSmallSize ? MaxSmallSize : _chunkSize)
+{
+}
+
+spvgentwo::ModuleArena::~ModuleArena()
+{
+	release();
+}
+
+unsigned int spvgentwo::ModuleArena::getSizeClass(sgt_size_t _bytes, sgt_size_t& _outBlockSize)
+{
+	if (_bytes == 0u)
+	{
+		_bytes = 1u;
+	}
+
+	if (_bytes <= MaxSmallSize)
+	{
+		const unsigned int index = static_cast<unsigned int>((_bytes + MinAlignment - 1u) / MinAlignment) - 1u;
+		_outBlockSize = (index + 1u) * MinAlignment;
+		return index;
+	}
+
+	sgt_size_t blockSize = MaxSmallSize << 1u;
+	for (unsigned int i = 0u; i < LargeClassCount; ++i, blockSize <<= 1u)
+	{
+		if (_bytes <= blockSize)
+		{
+			_outBlockSize = blockSize;
+			return SmallClassCount + i;
+		}
+	}
+
+	_outBlockSize = _bytes;
+	return InvalidClass;
+}
+
+void* spvgentwo::ModuleArena::carve(sgt_size_t _blockSize)
+{
+	if (m_pCurrent == nullptr || static_cast<sgt_size_t>(m_pEnd - m_pCurrent) < _blockSize)
+	{
+		if (m_pBackingAllocator == nullptr)
+		{
+			return nullptr;
+		}
+
+		// chunk header is padded to MinAlignment so that all blocks carved from the chunk stay aligned
+		constexpr sgt_size_t headerSize = (sizeof(Chunk) + MinAlignment - 1u) & ~(MinAlignment - 1u);
+		const sgt_size_t chunkSize = headerSize + (_blockSize > m_chunkSize ? _blockSize : m_chunkSize);
+
+		void* mem = m_pBackingAllocator->allocate(chunkSize, static_cast<unsigned int>(MinAlignment));
+		if (mem == nullptr)
+		{
+			return nullptr;
+		}
+
+		// the remainder of the previous chunk is wasted, it is at most one block of the requested class
+		Chunk* chunk = static_cast<Chunk*>(mem);
+		chunk->next = m_pChunks;
+		chunk->size = chunkSize;
+		m_pChunks = chunk;
+
+		m_pCurrent = static_cast<char*>(mem) + headerSize;
+		m_pEnd = static_cast<char*>(mem) + chunkSize;
+		m_reservedBytes += chunkSize;
+	}
+
+	void* ptr = m_pCurrent;
+	m_pCurrent += _blockSize;
+	return ptr;
+}
+
+void* spvgentwo::ModuleArena::allocate(sgt_size_t _bytes, [[maybe_unused]] unsigned int _alignmentHint)
+{
+	sgt_size_t blockSize = 0u;
+	const unsigned int sizeClass = getSizeClass(_bytes, blockSize);
+
+	void* ptr = nullptr;
+
+	if (sizeClass == InvalidClass)
+	{
+		if (m_pBackingAllocator == nullptr)
+		{
+			return nullptr;
+		}
+
+		ptr = m_pBackingAllocator->allocate(blockSize, static_cast<unsigned int>(MinAlignment));
+		if (ptr != nullptr)
+		{
+			m_reservedBytes += blockSize;
+		}
+	}
+	else if (FreeBlock* block = m_pFreeLists[sizeClass]; block != nullptr)
+	{
+		m_pFreeLists[sizeClass] = block->next;
+		ptr = block;
+	}
+	else
+	{
+		ptr = carve(blockSize);
+	}
+
+	if (ptr != nullptr)
+	{
+		m_usedBytes += blockSize;
+		if (m_usedBytes > m_peakUsedBytes)
+		{
+			m_peakUsedBytes = m_usedBytes;
+		}
+	}
+
+	return ptr;
+}
+
+void spvgentwo::ModuleArena::deallocate(void* _ptr, sgt_size_t _bytes)
+{
+	if (_ptr == nullptr || _bytes == 0u)
+	{
+		return;
+	}
+
+	sgt_size_t blockSize = 0u;
+	const unsigned int sizeClass = getSizeClass(_bytes, blockSize);
+
+	m_usedBytes -= blockSize;
+
+	if (sizeClass == InvalidClass)
+	{
+		m_reservedBytes -= blockSize;
+		m_pBackingAllocator->deallocate(_ptr, blockSize);
+		return;
+	}
+
+	FreeBlock* block = static_cast<FreeBlock*>(_ptr);
+	block->next = m_pFreeLists[sizeClass];
+	m_pFreeLists[sizeClass] = block;
+}
+
+void spvgentwo::ModuleArena::release()
+{
+	while (m_pChunks != nullptr)
+	{
+		Chunk* next = m_pChunks->next;
+		m_reservedBytes -= m_pChunks->size;
+		m_pBackingAllocator->deallocate(m_pChunks, m_pChunks->size);
+		m_pChunks = next;
+	}
+
+	for (FreeBlock*& list : m_pFreeLists)
+	{
+		list = nullptr;
+	}
+
+	m_pCurrent = nullptr;
+	m_pEnd = nullptr;
+	m_usedBytes = 0u;
+	m_peakUsedBytes = 0u;
+}
+
+spvgentwo::ModulePool::Slot::Slot(IAllocator* _pBackingAllocator, sgt_size_t _chunkSize, ILogger* _pLogger, ITypeInferenceAndVailation* _pTypeInferenceAndVailation) :
+	arena(_pBackingAllocator, _chunkSize),
+	module(&arena, _pLogger, _pTypeInferenceAndVailation)
+{
+}
+
+spvgentwo::ModulePool::Handle::Handle(Handle&& _other) noexcept :
+	m_pPool(_other.m_pPool),
+	m_pSlot(_other.m_pSlot)
+{
+	_other.m_pPool = nullptr;
+	_other.m_pSlot = nullptr;
+}
+
+spvgentwo::ModulePool::Handle::~Handle()
+{
+	release();
+}
+
+spvgentwo::ModulePool::Handle& spvgentwo::ModulePool::Handle::operator=(Handle&& _other) noexcept
+{
+	if (this == &_other) return *this;
+
+	release();
+
+	m_pPool = _other.m_pPool;
+	m_pSlot = _other.m_pSlot;
+
+	_other.m_pPool = nullptr;
+	_other.m_pSlot = nullptr;
+
+	return *this;
+}
+
+void spvgentwo::ModulePool::Handle::release()
+{
+	if (m_pPool != nullptr && m_pSlot != nullptr)
+	{
+		m_pPool->release(m_pSlot);
+	}
+
+	m_pPool = nullptr;
+	m_pSlot = nullptr;
+}
+
+spvgentwo::ModulePool::ModulePool(IAllocator* _pAllocator, const Grammar* _pGrammar, ILogger* _pLogger, ITypeInferenceAndVailation* _pTypeInferenceAndVailation, sgt_size_t _arenaChunkSize) :
+	m_pAllocator(_pAllocator),
+	m_pGrammar(_pGrammar),
+	m_pLogger(_pLogger),
+	m_pTypeInferenceAndVailation(_pTypeInferenceAndVailation),
+	m_arenaChunkSize(_arenaChunkSize),
+	m_slots(_pAllocator)
+{
+}
+
+spvgentwo::ModulePool::~ModulePool()
+{
+	// outstanding handles would dangle, modules are destroyed before their arenas (member order of Slot)
+	m_slots.clear();
+	m_pIdle = nullptr;
+}
+
+spvgentwo::ModulePool::Handle spvgentwo::ModulePool::acquire()
+{
+	++m_stats.acquired;
+
+	Slot* slot = m_pIdle;
+
+	if (slot != nullptr)
+	{
+		m_pIdle = slot->nextIdle;
+		slot->nextIdle = nullptr;
+		++m_stats.reused;
+	}
+	else
+	{
+		slot = &m_slots.emplace_back(m_pAllocator, m_arenaChunkSize, m_pLogger, m_pTypeInferenceAndVailation);
+		++m_stats.slots;
+	}
+
+	if (++m_slotsInUse > m_stats.peakSlotsInUse)
+	{
+		m_stats.peakSlotsInUse = m_slotsInUse;
+	}
+
+	return Handle(this, slot);
+}
+
+void spvgentwo::ModulePool::reserve(unsigned int _slots)
+{
+	while (m_stats.slots < _slots)
+	{
+		Slot& slot = m_slots.emplace_back(m_pAllocator, m_arenaChunkSize, m_pLogger, m_pTypeInferenceAndVailation);
+		slot.nextIdle = m_pIdle;
+		m_pIdle = &slot;
+		++m_stats.slots;
+	}
+}
+
+void spvgentwo::ModulePool::shrink()
+{
+	getStats(); // capture peaks before memory is returned
+
+	for (auto it = m_slots.begin(); it != m_slots.end();)
+	{
+		bool idle = false;
+		for (const Slot* s = m_pIdle; s != nullptr && idle == false; s = s->nextIdle)
+		{
+			idle = s == &(*it);
+		}
+
+		if (idle)
+		{
+			it = m_slots.erase(it);
+			--m_stats.slots;
+		}
+		else
+		{
+			++it;
+		}
+	}
+
+	m_pIdle = nullptr;
+}
+
+const spvgentwo::ModulePoolStats& spvgentwo::ModulePool::getStats()
+{
+	sgt_size_t reserved = 0u;
+	for (const Slot& slot : m_slots)
+	{
+		reserved += slot.arena.getReservedBytes();
+		if (slot.arena.getPeakUsedBytes() > m_stats.peakModuleBytes)
+		{
+			m_stats.peakModuleBytes = slot.arena.getPeakUsedBytes();
+		}
+	}
+
+	m_stats.reservedBytes = reserved;
+	if (reserved > m_stats.peakReservedBytes)
+	{
+		m_stats.peakReservedBytes = reserved;
+	}
+
+	return m_stats;
+}
+
+void spvgentwo::ModulePool::release(Slot* _pSlot)
+{
+	// capture peaks before reset() returns the memory to the free lists and large blocks to the backing allocator
+	getStats();
+
+	_pSlot->module.reset();
+
+	_pSlot->nextIdle = m_pIdle;
+	m_pIdle = _pSlot;
+	--m_slotsInUse;
+}
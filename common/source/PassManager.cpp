@@ -0,0 +1,578 @@
+#include "common/PassManager.h"
+#include "common/ControlFlowGraph.h"
+#include "common/DominatorTree.h"
+#include "common/FunctionCallGraph.h"
+
+#include "common/Canonicalization.h"
+#include "common/DeadCodeElimination.h"
+#include "common/FunctionDeduplication.h"
+#include "common/FunctionInlining.h"
+#include "common/VariablePromotion.h"
+#include "common/PeepholeOptimizer.h"
+#include "common/LoopInvariantCodeMotion.h"
+#include "common/LoopUnrolling.h"
+
+#include "spvgentwo/Module.h"
+#include "spvgentwo/ModuleTemplate.inl"
+
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+
+namespace
+{
+	using namespace spvgentwo;
+
+	unsigned int countInstructions(const Module& _module)
+	{
+		unsigned int count = 0u;
+		_module.iterateInstructions([&count](const Instruction&) { ++count; });
+		return count;
+	}
+
+	bool isNamed(const char* _pName, const char* _pPipeline)
+	{
+		while (*_pName == '-')
+		{
+			++_pName;
+		}
+		for (; *_pName != '\0' && *_pName == *_pPipeline; ++_pName, ++_pPipeline) {}
+		return *_pName == *_pPipeline;
+	}
+
+	bool startsWith(const char* _pStr, const char* _pPrefix)
+	{
+		for (; *_pPrefix != '\0'; ++_pStr, ++_pPrefix)
+		{
+			if (*_pStr != *_pPrefix) return false;
+		}
+		return true;
+	}
+
+	constexpr Analyses instructionsOnly{ AnalysisBits::ControlFlow, AnalysisBits::Dominators, AnalysisBits::CallGraph }; // blocks and calls are unchanged
+
+	// none of the built-in function passes is thread safe (see Pass::threadSafe): promote adds types and OpUndefs and removes names
+	// and decorations of promoted variables, peephole and fold add constants, licm rewrites operands of names and decorations in place
+
+	bool promote(Function& _func, FunctionAnalyses& _analyses, IAllocator* _pAllocator, void*)
+	{
+		return VariablePromotion::promote(_func, _analyses, _pAllocator).promotedVariables != 0u;
+	}
+
+	bool peephole(Function& _func, FunctionAnalyses&, IAllocator* _pAllocator, void*)
+	{
+		PeepholeOptimizer::Rules rules(_pAllocator);
+		PeepholeOptimizer::addDefaultRules(rules);
+
+		const PeepholeOptimizer::Result result = PeepholeOptimizer::optimize(_func, rules, _pAllocator);
+		return result.replaced + result.rewritten != 0u;
+	}
+
+	bool fold(Function& _func, FunctionAnalyses&, IAllocator* _pAllocator, void*)
+	{
+		PeepholeOptimizer::Rules rules(_pAllocator);
+		PeepholeOptimizer::addFoldingRules(rules);
+
+		return PeepholeOptimizer::optimize(_func, rules, _pAllocator).replaced != 0u;
+	}
+
+	bool hoist(Function& _func, FunctionAnalyses& _analyses, IAllocator* _pAllocator, void*)
+	{
+		return LoopInvariantCodeMotion::hoist(_func, _analyses, _pAllocator).hoistedInstructions != 0u;
+	}
+
+	bool unroll(Function& _func, FunctionAnalyses& _analyses, IAllocator* _pAllocator, void*)
+	{
+		const LoopUnrolling::Result result = LoopUnrolling::unroll(_func, _analyses, {}, _pAllocator);
+		return result.fullyUnrolled + result.partiallyUnrolled + result.markedLoops != 0u;
+	}
+
+	bool inlineCalls(Module& _module, PassManager&, IAllocator* _pAllocator, void*)
+	{
+		return FunctionInlining::inlineCalls(_module, {}, _pAllocator).inlinedCalls != 0u;
+	}
+
+	bool deduplicate(Module& _module, PassManager&, IAllocator* _pAllocator, void*)
+	{
+		return FunctionDeduplication::deduplicate(_module, _pAllocator).removedFunctions != 0u;
+	}
+
+	bool eliminate(Module& _module, PassManager&, IAllocator* _pAllocator, void*)
+	{
+		const DeadCodeElimination::Result result = DeadCodeElimination::eliminate(_module, _pAllocator);
+		return result.removedFunctions + result.removedInstructions != 0u;
+	}
+
+	bool canonicalize(Module& _module, PassManager&, IAllocator* _pAllocator, void*)
+	{
+		const Canonicalization::Result result = Canonicalization::canonicalize(_module, _pAllocator);
+		return result.movedTypesAndConstants + result.movedDecorations + result.movedNames != 0u;
+	}
+
+	bool strip(Module& _module, PassManager&, IAllocator*, void*)
+	{
+		bool changed = _module.getNames().empty() == false || _module.getLines().empty() == false || _module.getModulesProcessed().empty() == false;
+
+		_module.getNames().clear();
+		_module.getNameLookupMap().clear();
+		_module.getLines().clear();
+		_module.getModulesProcessed().clear();
+
+		// OpStrings might be referenced by debug info extended instructions
+		bool debugInfo = false;
+		for (const auto& [name, instr] : _module.getExtInstrImports())
+		{
+			debugInfo |= startsWith(name.c_str(), "NonSemantic.") || startsWith(name.c_str(), "OpenCL.DebugInfo");
+		}
+
+		if (debugInfo == false)
+		{
+			changed |= _module.getSourceStrings().empty() == false;
+			_module.getSourceStrings().clear();
+		}
+
+		auto stripFunction = [&](Function& _func)
+		{
+			for (BasicBlock& bb : _func)
+			{
+				for (auto it = bb.begin(); it != bb.end();)
+				{
+					if (*it == spv::Op::OpLine || *it == spv::Op::OpNoLine)
+					{
+						it = bb.erase(it);
+						changed = true;
+					}
+					else
+					{
+						++it;
+					}
+				}
+			}
+		};
+
+		for (Function& func : _module.getFunctions())
+		{
+			stripFunction(func);
+		}
+		for (EntryPoint& ep : _module.getEntryPoints())
+		{
+			stripFunction(ep);
+		}
+
+		return changed;
+	}
+}
+
+spvgentwo::FunctionAnalyses::FunctionAnalyses(Function& _func, IAllocator* _pAllocator) :
+	m_func(_func),
+	m_pAllocator(_pAllocator)
+{
+}
+
+spvgentwo::FunctionAnalyses::~FunctionAnalyses()
+{
+	invalidate();
+}
+
+bool spvgentwo::FunctionAnalyses::unshare()
+{
+	if (m_func.isShared() == false)
+	{
+		return true;
+	}
+
+	invalidate();
+	return m_func.unshare();
+}
+
+const spvgentwo::ControlFlowGraph<spvgentwo::EmptyEdge>& spvgentwo::FunctionAnalyses::getControlFlowGraph()
+{
+	if (m_pControlFlowGraph == nullptr)
+	{
+		m_pControlFlowGraph = m_pAllocator->construct<ControlFlowGraph<EmptyEdge>>(m_func, m_pAllocator);
+	}
+	return *m_pControlFlowGraph;
+}
+
+const spvgentwo::DominatorTree& spvgentwo::FunctionAnalyses::getDominatorTree()
+{
+	if (m_pDominatorTree == nullptr)
+	{
+		m_pDominatorTree = m_pAllocator->construct<DominatorTree>(m_func, m_pAllocator);
+	}
+	return *m_pDominatorTree;
+}
+
+const spvgentwo::FunctionCallGraph& spvgentwo::FunctionAnalyses::getCallGraph()
+{
+	if (m_pCallGraph == nullptr)
+	{
+		m_pCallGraph = m_pAllocator->construct<FunctionCallGraph>(m_func, m_pAllocator);
+	}
+	return *m_pCallGraph;
+}
+
+const spvgentwo::List<spvgentwo::Instruction*>* spvgentwo::FunctionAnalyses::getUses(const Instruction* _pInstr)
+{
+	if (m_pUses == nullptr)
+	{
+		m_pUses = m_pAllocator->construct<HashMap<const Instruction*, List<Instruction*>>>(m_pAllocator);
+
+		for (BasicBlock& bb : m_func)
+		{
+			for (Instruction& instr : bb)
+			{
+				for (auto it = instr.getFirstActualOperand(); it != nullptr; ++it)
+				{
+					if (const Instruction* op = it->isInstruction() ? it->getInstruction() : nullptr; op != nullptr)
+					{
+						List<Instruction*>& uses = m_pUses->emplaceUnique(op, m_pAllocator).kv.value;
+						if (uses.empty() || uses.back() != &instr) // same operand used twice
+						{
+							uses.emplace_back(&instr);
+						}
+					}
+				}
+			}
+		}
+	}
+
+	return m_pUses->get(_pInstr);
+}
+
+void spvgentwo::FunctionAnalyses::invalidate(Analyses _preserved)
+{
+	if (_preserved.none(AnalysisBits::ControlFlow) && m_pControlFlowGraph != nullptr)
+	{
+		m_pAllocator->destruct(m_pControlFlowGraph);
+		m_pControlFlowGraph = nullptr;
+	}
+	if (_preserved.none(AnalysisBits::Dominators) && m_pDominatorTree != nullptr)
+	{
+		m_pAllocator->destruct(m_pDominatorTree);
+		m_pDominatorTree = nullptr;
+	}
+	if (_preserved.none(AnalysisBits::CallGraph) && m_pCallGraph != nullptr)
+	{
+		m_pAllocator->destruct(m_pCallGraph);
+		m_pCallGraph = nullptr;
+	}
+	if (_preserved.none(AnalysisBits::DefUse) && m_pUses != nullptr)
+	{
+		m_pAllocator->destruct(m_pUses);
+		m_pUses = nullptr;
+	}
+}
+
+spvgentwo::Analyses spvgentwo::FunctionAnalyses::getValid() const
+{
+	Analyses valid{};
+	if (m_pControlFlowGraph != nullptr) valid |= AnalysisBits::ControlFlow;
+	if (m_pDominatorTree != nullptr) valid |= AnalysisBits::Dominators;
+	if (m_pCallGraph != nullptr) valid |= AnalysisBits::CallGraph;
+	if (m_pUses != nullptr) valid |= AnalysisBits::DefUse;
+	return valid;
+}
+
+// serializes allocations of workers and counts them for PassStatistics
+struct spvgentwo::PassManager::SharedAllocator : public IAllocator
+{
+	SharedAllocator(IAllocator* _pBacking) : pBacking(_pBacking) {}
+
+	void* allocate(sgt_size_t _bytes, unsigned int _alignmentHint) final
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		++allocations;
+		allocatedBytes += _bytes;
+		return pBacking->allocate(_bytes, _alignmentHint);
+	}
+
+	void deallocate(void* _ptr, sgt_size_t _bytes) final
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		pBacking->deallocate(_ptr, _bytes);
+	}
+
+	IAllocator* pBacking = nullptr;
+	std::mutex mutex;
+	unsigned int allocations = 0u;
+	sgt_size_t allocatedBytes = 0u;
+};
+
+spvgentwo::PassManager::PassManager(IAllocator* _pAllocator, unsigned int _threadCount) :
+	m_pShared(_pAllocator->construct<SharedAllocator>(_pAllocator)),
+	m_pAllocator(m_pShared),
+	m_passes(_pAllocator),
+	m_analyses(_pAllocator)
+{
+	m_threadCount = _threadCount != 0u ? _threadCount : std::thread::hardware_concurrency();
+	if (m_threadCount == 0u)
+	{
+		m_threadCount = 1u;
+	}
+}
+
+spvgentwo::PassManager::~PassManager()
+{
+	clear();
+
+	m_pShared->pBacking->destruct(m_pShared);
+}
+
+void spvgentwo::PassManager::add(const Pass& _pass)
+{
+	m_passes.emplace_back(_pass);
+}
+
+void spvgentwo::PassManager::addFunctionPass(const char* _pName, FunctionPass _pass, Analyses _preserved, bool _threadSafe, void* _pUserData)
+{
+	Pass pass;
+	pass.name = _pName;
+	pass.function = _pass;
+	pass.preserved = _preserved;
+	pass.threadSafe = _threadSafe;
+	pass.userData = _pUserData;
+	add(pass);
+}
+
+void spvgentwo::PassManager::addModulePass(const char* _pName, ModulePass _pass, Analyses _preserved, void* _pUserData)
+{
+	Pass pass;
+	pass.name = _pName;
+	pass.module = _pass;
+	pass.preserved = _preserved;
+	pass.userData = _pUserData;
+	add(pass);
+}
+
+spvgentwo::FunctionAnalyses& spvgentwo::PassManager::getAnalyses(Function& _func)
+{
+	if (FunctionAnalyses** analyses = m_analyses.get(static_cast<const Function*>(&_func)); analyses != nullptr)
+	{
+		return **analyses;
+	}
+
+	return *m_analyses.emplaceUnique(&_func, m_pAllocator->construct<FunctionAnalyses>(_func, m_pAllocator)).kv.value;
+}
+
+void spvgentwo::PassManager::invalidate(Analyses _preserved)
+{
+	for (auto& [func, analyses] : m_analyses)
+	{
+		analyses->invalidate(_preserved);
+	}
+}
+
+void spvgentwo::PassManager::clear()
+{
+	for (auto& [func, analyses] : m_analyses)
+	{
+		m_pAllocator->destruct(analyses);
+	}
+	m_analyses.clear();
+}
+
+bool spvgentwo::PassManager::runFunctionPass(Module& _module, const Pass& _pass)
+{
+	Vector<FunctionAnalyses*> functions(m_pAllocator);
+	for (Function& func : _module.getFunctions())
+	{
+		functions.emplace_back(&getAnalyses(func));
+	}
+	for (EntryPoint& ep : _module.getEntryPoints())
+	{
+		functions.emplace_back(&getAnalyses(ep));
+	}
+
+	Vector<unsigned char> changed(m_pAllocator);
+	changed.resize(functions.size());
+
+	auto run = [&](sgt_size_t i)
+	{
+		FunctionAnalyses& analyses = *functions[i];
+		changed[i] = analyses.getFunction().empty() == false && _pass.function(analyses.getFunction(), analyses, m_pAllocator, _pass.userData) ? 1u : 0u;
+	};
+
+	const unsigned int threadCount = _pass.threadSafe ? static_cast<unsigned int>(functions.size() < m_threadCount ? functions.size() : m_threadCount) : 1u;
+
+	if (threadCount > 1u)
+	{
+		std::atomic<sgt_size_t> next{ 0u };
+		auto worker = [&]()
+		{
+			for (sgt_size_t i = next++; i < functions.size(); i = next++)
+			{
+				run(i);
+			}
+		};
+
+		List<std::thread> threads(m_pAllocator);
+		for (unsigned int i = 1u; i < threadCount; ++i)
+		{
+			threads.emplace_back(worker);
+		}
+		worker();
+
+		for (std::thread& t : threads)
+		{
+			t.join();
+		}
+	}
+	else
+	{
+		for (sgt_size_t i = 0u; i < functions.size(); ++i)
+		{
+			run(i);
+		}
+	}
+
+	bool anyChanged = false;
+	for (sgt_size_t i = 0u; i < functions.size(); ++i)
+	{
+		if (changed[i] != 0u)
+		{
+			functions[i]->invalidate(_pass.preserved);
+			functions[i]->getFunction().setDirty(); // passes may change operands in place
+			anyChanged = true;
+		}
+	}
+
+	// call graphs of callers include the changed callees
+	if (anyChanged && _pass.preserved.none(AnalysisBits::CallGraph))
+	{
+		invalidate(static_cast<unsigned int>(AnalysisBits::All) & ~static_cast<unsigned int>(AnalysisBits::CallGraph));
+	}
+
+	return anyChanged;
+}
+
+bool spvgentwo::PassManager::run(Module& _module)
+{
+	bool anyChanged = false;
+
+	for (const Pass& pass : m_passes)
+	{
+		PassStatistics stats;
+		stats.name = pass.name;
+
+		if (m_instrumentation != nullptr)
+		{
+			stats.instructionsBefore = countInstructions(_module);
+		}
+
+		m_pShared->allocations = 0u;
+		m_pShared->allocatedBytes = 0u;
+
+		const auto start = std::chrono::steady_clock::now();
+
+		if (pass.module != nullptr)
+		{
+			stats.changed = pass.module(_module, *this, m_pAllocator, pass.userData);
+			if (stats.changed)
+			{
+				clear();
+
+				for (Function& func : _module.getFunctions())
+				{
+					func.setDirty();
+				}
+				for (EntryPoint& ep : _module.getEntryPoints())
+				{
+					ep.setDirty();
+				}
+			}
+		}
+		else if (pass.function != nullptr)
+		{
+			stats.changed = runFunctionPass(_module, pass);
+		}
+
+		stats.milliseconds = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+		stats.allocations = m_pShared->allocations;
+		stats.allocatedBytes = m_pShared->allocatedBytes;
+
+		anyChanged |= stats.changed;
+
+		if (m_instrumentation != nullptr)
+		{
+			stats.instructionsAfter = countInstructions(_module);
+			m_instrumentation(stats, m_pInstrumentationUserData);
+		}
+	}
+
+	return anyChanged;
+}
+
+bool spvgentwo::Pipelines::add(PassManager& _manager, const char* _pName)
+{
+	if (_pName == nullptr)
+	{
+		return false;
+	}
+
+	if (isNamed(_pName, "O"))
+	{
+		_manager.addModulePass("FunctionInlining", inlineCalls);
+		_manager.addFunctionPass("VariablePromotion", promote, instructionsOnly);
+		_manager.addFunctionPass("ConstantFolding", fold, instructionsOnly);
+		_manager.addFunctionPass("PeepholeOptimizer", peephole, instructionsOnly);
+		_manager.addFunctionPass("LoopInvariantCodeMotion", hoist, instructionsOnly);
+		_manager.addFunctionPass("LoopUnrolling", unroll);
+		_manager.addFunctionPass("PeepholeOptimizer", peephole, instructionsOnly);
+		_manager.addModulePass("FunctionDeduplication", deduplicate);
+		_manager.addModulePass("DeadCodeElimination", eliminate);
+		return true;
+	}
+	else if (isNamed(_pName, "Os"))
+	{
+		_manager.addModulePass("FunctionDeduplication", deduplicate);
+		_manager.addFunctionPass("VariablePromotion", promote, instructionsOnly);
+		_manager.addFunctionPass("ConstantFolding", fold, instructionsOnly);
+		_manager.addFunctionPass("PeepholeOptimizer", peephole, instructionsOnly);
+		_manager.addFunctionPass("LoopInvariantCodeMotion", hoist, instructionsOnly);
+		_manager.addModulePass("DeadCodeElimination", eliminate);
+		return true;
+	}
+
+	struct Named
+	{
+		const char* name;
+		const char* passName;
+		FunctionPass function;
+		ModulePass module;
+		Analyses preserved;
+	};
+
+	const Named passes[] =
+	{
+		{ "inline", "FunctionInlining", nullptr, inlineCalls, {} },
+		{ "promote", "VariablePromotion", promote, nullptr, instructionsOnly },
+		{ "fold", "ConstantFolding", fold, nullptr, instructionsOnly },
+		{ "peephole", "PeepholeOptimizer", peephole, nullptr, instructionsOnly },
+		{ "licm", "LoopInvariantCodeMotion", hoist, nullptr, instructionsOnly },
+		{ "unroll", "LoopUnrolling", unroll, nullptr, {} },
+		{ "dedup", "FunctionDeduplication", nullptr, deduplicate, {} },
+		{ "dce", "DeadCodeElimination", nullptr, eliminate, {} },
+		{ "strip", "StripDebugInfo", nullptr, strip, instructionsOnly }, // OpLine and OpNoLine are removed from blocks
+		{ "canonicalize", "Canonicalization", nullptr, canonicalize, {} },
+	};
+
+	for (const Named& p : passes)
+	{
+		if (isNamed(_pName, p.name))
+		{
+			if (p.module != nullptr)
+			{
+				_manager.addModulePass(p.passName, p.module, p.preserved);
+			}
+			else
+			{
+				_manager.addFunctionPass(p.passName, p.function, p.preserved);
+			}
+			return true;
+		}
+	}
+
+	return false;
+}
@@ -0,0 +1,155 @@
+#include "common/PatchTable.h"
+
+bool spvgentwo::PatchTable::scan(const unsigned int* _pWords, sgt_size_t _wordCount)
+{
+	m_patches.clear();
+
+	if (_pWords == nullptr || _wordCount < 5u || _pWords[0] != spv::MagicNumber)
+	{
+		return false;
+	}
+
+	for (sgt_size_t offset = 5u; offset < _wordCount;)
+	{
+		const unsigned int* pInstr = _pWords + offset;
+		const unsigned int wordCount = pInstr[0] >> spv::WordCountShift;
+		const spv::Op op = static_cast<spv::Op>(pInstr[0] & spv::OpCodeMask);
+
+		if (wordCount == 0u || offset + wordCount > _wordCount)
+		{
+			m_patches.clear();
+			return false;
+		}
+
+		if (op == spv::Op::OpFunction)
+		{
+			break;
+		}
+
+		if (op == spv::Op::OpDecorate && wordCount == 4u) // target, decoration, literal
+		{
+			Patch patch{ pInstr[1], InvalidSpecId, static_cast<unsigned int>(offset + 3u), 1u };
+			bool add = true;
+
+			switch (static_cast<spv::Decoration>(pInstr[2]))
+			{
+			case spv::Decoration::DescriptorSet: patch.slot = Slot::DescriptorSet; break;
+			case spv::Decoration::Binding: patch.slot = Slot::Binding; break;
+			case spv::Decoration::Location: patch.slot = Slot::Location; break;
+			case spv::Decoration::SpecId: patch.slot = Slot::SpecId; break;
+			default: add = false; break;
+			}
+
+			if (add)
+			{
+				m_patches.emplace_back(patch);
+			}
+		}
+		else if ((op == spv::Op::OpSpecConstantTrue || op == spv::Op::OpSpecConstantFalse) && wordCount == 3u) // type, result
+		{
+			m_patches.emplace_back(Patch{ pInstr[2], InvalidSpecId, static_cast<unsigned int>(offset), 1u, Slot::SpecConstantBool });
+		}
+		else if (op == spv::Op::OpSpecConstant && (wordCount == 4u || wordCount == 5u)) // type, result, 32 or 64 bit literal
+		{
+			m_patches.emplace_back(Patch{ pInstr[2], InvalidSpecId, static_cast<unsigned int>(offset + 3u), wordCount - 3u, Slot::SpecConstant });
+		}
+
+		offset += wordCount;
+	}
+
+	// decorations precede constants, resolve spec ids once so setSpecConstant() doesn't have to
+	for (const Patch& decoration : m_patches)
+	{
+		if (decoration.slot != Slot::SpecId)
+		{
+			continue;
+		}
+
+		for (Patch& constant : m_patches)
+		{
+			if ((constant.slot == Slot::SpecConstant || constant.slot == Slot::SpecConstantBool) && constant.target == decoration.target)
+			{
+				constant.specId = _pWords[decoration.offset];
+				break;
+			}
+		}
+	}
+
+	return true;
+}
+
+unsigned int spvgentwo::PatchTable::find(Slot _slot, unsigned int _target) const
+{
+	for (unsigned int i = 0u; i < m_patches.size(); ++i)
+	{
+		if (m_patches[i].slot == _slot && m_patches[i].target == _target)
+		{
+			return i;
+		}
+	}
+	return InvalidIndex;
+}
+
+unsigned int spvgentwo::PatchTable::findSpecConstant(unsigned int _specId) const
+{
+	for (unsigned int i = 0u; i < m_patches.size(); ++i)
+	{
+		if (m_patches[i].specId == _specId && _specId != InvalidSpecId)
+		{
+			return i;
+		}
+	}
+	return InvalidIndex;
+}
+
+void spvgentwo::PatchTable::apply(unsigned int* _pWords, const Patch& _patch, unsigned int _value)
+{
+	if (_patch.slot == Slot::SpecConstantBool)
+	{
+		const spv::Op op = _value != 0u ? spv::Op::OpSpecConstantTrue : spv::Op::OpSpecConstantFalse;
+		_pWords[_patch.offset] = (3u << spv::WordCountShift) | static_cast<unsigned int>(op);
+	}
+	else
+	{
+		_pWords[_patch.offset] = _value;
+	}
+}
+
+void spvgentwo::PatchTable::apply64(unsigned int* _pWords, const Patch& _patch, sgt_uint64_t _value)
+{
+	apply(_pWords, _patch, static_cast<unsigned int>(_value));
+
+	if (_patch.wordCount == 2u)
+	{
+		_pWords[_patch.offset + 1u] = static_cast<unsigned int>(_value >> 32u);
+	}
+}
+
+unsigned int spvgentwo::PatchTable::get(const unsigned int* _pWords, const Patch& _patch)
+{
+	if (_patch.slot == Slot::SpecConstantBool)
+	{
+		return static_cast<spv::Op>(_pWords[_patch.offset] & spv::OpCodeMask) == spv::Op::OpSpecConstantTrue ? 1u : 0u;
+	}
+	return _pWords[_patch.offset];
+}
+
+bool spvgentwo::PatchTable::set(unsigned int* _pWords, Slot _slot, unsigned int _target, unsigned int _value) const
+{
+	if (const unsigned int index = find(_slot, _target); index != InvalidIndex)
+	{
+		apply(_pWords, m_patches[index], _value);
+		return true;
+	}
+	return false;
+}
+
+bool spvgentwo::PatchTable::setSpecConstant(unsigned int* _pWords, unsigned int _specId, unsigned int _value) const
+{
+	if (const unsigned int index = findSpecConstant(_specId); index != InvalidIndex)
+	{
+		apply(_pWords, m_patches[index], _value);
+		return true;
+	}
+	return false;
+}
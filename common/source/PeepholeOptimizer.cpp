@@ -0,0 +1,663 @@
+#include "common/PeepholeOptimizer.h"
+
+#include "spvgentwo/Module.h"
+#include "spvgentwo/ConstantFolder.h"
+#include "spvgentwo/InstructionTemplate.inl"
+#include "spvgentwo/BasicBlockTemplate.inl"
+
+namespace
+{
+	using namespace spvgentwo;
+	using PeepholeOptimizer::Context;
+
+	const Instruction* getTarget(const Instruction& _instr)
+	{
+		return _instr.empty() ? nullptr : _instr.front().getInstruction();
+	}
+
+	bool sameType(const Instruction* _pLeft, const Instruction& _instr)
+	{
+		return _pLeft != nullptr && _pLeft->getResultTypeInstr() != nullptr && _pLeft->getResultTypeInstr() == _instr.getResultTypeInstr();
+	}
+
+	bool sameData(const Constant& _left, const Constant& _right)
+	{
+		const Vector<unsigned int>& left = _left.getData();
+		const Vector<unsigned int>& right = _right.getData();
+
+		if (left.size() != right.size())
+		{
+			return false;
+		}
+
+		for (sgt_size_t i = 0u; i < left.size(); ++i)
+		{
+			if (left[i] != right[i])
+			{
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// scalar constant or the scalar all components of a vector constant are equal to
+	const Constant* getSplat(const Constant* _pConstant)
+	{
+		if (_pConstant == nullptr || _pConstant->getType().isVector() == false)
+		{
+			return _pConstant;
+		}
+
+		const List<Constant>& components = _pConstant->getComponents();
+		if (components.empty())
+		{
+			return nullptr;
+		}
+
+		for (const Constant& c : components)
+		{
+			if (c.getOperation() != components.front().getOperation() || sameData(c, components.front()) == false)
+			{
+				return nullptr;
+			}
+		}
+
+		return &components.front();
+	}
+
+	// 32 and 64 bit integer value of a scalar or splat constant, OpConstantNull is 0
+	bool getInt(const Context& _context, const Instruction* _pInstr, sgt_uint64_t& _outValue)
+	{
+		const Constant* c = getSplat(_context.getConstant(_pInstr));
+		if (c == nullptr || c->getType().isInt() == false)
+		{
+			return false;
+		}
+
+		const Vector<unsigned int>& data = c->getData();
+		if (c->getOperation() == spv::Op::OpConstantNull)
+		{
+			_outValue = 0u;
+			return true;
+		}
+		else if (data.empty() || c->getType().getIntWidth() > 64u)
+		{
+			return false;
+		}
+
+		_outValue = data[0];
+		if (c->getType().getIntWidth() == 64u && data.size() > 1u)
+		{
+			_outValue |= static_cast<sgt_uint64_t>(data[1]) << 32u;
+		}
+
+		return true;
+	}
+
+	// compare the bit patterns of a 32 or 64 bit float constant with _value, 0.0 and -0.0 are distinct
+	bool isFloat(const Context& _context, const Instruction* _pInstr, float _value)
+	{
+		const Constant* c = getSplat(_context.getConstant(_pInstr));
+		if (c == nullptr || c->getOperation() != spv::Op::OpConstant || (c->getType().isFloat(32u) == false && c->getType().isFloat(64u) == false))
+		{
+			return false;
+		}
+
+		Constant expected(_context.getModule().getAllocator());
+		if (c->getType().isFloat(64u))
+		{
+			expected.make(static_cast<double>(_value));
+		}
+		else
+		{
+			expected.make(_value);
+		}
+
+		return sameData(*c, expected);
+	}
+
+	// returns n for 2^n, ~0u otherwise
+	unsigned int getLog2(sgt_uint64_t _value)
+	{
+		if (_value == 0u || (_value & (_value - 1u)) != 0u)
+		{
+			return ~0u;
+		}
+
+		unsigned int n = 0u;
+		while (_value > 1u)
+		{
+			_value >>= 1u;
+			++n;
+		}
+		return n;
+	}
+
+	bool isScalarInt(const Instruction* _pInstr)
+	{
+		const Type* type = _pInstr != nullptr ? _pInstr->getType() : nullptr;
+		return type != nullptr && type->isInt() && type->getIntWidth() <= 64u;
+	}
+
+	// replace the second operand by _pOperand
+	void setSecondOperand(Instruction& _instr, Instruction* _pOperand)
+	{
+		*_instr.getFirstActualOperand().next() = _pOperand;
+	}
+
+	// x op c -> x if c == _identity, or c op x -> x if _commutative
+	Instruction* foldIntIdentity(Context& _context, Instruction& _instr, sgt_uint64_t _identity, bool _commutative)
+	{
+		Instruction* left = Context::getOperand(_instr, 0u);
+		Instruction* right = Context::getOperand(_instr, 1u);
+		sgt_uint64_t value = 0u;
+
+		if (getInt(_context, right, value) && value == _identity && sameType(left, _instr))
+		{
+			return left;
+		}
+		else if (_commutative && getInt(_context, left, value) && value == _identity && sameType(right, _instr))
+		{
+			return right;
+		}
+		return nullptr;
+	}
+
+	Instruction* foldFloatIdentity(Context& _context, Instruction& _instr, float _identity, bool _commutative)
+	{
+		Instruction* left = Context::getOperand(_instr, 0u);
+		Instruction* right = Context::getOperand(_instr, 1u);
+
+		if (isFloat(_context, right, _identity) && sameType(left, _instr))
+		{
+			return left;
+		}
+		else if (_commutative && isFloat(_context, left, _identity) && sameType(right, _instr))
+		{
+			return right;
+		}
+		return nullptr;
+	}
+
+	// OpIAdd: x + 0, 0 + x -> x
+	Instruction* addZero(Context& _context, Instruction& _instr) { return foldIntIdentity(_context, _instr, 0u, true); }
+
+	// OpISub: x - 0 -> x
+	Instruction* subZero(Context& _context, Instruction& _instr) { return foldIntIdentity(_context, _instr, 0u, false); }
+
+	// OpIMul: x * 1, 1 * x -> x
+	Instruction* mulOne(Context& _context, Instruction& _instr) { return foldIntIdentity(_context, _instr, 1u, true); }
+
+	// OpSDiv, OpUDiv: x / 1 -> x
+	Instruction* divOne(Context& _context, Instruction& _instr) { return foldIntIdentity(_context, _instr, 1u, false); }
+
+	// OpFMul: x * 1.0, 1.0 * x -> x
+	Instruction* fmulOne(Context& _context, Instruction& _instr) { return foldFloatIdentity(_context, _instr, 1.f, true); }
+
+	// OpFDiv: x / 1.0 -> x
+	Instruction* fdivOne(Context& _context, Instruction& _instr) { return foldFloatIdentity(_context, _instr, 1.f, false); }
+
+	// OpFSub: x - 0.0 -> x
+	Instruction* fsubZero(Context& _context, Instruction& _instr) { return foldFloatIdentity(_context, _instr, 0.f, false); }
+
+	// OpFAdd: x + -0.0, -0.0 + x -> x
+	Instruction* faddNegZero(Context& _context, Instruction& _instr) { return foldFloatIdentity(_context, _instr, -0.f, true); }
+
+	// OpIMul: x * 2^n, 2^n * x -> OpShiftLeftLogical(x, n)
+	Instruction* mulPow2(Context& _context, Instruction& _instr)
+	{
+		Instruction* left = Context::getOperand(_instr, 0u);
+		Instruction* right = Context::getOperand(_instr, 1u);
+		sgt_uint64_t value = 0u;
+
+		if (getInt(_context, left, value) && getInt(_context, right, value) == false)
+		{
+			Instruction* tmp = left;
+			left = right;
+			right = tmp;
+		}
+
+		// shift amount is a scalar, vectors would need a vector of shifts
+		if (isScalarInt(left) == false || getInt(_context, right, value) == false || value < 2u)
+		{
+			return nullptr;
+		}
+
+		const unsigned int n = getLog2(value);
+		if (n == ~0u)
+		{
+			return nullptr;
+		}
+
+		*_instr.getFirstActualOperand() = left;
+		setSecondOperand(_instr, _context.getModule().constant(n));
+		_instr.setOperation(spv::Op::OpShiftLeftLogical);
+		return &_instr;
+	}
+
+	// OpUDiv: x / 2^n -> OpShiftRightLogical(x, n)
+	Instruction* udivPow2(Context& _context, Instruction& _instr)
+	{
+		Instruction* left = Context::getOperand(_instr, 0u);
+		sgt_uint64_t value = 0u;
+
+		if (isScalarInt(left) == false || getInt(_context, Context::getOperand(_instr, 1u), value) == false || value < 2u)
+		{
+			return nullptr;
+		}
+
+		const unsigned int n = getLog2(value);
+		if (n == ~0u)
+		{
+			return nullptr;
+		}
+
+		setSecondOperand(_instr, _context.getModule().constant(n));
+		_instr.setOperation(spv::Op::OpShiftRightLogical);
+		return &_instr;
+	}
+
+	// OpUMod: x % 2^n -> OpBitwiseAnd(x, 2^n - 1)
+	Instruction* umodPow2(Context& _context, Instruction& _instr)
+	{
+		Instruction* right = Context::getOperand(_instr, 1u);
+		const Constant* c = _context.getConstant(right);
+		sgt_uint64_t value = 0u;
+
+		if (isScalarInt(right) == false || sameType(right, _instr) == false || c == nullptr || c->getOperation() != spv::Op::OpConstant ||
+			getInt(_context, right, value) == false || getLog2(value) == ~0u)
+		{
+			return nullptr;
+		}
+
+		Constant mask(*c, _context.getModule().getAllocator());
+		mask.getData()[0] = static_cast<unsigned int>(value - 1u);
+		if (mask.getData().size() > 1u)
+		{
+			mask.getData()[1] = static_cast<unsigned int>((value - 1u) >> 32u);
+		}
+
+		setSecondOperand(_instr, _context.getModule().addConstant(mask));
+		_instr.setOperation(spv::Op::OpBitwiseAnd);
+		return &_instr;
+	}
+
+	// OpSNegate, OpFNegate, OpNot, OpLogicalNot: op(op(x)) -> x
+	Instruction* doubleNegation(Context&, Instruction& _instr)
+	{
+		const Instruction* inner = Context::getOperand(_instr, 0u);
+		if (inner != nullptr && *inner == _instr.getOperation())
+		{
+			Instruction* x = Context::getOperand(*inner, 0u);
+			return sameType(x, _instr) ? x : nullptr;
+		}
+		return nullptr;
+	}
+
+	// OpSelect: select(true, a, b) -> a, select(false, a, b) -> b, select(c, a, a) -> a
+	Instruction* selectConstant(Context& _context, Instruction& _instr)
+	{
+		const Constant* condition = _context.getConstant(Context::getOperand(_instr, 0u));
+		Instruction* a = Context::getOperand(_instr, 1u);
+		Instruction* b = Context::getOperand(_instr, 2u);
+
+		if (a != nullptr && a == b)
+		{
+			return a;
+		}
+		else if (condition == nullptr || condition->getType().isBool() == false)
+		{
+			return nullptr;
+		}
+
+		return condition->getOperation() == spv::Op::OpConstantTrue ? a : b;
+	}
+
+	// OpBitcast: bitcast(x) -> x if the type is the same, bitcast(bitcast(x)) -> bitcast(x)
+	Instruction* bitcastChain(Context&, Instruction& _instr)
+	{
+		Instruction* x = Context::getOperand(_instr, 0u);
+		if (sameType(x, _instr))
+		{
+			return x;
+		}
+		else if (x != nullptr && *x == spv::Op::OpBitcast)
+		{
+			*_instr.getFirstActualOperand() = Context::getOperand(*x, 0u);
+			return &_instr;
+		}
+		return nullptr;
+	}
+
+	// OpCompositeExtract(OpCompositeConstruct(a, b, ...), i, ...) -> constituent i or OpCompositeExtract(constituent, ...)
+	Instruction* extractConstruct(Context&, Instruction& _instr)
+	{
+		// result type, id, composite, indices
+		auto composite = _instr.getFirstActualOperand();
+		const Instruction* construct = composite != nullptr ? composite->getInstruction() : nullptr;
+
+		if (construct == nullptr || *construct != spv::Op::OpCompositeConstruct || composite.next() == nullptr || composite.next()->isLiteral() == false)
+		{
+			return nullptr;
+		}
+
+		const Type* type = construct->getType();
+		if (type == nullptr)
+		{
+			return nullptr;
+		}
+
+		const unsigned int index = composite.next()->getLiteral().value;
+		unsigned int offset = 0u;
+
+		for (auto it = construct->getFirstActualOperand(); it != nullptr; ++it)
+		{
+			Instruction* constituent = it->getInstruction();
+			const Type* constituentType = constituent != nullptr ? constituent->getType() : nullptr;
+			if (constituentType == nullptr)
+			{
+				return nullptr;
+			}
+
+			// vectors can be constructed from smaller vectors
+			const unsigned int count = type->isVector() && constituentType->isVector() ? constituentType->getVectorComponentCount() : 1u;
+
+			if (index >= offset + count)
+			{
+				offset += count;
+				continue;
+			}
+
+			if (count == 1u && composite.next().next() == nullptr)
+			{
+				return sameType(constituent, _instr) ? constituent : nullptr;
+			}
+
+			// extract the remaining indices from the constituent
+			*composite = constituent;
+			if (count > 1u)
+			{
+				*composite.next() = literal_t{ index - offset };
+			}
+			else
+			{
+				_instr.erase(composite.next());
+			}
+			return &_instr;
+		}
+
+		return nullptr;
+	}
+
+	// any pure op: evaluate constant operands
+	Instruction* foldConstant(Context& _context, Instruction& _instr)
+	{
+		static const IConstantFolder defaultFolder{};
+		const IConstantFolder* folder = _context.getModule().getConstantFolder();
+
+		Instruction* result = (folder != nullptr ? folder : &defaultFolder)->fold(_instr);
+		return result != &_instr ? result : nullptr;
+	}
+}
+
+void spvgentwo::PeepholeOptimizer::Rules::add(spv::Op _op, Rule _rule)
+{
+	m_rules.emplaceUnique(_op, m_pAllocator).kv.value.emplace_back(_rule);
+}
+
+void spvgentwo::PeepholeOptimizer::addDefaultRules(Rules& _rules)
+{
+	_rules.add(spv::Op::OpIAdd, addZero);
+	_rules.add(spv::Op::OpISub, subZero);
+	_rules.add(spv::Op::OpIMul, mulOne);
+	_rules.add(spv::Op::OpIMul, mulPow2);
+	_rules.add(spv::Op::OpSDiv, divOne);
+	_rules.add(spv::Op::OpUDiv, divOne);
+	_rules.add(spv::Op::OpUDiv, udivPow2);
+	_rules.add(spv::Op::OpUMod, umodPow2);
+
+	_rules.add(spv::Op::OpFMul, fmulOne);
+	_rules.add(spv::Op::OpFDiv, fdivOne);
+	_rules.add(spv::Op::OpFSub, fsubZero);
+	_rules.add(spv::Op::OpFAdd, faddNegZero);
+
+	_rules.add(spv::Op::OpSNegate, doubleNegation);
+	_rules.add(spv::Op::OpFNegate, doubleNegation);
+	_rules.add(spv::Op::OpNot, doubleNegation);
+	_rules.add(spv::Op::OpLogicalNot, doubleNegation);
+
+	_rules.add(spv::Op::OpSelect, selectConstant);
+	_rules.add(spv::Op::OpBitcast, bitcastChain);
+	_rules.add(spv::Op::OpCompositeExtract, extractConstruct);
+}
+
+void spvgentwo::PeepholeOptimizer::addFoldingRules(Rules& _rules)
+{
+	// all pure ops are core opcodes up to OpBitCount
+	for (unsigned int op = 0u; op <= static_cast<unsigned int>(spv::Op::OpBitCount); ++op)
+	{
+		if (isPureOp(static_cast<spv::Op>(op)))
+		{
+			_rules.add(static_cast<spv::Op>(op), foldConstant);
+		}
+	}
+}
+
+spvgentwo::PeepholeOptimizer::Context::Context(Function& _func, IAllocator* _pAllocator) :
+	m_func(_func),
+	m_module(*_func.getModule()),
+	m_pAllocator(_pAllocator),
+	m_uses(_pAllocator),
+	m_worklist(_pAllocator),
+	m_queued(_pAllocator),
+	m_dead(_pAllocator),
+	m_inserted(_pAllocator)
+{
+}
+
+spvgentwo::Instruction* spvgentwo::PeepholeOptimizer::Context::insertBefore(Instruction& _instr)
+{
+	BasicBlock* bb = _instr.getBasicBlock();
+	auto pos = bb->find_if([&_instr](const Instruction& _other) { return &_other == &_instr; });
+
+	Instruction* instr = &bb->insert_before(pos, bb, spv::Op::OpNop)->inner();
+	m_inserted.emplace_back(instr);
+	return instr;
+}
+
+spvgentwo::Instruction* spvgentwo::PeepholeOptimizer::Context::getOperand(const Instruction& _instr, unsigned int _index)
+{
+	auto it = _instr.getFirstActualOperand();
+	for (unsigned int i = 0u; i < _index && it != nullptr; ++i)
+	{
+		++it;
+	}
+	return it != nullptr ? it->getInstruction() : nullptr;
+}
+
+const spvgentwo::Constant* spvgentwo::PeepholeOptimizer::Context::getConstant(const Instruction* _pInstr) const
+{
+	const Constant* c = m_module.getConstantInfo(_pInstr);
+	return c != nullptr && IsConstantOp(c->getOperation()) ? c : nullptr;
+}
+
+void spvgentwo::PeepholeOptimizer::Context::addUses(Instruction* _pInstr)
+{
+	for (auto it = _pInstr->getFirstActualOperand(); it != nullptr; ++it)
+	{
+		if (const Instruction* op = it->getInstruction(); op != nullptr && op->getBasicBlock() != nullptr)
+		{
+			List<Instruction*>& uses = m_uses.emplaceUnique(op, m_pAllocator).kv.value;
+			if (uses.contains(_pInstr) == false)
+			{
+				uses.emplace_back(_pInstr);
+			}
+		}
+	}
+}
+
+void spvgentwo::PeepholeOptimizer::Context::enqueue(Instruction* _pInstr)
+{
+	if (m_queued.get(static_cast<const Instruction*>(_pInstr)) == nullptr && m_dead.get(static_cast<const Instruction*>(_pInstr)) == nullptr)
+	{
+		m_queued.emplaceUnique(_pInstr, true);
+		m_worklist.emplace_back(_pInstr);
+	}
+}
+
+void spvgentwo::PeepholeOptimizer::Context::replace(Instruction* _pInstr, Instruction* _pReplacement)
+{
+	m_dead.emplaceUnique(_pInstr, true);
+
+	const List<Instruction*>* uses = m_uses.get(static_cast<const Instruction*>(_pInstr));
+	if (uses == nullptr)
+	{
+		return;
+	}
+
+	for (Instruction* use : *uses)
+	{
+		for (Operand& op : *use)
+		{
+			if (op == _pInstr)
+			{
+				op = _pReplacement;
+			}
+		}
+		addUses(use);
+		enqueue(use);
+	}
+}
+
+void spvgentwo::PeepholeOptimizer::Context::removeDead()
+{
+	auto sweep = [this](List<Instruction>& _container)
+	{
+		for (auto it = _container.begin(); it != _container.end();)
+		{
+			if (m_dead.get(getTarget(*it)) != nullptr)
+			{
+				it = _container.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+	};
+
+	sweep(m_module.getNames());
+	sweep(m_module.getDecorations());
+
+	if (m_dead.elements() == 0u)
+	{
+		return;
+	}
+
+	for (BasicBlock& bb : m_func)
+	{
+		bb.removeIf([this](const Instruction& _instr) { return m_dead.get(&_instr) != nullptr; });
+	}
+}
+
+spvgentwo::PeepholeOptimizer::Result spvgentwo::PeepholeOptimizer::Context::run(const Rules& _rules)
+{
+	Result result;
+
+	unsigned int count = 0u;
+	for (BasicBlock& bb : m_func)
+	{
+		for (Instruction& instr : bb)
+		{
+			addUses(&instr);
+			enqueue(&instr);
+			++count;
+		}
+	}
+
+	// guards against rules undoing each others rewrites
+	for (unsigned int budget = 16u * count + 64u; m_worklist.empty() == false && budget > 0u; --budget)
+	{
+		Instruction* instr = m_worklist.pop_front();
+		m_queued.erase(m_queued.find(instr));
+
+		const List<Rule>* rules = m_dead.get(static_cast<const Instruction*>(instr)) == nullptr ? _rules.get(instr->getOperation()) : nullptr;
+		if (rules == nullptr)
+		{
+			continue;
+		}
+
+		for (Rule rule : *rules)
+		{
+			Instruction* replacement = rule(*this, *instr);
+
+			for (Instruction* inserted : m_inserted)
+			{
+				addUses(inserted);
+				enqueue(inserted);
+			}
+			m_inserted.clear();
+
+			if (replacement == instr)
+			{
+				addUses(instr);
+				enqueue(instr);
+				if (const List<Instruction*>* uses = m_uses.get(static_cast<const Instruction*>(instr)); uses != nullptr)
+				{
+					for (Instruction* use : *uses)
+					{
+						enqueue(use);
+					}
+				}
+				++result.rewritten;
+				break;
+			}
+			else if (replacement != nullptr)
+			{
+				replace(instr, replacement);
+				++result.replaced;
+				break;
+			}
+		}
+	}
+
+	removeDead();
+
+	return result;
+}
+
+spvgentwo::PeepholeOptimizer::Result spvgentwo::PeepholeOptimizer::optimize(Function& _func, const Rules& _rules, IAllocator* _pAllocator)
+{
+	if (_func.empty())
+	{
+		return {};
+	}
+
+	_func.unshare();
+
+	Context context(_func, _pAllocator != nullptr ? _pAllocator : _func.getAllocator());
+	return context.run(_rules);
+}
+
+spvgentwo::PeepholeOptimizer::Result spvgentwo::PeepholeOptimizer::optimize(Module& _module, const Rules& _rules, IAllocator* _pAllocator)
+{
+	Result result;
+
+	auto add = [&](Function& _func)
+	{
+		const Result r = optimize(_func, _rules, _pAllocator);
+		result.replaced += r.replaced;
+		result.rewritten += r.rewritten;
+	};
+
+	for (Function& func : _module.getFunctions())
+	{
+		add(func);
+	}
+	for (EntryPoint& ep : _module.getEntryPoints())
+	{
+		add(ep);
+	}
+
+	return result;
+}
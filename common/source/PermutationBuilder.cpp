@@ -0,0 +1,335 @@
+#include "common/PermutationBuilder.h"
+#include "common/ModulePool.h"
+#include "common/HeapAllocator.h"
+#include "common/BinaryVectorWriter.h"
+
+#include "spvgentwo/Module.h"
+#include "spvgentwo/ModuleTemplate.inl"
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+namespace
+{
+	bool equalName(const char* _pLeft, const char* _pRight)
+	{
+		if (_pLeft == nullptr || _pRight == nullptr)
+		{
+			return _pLeft == _pRight;
+		}
+
+		for (; *_pLeft != 0 && *_pLeft == *_pRight; ++_pLeft, ++_pRight) {}
+
+		return *_pLeft == *_pRight;
+	}
+
+	// overwrite default values of named spec constants
+	bool patchSpecConstants(spvgentwo::Module& _module, const spvgentwo::PermutationKey& _key)
+	{
+		using namespace spvgentwo;
+
+		for (const PermutationValue& val : _key.getValues())
+		{
+			if (val.kind != PermutationValue::Kind::SpecConstant)
+			{
+				continue;
+			}
+
+			Instruction* instr = _module.getInstructionByName(val.name);
+			if (instr == nullptr)
+			{
+				_module.logError("Spec constant %s not found", val.name);
+				return false;
+			}
+
+			switch (instr->getOperation())
+			{
+			case spv::Op::OpSpecConstantTrue:
+			case spv::Op::OpSpecConstantFalse:
+				instr->setOperation(val.value != 0u ? spv::Op::OpSpecConstantTrue : spv::Op::OpSpecConstantFalse);
+				break;
+			case spv::Op::OpSpecConstant:
+				if (instr->size() != 3u) // result type, result id, one literal word
+				{
+					_module.logError("Spec constant %s is not a 32 bit scalar", val.name);
+					return false;
+				}
+				instr->back() = literal_t{ val.value };
+				break;
+			default:
+				_module.logError("%s is not a spec constant", val.name);
+				return false;
+			}
+		}
+
+		return true;
+	}
+}
+
+spvgentwo::PermutationKey& spvgentwo::PermutationKey::add(const char* _pName, unsigned int _value, PermutationValue::Kind _kind)
+{
+	for (PermutationValue& val : m_values)
+	{
+		if (val.kind == _kind && equalName(val.name, _pName))
+		{
+			val.value = _value;
+			return *this;
+		}
+	}
+
+	m_values.emplace_back(PermutationValue{ _pName, _value, _kind });
+	return *this;
+}
+
+const spvgentwo::PermutationValue* spvgentwo::PermutationKey::find(const char* _pName, PermutationValue::Kind _kind) const
+{
+	for (const PermutationValue& val : m_values)
+	{
+		if (val.kind == _kind && equalName(val.name, _pName))
+		{
+			return &val;
+		}
+	}
+	return nullptr;
+}
+
+bool spvgentwo::PermutationKey::getBool(const char* _pName, bool _default) const
+{
+	const PermutationValue* val = find(_pName);
+	return val != nullptr ? val->value != 0u : _default;
+}
+
+int spvgentwo::PermutationKey::getInt(const char* _pName, int _default) const
+{
+	const PermutationValue* val = find(_pName);
+	return val != nullptr ? static_cast<int>(val->value) : _default;
+}
+
+unsigned int spvgentwo::PermutationKey::getUInt(const char* _pName, unsigned int _default) const
+{
+	const PermutationValue* val = find(_pName);
+	return val != nullptr ? val->value : _default;
+}
+
+struct spvgentwo::PermutationBuilder::Pool
+{
+	struct Worker
+	{
+		Worker(ILogger* _pLogger, ITypeInferenceAndVailation* _pTypeInferenceAndVailation) :
+			arena(&backing),
+			module(&arena, _pLogger, _pTypeInferenceAndVailation),
+			binary(&arena)
+		{
+		}
+
+		HeapAllocator backing; // HeapAllocator statistics are not thread safe, one per worker
+		ModuleArena arena;
+		Module module;
+		Vector<unsigned int> binary;
+		std::thread thread;
+	};
+
+	Pool(PermutationBuilder* _pBuilder, ILogger* _pLogger, ITypeInferenceAndVailation* _pTypeInferenceAndVailation, unsigned int _threadCount) :
+		pBuilder(_pBuilder),
+		workers(_pBuilder->m_pAllocator)
+	{
+		for (unsigned int i = 0u; i < _threadCount; ++i)
+		{
+			workers.emplace_back(_pLogger, _pTypeInferenceAndVailation);
+		}
+
+		// start threads after all workers were constructed, List entries don't move
+		for (Worker& w : workers)
+		{
+			w.thread = std::thread(&Pool::run, this, &w);
+		}
+	}
+
+	~Pool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stop = true;
+		}
+		wake.notify_all();
+
+		for (Worker& w : workers)
+		{
+			w.thread.join();
+		}
+	}
+
+	void run(Worker* _pWorker)
+	{
+		unsigned int seenJob = 0u;
+
+		for (;;)
+		{
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wake.wait(lock, [&] { return stop || job != seenJob; });
+				if (stop) return;
+				seenJob = job;
+			}
+
+			for (unsigned int i = next.fetch_add(1u); i < count; i = next.fetch_add(1u))
+			{
+				PermutationResult& result = pBuilder->m_results[resultOffset + i];
+				if (generate(*_pWorker, pKeys[i], result) == false)
+				{
+					failed.store(true);
+				}
+			}
+
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				if (--active == 0u)
+				{
+					done.notify_one();
+				}
+			}
+		}
+	}
+
+	bool generate(Worker& _worker, const PermutationKey& _key, PermutationResult& _result)
+	{
+		Module& module = _worker.module;
+		module.reset();
+		_worker.binary.clear();
+
+		if (generator(module, _key, pUserData) == false || patchSpecConstants(module, _key) == false)
+		{
+			return false;
+		}
+
+		BinaryVectorWriter<Vector<unsigned int>> writer(_worker.binary);
+		if (module.finalizeAndWrite(writer, pBuilder->m_pGrammar) == false)
+		{
+			return false;
+		}
+
+		FNV1aHasher hasher;
+		_result.hash = hasher.add(_worker.binary.data(), _worker.binary.size() * sizeof(unsigned int));
+
+		std::lock_guard<std::mutex> lock(mutex);
+		_result.pBinary = pBuilder->insert(_result.hash, _worker.binary);
+
+		return _result.pBinary != nullptr;
+	}
+
+	PermutationBuilder* pBuilder = nullptr;
+	List<Worker> workers;
+
+	std::mutex mutex; // guards job state and PermutationBuilder::insert
+	std::condition_variable wake;
+	std::condition_variable done;
+	unsigned int job = 0u;
+	unsigned int active = 0u;
+	bool stop = false;
+
+	// current job
+	const PermutationKey* pKeys = nullptr;
+	unsigned int count = 0u;
+	sgt_size_t resultOffset = 0u;
+	Generator generator = nullptr;
+	void* pUserData = nullptr;
+	std::atomic<unsigned int> next{ 0u };
+	std::atomic<bool> failed{ false };
+};
+
+spvgentwo::PermutationBuilder::PermutationBuilder(IAllocator* _pAllocator, const Grammar* _pGrammar, ILogger* _pLogger, ITypeInferenceAndVailation* _pTypeInferenceAndVailation, unsigned int _threadCount) :
+	m_pAllocator(_pAllocator),
+	m_pGrammar(_pGrammar),
+	m_results(_pAllocator),
+	m_binaries(_pAllocator)
+{
+	m_threadCount = _threadCount != 0u ? _threadCount : std::thread::hardware_concurrency();
+	if (m_threadCount == 0u)
+	{
+		m_threadCount = 1u;
+	}
+
+	m_pPool = m_pAllocator->construct<Pool>(this, _pLogger, _pTypeInferenceAndVailation, m_threadCount);
+}
+
+spvgentwo::PermutationBuilder::~PermutationBuilder()
+{
+	if (m_pPool != nullptr)
+	{
+		m_pAllocator->destruct(m_pPool);
+	}
+}
+
+bool spvgentwo::PermutationBuilder::build(const PermutationKey* _pKeys, unsigned int _count, Generator _generator, void* _pUserData)
+{
+	if (_pKeys == nullptr || _count == 0u || _generator == nullptr)
+	{
+		return _count == 0u;
+	}
+
+	if (m_pPool == nullptr)
+	{
+		return false;
+	}
+
+	// results must not be reallocated while workers write them
+	const sgt_size_t offset = m_results.size();
+	if (m_results.reserve(offset + _count) == false)
+	{
+		return false;
+	}
+
+	for (unsigned int i = 0u; i < _count; ++i)
+	{
+		m_results.emplace_back();
+	}
+
+	Pool& pool = *m_pPool;
+
+	std::unique_lock<std::mutex> lock(pool.mutex);
+
+	pool.pKeys = _pKeys;
+	pool.count = _count;
+	pool.resultOffset = offset;
+	pool.generator = _generator;
+	pool.pUserData = _pUserData;
+	pool.next.store(0u);
+	pool.failed.store(false);
+	pool.active = m_threadCount;
+	++pool.job;
+
+	pool.wake.notify_all();
+	pool.done.wait(lock, [&pool] { return pool.active == 0u; });
+
+	return pool.failed.load() == false;
+}
+
+void spvgentwo::PermutationBuilder::clear()
+{
+	m_results.clear();
+	m_binaries.clear();
+}
+
+const spvgentwo::Vector<unsigned int>* spvgentwo::PermutationBuilder::insert(Hash64 _hash, const Vector<unsigned int>& _binary)
+{
+	for (auto& node : m_binaries.getRange(_hash))
+	{
+		const Vector<unsigned int>& existing = node.kv.value;
+
+		bool equal = existing.size() == _binary.size();
+		for (sgt_size_t i = 0u; i < existing.size() && equal; ++i)
+		{
+			equal = existing[i] == _binary[i];
+		}
+
+		if (equal)
+		{
+			return &existing;
+		}
+	}
+
+	auto& node = m_binaries.emplaceWithHash(_hash, _hash, m_pAllocator, _binary.data(), _binary.size());
+	return node.kv.value.size() == _binary.size() ? &node.kv.value : nullptr;
+}
@@ -0,0 +1,591 @@
+#include "common/SpecConstantFreezing.h"
+#include "common/ReflectionHelper.h"
+
+#include "spvgentwo/Module.h"
+#include "spvgentwo/ConstantFolder.h"
+#include "spvgentwo/ModuleTemplate.inl"
+
+namespace
+{
+	using namespace spvgentwo;
+
+	// replaced spec constant -> constant
+	using Replacements = HashMap<const Instruction*, Instruction*>;
+
+	Instruction* getReplacement(const Replacements& _replacements, Instruction* _pInstr)
+	{
+		Instruction* const* pReplacement = _replacements.get(static_cast<const Instruction*>(_pInstr));
+		return pReplacement != nullptr ? *pReplacement : _pInstr;
+	}
+
+	const Instruction* getTarget(const Instruction& _instr)
+	{
+		return _instr.empty() ? nullptr : _instr.front().getInstruction();
+	}
+
+	// branch target or OpLabel operand (modules parsed by Module::read)
+	BasicBlock* getBlock(const Operand& _operand)
+	{
+		if (_operand.isBranchTarget())
+		{
+			return _operand.getBranchTarget();
+		}
+		else if (const Instruction* label = _operand.getInstruction(); label != nullptr && *label == spv::Op::OpLabel)
+		{
+			return label->getBasicBlock();
+		}
+		return nullptr;
+	}
+
+	Instruction* freezeScalar(Module& _module, const Instruction& _spec, sgt_uint64_t _value)
+	{
+		const Type* type = _spec.getType();
+		if (type == nullptr)
+		{
+			return nullptr;
+		}
+
+		Constant constant(_module.getAllocator());
+
+		if (type->isBool())
+		{
+			constant.make(_value != 0u);
+		}
+		else if (type->isInt() || type->isFloat())
+		{
+			constant.setOperation(spv::Op::OpConstant);
+			constant.getType() = *type;
+			constant.addData(static_cast<unsigned int>(_value));
+
+			if ((type->isInt() ? type->getIntWidth() : type->getFloatWidth()) > 32u)
+			{
+				constant.addData(static_cast<unsigned int>(_value >> 32u));
+			}
+		}
+		else
+		{
+			return nullptr;
+		}
+
+		return _module.addConstant(constant);
+	}
+
+	// returns nullptr if not all constituents are (frozen) constants
+	Instruction* freezeComposite(Module& _module, const Instruction& _spec, const Replacements& _replacements)
+	{
+		const Type* type = _spec.getType();
+		if (type == nullptr)
+		{
+			return nullptr;
+		}
+
+		Constant constant(_module.getAllocator());
+		constant.setOperation(spv::Op::OpConstantComposite);
+		constant.getType() = *type;
+
+		for (auto it = _spec.getFirstActualOperand(); it != _spec.end(); ++it)
+		{
+			const Constant* component = _module.getConstantInfo(getReplacement(_replacements, it->getInstruction()));
+			if (component == nullptr || IsConstantOp(component->getOperation()) == false)
+			{
+				return nullptr;
+			}
+			constant.Component() = *component;
+		}
+
+		return constant.getComponents().empty() ? nullptr : _module.addConstant(constant);
+	}
+
+	// evaluate the operation of OpSpecConstantOp on its (frozen) operands
+	Instruction* foldSpecOp(Module& _module, const Instruction& _spec, const Replacements& _replacements, const IConstantFolder& _folder)
+	{
+		auto it = _spec.getFirstActualOperand();
+		if (it == _spec.end() || it->isLiteral() == false)
+		{
+			return nullptr;
+		}
+
+		Instruction instr(&_module, spv::Op::OpNop);
+		instr.setOperation(static_cast<spv::Op>(it->getLiteral().value));
+		instr.addOperand(_spec.getResultTypeInstr());
+		instr.addOperand(InvalidId);
+
+		for (++it; it != _spec.end(); ++it)
+		{
+			if (it->isInstruction())
+			{
+				instr.addOperand(getReplacement(_replacements, it->getInstruction()));
+			}
+			else
+			{
+				instr.addOperand(*it);
+			}
+		}
+
+		return _folder.fold(instr);
+	}
+
+	// constants and types added by Module::addConstant are appended, restore the definition before use order of m_TypesAndConstants
+	void sortTypesAndConstants(Module& _module, IAllocator* _pAllocator)
+	{
+		List<Instruction>& list = _module.getTypesAndConstants();
+
+		HashMap<const Instruction*, unsigned int> indices(_pAllocator, static_cast<unsigned int>(list.size() / 2u + 1u));
+		HashMap<const Instruction*, bool> forwardDeclared(_pAllocator);
+
+		unsigned int index = 0u;
+		for (const Instruction& instr : list)
+		{
+			indices.emplaceUnique(&instr, index++);
+
+			if (instr == spv::Op::OpTypeForwardPointer)
+			{
+				forwardDeclared.emplaceUnique(getTarget(instr), true);
+			}
+		}
+
+		// calls _func(index) for every operand defined in list, pointers declared by OpTypeForwardPointer can be used before their definition
+		auto forEachDependency = [&](const Instruction& _instr, auto _func)
+		{
+			if (_instr == spv::Op::OpTypeForwardPointer)
+			{
+				return;
+			}
+
+			for (const Operand& op : _instr)
+			{
+				const Instruction* dependency = op.getInstruction();
+				if (const unsigned int* pIndex = indices.get(dependency); pIndex != nullptr && forwardDeclared.get(dependency) == nullptr)
+				{
+					_func(*pIndex);
+				}
+			}
+		};
+
+		bool sorted = true;
+		index = 0u;
+		for (const Instruction& instr : list)
+		{
+			forEachDependency(instr, [&sorted, index](unsigned int _dependency) { sorted &= _dependency < index; });
+			++index;
+		}
+
+		if (sorted)
+		{
+			return;
+		}
+
+		Vector<Entry<Instruction>*> entries(_pAllocator, list.size());
+		for (auto it = list.begin(); it != list.end();)
+		{
+			Entry<Instruction>* entry = it.entry();
+			it = list.erase(it, false);
+			entries.emplace_back(entry);
+		}
+
+		const bool unvisited = false;
+		Vector<bool> visited(_pAllocator);
+		visited.resize(entries.size(), &unvisited);
+
+		// post order: dependencies first, original order otherwise
+		auto visit = [&](auto& _self, unsigned int _index) -> void
+		{
+			if (visited[_index])
+			{
+				return;
+			}
+
+			visited[_index] = true;
+			forEachDependency(*entries[_index]->operator->(), [&_self](unsigned int _dependency) { _self(_self, _dependency); });
+			list.append_entry(entries[_index]);
+		};
+
+		for (unsigned int i = 0u; i < entries.size(); ++i)
+		{
+			visit(visit, i);
+		}
+	}
+
+	// returns the target of a constant condition or selector, nullptr if _terminator can't be folded
+	BasicBlock* getConstantTarget(Module& _module, const Instruction& _terminator)
+	{
+		auto it = _terminator.getFirstActualOperand();
+		if (it == _terminator.end())
+		{
+			return nullptr;
+		}
+
+		const Constant* condition = _module.getConstantInfo(it->getInstruction());
+		if (condition == nullptr || IsConstantOp(condition->getOperation()) == false)
+		{
+			return nullptr;
+		}
+
+		if (_terminator == spv::Op::OpBranchConditional) // condition, true label, false label, weights
+		{
+			auto target = condition->getOperation() == spv::Op::OpConstantTrue ? it.next() : it.next().next();
+			return target != nullptr ? getBlock(*target) : nullptr;
+		}
+
+		if (_terminator != spv::Op::OpSwitch || it.next() == nullptr) // selector, default, literal label pairs
+		{
+			return nullptr;
+		}
+
+		// OpConstantNull has no data and selects literal 0
+		const Vector<unsigned int>& value = condition->getData();
+		const sgt_size_t words = condition->getType().getIntWidth() > 32u ? 2u : 1u;
+
+		BasicBlock* target = getBlock(*it.next());
+
+		for (auto c = it.next().next(); c != _terminator.end();)
+		{
+			bool match = true;
+			for (sgt_size_t i = 0u; i < words && c != _terminator.end(); ++i, ++c)
+			{
+				match &= c->isLiteral() && c->getLiteral().value == (i < value.size() ? value[i] : 0u);
+			}
+
+			if (c == _terminator.end())
+			{
+				break;
+			}
+
+			if (match)
+			{
+				target = getBlock(*c);
+				break;
+			}
+
+			++c;
+		}
+
+		return target;
+	}
+
+	// OpSelectionMerge or OpLoopMerge preceding the terminator
+	const Instruction* getMerge(const BasicBlock& _bb)
+	{
+		for (const Instruction& instr : _bb)
+		{
+			if (instr == spv::Op::OpSelectionMerge || instr == spv::Op::OpLoopMerge)
+			{
+				return &instr;
+			}
+		}
+		return nullptr;
+	}
+
+	bool branchesTo(const BasicBlock& _from, const BasicBlock* _pTo)
+	{
+		const Instruction* terminator = _from.getTerminator();
+		if (terminator == nullptr)
+		{
+			return false;
+		}
+
+		for (const Operand& op : *terminator)
+		{
+			if (getBlock(op) == _pTo)
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	unsigned int foldBranches(Module& _module, Function& _func)
+	{
+		unsigned int folded = 0u;
+
+		for (BasicBlock& bb : _func)
+		{
+			Instruction* terminator = bb.getTerminator();
+			const Instruction* merge = getMerge(bb);
+
+			// keep the structure of loops intact
+			if (terminator == nullptr || (merge != nullptr && *merge == spv::Op::OpLoopMerge))
+			{
+				continue;
+			}
+
+			BasicBlock* target = getConstantTarget(_module, *terminator);
+			if (target == nullptr)
+			{
+				continue;
+			}
+
+			// OpSelectionMerge must be followed by a conditional branch or switch
+			if (merge != nullptr)
+			{
+				bb.remove(merge);
+			}
+
+			terminator->reset();
+			terminator->opBranch(target);
+			++folded;
+		}
+
+		return folded;
+	}
+
+	unsigned int removeUnreachableBlocks(Module& _module, Function& _func, IAllocator* _pAllocator)
+	{
+		if (_func.empty())
+		{
+			return 0u;
+		}
+
+		// merge and continue targets of reachable headers are kept to preserve the structured control flow
+		HashMap<const BasicBlock*, bool> reachable(_pAllocator, 32u);
+		List<BasicBlock*> worklist(_pAllocator);
+		worklist.emplace_back(&_func.front());
+		reachable.emplaceUnique(&_func.front(), true);
+
+		while (worklist.empty() == false)
+		{
+			const BasicBlock* bb = worklist.pop_back();
+
+			List<BasicBlock*> successors(_pAllocator);
+			bb->getBranchTargets(successors);
+
+			if (const Instruction* merge = getMerge(*bb); merge != nullptr)
+			{
+				for (const Operand& op : *merge)
+				{
+					if (BasicBlock* target = getBlock(op); target != nullptr)
+					{
+						successors.emplace_back(target);
+					}
+				}
+			}
+
+			for (BasicBlock* successor : successors)
+			{
+				if (reachable.get(static_cast<const BasicBlock*>(successor)) == nullptr)
+				{
+					reachable.emplaceUnique(successor, true);
+					worklist.emplace_back(successor);
+				}
+			}
+		}
+
+		auto isReachable = [&reachable](const BasicBlock* _pBB) { return _pBB != nullptr && reachable.get(_pBB) != nullptr; };
+
+		// remove phi operands of edges that don't exist anymore
+		for (BasicBlock& bb : _func)
+		{
+			if (isReachable(&bb) == false)
+			{
+				continue;
+			}
+
+			for (Instruction& instr : bb)
+			{
+				if (instr != spv::Op::OpPhi)
+				{
+					continue;
+				}
+
+				for (auto it = instr.getFirstActualOperand(); it != instr.end() && it.next() != instr.end();)
+				{
+					const BasicBlock* parent = getBlock(*it.next());
+					if (isReachable(parent) && branchesTo(*parent, &bb))
+					{
+						it = it.next().next();
+					}
+					else
+					{
+						it = instr.erase(it);
+						it = instr.erase(it);
+					}
+				}
+			}
+		}
+
+		List<const BasicBlock*> dead(_pAllocator);
+		HashMap<const Instruction*, bool> deadInstructions(_pAllocator);
+		for (const BasicBlock& bb : _func)
+		{
+			if (isReachable(&bb) == false)
+			{
+				dead.emplace_back(&bb);
+				deadInstructions.emplaceUnique(bb.getLabel(), true);
+				for (const Instruction& instr : bb)
+				{
+					deadInstructions.emplaceUnique(&instr, true);
+				}
+			}
+		}
+
+		if (dead.empty())
+		{
+			return 0u;
+		}
+
+		auto sweep = [&deadInstructions](List<Instruction>& _container)
+		{
+			for (auto it = _container.begin(); it != _container.end();)
+			{
+				if (deadInstructions.get(getTarget(*it)) != nullptr)
+				{
+					it = _container.erase(it);
+				}
+				else
+				{
+					++it;
+				}
+			}
+		};
+
+		sweep(_module.getNames());
+		sweep(_module.getDecorations());
+
+		for (const auto& [instr, isDead] : deadInstructions)
+		{
+			_module.removeFromLookupMaps(instr);
+		}
+
+		for (const BasicBlock* bb : dead)
+		{
+			_func.remove(bb, nullptr, _pAllocator);
+		}
+
+		return static_cast<unsigned int>(dead.size());
+	}
+}
+
+spvgentwo::SpecConstantFreezing::Result spvgentwo::SpecConstantFreezing::freeze(Module& _module, const Values& _values, const IConstantFolder* _pFolder, IAllocator* _pAllocator)
+{
+	static const IConstantFolder defaultFolder{};
+
+	IAllocator* pAllocator = _pAllocator == nullptr ? _module.getAllocator() : _pAllocator;
+	const IConstantFolder& folder = _pFolder != nullptr ? *_pFolder : (_module.getConstantFolder() != nullptr ? *_module.getConstantFolder() : defaultFolder);
+
+	// shared instructions reference the spec constants of the module they were cloned from
+	_module.unshareAll();
+
+	Result result;
+
+	HashMap<const Instruction*, unsigned int> specIds(pAllocator);
+	for (const Instruction& decoration : _module.getDecorations())
+	{
+		spv::Decoration kind = spv::Decoration::Max;
+		unsigned int specId = 0u;
+
+		if (decoration == spv::Op::OpDecorate && ReflectionHelper::getSpvDecorationAndLiteralFromDecoration(&decoration, kind, specId) && kind == spv::Decoration::SpecId)
+		{
+			specIds.emplaceUnique(getTarget(decoration), specId);
+		}
+	}
+
+	// operands are defined before use, constants added while iterating are appended and visited as well
+	Replacements replacements(pAllocator);
+	for (Instruction& instr : _module.getTypesAndConstants())
+	{
+		Instruction* pConstant = nullptr;
+
+		switch (instr.getOperation())
+		{
+		case spv::Op::OpSpecConstantTrue:
+		case spv::Op::OpSpecConstantFalse:
+		case spv::Op::OpSpecConstant:
+			if (const unsigned int* specId = specIds.get(static_cast<const Instruction*>(&instr)); specId != nullptr)
+			{
+				if (const sgt_uint64_t* value = _values.get(*specId); value != nullptr)
+				{
+					pConstant = freezeScalar(_module, instr, *value);
+					result.frozenConstants += pConstant != nullptr ? 1u : 0u;
+				}
+			}
+			break;
+		case spv::Op::OpSpecConstantComposite:
+			pConstant = freezeComposite(_module, instr, replacements);
+			result.foldedConstants += pConstant != nullptr ? 1u : 0u;
+			break;
+		case spv::Op::OpSpecConstantOp:
+			pConstant = foldSpecOp(_module, instr, replacements, folder);
+			result.foldedConstants += pConstant != nullptr ? 1u : 0u;
+			break;
+		default:
+			break;
+		}
+
+		if (pConstant != nullptr)
+		{
+			replacements.emplaceUnique(&instr, getReplacement(replacements, pConstant));
+		}
+	}
+
+	if (replacements.elements() != 0u)
+	{
+		// SpecId and names don't apply to the (shared) constants
+		auto sweep = [&replacements](List<Instruction>& _container)
+		{
+			for (auto it = _container.begin(); it != _container.end();)
+			{
+				if (replacements.get(getTarget(*it)) != nullptr)
+				{
+					it = _container.erase(it);
+				}
+				else
+				{
+					++it;
+				}
+			}
+		};
+
+		sweep(_module.getNames());
+		sweep(_module.getDecorations());
+
+		_module.iterateInstructions([&replacements](Instruction& _instr)
+		{
+			for (Operand& op : _instr)
+			{
+				if (op.isInstruction())
+				{
+					op = getReplacement(replacements, op.getInstruction());
+				}
+			}
+		});
+
+		List<const Instruction*> frozen(pAllocator);
+		for (const auto& [instr, replacement] : replacements)
+		{
+			frozen.emplace_back(instr);
+		}
+		_module.removeFromLookupMaps(frozen);
+
+		List<Instruction>& typesAndConstants = _module.getTypesAndConstants();
+		for (auto it = typesAndConstants.begin(); it != typesAndConstants.end();)
+		{
+			if (replacements.get(static_cast<const Instruction*>(it.operator->())) != nullptr)
+			{
+				it = typesAndConstants.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+
+		sortTypesAndConstants(_module, pAllocator);
+	}
+
+	auto simplify = [&](Function& _func)
+	{
+		result.foldedBranches += foldBranches(_module, _func);
+		result.removedBlocks += removeUnreachableBlocks(_module, _func, pAllocator);
+	};
+
+	for (Function& func : _module.getFunctions())
+	{
+		simplify(func);
+	}
+	for (EntryPoint& ep : _module.getEntryPoints())
+	{
+		simplify(ep);
+	}
+
+	return result;
+}
@@ -0,0 +1,554 @@
+#include "common/VariablePromotion.h"
+#include "common/DominatorTree.h"
+#include "common/PassManager.h"
+
+#include "spvgentwo/Module.h"
+#include "spvgentwo/InstructionTemplate.inl"
+#include "spvgentwo/ModuleTemplate.inl"
+
+namespace
+{
+	using namespace spvgentwo;
+
+	struct Variable
+	{
+		Variable(IAllocator* _pAllocator) : defBlocks(_pAllocator) {}
+
+		Instruction* var = nullptr;
+		Instruction* type = nullptr; // pointee type
+		Instruction* initializer = nullptr;
+		List<BasicBlock*> defBlocks; // blocks with stores
+		bool escaped = false;
+	};
+
+	struct Phi
+	{
+		unsigned int var = 0u;
+		Instruction* phi = nullptr;
+	};
+
+	const Instruction* getTarget(const Instruction& _instr)
+	{
+		return _instr.empty() ? nullptr : _instr.front().getInstruction();
+	}
+
+	bool isVolatile(const Instruction::Iterator& _memoryAccess)
+	{
+		return _memoryAccess != nullptr && _memoryAccess->isLiteral() && (_memoryAccess->getLiteral().value & static_cast<unsigned int>(spv::MemoryAccessMask::Volatile)) != 0u;
+	}
+
+	class Promoter
+	{
+	public:
+		Promoter(Function& _func, FunctionAnalyses& _analyses, IAllocator* _pAllocator) :
+			m_func(_func),
+			m_module(*_func.getModule()),
+			m_analyses(_analyses),
+			m_pAllocator(_pAllocator),
+			m_vars(_pAllocator),
+			m_indices(_pAllocator),
+			m_phis(_pAllocator),
+			m_replaced(_pAllocator),
+			m_undefs(_pAllocator),
+			m_dead(_pAllocator),
+			m_current(_pAllocator)
+		{
+		}
+
+		VariablePromotion::Result run()
+		{
+			if (m_func.empty() || gatherVariables() == false)
+			{
+				return m_result;
+			}
+
+			const DominatorTree& domTree = m_analyses.getDominatorTree();
+
+			placePhis(domTree);
+
+			for (const Variable& v : m_vars)
+			{
+				m_current.emplace_back(v.escaped ? nullptr : v.initializer);
+			}
+			rename(domTree, m_func.front());
+
+			handleUnreachable(domTree);
+			replaceOperands();
+			removeUnusedPhis();
+			removeDead();
+
+			return m_result;
+		}
+
+	private:
+		// returns index of the promotable variable _pInstr or nullptr
+		const unsigned int* getVar(const Instruction* _pInstr) const
+		{
+			const unsigned int* index = m_indices.get(_pInstr);
+			return index != nullptr && m_vars[*index].escaped == false ? index : nullptr;
+		}
+
+		bool gatherVariables()
+		{
+			// decorated variables are not promoted
+			HashMap<const Instruction*, bool> decorated(m_pAllocator);
+			for (const Instruction& decoration : m_module.getDecorations())
+			{
+				decorated.emplaceUnique(getTarget(decoration), true);
+			}
+
+			for (Instruction& instr : m_func.front())
+			{
+				if (instr != spv::Op::OpVariable || instr.getStorageClass() != spv::StorageClass::Function || decorated.get(static_cast<const Instruction*>(&instr)) != nullptr)
+				{
+					continue;
+				}
+
+				const Type* type = instr.getType();
+				if (type == nullptr || type->isPointer() == false || (type->front().isScalar() == false && type->front().isVector() == false))
+				{
+					continue;
+				}
+
+				Variable& v = *m_vars.emplace_back(m_pAllocator);
+				v.var = &instr;
+				v.type = m_module.addType(type->front());
+
+				// result type, id, storage class, initializer
+				if (auto it = instr.getFirstActualOperand(); it != nullptr && it.next() != nullptr)
+				{
+					v.initializer = it.next()->getInstruction();
+				}
+
+				m_indices.emplaceUnique(&instr, static_cast<unsigned int>(m_vars.size() - 1u));
+			}
+
+			if (m_vars.empty())
+			{
+				return false;
+			}
+
+			// only OpLoad and OpStore may use the variable as pointer
+			for (BasicBlock& bb : m_func)
+			{
+				for (Instruction& instr : bb)
+				{
+					auto first = instr.getFirstActualOperand();
+					unsigned int i = 0u;
+					for (auto it = first; it != instr.end(); ++it, ++i)
+					{
+						const unsigned int* index = m_indices.get(static_cast<const Instruction*>(it->getInstruction()));
+						if (index == nullptr || &instr == m_vars[*index].var)
+						{
+							continue;
+						}
+
+						Variable& v = m_vars[*index];
+
+						if (instr == spv::Op::OpLoad && i == 0u && isVolatile(it.next()) == false)
+						{
+							continue;
+						}
+						else if (instr == spv::Op::OpStore && i == 0u && (it.next() == nullptr || isVolatile(it.next().next()) == false))
+						{
+							if (v.defBlocks.contains(&bb) == false)
+							{
+								v.defBlocks.emplace_back(&bb);
+							}
+							continue;
+						}
+
+						v.escaped = true;
+					}
+				}
+			}
+
+			for (const Variable& v : m_vars)
+			{
+				m_result.promotedVariables += v.escaped ? 0u : 1u;
+			}
+
+			return m_result.promotedVariables != 0u;
+		}
+
+		List<Phi>* getPhis(const BasicBlock* _pBB) const
+		{
+			return m_phis.get(_pBB);
+		}
+
+		void placePhis(const DominatorTree& _domTree)
+		{
+			for (unsigned int i = 0u; i < m_vars.size(); ++i)
+			{
+				Variable& v = m_vars[i];
+				if (v.escaped)
+				{
+					continue;
+				}
+
+				HashMap<const BasicBlock*, bool> visited(m_pAllocator);
+				List<BasicBlock*> worklist(m_pAllocator);
+
+				for (BasicBlock* bb : v.defBlocks)
+				{
+					visited.emplaceUnique(bb, true);
+					worklist.emplace_back(bb);
+				}
+
+				while (worklist.empty() == false)
+				{
+					const List<BasicBlock*>* frontier = _domTree.getFrontier(worklist.pop_back());
+					if (frontier == nullptr) // unreachable
+					{
+						continue;
+					}
+
+					for (BasicBlock* bb : *frontier)
+					{
+						List<Phi>& phis = m_phis.emplaceUnique(bb, m_pAllocator).kv.value;
+						if (phis.find_if([i](const Phi& _phi) { return _phi.var == i; }) != phis.end())
+						{
+							continue;
+						}
+
+						Instruction& phi = bb->emplace_front(bb, spv::Op::OpNop);
+						phi.setOperation(spv::Op::OpPhi);
+						phi.addOperand(v.type);
+						phi.addOperand(InvalidId);
+						phis.emplace_back(Phi{ i, &phi });
+						++m_result.insertedPhis;
+
+						if (visited.get(static_cast<const BasicBlock*>(bb)) == nullptr)
+						{
+							visited.emplaceUnique(bb, true);
+							worklist.emplace_back(bb);
+						}
+					}
+				}
+			}
+		}
+
+		Instruction* getUndef(unsigned int _var)
+		{
+			const Instruction* type = m_vars[_var].type;
+			if (Instruction** undef = m_undefs.get(type); undef != nullptr)
+			{
+				return *undef;
+			}
+
+			Instruction* undef = m_module.addUndefInstr()->opUndef(m_vars[_var].type);
+			m_undefs.emplaceUnique(type, undef);
+			return undef;
+		}
+
+		Instruction* getCurrent(unsigned int _var)
+		{
+			return m_current[_var] != nullptr ? m_current[_var] : getUndef(_var);
+		}
+
+		Instruction* resolve(Instruction* _pInstr) const
+		{
+			for (Instruction* const* replacement = m_replaced.get(static_cast<const Instruction*>(_pInstr)); replacement != nullptr; replacement = m_replaced.get(static_cast<const Instruction*>(_pInstr)))
+			{
+				_pInstr = *replacement;
+			}
+			return _pInstr;
+		}
+
+		void addIncoming(BasicBlock& _pred, BasicBlock& _bb, bool _undef)
+		{
+			if (const List<Phi>* phis = getPhis(&_bb); phis != nullptr)
+			{
+				for (const Phi& phi : *phis)
+				{
+					phi.phi->addOperand(_undef ? getUndef(phi.var) : getCurrent(phi.var));
+					phi.phi->addOperand(&_pred);
+				}
+			}
+		}
+
+		// walk the dominator tree, the value of each variable is the last store (or phi) of the dominating blocks
+		void rename(const DominatorTree& _domTree, BasicBlock& _bb)
+		{
+			Vector<Instruction*> saved(m_pAllocator, m_current.size());
+			for (Instruction* value : m_current)
+			{
+				saved.emplace_back(value);
+			}
+
+			if (const List<Phi>* phis = getPhis(&_bb); phis != nullptr)
+			{
+				for (const Phi& phi : *phis)
+				{
+					m_current[phi.var] = phi.phi;
+				}
+			}
+
+			for (Instruction& instr : _bb)
+			{
+				const bool load = instr == spv::Op::OpLoad;
+				if (load == false && instr != spv::Op::OpStore)
+				{
+					continue;
+				}
+
+				auto ptr = instr.getFirstActualOperand();
+				if (const unsigned int* var = getVar(ptr != nullptr ? ptr->getInstruction() : nullptr); var != nullptr)
+				{
+					if (load)
+					{
+						m_replaced.emplaceUnique(&instr, getCurrent(*var));
+						++m_result.removedLoads;
+					}
+					else
+					{
+						m_current[*var] = resolve(ptr.next()->getInstruction());
+						++m_result.removedStores;
+					}
+					m_dead.emplaceUnique(&instr, true);
+				}
+			}
+
+			List<BasicBlock*> successors(m_pAllocator);
+			_bb.getBranchTargets(successors);
+
+			for (auto it = successors.begin(); it != successors.end(); ++it)
+			{
+				// one incoming value per predecessor, even if both targets of a branch are the same
+				if (successors.find(*it) == it)
+				{
+					addIncoming(_bb, **it, false);
+				}
+			}
+
+			if (const List<BasicBlock*>* children = _domTree.getChildren(&_bb); children != nullptr)
+			{
+				for (BasicBlock* child : *children)
+				{
+					rename(_domTree, *child);
+				}
+			}
+
+			for (unsigned int i = 0u; i < saved.size(); ++i)
+			{
+				m_current[i] = saved[i];
+			}
+		}
+
+		// unreachable blocks are not visited by rename, their loads read undefined values
+		void handleUnreachable(const DominatorTree& _domTree)
+		{
+			for (BasicBlock& bb : m_func)
+			{
+				if (_domTree.isReachable(&bb))
+				{
+					continue;
+				}
+
+				for (Instruction& instr : bb)
+				{
+					auto ptr = instr.getFirstActualOperand();
+					if (const unsigned int* var = getVar(ptr != nullptr ? ptr->getInstruction() : nullptr); var != nullptr && (instr == spv::Op::OpLoad || instr == spv::Op::OpStore))
+					{
+						if (instr == spv::Op::OpLoad)
+						{
+							m_replaced.emplaceUnique(&instr, getUndef(*var));
+							++m_result.removedLoads;
+						}
+						else
+						{
+							++m_result.removedStores;
+						}
+						m_dead.emplaceUnique(&instr, true);
+					}
+				}
+
+				List<BasicBlock*> successors(m_pAllocator);
+				bb.getBranchTargets(successors);
+
+				for (auto it = successors.begin(); it != successors.end(); ++it)
+				{
+					if (successors.find(*it) == it && _domTree.isReachable(*it))
+					{
+						addIncoming(bb, **it, true);
+					}
+				}
+			}
+		}
+
+		void replaceOperands()
+		{
+			for (BasicBlock& bb : m_func)
+			{
+				for (Instruction& instr : bb)
+				{
+					for (Operand& op : instr)
+					{
+						if (op.isInstruction() && m_replaced.get(static_cast<const Instruction*>(op.getInstruction())) != nullptr)
+						{
+							op = resolve(op.getInstruction());
+						}
+					}
+				}
+			}
+		}
+
+		void removeUnusedPhis()
+		{
+			HashMap<const Instruction*, unsigned int> uses(m_pAllocator);
+			for (const auto& [bb, phis] : m_phis)
+			{
+				for (const Phi& phi : phis)
+				{
+					uses.emplaceUnique(phi.phi, 0u);
+				}
+			}
+
+			for (const BasicBlock& bb : m_func)
+			{
+				for (const Instruction& instr : bb)
+				{
+					for (const Operand& op : instr)
+					{
+						if (unsigned int* count = uses.get(static_cast<const Instruction*>(op.getInstruction())); count != nullptr && op.getInstruction() != &instr)
+						{
+							++*count;
+						}
+					}
+				}
+			}
+
+			List<const Instruction*> worklist(m_pAllocator);
+			for (const auto& [phi, count] : uses)
+			{
+				if (count == 0u)
+				{
+					worklist.emplace_back(phi);
+				}
+			}
+
+			while (worklist.empty() == false)
+			{
+				const Instruction* phi = worklist.pop_back();
+				m_dead.emplaceUnique(phi, true);
+				--m_result.insertedPhis;
+
+				for (const Operand& op : *phi)
+				{
+					if (unsigned int* count = uses.get(static_cast<const Instruction*>(op.getInstruction())); count != nullptr && op.getInstruction() != phi && *count != 0u && --*count == 0u)
+					{
+						worklist.emplace_back(op.getInstruction());
+					}
+				}
+			}
+		}
+
+		void removeDead()
+		{
+			for (const Variable& v : m_vars)
+			{
+				if (v.escaped == false)
+				{
+					m_dead.emplaceUnique(v.var, true);
+				}
+			}
+
+			auto isDead = [this](const Instruction* _pInstr) { return m_dead.get(_pInstr) != nullptr; };
+
+			auto sweep = [&isDead](List<Instruction>& _container)
+			{
+				for (auto it = _container.begin(); it != _container.end();)
+				{
+					if (isDead(getTarget(*it)))
+					{
+						it = _container.erase(it);
+					}
+					else
+					{
+						++it;
+					}
+				}
+			};
+
+			sweep(m_module.getNames());
+			sweep(m_module.getDecorations());
+
+			for (BasicBlock& bb : m_func)
+			{
+				for (auto it = bb.begin(); it != bb.end();)
+				{
+					if (isDead(it.operator->()))
+					{
+						m_module.removeFromLookupMaps(it.operator->());
+						it = bb.erase(it);
+					}
+					else
+					{
+						++it;
+					}
+				}
+			}
+		}
+
+	private:
+		Function& m_func;
+		Module& m_module;
+		FunctionAnalyses& m_analyses;
+		IAllocator* m_pAllocator = nullptr;
+		VariablePromotion::Result m_result;
+
+		Vector<Variable> m_vars;
+		HashMap<const Instruction*, unsigned int> m_indices; // OpVariable -> m_vars index
+		HashMap<const BasicBlock*, List<Phi>> m_phis; // inserted phis
+		HashMap<const Instruction*, Instruction*> m_replaced; // load -> value
+		HashMap<const Instruction*, Instruction*> m_undefs; // type -> OpUndef
+		HashMap<const Instruction*, bool> m_dead; // loads, stores, variables and unused phis
+		Vector<Instruction*> m_current; // current value of each variable while renaming
+	};
+}
+
+spvgentwo::VariablePromotion::Result spvgentwo::VariablePromotion::promote(Function& _func, IAllocator* _pAllocator)
+{
+	IAllocator* pAllocator = _pAllocator != nullptr ? _pAllocator : _func.getAllocator();
+	FunctionAnalyses analyses(_func, pAllocator);
+	return promote(_func, analyses, pAllocator);
+}
+
+spvgentwo::VariablePromotion::Result spvgentwo::VariablePromotion::promote(Function& _func, FunctionAnalyses& _analyses, IAllocator* _pAllocator)
+{
+	_analyses.unshare();
+	const Result result = Promoter(_func, _analyses, _pAllocator != nullptr ? _pAllocator : _func.getAllocator()).run();
+
+	// loads, stores and variables were replaced, the blocks are unchanged
+	if (result.promotedVariables != 0u)
+	{
+		_analyses.invalidate({ AnalysisBits::ControlFlow, AnalysisBits::Dominators, AnalysisBits::CallGraph });
+	}
+
+	return result;
+}
+
+spvgentwo::VariablePromotion::Result spvgentwo::VariablePromotion::promote(Module& _module, IAllocator* _pAllocator)
+{
+	Result result;
+
+	auto add = [&](Function& _func)
+	{
+		const Result r = promote(_func, _pAllocator);
+		result.promotedVariables += r.promotedVariables;
+		result.removedLoads += r.removedLoads;
+		result.removedStores += r.removedStores;
+		result.insertedPhis += r.insertedPhis;
+	};
+
+	for (Function& func : _module.getFunctions())
+	{
+		add(func);
+	}
+	for (EntryPoint& ep : _module.getEntryPoints())
+	{
+		add(ep);
+	}
+
+	return result;
+}
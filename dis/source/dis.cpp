@@ -4,6 +4,7 @@
 #include "common/HeapAllocator.h"
 #include "common/BinaryFileWriter.h"
 #include "common/BinaryFileReader.h"
+#include "common/CompressedBinary.h"
 #include "common/ConsoleLogger.h"
 #include "common/ModulePrinter.h"
 
@@ -23,6 +24,7 @@ int main(int argc, char* argv[])
 	const char* tabs = "\t\t";
 	bool serialize = false; // for debugging
 	bool reassignIDs = false;
+	IdOrder idOrder = IdOrder::Serialization;
 	bool colors = false;
 
 	PrintOptions options{ PrintOptionsBits::All };
@@ -41,6 +43,25 @@ int main(int argc, char* argv[])
 		else if (strcmp(arg, "-assignIDs") == 0 || strcmp(arg, "-assignids") == 0)
 		{
 			reassignIDs = true;
+
+			// optional order, the next option starts with '-'
+			if (i + 1 < argc && argv[i + 1][0] != '-')
+			{
+				const char* order = argv[++i];
+				if (strcmp(order, "frequency") == 0)
+				{
+					idOrder = IdOrder::Frequency;
+				}
+				else if (strcmp(order, "firstuse") == 0)
+				{
+					idOrder = IdOrder::FirstUse;
+				}
+				else
+				{
+					logger.logError("Unknown id order \'%s\' for -assignIDs, valid orders: frequency, firstuse", order);
+					return -1;
+				}
+			}
 		}
 		else if (strcmp(arg, "-noinstrnames") == 0)
 		{
@@ -71,11 +92,14 @@ int main(int argc, char* argv[])
 
 	HeapAllocator alloc;
 
-	if (BinaryFileReader reader(alloc, spv); reader)
+	if (BinaryFileReader fileReader(alloc, spv); fileReader)
 	{
 		Module module(&alloc, &logger);
 		Grammar gram(&alloc);
 
+		// decompresses CompressedWriter output, plain SPIR-V is passed through
+		CompressedReader reader(fileReader, gram, &alloc);
+
 		// parse the binary instructions & operands
 		if (module.readAndInit(reader, gram) == false)
 		{
@@ -84,7 +108,7 @@ int main(int argc, char* argv[])
 
 		if (reassignIDs)
 		{
-			module.assignIDs(); // compact ids
+			module.assignIDs(nullptr, idOrder); // compact ids
 		}
 
 		auto printer = ModulePrinter::ModuleSimpleFuncPrinter([](const char* _pStr) { printf("%s", _pStr);	}, colors);
@@ -99,7 +123,7 @@ int main(int argc, char* argv[])
 		{
 			if (BinaryFileWriter writer(alloc, "serialized.spv"); writer.isOpen())
 			{
-				module.finalizeAndWrite(writer);
+				module.finalizeAndWrite(writer, nullptr, idOrder);
 			}
 		}
 	}
@@ -1,5 +1,6 @@
 #pragma once
 #include "Instruction.h"
+#include "HashMap.h"
 
 namespace spvgentwo
 {
@@ -14,10 +15,16 @@ namespace spvgentwo
 	{
 		friend class Module;
 		friend class Function;
+		friend class Instruction;
 	private:
 
 		Function* m_pFunction = nullptr; // parent
 		Instruction m_Label;
+		bool m_shared = false; // instructions are owned by the BasicBlock this block was cloned from (see Module::clone)
+
+		bool m_valueNumbering = false;
+		HashMap<Hash64, Instruction*> m_values; // (operation, result type, operands) hash -> first pure instruction of this block
+		Instruction* m_pLastValue = nullptr; // instruction reused by the last operation
 
 	public:
 		BasicBlock() = default;
@@ -47,10 +54,18 @@ namespace spvgentwo
 		// returns a list of BasicBlock branch targets of this blocks terminator
 		bool getBranchTargets(List<BasicBlock*>& _outTargetBlocks) const;
 
+		// true if the instructions of this block are shared with the module it was cloned from, they are copied on first modification
+		bool isShared() const { return m_shared; }
+
+		// pure instructions (see isPureOp) with the same operation, result type and operands as a previous instruction of this block are not emitted,
+		// the new instruction is removed again and the previous one is returned instead. Always use the instruction returned by the op* functions
+		void setValueNumbering(bool _enable);
+		bool getValueNumbering() const { return m_valueNumbering; }
+
 		// manual instruction add
 		Instruction* addInstruction();
 
-		Instruction* operator->() { return &emplace_back(this, spv::Op::OpNop); }
+		Instruction* operator->() { return addInstruction(); }
 
 		template <class ExtInstr>
 		ExtInstr* ext() { return reinterpret_cast<ExtInstr*>(addInstruction()); }
@@ -61,8 +76,8 @@ namespace spvgentwo
 		// set return value of this block (used in function), returns opReturn/opReturnValue instruction
 		Instruction* returnValue(Instruction* _pValue = nullptr);
 
-		// return last operation
-		operator Instruction* () const { return m_pLast != nullptr ? m_pLast->operator->() : nullptr; };
+		// return last operation (or the instruction it was replaced with by value numbering or constant folding)
+		operator Instruction* () const { return m_pLastValue != nullptr ? m_pLastValue : (m_pLast != nullptr ? m_pLast->operator->() : nullptr); };
 
 		void write(IWriter& _writer) const;
 
@@ -71,6 +86,14 @@ namespace spvgentwo
 		// remove instruction from this block (if it is in this block). OpLabel can't be removed. Returns true if the instruction was removed
 		bool remove(const Instruction* _pInstr);
 
+		// remove all instructions for which _pred(const Instruction&) returns true in a single pass, returns the number of removed instructions
+		template <class Pred>
+		unsigned int removeIf(Pred _pred);
+
+		// move all instructions following _pInstr to a new basic block inserted after this block in the function, returns the new block or nullptr if _pInstr is not part of this block.
+		// this block is left without terminator, OpPhi instructions of the successors are updated to reference the new block
+		BasicBlock* split(const Instruction* _pInstr, const char* _pName = nullptr);
+
 		// structured if, returns last instruction of MergeBlock which creats a result
 		BasicBlock& If(Instruction* _pCondition, BasicBlock& _trueBlock, BasicBlock& _falseBlock, BasicBlock* _pMergeBlock = nullptr, const Flag<spv::SelectionControlMask> _mask = spv::SelectionControlMask::MaskNone);
 
@@ -103,17 +126,27 @@ namespace spvgentwo
 		BasicBlock& Greater(Instruction* _pLeft, Instruction* _pRight) { addInstruction()->Greater(_pLeft, _pRight); return *this; }
 		BasicBlock& GreaterEqual(Instruction* _pLeft, Instruction* _pRight) { addInstruction()->GreaterEqual(_pLeft, _pRight); return *this; }
 
-		// add _pRight to last instruction in this basic block and push the result (stack like) to this basic block
-		BasicBlock& Add(Instruction* _pRight) { return Add(&back(), _pRight); }
-		BasicBlock& Sub(Instruction* _pRight) { return Sub(&back(), _pRight); }
-		BasicBlock& Mul(Instruction* _pRight) { return Mul(&back(), _pRight); }
-		BasicBlock& Div(Instruction* _pRight) { return Div(&back(), _pRight); }
-		BasicBlock& Not() { return Not(&back()); }
-		BasicBlock& Equal(Instruction* _pRight) { return Equal(&back(), _pRight); }
-		BasicBlock& NotEqual(Instruction* _pRight) { return NotEqual(&back(), _pRight); }
-		BasicBlock& Less(Instruction* _pRight) { return Less(&back(), _pRight); }
-		BasicBlock& LessEqual(Instruction* _pRight) { return LessEqual(&back(), _pRight); }
-		BasicBlock& Greater(Instruction* _pRight) { return Greater(&back(), _pRight); }
-		BasicBlock& GreaterEqual(Instruction* _pRight) { return GreaterEqual(&back(), _pRight); }
+		// add _pRight to last operation in this basic block and push the result (stack like) to this basic block
+		BasicBlock& Add(Instruction* _pRight) { return Add(*this, _pRight); }
+		BasicBlock& Sub(Instruction* _pRight) { return Sub(*this, _pRight); }
+		BasicBlock& Mul(Instruction* _pRight) { return Mul(*this, _pRight); }
+		BasicBlock& Div(Instruction* _pRight) { return Div(*this, _pRight); }
+		BasicBlock& Not() { return Not(*this); }
+		BasicBlock& Equal(Instruction* _pRight) { return Equal(*this, _pRight); }
+		BasicBlock& NotEqual(Instruction* _pRight) { return NotEqual(*this, _pRight); }
+		BasicBlock& Less(Instruction* _pRight) { return Less(*this, _pRight); }
+		BasicBlock& LessEqual(Instruction* _pRight) { return LessEqual(*this, _pRight); }
+		BasicBlock& Greater(Instruction* _pRight) { return Greater(*this, _pRight); }
+		BasicBlock& GreaterEqual(Instruction* _pRight) { return GreaterEqual(*this, _pRight); }
+
+	private:
+		// forget shared instructions without destroying them
+		void detachShared();
+
+		// called by Instruction::makeOp, returns _pInstr or the equivalent instruction _pInstr was replaced with (_pInstr is destroyed)
+		Instruction* numberValue(Instruction* _pInstr);
+
+		// removes _pInstr if it is the last instruction of this block and returns _pValue instead
+		Instruction* rollback(Instruction* _pInstr, Instruction* _pValue);
 	};
 } // !spvgentwo
\ No newline at end of file
@@ -53,6 +53,58 @@ namespace spvgentwo
 		return mergeBB;
 	}
 
+	template <class Pred>
+	inline unsigned int BasicBlock::removeIf(Pred _pred)
+	{
+		static_assert(traits::is_invocable_v<Pred, const Instruction&>, "Pred _pred is not invocable: _pred(const Instruction& instr)");
+
+		if (m_shared)
+		{
+			m_pFunction->unshare();
+		}
+
+		if (m_valueNumbering)
+		{
+			for (auto it = m_values.begin(); it != m_values.end();)
+			{
+				if (_pred(static_cast<const Instruction&>(*it->value)))
+				{
+					it = m_values.erase(it);
+				}
+				else
+				{
+					++it;
+				}
+			}
+
+			if (m_pLastValue != nullptr && _pred(static_cast<const Instruction&>(*m_pLastValue)))
+			{
+				m_pLastValue = nullptr;
+			}
+		}
+
+		unsigned int removed = 0u;
+		for (auto it = begin(); it != end();)
+		{
+			if (_pred(static_cast<const Instruction&>(*it)))
+			{
+				it = erase(it);
+				++removed;
+			}
+			else
+			{
+				++it;
+			}
+		}
+
+		if (removed != 0u)
+		{
+			m_pFunction->setDirty();
+		}
+
+		return removed;
+	}
+
 	// ContinueFunc is increment func
 	template<class ConditionFunc, class ContinueFunc, class LoopBodyFunc>
 	inline BasicBlock& BasicBlock::Loop(ConditionFunc _condition, ContinueFunc _continue, LoopBodyFunc _body, BasicBlock* _pMergeBlock, const Flag<spv::LoopControlMask> _mask)
@@ -11,6 +11,8 @@ namespace spvgentwo
 	public:
 		Constant(IAllocator* _pAllocator = nullptr);
 		Constant(const Constant& _other);
+		// deep copy of _other, type, components and data are allocated from _pAllocator
+		Constant(const Constant& _other, IAllocator* _pAllocator);
 		Constant(Constant&& _other) noexcept;
 		~Constant();
 
@@ -168,7 +170,8 @@ namespace spvgentwo
 			return operator()(_const, hasher);
 		}
 
-		constexpr Hash64 operator()(const Constant& _const, FNV1aHasher& _hasher) const
+		template <class H> // FNV1aHasher or WordHasher
+		constexpr Hash64 operator()(const Constant& _const, H& _hasher) const
 		{
 			_hasher << _const.getOperation();
 			Hasher<Type>()(_const.getType(), _hasher);
@@ -182,7 +185,13 @@ namespace spvgentwo
 				operator()(component, _hasher);
 			}
 
-			return _hasher;
+			return _hasher.get();
 		}
 	};
+
+	template <>
+	struct KeyHasher<Constant>
+	{
+		using Algorithm = WordHasher;
+	};
 } // !spvgentwo
\ No newline at end of file
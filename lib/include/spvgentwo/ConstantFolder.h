@@ -0,0 +1,17 @@
+#pragma once
+
+namespace spvgentwo
+{
+	// forward delcs
+	class Instruction;
+
+	class IConstantFolder
+	{
+	public:
+		// called by makeOp for pure instructions (see isPureOp) of a BasicBlock, returns the instruction _instr evaluates to or nullptr if it can't be folded.
+		// the default implementation evaluates 32 and 64 bit integer and float arithmetic, bit, logical, relational and conversion ops
+		// (component wise for vectors), OpSelect, OpCompositeConstruct, OpCompositeExtract and OpVectorShuffle on OpConstant operands.
+		// the result is added to the module via Module::addConstant. spec constants and undefined results (e.g. division by zero) are not folded
+		virtual Instruction* fold(const Instruction& _instr) const;
+	};
+} //!spvgentwo
@@ -41,6 +41,7 @@ namespace spvgentwo
 		Entry* insertAfter(IAllocator* _pAlloc, Args&& ..._args);
 
 		// removes this entry from the list (and destroys it if allocator is provieded), returns next entry
+		// a removed entry that is not destroyed is unlinked and can be inserted again (e.g. List::append_entry)
 		Entry* remove(IAllocator* _pAlloc);
 
 		constexpr const Entry* first() const; // head
@@ -167,7 +168,9 @@ namespace spvgentwo
 
 		entry->m_pPrev = m_pPrev;
 		entry->m_pNext = this;
-		
+
+		m_pPrev = entry;
+
 		return entry;
 	}
 
@@ -214,6 +217,11 @@ namespace spvgentwo
 		{
 			_pAlloc->destruct(this);
 		}
+		else
+		{
+			m_pPrev = nullptr;
+			m_pNext = nullptr;
+		}
 
 		return next;
 	}
@@ -18,11 +18,14 @@ namespace spvgentwo
 		template <class ... TypeInstr>
 		EntryPoint(Module* _pModule, const spv::ExecutionModel _model, const char* _pEntryPointName, const Flag<spv::FunctionControlMask> _control, Instruction* _pReturnType, TypeInstr* ... _paramTypeInstructions);
 		
+		// OpEntryPoint is remapped to the moved OpFunction, the global interface is recollected on the next finalize
+		EntryPoint(Module* _pModule, EntryPoint&& _other) noexcept;
+
 		~EntryPoint() override;
 
-		const char* getName() const;
+		EntryPoint& operator=(EntryPoint&& _other) noexcept;
 
-		// TODO: move constructor & asignment
+		const char* getName() const;
 
 		spv::ExecutionModel getExecutionModel() const { return m_ExecutionModel; }
 		void setExecutionModel(const spv::ExecutionModel _model) { m_ExecutionModel = _model; }
@@ -40,15 +43,25 @@ namespace spvgentwo
 		// get Variable interface (instructions) operands of OpEntryPoint
 		Range<Instruction::Iterator> getInterfaceVariables() const;
 
+		// true if this entry point or a function it calls (as of the last finalizeGlobalInterface) is dirty, or _version differs
+		bool isGlobalInterfaceDirty(const GlobalInterfaceVersion _version) const;
+
 	private:
-		// only to be called by the Module before serialization
-		void finalizeGlobalInterface(const GlobalInterfaceVersion _version);
+		// only to be called by the Module before serialization, _incremental skips entry points with a clean interface. returns true if the interface was collected
+		bool finalizeGlobalInterface(const GlobalInterfaceVersion _version, bool _incremental = false);
 
 		String& getNameStorage();
 
+		// replace references to _pOldFunction in OpEntryPoint by this entry points OpFunction
+		void remapEntryPoint(const Instruction* _pOldFunction);
+
 	private:
 		Instruction m_EntryPoint; // OpEntryPoint
 		spv::ExecutionModel m_ExecutionModel = spv::ExecutionModel::Max;
 		String m_nameStorage; // literal string of EP name that was encoded in OpEntryPoint
+
+		List<const Function*> m_callees; // call tree of the last finalizeGlobalInterface
+		GlobalInterfaceVersion m_interfaceVersion = GlobalInterfaceVersion::SpirV1_3;
+		bool m_interfaceFinalized = false;
 	};
 } // !spvgentwo
\ No newline at end of file
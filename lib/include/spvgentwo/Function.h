@@ -64,10 +64,16 @@ namespace spvgentwo
 		const char* getName() const;
 
 		bool isEntryPoint() const { return m_isEntryPoint; }
+
+		// true if some basic blocks share their instructions with the module this function was cloned from (see Module::clone)
+		bool isShared() const { return m_shared; }
+
+		// copy shared instructions of all basic blocks to this module, called implicitly by BasicBlock & Module modifiers. Returns true on success
+		bool unshare();
 		EntryPoint* asEntryPoint() { return m_isEntryPoint ? reinterpret_cast<EntryPoint*>(this) : nullptr; }
 		const EntryPoint* asEntryPoint() const { return m_isEntryPoint ? reinterpret_cast<const EntryPoint*>(this) : nullptr; }
 
-		BasicBlock& addBasicBlock(const char* _pName = nullptr) { return emplace_back(this, _pName); }
+		BasicBlock& addBasicBlock(const char* _pName = nullptr) { m_dirty = true; return emplace_back(this, _pName); }
 
 		// remove _pBB from this function (destroying it), optionally replacing it with _pReplacement, returning uses of this basic block or its label
 		// if bool _gatherReferencedInstructions is true, also return uses of instructions from the removed basic block (OpName etc)
@@ -123,6 +129,11 @@ namespace spvgentwo
 
 		Flag<spv::FunctionControlMask> getFunctionControl() const;
 
+		// true if the function was changed since the last Module::finalize, set by addBasicBlock, remove and the BasicBlock modifiers (addInstruction, remove, split).
+		// instructions changed in place or removed from the lists directly require setDirty() for incremental finalization (see IdOrder::Stable)
+		bool isDirty() const { return m_dirty; }
+		void setDirty(bool _dirty = true) { m_dirty = _dirty; }
+
 	protected:
 		Module* m_pModule = nullptr; // parent
 
@@ -134,8 +145,12 @@ namespace spvgentwo
 		List<Instruction> m_Parameters; // OpFunctionParameters
 
 		bool m_isEntryPoint = false;
+
+		bool m_shared = false;
+
+		bool m_dirty = true;
 	};
 
-	// get all the global OpVariables with StorageClass != Function used in this function
-	void collectReferencedVariables(const Function& _func, List<Operand>& _outVarInstr, const GlobalInterfaceVersion _version, IAllocator* _pAllocator);
+	// get all the global OpVariables with StorageClass != Function used in this function, optionally returns the functions called directly or indirectly
+	void collectReferencedVariables(const Function& _func, List<Operand>& _outVarInstr, const GlobalInterfaceVersion _version, IAllocator* _pAllocator, List<const Function*>* _pOutCallees = nullptr);
 } // !spvgentwo
\ No newline at end of file
@@ -25,7 +25,7 @@ namespace spvgentwo
 	public:
 
 		constexpr HashMap() = default;
-		HashMap(IAllocator* _pAllocator, unsigned int _buckets = DefaultBucktCount, HashFunc _func = hash<Key>);
+		HashMap(IAllocator* _pAllocator, unsigned int _buckets = DefaultBucktCount, HashFunc _func = hashKey<Key>);
 		HashMap(HashMap&& _other) noexcept;
 
 		// computes bucket size as sizeof..(_keyvals) * 2 + 1 (number of nodes constructed from args passed)
@@ -46,6 +46,10 @@ namespace spvgentwo
 		template <class ... Args>
 		Node& emplaceUnique(const Key& _key, Args&& ... _args);
 
+		// insert without hashing _key, _hash must have been computed by the same HashFunc (e.g. Node::getHash() of another map)
+		template <class KeyT, class ... Args>
+		Node& emplaceWithHash(const Hash64 _hash, KeyT&& _key, Args&& ... _args);
+
 		// retuns nullptr if not resident
 		Value* get(const Hash64 _hash) const;
 
@@ -373,6 +377,22 @@ namespace spvgentwo
 		return n;
 	}
 
+	template<class Key, class Value>
+	template<class KeyT, class ...Args>
+	inline typename HashMap<Key, Value>::Node& HashMap<Key, Value>::emplaceWithHash(const Hash64 _hash, KeyT&& _key, Args&& ..._args)
+	{
+		Entry<Node>* pNode = Entry<Node>::create(m_pAllocator, stdrep::forward<KeyT>(_key), stdrep::forward<Args>(_args)...);
+
+		Node& n = pNode->inner();
+		n.hash = _hash;
+
+		m_pBuckets[_hash % m_Buckets].append_entry(pNode);
+
+		++m_Elements;
+
+		return n;
+	}
+
 	template<class Key, class Value>
 	template<class ...Args>
 	inline void HashMap<Key, Value>::emplaceArgs(Key&& _key, Value&& _value, Args && ..._keyvals)
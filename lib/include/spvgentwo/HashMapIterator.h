@@ -1,7 +1,7 @@
 #pragma once
 
 #include "List.h"
-#include "FNV1aHasher.h"
+#include "WordHasher.h"
 
 namespace spvgentwo
 {
@@ -25,6 +25,8 @@ namespace spvgentwo
 			Value value{};
 		} kv;
 
+		constexpr Hash64 getHash() const { return hash; }
+
 	private:
 		Hash64 hash{0u};
 	};
@@ -42,6 +44,7 @@ namespace spvgentwo
 
 		constexpr HashMapIterator(Bucket* _pBucket = nullptr, Bucket* _pEnd = nullptr, typename Bucket::Iterator _element = nullptr) : m_element(_element), m_pBucket(_pBucket), m_pEnd(_pEnd){}
 		constexpr HashMapIterator(const HashMapIterator& _other) : m_element(_other.m_element), m_pBucket(_other.m_pBucket), m_pEnd(_other.m_pEnd) {}
+		constexpr HashMapIterator& operator=(const HashMapIterator& _other) = default;
 
 		constexpr bool operator==(const HashMapIterator& _other) const;
 		constexpr bool operator!=(const HashMapIterator& _other) const;
@@ -777,6 +777,15 @@ namespace spvgentwo
 		template <class T, class ...Args>
 		void makeOpInternal(T&& first, Args&& ... _args);
 
+		// makeOp without validateOperands and reuseValue, for instructions whose remaining operands are added afterwards (dynamic ops).
+		// a partial instruction must not be folded or numbered, the caller validates and calls reuseValue after the last operand
+		template <class ...Args>
+		void initOp(const spv::Op _op, Args&& ... _args);
+
+		// returns this, the constant this instruction folds to (see Module::setConstantFolder) or an equivalent instruction of the parent BasicBlock (see BasicBlock::setValueNumbering).
+		// this is destroyed if another instruction is returned
+		Instruction* reuseValue();
+
 		// generic base case with image operands
 		template <class ...ImageOperands>
 		Instruction* genericImageOp(const spv::Op _imageOp, Instruction* _pTargetImage, Instruction* _pCoordinate, Instruction* _pDrefOrCompnent, const Flag<spv::ImageOperandsMask> _imageOperands, ImageOperands... _operands);
@@ -32,6 +32,16 @@ namespace spvgentwo
 
 	template<class ...Args>
 	inline Instruction* Instruction::makeOp(const spv::Op _op, Args&& ..._args)
+	{
+		initOp(_op, stdrep::forward<Args>(_args)...);
+
+		validateOperands();
+
+		return reuseValue();
+	}
+
+	template<class ...Args>
+	inline void Instruction::initOp(const spv::Op _op, Args&& ..._args)
 	{
 		reset();
 
@@ -43,10 +53,6 @@ namespace spvgentwo
 		}
 
 		inferResultTypeOperand();
-
-		validateOperands();
-
-		return this;
 	}
 	
 	template<class T>
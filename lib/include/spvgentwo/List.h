@@ -66,7 +66,7 @@ namespace spvgentwo
 		template<class ...Args>
 		Entry<T>* insert_after(Iterator _pos, Args&& ..._args);
 
-		// removes element at pos from list, returns next element
+		// removes element at pos from list, returns next element. If _destruct is false, the entry is only unlinked (owned by the caller)
 		Entry<T>* erase(Iterator _pos, const bool _destruct = true);
 
 		T pop_back();
@@ -10,6 +10,17 @@ namespace spvgentwo
 {
 	// forward delcs:
 	class ITypeInferenceAndVailation;
+	class IConstantFolder;
+
+	// order in which assignIDs numbers result ids, all orders compact ids to [1, bound)
+	enum class IdOrder
+	{
+		Serialization, // ids increase in the order instructions are written
+		Frequency, // most referenced instructions get the smallest ids (small ids are cheaper for varint encoders)
+		FirstUse, // function by function, operands are numbered on their first use, remaining globals last
+		Stable // valid ids are kept, only new instructions are numbered starting at the bound (ids of removed instructions are not reused).
+		// finalize only recollects the interfaces of entry points whose call tree contains a dirty function (see Function::isDirty)
+	};
 
 	class Module
 	{
@@ -30,6 +41,26 @@ namespace spvgentwo
 		// reset module to its initial / empty state - clear all functions and instructions etc (invalidate all pointers)
 		void reset();
 
+		// deep copy of all sections, functions, basic blocks, names and type & constant lookup maps, result ids are preserved
+		// Instruction and BasicBlock operands are remapped to the cloned instructions, uses this modules allocator if _pAllocator is nullptr
+		// _shareFunctionBodies: basic blocks of the clone share their instructions with this module until they are modified (copy on write),
+		// requires valid result ids (finalized or read module), otherwise a deep copy is made. Types and constants are always copied.
+		// this module must outlive the clone and must not be modified while it is shared, call unshareAll() on the clone before destroying or changing this module
+		Module clone(IAllocator* _pAllocator = nullptr, bool _shareFunctionBodies = false) const;
+
+		// true if any function of this module shares basic blocks with the module it was cloned from
+		bool hasSharedFunctions() const;
+
+		// copy shared instructions of _func to this module, returns true on success
+		bool unshare(Function& _func);
+
+		// unshare the function owning _pSharedInstr, returns the private copy of _pSharedInstr or nullptr if it is not shared with this module
+		Instruction* unshare(const Instruction* _pSharedInstr);
+
+		// unshare all functions and entry points. passes that rewrite instructions in place, clone them or remove the types and constants
+		// they reference call this first, shared instructions reference the module they were cloned from by id. returns false if any unshare failed
+		bool unshareAll();
+
 		unsigned int getSpvVersion() const { return m_spvVersion; }
 		void setSpvVersion(unsigned int _version) { m_spvVersion = _version; }
 		void setSpvVersion(unsigned char _major, unsigned char _minor) { m_spvVersion = makeVersion(_major, _minor); }
@@ -61,6 +92,10 @@ namespace spvgentwo
 		ITypeInferenceAndVailation* getTypeInferenceAndVailation() const { return m_pTypeInferenceAndVailation; }
 		void setITypeInferenceAndVailation(ITypeInferenceAndVailation* _pTypeInferenceAndVailation) { m_pTypeInferenceAndVailation = _pTypeInferenceAndVailation; }
 
+		// optional, pure instructions of basic blocks with constant operands are replaced by their result constant (see IConstantFolder::fold)
+		IConstantFolder* getConstantFolder() const { return m_pConstantFolder; }
+		void setConstantFolder(IConstantFolder* _pConstantFolder) { m_pConstantFolder = _pConstantFolder; }
+
 		const List<Function>& getFunctions() const { return m_Functions; }
 		List<Function>& getFunctions() { return m_Functions; }
 
@@ -193,7 +228,8 @@ namespace spvgentwo
 		// adds missing OpCapabilities if _pGrammar != nullptr
 		// adds missing OpExtensions if _pGrammar != nullptr
 		// sets minimum required version if _pGrammar != nullptr
-		spv::Id assignIDs(const Grammar* _pGrammar = nullptr);
+		// valid IDs are kept if the module has shared functions (see clone) or _order is IdOrder::Stable, _order is ignored in that case
+		spv::Id assignIDs(const Grammar* _pGrammar = nullptr, IdOrder _order = IdOrder::Serialization);
 
 		// converts any spv::Id operand to Instruction pointer operands
 		// resets resultId to InvalidId for new assignment
@@ -214,14 +250,15 @@ namespace spvgentwo
 		// call this function before any call to module.write()!
 		// calls finalizeGlobalInterface() on EntryPoints
 		// automatically assigns IDs (calls assignIDs, adds Required Capabilities & Extensions & Version if _pGrammar != nullptr)
-		spv::Id finalize( const Grammar* _pGrammar = nullptr );
+		spv::Id finalize( const Grammar* _pGrammar = nullptr, IdOrder _order = IdOrder::Serialization );
 
 		// calls finalize()
 		// serializes module to IWriter
-		bool finalizeAndWrite(IWriter& _writer, const Grammar* _pGrammar = nullptr);
+		bool finalizeAndWrite(IWriter& _writer, const Grammar* _pGrammar = nullptr, IdOrder _order = IdOrder::Serialization);
 
 		// calls finalizeGlobalInterface() on all EntryPoints, adds referenced global variables to OpEntryPoint parameters
-		void finalizeEntryPoints();
+		// _incremental skips entry points with a clean call tree (see EntryPoint::isGlobalInterfaceDirty), clears the dirty flags of all functions
+		void finalizeEntryPoints(bool _incremental = false);
 
 		// parse a binary SPIR-V program from IReader using _grammer generated from SPIR-V machinereadable grammer json
 		bool read(IReader& _reader, const Grammar& _grammar);
@@ -255,6 +292,9 @@ namespace spvgentwo
 		// for use with opDecoration, opMemberDecoration etc
 		Instruction* addDecorationInstr();
 
+		// duplicate decorations targeting a key of _copies for the mapped instruction, e.g. after cloning instructions of a function
+		void copyDecorations(const HashMap<const Instruction*, Instruction*>& _copies);
+
 		// creates new empty type using this modules allocator
 		Type newType() const;
 
@@ -347,6 +387,9 @@ namespace spvgentwo
 		// remove _pInstr from type/constant and name lookup maps
 		void removeFromLookupMaps(const Instruction* _pInstr);
 
+		// remove all _instrs from type/constant and name lookup maps, instructions sharing a spec constant are resolved in a single pass
+		void removeFromLookupMaps(const List<const Instruction*>& _instrs);
+
 		// remove _pInstr if it is homed in this module, its functions and basic blocks, returns true if it was removed
 		bool remove(const Instruction* _pInstr);
 
@@ -399,14 +442,25 @@ namespace spvgentwo
 	private:
 		void updateParentPointers();
 
+		// instructions with a valid result id indexed by id, instructions of shared basic blocks are skipped
+		void getInstructionsById(Vector<Instruction*>& _outInstructions);
+
+		// assigns new result ids to all instructions in _order, returns max id
+		spv::Id reorderIDs(IdOrder _order);
+
+		// unshare all functions using _pInstr (matched by result id), returns the private copy of _pInstr if it was shared
+		const Instruction* unshareUses(const Instruction* _pInstr);
+
 	private:
 		IAllocator* m_pAllocator = nullptr;
 		ILogger* m_pLogger = nullptr;
 		ITypeInferenceAndVailation* m_pTypeInferenceAndVailation = nullptr;
+		IConstantFolder* m_pConstantFolder = nullptr;
 		unsigned int m_spvVersion = spv::Version;
 		unsigned int m_spvGenerator = GeneratorId;
 		unsigned int m_spvBound = 0u;
 		unsigned int m_spvSchema = 0u;
+		unsigned int m_sharedFunctions = 0u; // functions and entry points cloned with shared bodies and not unshared yet, removed ones are not subtracted
 		List<Function> m_Functions;
 		List<EntryPoint> m_EntryPoints;
 
@@ -88,6 +88,117 @@ namespace spvgentwo
 		}
 	}
 
+	// side-effect free instructions whose result only depends on their operands (value semantics, no memory access, no derivatives or images),
+	// taken from the grammar instruction classes Arithmetic, Bit, Relational_and_Logical, Conversion (excluding pointer conversions) and Composite
+	constexpr bool isPureOp(spv::Op _instr)
+	{
+		switch (_instr)
+		{
+		// Arithmetic
+		case spv::Op::OpSNegate:
+		case spv::Op::OpFNegate:
+		case spv::Op::OpIAdd:
+		case spv::Op::OpFAdd:
+		case spv::Op::OpISub:
+		case spv::Op::OpFSub:
+		case spv::Op::OpIMul:
+		case spv::Op::OpFMul:
+		case spv::Op::OpUDiv:
+		case spv::Op::OpSDiv:
+		case spv::Op::OpFDiv:
+		case spv::Op::OpUMod:
+		case spv::Op::OpSRem:
+		case spv::Op::OpSMod:
+		case spv::Op::OpFRem:
+		case spv::Op::OpFMod:
+		case spv::Op::OpVectorTimesScalar:
+		case spv::Op::OpMatrixTimesScalar:
+		case spv::Op::OpVectorTimesMatrix:
+		case spv::Op::OpMatrixTimesVector:
+		case spv::Op::OpMatrixTimesMatrix:
+		case spv::Op::OpOuterProduct:
+		case spv::Op::OpDot:
+		case spv::Op::OpIAddCarry:
+		case spv::Op::OpISubBorrow:
+		case spv::Op::OpUMulExtended:
+		case spv::Op::OpSMulExtended:
+		// Bit
+		case spv::Op::OpShiftRightLogical:
+		case spv::Op::OpShiftRightArithmetic:
+		case spv::Op::OpShiftLeftLogical:
+		case spv::Op::OpBitwiseOr:
+		case spv::Op::OpBitwiseXor:
+		case spv::Op::OpBitwiseAnd:
+		case spv::Op::OpNot:
+		case spv::Op::OpBitFieldInsert:
+		case spv::Op::OpBitFieldSExtract:
+		case spv::Op::OpBitFieldUExtract:
+		case spv::Op::OpBitReverse:
+		case spv::Op::OpBitCount:
+		// Relational_and_Logical
+		case spv::Op::OpAny:
+		case spv::Op::OpAll:
+		case spv::Op::OpIsNan:
+		case spv::Op::OpIsInf:
+		case spv::Op::OpIsFinite:
+		case spv::Op::OpIsNormal:
+		case spv::Op::OpSignBitSet:
+		case spv::Op::OpLessOrGreater:
+		case spv::Op::OpOrdered:
+		case spv::Op::OpUnordered:
+		case spv::Op::OpLogicalEqual:
+		case spv::Op::OpLogicalNotEqual:
+		case spv::Op::OpLogicalOr:
+		case spv::Op::OpLogicalAnd:
+		case spv::Op::OpLogicalNot:
+		case spv::Op::OpSelect:
+		case spv::Op::OpIEqual:
+		case spv::Op::OpINotEqual:
+		case spv::Op::OpUGreaterThan:
+		case spv::Op::OpSGreaterThan:
+		case spv::Op::OpUGreaterThanEqual:
+		case spv::Op::OpSGreaterThanEqual:
+		case spv::Op::OpULessThan:
+		case spv::Op::OpSLessThan:
+		case spv::Op::OpULessThanEqual:
+		case spv::Op::OpSLessThanEqual:
+		case spv::Op::OpFOrdEqual:
+		case spv::Op::OpFUnordEqual:
+		case spv::Op::OpFOrdNotEqual:
+		case spv::Op::OpFUnordNotEqual:
+		case spv::Op::OpFOrdLessThan:
+		case spv::Op::OpFUnordLessThan:
+		case spv::Op::OpFOrdGreaterThan:
+		case spv::Op::OpFUnordGreaterThan:
+		case spv::Op::OpFOrdLessThanEqual:
+		case spv::Op::OpFUnordLessThanEqual:
+		case spv::Op::OpFOrdGreaterThanEqual:
+		case spv::Op::OpFUnordGreaterThanEqual:
+		// Conversion
+		case spv::Op::OpConvertFToU:
+		case spv::Op::OpConvertFToS:
+		case spv::Op::OpConvertSToF:
+		case spv::Op::OpConvertUToF:
+		case spv::Op::OpUConvert:
+		case spv::Op::OpSConvert:
+		case spv::Op::OpFConvert:
+		case spv::Op::OpQuantizeToF16:
+		case spv::Op::OpBitcast:
+		// Composite
+		case spv::Op::OpVectorExtractDynamic:
+		case spv::Op::OpVectorInsertDynamic:
+		case spv::Op::OpVectorShuffle:
+		case spv::Op::OpCompositeConstruct:
+		case spv::Op::OpCompositeExtract:
+		case spv::Op::OpCompositeInsert:
+		case spv::Op::OpCopyObject:
+		case spv::Op::OpTranspose:
+			return true;
+		default:
+			return false;
+		}
+	}
+
 	// Instructions that start "OpConstant" or "OpSpec"
 	constexpr bool isSpecOrConstantOp(spv::Op _instr)
 	{
@@ -243,6 +354,11 @@ namespace spvgentwo
 	{
 		return (_word & 0x000000FFu) == 0u || (_word & 0x0000FF00) == 0u || (_word & 0x00FF0000) == 0u || (_word & 0xFF000000) == 0u;
 	}
+
+	constexpr unsigned int byteSwap(unsigned int _word)
+	{
+		return (_word << 24u) | ((_word << 8u) & 0x00FF0000u) | ((_word >> 8u) & 0x0000FF00u) | (_word >> 24u);
+	}
 	
 	struct BaseCapability
 	{
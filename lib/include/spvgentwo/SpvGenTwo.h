@@ -20,6 +20,7 @@
 #include "Writer.h"
 #include "Reader.h"
 #include "TypeInferenceAndValiation.h"
+#include "ConstantFolder.h"
 #include "TypeAlias.h"
 
 // extensions
@@ -1,7 +1,7 @@
 #pragma once
 
 #include "Vector.h"
-#include "FNV1aHasher.h"
+#include "WordHasher.h"
 
 namespace spvgentwo
 {
@@ -100,6 +100,18 @@ namespace spvgentwo
 			h.add(_str.data(), _str.size());
 			return h;
 		}
+
+		template <class H> // FNV1aHasher or WordHasher
+		Hash64 operator()(const String& _str, H& _hasher) const noexcept
+		{
+			return _hasher.add(_str.data(), _str.size());
+		}
+	};
+
+	template <>
+	struct KeyHasher<String>
+	{
+		using Algorithm = WordHasher;
 	};
 
 	template<class Arg>
@@ -2,7 +2,7 @@
 
 #include "List.h"
 #include "SpvDefines.h"
-#include "FNV1aHasher.h"
+#include "WordHasher.h"
 
 namespace spvgentwo
 {
@@ -86,6 +86,8 @@ namespace spvgentwo
 
 		Type(Type&& _other) noexcept;
 		Type(const Type& _other);
+		// deep copy of _other, sub types are allocated from _pAllocator
+		Type(const Type& _other, IAllocator* _pAllocator);
 		~Type();
 
 		Type& operator=(Type&& _other) noexcept;
@@ -656,7 +658,8 @@ namespace spvgentwo
 			return operator()(_type, h);
 		}
 
-		constexpr Hash64 operator()(const Type& _type, FNV1aHasher& _hasher) const
+		template <class H> // FNV1aHasher or WordHasher
+		constexpr Hash64 operator()(const Type& _type, H& _hasher) const
 		{
 			_hasher << _type.getType();
 			_hasher << _type.getIntWidth(); // image depth, float width
@@ -673,10 +676,16 @@ namespace spvgentwo
 				operator()(sub, _hasher); // go deeper
 			}
 
-			return _hasher;
+			return _hasher.get();
 		}
 	};
 
+	template <>
+	struct KeyHasher<Type>
+	{
+		using Algorithm = WordHasher;
+	};
+
 	template<class ...Indices>
 	inline List<Type>::Iterator Type::getSubType(unsigned int _i, Indices ..._indices) const
 	{
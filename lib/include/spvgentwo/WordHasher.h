@@ -0,0 +1,255 @@
+#pragma once
+#include "FNV1aHasher.h"
+
+namespace spvgentwo
+{
+	namespace detail
+	{
+		// xxHash64 primes
+		constexpr sgt_uint64_t WordPrime1 = 0x9e3779b185ebca87ull;
+		constexpr sgt_uint64_t WordPrime2 = 0xc2b2ae3d27d4eb4full;
+		constexpr sgt_uint64_t WordPrime3 = 0x165667b19e3779f9ull;
+		constexpr sgt_uint64_t WordPrime4 = 0x85ebca77c2b2ae63ull;
+		constexpr sgt_uint64_t WordPrime5 = 0x27d4eb2f165667c5ull;
+
+		constexpr sgt_uint64_t rotl(sgt_uint64_t _x, unsigned int _r) { return (_x << _r) | (_x >> (64u - _r)); }
+	}
+
+	// 64 bit hash mixing 8 bytes at a time in the style of xxHash64, input is buffered so small fields are packed into one word.
+	// same interface and Hasher<T> customization point as FNV1aHasher: Hasher<T> specializations providing
+	// 'template <class H> Hash64 operator()(const T&, H& _hasher)' stream into the WordHasher directly,
+	// specializations only providing 'Hash64 operator()(const T&, Hash64 _seed)' are hashed separately and the result is mixed in.
+	// hashes are not compatible with FNV1aHasher and depend on the byte order of the host
+	class WordHasher
+	{
+		template <class T>
+		constexpr void addOrDefault(const T& _data)
+		{
+			if constexpr (traits::is_complete_v<Hasher<T>>) // check if specialization exists
+			{
+				if constexpr (traits::is_invocable_v<Hasher<T>, const T&, WordHasher&>)
+				{
+					Hasher<T> h{};
+					h(_data, *this);
+				}
+				else
+				{
+					Hasher<T> h{};
+					addWord(h(_data, detail::Offset));
+				}
+			}
+			else if constexpr (sizeof(T) <= sizeof(sgt_uint64_t)) // scalars, enums, pointers
+			{
+				const void* pErased = &_data; // avoid reinterpret_cast in constexpr
+				addSmall(load<sizeof(T)>(static_cast<const unsigned char*>(pErased)), sizeof(T));
+			}
+			else // resort for default impl
+			{
+				const void* pErased = &_data;
+				addBytes(static_cast<const unsigned char*>(pErased), sizeof(_data));
+			}
+		}
+
+	public:
+		constexpr explicit WordHasher(Hash64 _seed = detail::Offset) : m_acc(_seed.value + detail::WordPrime5) {}
+
+		constexpr Hash64 add(const void* _pData, const sgt_size_t _length);
+
+		// finalized hash of all input so far, the hasher can still be fed afterwards
+		constexpr Hash64 get() const;
+
+		constexpr Hash64 operator()(const char* _str);
+
+		template <class T>
+		constexpr Hash64 operator()(const T& _data) { addOrDefault(_data); return get(); }
+
+		template <class T, class ...Tail>
+		constexpr Hash64 operator()(const T& _data, const Tail&... _tail);
+
+		constexpr WordHasher& operator<<(const char* _pStr) { operator()(_pStr); return *this; }
+
+		template <class T>
+		constexpr WordHasher& operator<<(const T& _data) { addOrDefault(_data); return *this; }
+
+		template <class T>
+		constexpr WordHasher& operator<<(const T* _ptr) { addOrDefault(_ptr); return *this; }
+
+	private:
+		template <class Byte>
+		constexpr void addBytes(const Byte* _pBytes, sgt_size_t _length);
+
+		// little endian word of _count <= 8 bytes
+		template <class Byte>
+		static constexpr sgt_uint64_t load(const Byte* _pBytes, unsigned int _count);
+
+		// unrolled so compilers fold it to a single load on little endian hosts
+		template <unsigned int Count, class Byte>
+		static constexpr sgt_uint64_t load(const Byte* _pBytes);
+
+		// append the _count low bytes of _bits
+		constexpr void addSmall(sgt_uint64_t _bits, unsigned int _count);
+
+		constexpr void addWord(sgt_uint64_t _word) { addSmall(_word, 8u); }
+
+		constexpr void mix(sgt_uint64_t _word);
+
+	private:
+		sgt_uint64_t m_acc = 0u;
+		sgt_uint64_t m_pending = 0u; // bytes not mixed yet, little endian
+		unsigned int m_pendingBytes = 0u;
+		sgt_uint64_t m_length = 0u;
+	};
+
+	inline constexpr void WordHasher::mix(sgt_uint64_t _word)
+	{
+		_word *= detail::WordPrime2;
+		_word = detail::rotl(_word, 31u);
+		_word *= detail::WordPrime1;
+
+		m_acc ^= _word;
+		m_acc = detail::rotl(m_acc, 27u) * detail::WordPrime1 + detail::WordPrime4;
+	}
+
+	template <class Byte>
+	inline constexpr sgt_uint64_t WordHasher::load(const Byte* _pBytes, unsigned int _count)
+	{
+		sgt_uint64_t word = 0u;
+		for (unsigned int i = 0u; i < _count; ++i)
+		{
+			word |= static_cast<sgt_uint64_t>(static_cast<unsigned char>(_pBytes[i])) << (8u * i);
+		}
+		return word;
+	}
+
+	template <unsigned int Count, class Byte>
+	inline constexpr sgt_uint64_t WordHasher::load(const Byte* _pBytes)
+	{
+		const sgt_uint64_t byte = static_cast<unsigned char>(_pBytes[Count - 1u]);
+
+		if constexpr (Count > 1u)
+		{
+			return load<Count - 1u>(_pBytes) | byte << (8u * (Count - 1u));
+		}
+		else
+		{
+			return byte;
+		}
+	}
+
+	inline constexpr void WordHasher::addSmall(sgt_uint64_t _bits, unsigned int _count)
+	{
+		m_length += _count;
+		m_pending |= _bits << (8u * m_pendingBytes);
+
+		const unsigned int total = m_pendingBytes + _count;
+		if (total < 8u)
+		{
+			m_pendingBytes = total;
+			return;
+		}
+
+		mix(m_pending);
+
+		const unsigned int consumed = 8u - m_pendingBytes;
+		m_pending = consumed < 8u ? _bits >> (8u * consumed) : 0u;
+		m_pendingBytes = total - 8u;
+	}
+
+	template <class Byte>
+	inline constexpr void WordHasher::addBytes(const Byte* _pBytes, sgt_size_t _length)
+	{
+		sgt_size_t i = 0u;
+
+		if (m_pendingBytes == 0u)
+		{
+			for (; i + 8u <= _length; i += 8u)
+			{
+				mix(load<8u>(_pBytes + i));
+			}
+			m_length += i;
+		}
+		else
+		{
+			for (; i + 8u <= _length; i += 8u)
+			{
+				addSmall(load<8u>(_pBytes + i), 8u);
+			}
+		}
+
+		if (i < _length)
+		{
+			addSmall(load(_pBytes + i, static_cast<unsigned int>(_length - i)), static_cast<unsigned int>(_length - i));
+		}
+	}
+
+	inline constexpr Hash64 WordHasher::add(const void* _pData, const sgt_size_t _length)
+	{
+		addBytes(static_cast<const unsigned char*>(_pData), _length);
+		return get();
+	}
+
+	inline constexpr Hash64 WordHasher::get() const
+	{
+		sgt_uint64_t h = m_acc;
+
+		if (m_pendingBytes != 0u)
+		{
+			h ^= detail::rotl(m_pending * detail::WordPrime5, 11u) * detail::WordPrime1;
+			h = detail::rotl(h, 23u) * detail::WordPrime2 + detail::WordPrime3;
+		}
+
+		h ^= m_length;
+
+		// avalanche
+		h ^= h >> 33u;
+		h *= detail::WordPrime2;
+		h ^= h >> 29u;
+		h *= detail::WordPrime3;
+		h ^= h >> 32u;
+
+		return h;
+	}
+
+	inline constexpr Hash64 WordHasher::operator()(const char* _pStr)
+	{
+		sgt_size_t length = 0u;
+		for (; _pStr[length] != 0; ++length) {}
+
+		addBytes(_pStr, length);
+		return get();
+	}
+
+	template<class T, class ...Tail>
+	inline constexpr Hash64 WordHasher::operator()(const T& _data, const Tail& ..._tail)
+	{
+		operator()(_data);
+
+		if constexpr (sizeof...(_tail) > 0)
+		{
+			operator()(_tail...);
+		}
+
+		return get();
+	}
+
+	// hash algorithm used by HashMap for Key by default, specialize to select WordHasher (or another hasher with the same interface)
+	template <class Key>
+	struct KeyHasher
+	{
+		using Algorithm = FNV1aHasher;
+	};
+
+	// pointers are hashed by address, one word
+	template <class T>
+	struct KeyHasher<T*>
+	{
+		using Algorithm = WordHasher;
+	};
+
+	template <class Key>
+	inline constexpr Hash64 hashKey(const Key& _key)
+	{
+		typename KeyHasher<Key>::Algorithm h{};
+		return h(_key);
+	}
+} // !spvgentwo
@@ -2,6 +2,7 @@
 #include "spvgentwo/Function.h"
 #include "spvgentwo/Module.h"
 #include "spvgentwo/Reader.h"
+#include "spvgentwo/WordHasher.h"
 
 #include "spvgentwo/InstructionTemplate.inl"
 #include "spvgentwo/ModuleTemplate.inl"
@@ -22,34 +23,71 @@ spvgentwo::BasicBlock::BasicBlock(Function* _pFunction, const char* _pName) : Li
 spvgentwo::BasicBlock::BasicBlock(Function* _pFunction, BasicBlock&& _other) noexcept :
 	List(stdrep::move(_other)),
 	m_pFunction(_pFunction),
-	m_Label(this, spv::Op::OpNop)
+	m_Label(this, spv::Op::OpNop),
+	m_shared(_other.m_shared),
+	m_valueNumbering(_other.m_valueNumbering),
+	m_values(stdrep::move(_other.m_values)),
+	m_pLastValue(_other.m_pLastValue)
 {
 	m_Label.opLabel();
+	_other.m_shared = false;
+	_other.m_valueNumbering = false;
+	_other.m_pLastValue = nullptr;
 
-	for (Instruction& instr : *this)
+	// shared instructions keep pointing to the block that owns them
+	if (m_shared == false)
 	{
-		instr.m_parent.pBasicBlock = this;
+		for (Instruction& instr : *this)
+		{
+			instr.m_parent.pBasicBlock = this;
+		}
 	}
 }
 
 spvgentwo::BasicBlock::~BasicBlock()
 {
+	detachShared();
 }
 
 spvgentwo::BasicBlock& spvgentwo::BasicBlock::operator=(BasicBlock&& _other) noexcept
 {
 	if (this == &_other) return *this;
 
+	detachShared();
+
 	List::operator=(stdrep::move(_other));
 
-	for (Instruction& instr : *this)
+	m_shared = _other.m_shared;
+	_other.m_shared = false;
+
+	m_valueNumbering = _other.m_valueNumbering;
+	m_values = stdrep::move(_other.m_values);
+	m_pLastValue = _other.m_pLastValue;
+	_other.m_valueNumbering = false;
+	_other.m_pLastValue = nullptr;
+
+	if (m_shared == false)
 	{
-		instr.m_parent.pBasicBlock = this;
+		for (Instruction& instr : *this)
+		{
+			instr.m_parent.pBasicBlock = this;
+		}
 	}
 
 	return *this;
 }
 
+void spvgentwo::BasicBlock::detachShared()
+{
+	if (m_shared)
+	{
+		m_pBegin = nullptr;
+		m_pLast = nullptr;
+		m_Elements = 0u;
+		m_shared = false;
+	}
+}
+
 spvgentwo::Module* spvgentwo::BasicBlock::getModule() const
 {
 	return m_pFunction->getModule();
@@ -77,9 +115,119 @@ spvgentwo::Instruction* spvgentwo::BasicBlock::getTerminator() const
 
 spvgentwo::Instruction* spvgentwo::BasicBlock::addInstruction()
 {
+	if (m_shared)
+	{
+		m_pFunction->unshare();
+	}
+
+	m_pLastValue = nullptr;
+	m_pFunction->setDirty();
+
 	return &emplace_back(this, spv::Op::OpNop);
 }
 
+void spvgentwo::BasicBlock::setValueNumbering(bool _enable)
+{
+	if (_enable && m_valueNumbering == false)
+	{
+		m_values = HashMap<Hash64, Instruction*>(getAllocator());
+	}
+	else if (_enable == false)
+	{
+		m_values.clear();
+		m_pLastValue = nullptr;
+	}
+
+	m_valueNumbering = _enable;
+}
+
+namespace
+{
+	using namespace spvgentwo;
+
+	// result ids are not part of the value
+	Hash64 hashValue(const Instruction& _instr)
+	{
+		WordHasher hasher;
+		hasher << _instr.getOperation();
+
+		for (const Operand& op : _instr)
+		{
+			switch (op.type)
+			{
+			case Operand::Type::Instruction:
+				hasher << op.instruction;
+				break;
+			case Operand::Type::BranchTarget:
+				hasher << op.branchTarget;
+				break;
+			case Operand::Type::Literal:
+				hasher << op.literal.value;
+				break;
+			case Operand::Type::Id:
+				break;
+			}
+		}
+
+		return hasher.get();
+	}
+
+	bool sameValue(const Instruction& _left, const Instruction& _right)
+	{
+		if (_left.getOperation() != _right.getOperation() || _left.size() != _right.size())
+		{
+			return false;
+		}
+
+		for (auto l = _left.begin(), r = _right.begin(), end = _left.end(); l != end; ++l, ++r)
+		{
+			if (l->type != r->type || (l->isId() == false && (*l == *r) == false))
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+}
+
+spvgentwo::Instruction* spvgentwo::BasicBlock::numberValue(Instruction* _pInstr)
+{
+	// only the instruction that was just added can be rolled back
+	if (m_valueNumbering == false || empty() || &back() != _pInstr)
+	{
+		return _pInstr;
+	}
+
+	const Hash64 hash = hashValue(*_pInstr);
+
+	for (auto& node : m_values.getRange(hash))
+	{
+		Instruction* pExisting = node.kv.value;
+		if (pExisting != _pInstr && sameValue(*pExisting, *_pInstr))
+		{
+			return rollback(_pInstr, pExisting);
+		}
+	}
+
+	m_values.emplace(hash, _pInstr);
+
+	return _pInstr;
+}
+
+spvgentwo::Instruction* spvgentwo::BasicBlock::rollback(Instruction* _pInstr, Instruction* _pValue)
+{
+	if (empty() || &back() != _pInstr)
+	{
+		return _pInstr;
+	}
+
+	erase(last()); // destroys _pInstr
+	m_pLastValue = _pValue;
+
+	return _pValue;
+}
+
 bool spvgentwo::BasicBlock::getBranchTargets(List<BasicBlock*>& _outTargetBlocks) const
 {
 	if (empty() == false) // there is more then just initial opLabel
@@ -154,13 +302,38 @@ bool spvgentwo::BasicBlock::read(IReader& _reader, const Grammar& _grammar)
 
 bool spvgentwo::BasicBlock::remove(const Instruction* _pInstr)
 {
+	if (m_shared && _pInstr != nullptr && _pInstr->getBasicBlock() != this)
+	{
+		// _pInstr might be owned by the block this one was cloned from, remove its private copy instead
+		_pInstr = getModule()->unshare(_pInstr);
+	}
+
 	if(_pInstr != nullptr && this == _pInstr->getBasicBlock())
 	{
+		if (m_valueNumbering)
+		{
+			// instructions are numbered once, after their last operand was added
+			for (auto it = m_values.begin(); it != m_values.end(); ++it)
+			{
+				if (it->value == _pInstr)
+				{
+					m_values.erase(it);
+					break;
+				}
+			}
+
+			if (m_pLastValue == _pInstr)
+			{
+				m_pLastValue = nullptr;
+			}
+		}
+
 		for(auto it = begin(), e = end(); it != e; ++it)
 		{
 			if(it.operator->() == _pInstr)
 			{
 				erase(it);
+				m_pFunction->setDirty();
 				return true;
 			}
 		}
@@ -169,6 +342,85 @@ bool spvgentwo::BasicBlock::remove(const Instruction* _pInstr)
 	return false;
 }
 
+spvgentwo::BasicBlock* spvgentwo::BasicBlock::split(const Instruction* _pInstr, const char* _pName)
+{
+	if (m_shared && _pInstr != nullptr && _pInstr->getBasicBlock() != this)
+	{
+		// _pInstr might be owned by the block this one was cloned from, split at its private copy instead
+		_pInstr = getModule()->unshare(_pInstr);
+	}
+
+	if (m_shared)
+	{
+		m_pFunction->unshare();
+	}
+
+	auto it = find_if([_pInstr](const Instruction& _instr) { return &_instr == _pInstr; });
+	auto self = m_pFunction->find_if([this](const BasicBlock& _bb) { return &_bb == this; });
+
+	if (it == end() || self == m_pFunction->end())
+	{
+		return nullptr;
+	}
+
+	BasicBlock& tail = m_pFunction->insert_after(self, m_pFunction, _pName)->inner();
+	tail.m_valueNumbering = m_valueNumbering;
+	tail.m_values = HashMap<Hash64, Instruction*>(getAllocator());
+
+	// relink the entries, instructions keep their address
+	for (++it; it != end();)
+	{
+		Entry<Instruction>* entry = it.entry();
+		it = erase(it, false);
+		entry->inner().m_parent.pBasicBlock = &tail;
+		tail.append_entry(entry);
+	}
+
+	m_pLastValue = nullptr;
+	m_pFunction->setDirty();
+
+	// values of the moved instructions are numbered in the tail from now on
+	for (auto v = m_values.begin(); v != m_values.end();)
+	{
+		if (v->value->getBasicBlock() != this)
+		{
+			v = m_values.erase(v);
+		}
+		else
+		{
+			++v;
+		}
+	}
+
+	List<BasicBlock*> successors(getAllocator());
+	tail.getBranchTargets(successors);
+
+	for (BasicBlock* successor : successors)
+	{
+		for (Instruction& instr : *successor)
+		{
+			if (instr != spv::Op::OpPhi)
+			{
+				continue;
+			}
+
+			for (Operand& op : instr)
+			{
+				if (op == this)
+				{
+					op = &tail;
+				}
+				else if (op == getLabel())
+				{
+					op = tail.getLabel();
+				}
+			}
+		}
+	}
+
+	return &tail;
+}
+
 spvgentwo::BasicBlock& spvgentwo::BasicBlock::If(Instruction* _pCondition, BasicBlock& _trueBlock, BasicBlock& _falseBlock, BasicBlock* _pMergeBlock, const Flag<spv::SelectionControlMask> _mask)
 {
 	// this block has not been terminated yet
@@ -16,6 +16,18 @@ spvgentwo::Constant::Constant(const Constant& _other) :
 {
 }
 
+spvgentwo::Constant::Constant(const Constant& _other, IAllocator* _pAllocator) :
+	m_Operation(_other.m_Operation),
+	m_Type(_other.m_Type, _pAllocator),
+	m_Components(_pAllocator),
+	m_literalData(_pAllocator, _other.m_literalData.data(), _other.m_literalData.size())
+{
+	for (const Constant& component : _other.m_Components)
+	{
+		m_Components.emplace_back(component, _pAllocator);
+	}
+}
+
 spvgentwo::Constant::Constant(Constant&& _other) noexcept:
 	m_Operation(stdrep::move(_other.m_Operation)),
 	m_Type(stdrep::move(_other.m_Type)),
@@ -0,0 +1,475 @@
+#include "spvgentwo/ConstantFolder.h"
+#include "spvgentwo/Module.h"
+
+#include "spvgentwo/ModuleTemplate.inl"
+
+using namespace spvgentwo;
+
+namespace
+{
+	template <class To, class From>
+	To bitCast(const From& _from)
+	{
+		static_assert(sizeof(To) == sizeof(From));
+
+		To to{};
+		const char* src = reinterpret_cast<const char*>(&_from);
+		char* dst = reinterpret_cast<char*>(&to);
+		for (sgt_size_t i = 0u; i < sizeof(To); ++i)
+		{
+			dst[i] = src[i];
+		}
+		return to;
+	}
+
+	bool isSupported(const Type& _type)
+	{
+		return _type.isBool() || _type.isInt(32u) || _type.isInt(64u) || _type.isFloat(32u) || _type.isFloat(64u);
+	}
+
+	unsigned int getWidth(const Type& _type)
+	{
+		return _type.isInt() ? _type.getIntWidth() : (_type.isFloat() ? _type.getFloatWidth() : 1u);
+	}
+
+	constexpr sgt_uint64_t mask(unsigned int _width)
+	{
+		return _width >= 64u ? ~0ull : (1ull << _width) - 1ull;
+	}
+
+	constexpr sgt_int64_t minSigned(unsigned int _width)
+	{
+		return _width == 32u ? -2147483647ll - 1ll : -9223372036854775807ll - 1ll;
+	}
+
+	// value of a scalar OpConstant, OpConstantTrue/False or OpConstantNull
+	struct Scalar
+	{
+		const Type* type = nullptr;
+		sgt_uint64_t bits = 0u; // zero extended, 0 or 1 for bool
+
+		sgt_uint64_t u() const { return bits; }
+		sgt_int64_t s() const { return type->getIntWidth() == 32u ? static_cast<sgt_int64_t>(static_cast<sgt_int32_t>(static_cast<unsigned int>(bits))) : static_cast<sgt_int64_t>(bits); }
+		double f() const { return type->getFloatWidth() == 32u ? static_cast<double>(bitCast<float>(static_cast<unsigned int>(bits))) : bitCast<double>(bits); }
+		bool b() const { return bits != 0u; }
+		bool isNaN() const { const double v = f(); return v != v; }
+	};
+
+	bool read(const Constant& _constant, Scalar& _out)
+	{
+		const Type& type = _constant.getType();
+		const Vector<unsigned int>& data = _constant.getData();
+
+		if (isSupported(type) == false)
+		{
+			return false;
+		}
+
+		_out.type = &type;
+		_out.bits = 0u;
+
+		switch (_constant.getOperation())
+		{
+		case spv::Op::OpConstantTrue:
+			_out.bits = 1u;
+			return true;
+		case spv::Op::OpConstantFalse:
+		case spv::Op::OpConstantNull:
+			return true;
+		case spv::Op::OpConstant:
+			if (data.size() < (getWidth(type) == 64u ? 2u : 1u))
+			{
+				return false;
+			}
+			_out.bits = getWidth(type) == 64u ? data[0] | static_cast<sgt_uint64_t>(data[1]) << 32u : data[0];
+			return true;
+		default: // spec constants are not folded
+			return false;
+		}
+	}
+
+	void write(sgt_uint64_t _bits, const Type& _type, Constant& _out)
+	{
+		if (_type.isBool())
+		{
+			_out.make(_bits != 0u);
+			return;
+		}
+
+		_out.setOperation(spv::Op::OpConstant);
+		_out.getType() = _type;
+		_out.getData().emplace_back(static_cast<unsigned int>(_bits));
+
+		if (getWidth(_type) == 64u)
+		{
+			_out.getData().emplace_back(static_cast<unsigned int>(_bits >> 32u));
+		}
+	}
+
+	// 32 bit float ops are evaluated in double precision, rounding the exact double result of +,-,*,/ to float gives the correctly rounded float result
+	sgt_uint64_t toBits(double _value, const Type& _type)
+	{
+		return _type.getFloatWidth() == 32u ? bitCast<unsigned int>(static_cast<float>(_value)) : bitCast<sgt_uint64_t>(_value);
+	}
+
+	template <class Int>
+	sgt_uint64_t intToFloat(Int _value, const Type& _type)
+	{
+		return _type.getFloatWidth() == 32u ? bitCast<unsigned int>(static_cast<float>(_value)) : bitCast<sgt_uint64_t>(static_cast<double>(_value));
+	}
+
+	// _r is only valid for binary ops, returns false if the result is undefined or _op is not supported
+	bool evaluate(spv::Op _op, const Scalar& _l, const Scalar& _r, const Type& _resultType, sgt_uint64_t& _out)
+	{
+		const unsigned int width = getWidth(_resultType);
+
+		switch (_op)
+		{
+		// integer arithmetic wraps around
+		case spv::Op::OpSNegate: _out = 0u - _l.u(); break;
+		case spv::Op::OpIAdd: _out = _l.u() + _r.u(); break;
+		case spv::Op::OpISub: _out = _l.u() - _r.u(); break;
+		case spv::Op::OpIMul: _out = _l.u() * _r.u(); break;
+		case spv::Op::OpUDiv:
+		case spv::Op::OpUMod:
+			if (_r.u() == 0u) return false;
+			_out = _op == spv::Op::OpUDiv ? _l.u() / _r.u() : _l.u() % _r.u();
+			break;
+		case spv::Op::OpSDiv:
+		case spv::Op::OpSRem:
+		case spv::Op::OpSMod:
+		{
+			const sgt_int64_t l = _l.s(), r = _r.s();
+			if (r == 0 || (r == -1 && l == minSigned(getWidth(*_l.type)))) return false;
+
+			sgt_int64_t res = _op == spv::Op::OpSDiv ? l / r : l % r;
+			if (_op == spv::Op::OpSMod && res != 0 && ((res < 0) != (r < 0))) // sign of the divisor
+			{
+				res += r;
+			}
+			_out = static_cast<sgt_uint64_t>(res);
+			break;
+		}
+
+		// bit
+		case spv::Op::OpShiftRightLogical:
+		case spv::Op::OpShiftRightArithmetic:
+		case spv::Op::OpShiftLeftLogical:
+			if (_r.u() >= width) return false;
+			_out = _op == spv::Op::OpShiftRightLogical ? _l.u() >> _r.u() : (_op == spv::Op::OpShiftLeftLogical ? _l.u() << _r.u() : static_cast<sgt_uint64_t>(_l.s() >> _r.u()));
+			break;
+		case spv::Op::OpBitwiseOr: _out = _l.u() | _r.u(); break;
+		case spv::Op::OpBitwiseXor: _out = _l.u() ^ _r.u(); break;
+		case spv::Op::OpBitwiseAnd: _out = _l.u() & _r.u(); break;
+		case spv::Op::OpNot: _out = ~_l.u(); break;
+
+		// integer relational
+		case spv::Op::OpIEqual: _out = _l.u() == _r.u(); break;
+		case spv::Op::OpINotEqual: _out = _l.u() != _r.u(); break;
+		case spv::Op::OpUGreaterThan: _out = _l.u() > _r.u(); break;
+		case spv::Op::OpUGreaterThanEqual: _out = _l.u() >= _r.u(); break;
+		case spv::Op::OpULessThan: _out = _l.u() < _r.u(); break;
+		case spv::Op::OpULessThanEqual: _out = _l.u() <= _r.u(); break;
+		case spv::Op::OpSGreaterThan: _out = _l.s() > _r.s(); break;
+		case spv::Op::OpSGreaterThanEqual: _out = _l.s() >= _r.s(); break;
+		case spv::Op::OpSLessThan: _out = _l.s() < _r.s(); break;
+		case spv::Op::OpSLessThanEqual: _out = _l.s() <= _r.s(); break;
+
+		// float arithmetic
+		case spv::Op::OpFNegate: _out = toBits(-_l.f(), _resultType); break;
+		case spv::Op::OpFAdd: _out = toBits(_l.f() + _r.f(), _resultType); break;
+		case spv::Op::OpFSub: _out = toBits(_l.f() - _r.f(), _resultType); break;
+		case spv::Op::OpFMul: _out = toBits(_l.f() * _r.f(), _resultType); break;
+		case spv::Op::OpFDiv:
+			if (_r.f() == 0.0) return false;
+			_out = toBits(_l.f() / _r.f(), _resultType);
+			break;
+
+		// float relational, ordered compares are false and unordered compares are true if either operand is NaN
+		case spv::Op::OpFOrdEqual: _out = _l.f() == _r.f(); break;
+		case spv::Op::OpFOrdNotEqual: _out = !_l.isNaN() && !_r.isNaN() && _l.f() != _r.f(); break;
+		case spv::Op::OpFOrdLessThan: _out = _l.f() < _r.f(); break;
+		case spv::Op::OpFOrdGreaterThan: _out = _l.f() > _r.f(); break;
+		case spv::Op::OpFOrdLessThanEqual: _out = _l.f() <= _r.f(); break;
+		case spv::Op::OpFOrdGreaterThanEqual: _out = _l.f() >= _r.f(); break;
+		case spv::Op::OpFUnordEqual: _out = !(_l.f() != _r.f()); break;
+		case spv::Op::OpFUnordNotEqual: _out = _l.f() != _r.f(); break;
+		case spv::Op::OpFUnordLessThan: _out = !(_l.f() >= _r.f()); break;
+		case spv::Op::OpFUnordGreaterThan: _out = !(_l.f() <= _r.f()); break;
+		case spv::Op::OpFUnordLessThanEqual: _out = !(_l.f() > _r.f()); break;
+		case spv::Op::OpFUnordGreaterThanEqual: _out = !(_l.f() < _r.f()); break;
+		case spv::Op::OpIsNan: _out = _l.isNaN(); break;
+
+		// logical
+		case spv::Op::OpLogicalEqual: _out = _l.b() == _r.b(); break;
+		case spv::Op::OpLogicalNotEqual: _out = _l.b() != _r.b(); break;
+		case spv::Op::OpLogicalOr: _out = _l.b() || _r.b(); break;
+		case spv::Op::OpLogicalAnd: _out = _l.b() && _r.b(); break;
+		case spv::Op::OpLogicalNot: _out = !_l.b(); break;
+
+		// conversion, out of range float to int conversions are undefined
+		case spv::Op::OpConvertFToU:
+		{
+			const double v = _l.f();
+			if (_l.isNaN() || v <= -1.0 || v >= (width == 32u ? 4294967296.0 : 18446744073709551616.0)) return false;
+			_out = static_cast<sgt_uint64_t>(v);
+			break;
+		}
+		case spv::Op::OpConvertFToS:
+		{
+			const double v = _l.f();
+			if (_l.isNaN() || v < static_cast<double>(minSigned(width)) || v >= -static_cast<double>(minSigned(width))) return false;
+			_out = static_cast<sgt_uint64_t>(static_cast<sgt_int64_t>(v));
+			break;
+		}
+		case spv::Op::OpConvertSToF: _out = intToFloat(_l.s(), _resultType); break;
+		case spv::Op::OpConvertUToF: _out = intToFloat(_l.u(), _resultType); break;
+		case spv::Op::OpUConvert: _out = _l.u(); break;
+		case spv::Op::OpSConvert: _out = static_cast<sgt_uint64_t>(_l.s()); break;
+		case spv::Op::OpFConvert: _out = toBits(_l.f(), _resultType); break;
+		case spv::Op::OpBitcast:
+			if (getWidth(*_l.type) != width) return false;
+			_out = _l.u();
+			break;
+		default:
+			return false;
+		}
+
+		if (_resultType.isBool() == false)
+		{
+			_out &= mask(width);
+		}
+
+		return true;
+	}
+
+	bool isUnary(spv::Op _op)
+	{
+		switch (_op)
+		{
+		case spv::Op::OpSNegate:
+		case spv::Op::OpNot:
+		case spv::Op::OpFNegate:
+		case spv::Op::OpIsNan:
+		case spv::Op::OpLogicalNot:
+		case spv::Op::OpConvertFToU:
+		case spv::Op::OpConvertFToS:
+		case spv::Op::OpConvertSToF:
+		case spv::Op::OpConvertUToF:
+		case spv::Op::OpUConvert:
+		case spv::Op::OpSConvert:
+		case spv::Op::OpFConvert:
+		case spv::Op::OpBitcast:
+			return true;
+		default:
+			return false;
+		}
+	}
+
+	// scalars or component wise for vectors
+	bool evaluate(spv::Op _op, const Constant& _left, const Constant* _pRight, const Type& _resultType, Constant& _out)
+	{
+		if (_resultType.isVector())
+		{
+			const List<Constant>& left = _left.getComponents();
+			if (_left.getOperation() != spv::Op::OpConstantComposite || left.size() != _resultType.getVectorComponentCount() ||
+				(_pRight != nullptr && (_pRight->getOperation() != spv::Op::OpConstantComposite || _pRight->getComponents().size() != left.size())))
+			{
+				return false;
+			}
+
+			_out.setOperation(spv::Op::OpConstantComposite);
+			_out.getType() = _resultType;
+
+			auto r = _pRight != nullptr ? _pRight->getComponents().begin() : List<Constant>::Iterator(nullptr);
+			for (const Constant& l : left)
+			{
+				if (evaluate(_op, l, _pRight != nullptr ? r.operator->() : nullptr, _resultType.front(), _out.Component()) == false)
+				{
+					return false;
+				}
+
+				if (_pRight != nullptr)
+				{
+					++r;
+				}
+			}
+
+			return true;
+		}
+
+		Scalar l, r;
+		sgt_uint64_t result = 0u;
+
+		if (isSupported(_resultType) == false || read(_left, l) == false || (_pRight != nullptr && read(*_pRight, r) == false) || evaluate(_op, l, r, _resultType, result) == false)
+		{
+			return false;
+		}
+
+		write(result, _resultType, _out);
+		return true;
+	}
+
+	const Constant* getComponent(const Constant& _composite, unsigned int _index)
+	{
+		if (_composite.getOperation() != spv::Op::OpConstantComposite)
+		{
+			return nullptr;
+		}
+
+		for (const Constant& component : _composite.getComponents())
+		{
+			if (_index-- == 0u)
+			{
+				return &component;
+			}
+		}
+
+		return nullptr;
+	}
+
+	// constituents of OpCompositeConstruct must match the components of _type one by one to be folded
+	bool matchesComponent(const Type& _type, unsigned int _index, const Type& _constituent)
+	{
+		if (_type.isStruct())
+		{
+			for (const Type& member : _type.getSubTypes())
+			{
+				if (_index-- == 0u)
+				{
+					return member == _constituent;
+				}
+			}
+			return false;
+		}
+
+		const unsigned int count = _type.isVector() ? _type.getVectorComponentCount() : (_type.isMatrix() ? _type.getMatrixColumnCount() : (_type.isArray() ? _type.getArrayLength() : 0u));
+		return _index < count && _type.front() == _constituent;
+	}
+
+	unsigned int getComponentCount(const Type& _type)
+	{
+		return _type.isStruct() ? static_cast<unsigned int>(_type.getSubTypes().size()) : (_type.isVector() ? _type.getVectorComponentCount() : (_type.isMatrix() ? _type.getMatrixColumnCount() : (_type.isArray() ? _type.getArrayLength() : 0u)));
+	}
+
+	const Constant* getConstant(const Operand& _operand)
+	{
+		const Instruction* instr = _operand.getInstruction();
+		const Constant* c = instr != nullptr && instr->isConstant() ? instr->getConstant() : nullptr;
+		return c != nullptr && IsConstantOp(c->getOperation()) ? c : nullptr;
+	}
+}
+
+spvgentwo::Instruction* spvgentwo::IConstantFolder::fold(const Instruction& _instr) const
+{
+	Module* pModule = _instr.getModule();
+	const Type* pResultType = _instr.getType();
+	auto it = _instr.getFirstActualOperand();
+
+	if (pModule == nullptr || pResultType == nullptr || it == nullptr)
+	{
+		return nullptr;
+	}
+
+	Constant result(pModule->getAllocator());
+	const spv::Op op = _instr.getOperation();
+
+	switch (op)
+	{
+	case spv::Op::OpSelect:
+	{
+		const Constant* condition = getConstant(*it);
+		Scalar value;
+		if (condition == nullptr || condition->getType().isBool() == false || read(*condition, value) == false || it.next() == nullptr || it.next().next() == nullptr)
+		{
+			return nullptr;
+		}
+		return value.b() ? it.next()->getInstruction() : it.next().next()->getInstruction();
+	}
+	case spv::Op::OpCompositeExtract:
+	{
+		const Constant* c = getConstant(*it);
+		if (c == nullptr || ++it == nullptr) // index required
+		{
+			return nullptr;
+		}
+
+		for (; it != _instr.end() && c != nullptr; ++it)
+		{
+			c = it->isLiteral() ? getComponent(*c, it->getLiteral().value) : nullptr;
+		}
+
+		return c != nullptr && c->getType() == *pResultType ? pModule->addConstant(*c) : nullptr;
+	}
+	case spv::Op::OpCompositeConstruct:
+	{
+		const unsigned int count = getComponentCount(*pResultType);
+		if (count == 0u || _instr.size() != count + 2u) // result type and id
+		{
+			return nullptr;
+		}
+
+		result.setOperation(spv::Op::OpConstantComposite);
+		result.getType() = *pResultType;
+
+		for (unsigned int i = 0u; it != _instr.end(); ++it, ++i)
+		{
+			const Constant* c = getConstant(*it);
+			if (c == nullptr || matchesComponent(*pResultType, i, c->getType()) == false)
+			{
+				return nullptr;
+			}
+			result.Component() = *c;
+		}
+
+		return pModule->addConstant(result);
+	}
+	case spv::Op::OpVectorShuffle:
+	{
+		const Constant* left = getConstant(*it);
+		const Constant* right = it.next() != nullptr ? getConstant(*it.next()) : nullptr;
+		if (left == nullptr || right == nullptr || pResultType->isVector() == false || left->getOperation() != spv::Op::OpConstantComposite || right->getOperation() != spv::Op::OpConstantComposite)
+		{
+			return nullptr;
+		}
+
+		result.setOperation(spv::Op::OpConstantComposite);
+		result.getType() = *pResultType;
+
+		const unsigned int leftCount = static_cast<unsigned int>(left->getComponents().size());
+		for (it = it.next().next(); it != nullptr; ++it)
+		{
+			const unsigned int index = it->isLiteral() ? it->getLiteral().value : ~0u; // 0xFFFFFFFF is an undefined component
+			const Constant* c = index < leftCount ? getComponent(*left, index) : getComponent(*right, index - leftCount);
+			if (c == nullptr)
+			{
+				return nullptr;
+			}
+			result.Component() = *c;
+		}
+
+		return result.getComponents().size() == pResultType->getVectorComponentCount() ? pModule->addConstant(result) : nullptr;
+	}
+	default:
+	{
+		const Constant* left = getConstant(*it);
+		const Constant* right = nullptr;
+
+		if (left == nullptr)
+		{
+			return nullptr;
+		}
+
+		if (isUnary(op) == false)
+		{
+			right = it.next() != nullptr ? getConstant(*it.next()) : nullptr;
+			if (right == nullptr)
+			{
+				return nullptr;
+			}
+		}
+
+		return evaluate(op, *left, right, *pResultType, result) ? pModule->addConstant(result) : nullptr;
+	}
+	}
+}
@@ -1,4 +1,5 @@
 #include "spvgentwo/EntryPoint.h"
+#include "spvgentwo/Module.h"
 
 #include "spvgentwo/InstructionTemplate.inl"
 
@@ -10,22 +11,95 @@ spvgentwo::EntryPoint::EntryPoint()
 spvgentwo::EntryPoint::EntryPoint(Module* _pModule) :
 	Function(_pModule),
 	m_EntryPoint(this, spv::Op::OpNop),
-	m_nameStorage(_pModule->getAllocator())
+	m_nameStorage(_pModule->getAllocator()),
+	m_callees(_pModule->getAllocator())
 {
 	m_isEntryPoint = true;
 }
 
+spvgentwo::EntryPoint::EntryPoint(Module* _pModule, EntryPoint&& _other) noexcept :
+	Function(_pModule, stdrep::move(_other)),
+	m_EntryPoint(this, stdrep::move(_other.m_EntryPoint)),
+	m_ExecutionModel(_other.m_ExecutionModel),
+	m_nameStorage(stdrep::move(_other.m_nameStorage)),
+	m_callees(_pModule->getAllocator())
+{
+	m_isEntryPoint = true;
+	remapEntryPoint(&_other.m_Function);
+
+	_other.m_callees.clear();
+	_other.m_interfaceFinalized = false;
+}
+
 spvgentwo::EntryPoint::~EntryPoint()
 {
 }
 
+spvgentwo::EntryPoint& spvgentwo::EntryPoint::operator=(EntryPoint&& _other) noexcept
+{
+	if (this == &_other) return *this;
+
+	Function::operator=(stdrep::move(_other));
+
+	m_EntryPoint = stdrep::move(_other.m_EntryPoint);
+	remapEntryPoint(&_other.m_Function);
+
+	m_ExecutionModel = _other.m_ExecutionModel;
+	m_nameStorage = stdrep::move(_other.m_nameStorage);
+
+	// call tree belongs to the previous function
+	m_callees.clear();
+	m_interfaceFinalized = false;
+
+	_other.m_callees.clear();
+	_other.m_interfaceFinalized = false;
+
+	return *this;
+}
+
+void spvgentwo::EntryPoint::remapEntryPoint(const Instruction* _pOldFunction)
+{
+	for (Operand& op : m_EntryPoint)
+	{
+		if (op.isInstruction() && op.instruction == _pOldFunction)
+		{
+			op.instruction = &m_Function;
+		}
+	}
+}
+
 const char* spvgentwo::EntryPoint::getName() const
 {
 	return m_nameStorage.c_str();
 }
 
-void spvgentwo::EntryPoint::finalizeGlobalInterface(const GlobalInterfaceVersion _version)
+bool spvgentwo::EntryPoint::isGlobalInterfaceDirty(const GlobalInterfaceVersion _version) const
+{
+	if (m_interfaceFinalized == false || m_interfaceVersion != _version || isDirty())
+	{
+		return true;
+	}
+
+	const List<Function>& functions = m_pModule->getFunctions();
+	for (const Function* pCallee : m_callees)
+	{
+		// callee was removed from the module (or this entry point was moved to another module)
+		if (functions.find_if([pCallee](const Function& _func) { return &_func == pCallee; }) == functions.end() || pCallee->isDirty())
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool spvgentwo::EntryPoint::finalizeGlobalInterface(const GlobalInterfaceVersion _version, bool _incremental)
 {
+	if (_incremental && isGlobalInterfaceDirty(_version) == false)
+	{
+		return false;
+	}
+
 	// remove old interface IDs
 	auto interface = getInterfaceVariables();
 	for (auto it = interface.begin(); it != interface.end();)
@@ -34,7 +108,13 @@ void spvgentwo::EntryPoint::finalizeGlobalInterface(const GlobalInterfaceVersion
 	}
 
 	// collect new interface
-	collectReferencedVariables(*this, m_EntryPoint, _version, m_pAllocator);
+	m_callees.clear();
+	collectReferencedVariables(*this, m_EntryPoint, _version, m_pAllocator, &m_callees);
+
+	m_interfaceVersion = _version;
+	m_interfaceFinalized = true;
+
+	return true;
 }
 
 spvgentwo::String& spvgentwo::EntryPoint::getNameStorage()
@@ -22,8 +22,11 @@ spvgentwo::Function::Function(Module* _pModule, Function&& _other) noexcept :
 	m_Function(this, stdrep::move(_other.m_Function)),
 	m_FunctionEnd(this, spv::Op::OpFunctionEnd), // no need to move
 	m_FunctionType(stdrep::move(_other.m_FunctionType)),
-	m_Parameters(stdrep::move(_other.m_Parameters))
+	m_Parameters(stdrep::move(_other.m_Parameters)),
+	m_shared(_other.m_shared)
 {
+	_other.m_shared = false;
+
 	for (BasicBlock& bb : *this)
 	{
 		bb.m_pFunction = this;
@@ -50,9 +53,21 @@ spvgentwo::Function& spvgentwo::Function::operator=(Function&& _other) noexcept
 	m_FunctionType = stdrep::move(_other.m_FunctionType);
 	m_Parameters = stdrep::move(_other.m_Parameters);
 
+	m_shared = _other.m_shared;
+	_other.m_shared = false;
+
+	// OpFunction moved to this function, callers have to recollect their interfaces
+	m_dirty = true;
+	_other.m_dirty = true;
+
 	return *this;
 }
 
+bool spvgentwo::Function::unshare()
+{
+	return m_shared == false || m_pModule->unshare(*this);
+}
+
 void spvgentwo::Function::write(IWriter& _writer) const
 {
 	m_Function.write(_writer);
@@ -134,6 +149,9 @@ spvgentwo::List<spvgentwo::Instruction*> spvgentwo::Function::remove(const Basic
 		return uses;
 	}
 
+	// branches to _pBB in shared blocks reference the block it was cloned from
+	unshare();
+
 	const Instruction* opLabel = _pBB->getLabel();
 
 	bool found = false;
@@ -153,6 +171,8 @@ spvgentwo::List<spvgentwo::Instruction*> spvgentwo::Function::remove(const Basic
 		return uses;
 	}
 
+	m_dirty = true;
+
 	auto gatherUse = [opLabel, _pBB, _pReplacement, &uses](Instruction& instr)
 	{
 		for (auto it = instr.getFirstActualOperand(), end = instr.end(); it != end; ++it)
@@ -184,6 +204,8 @@ spvgentwo::Instruction* spvgentwo::Function::variable(Instruction* _pPtrType, co
 		addBasicBlock("FunctionEntry");
 	}
 
+	unshare();
+
 	BasicBlock& funcEntry = **m_pBegin;
 
 	// insert var instruction after label
@@ -300,7 +322,7 @@ spvgentwo::Flag<spvgentwo::spv::FunctionControlMask> spvgentwo::Function::getFun
 	return Flag<spv::FunctionControlMask>();
 }
 
-void spvgentwo::collectReferencedVariables(const Function& _func, List<Operand>& _outVarInstr, const GlobalInterfaceVersion _version, IAllocator* _pAllocator)
+void spvgentwo::collectReferencedVariables(const Function& _func, List<Operand>& _outVarInstr, const GlobalInterfaceVersion _version, IAllocator* _pAllocator, List<const Function*>* _pOutCallees)
 {
 	struct VisitedBB
 	{
@@ -339,6 +361,11 @@ void spvgentwo::collectReferencedVariables(const Function& _func, List<Operand>&
 						Instruction* pOpFunc = (instr.begin() + 2u)->getInstruction();
 						Function* pFunction = pOpFunc->getFunction();
 
+						if (_pOutCallees != nullptr && pFunction != &_func && _pOutCallees->contains(pFunction) == false)
+						{
+							_pOutCallees->emplace_back(pFunction);
+						}
+
 						// add unvisited function BBs
 						for (BasicBlock& funcBB : *pFunction)
 						{
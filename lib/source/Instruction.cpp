@@ -5,6 +5,7 @@
 #include "spvgentwo/Reader.h"
 #include "spvgentwo/Module.h"
 #include "spvgentwo/TypeInferenceAndValiation.h"
+#include "spvgentwo/ConstantFolder.h"
 #include "spvgentwo/Grammar.h"
 
 #include "spvgentwo/InstructionTemplate.inl"
@@ -1182,14 +1183,16 @@ spvgentwo::Instruction* spvgentwo::Instruction::opCompositeConstructDynamic(Inst
 		return error();
 	}
 
-	makeOp(spv::Op::OpCompositeConstruct, _pResultType, InvalidId);
+	initOp(spv::Op::OpCompositeConstruct, _pResultType, InvalidId);
 
 	for (Instruction* constituent : _constituents)
 	{
 		addOperand(constituent);
 	}
 
-	return this;
+	validateOperands();
+
+	return reuseValue();
 }
 
 spvgentwo::Instruction* spvgentwo::Instruction::opCompositeExtractDynamic(Instruction* _pComposite, const List<unsigned int>& _indices)
@@ -1215,14 +1218,16 @@ spvgentwo::Instruction* spvgentwo::Instruction::opCompositeExtractDynamic(Instru
 	if (it != nullptr)
 	{
 		Instruction* pResultType = pModule->addType(*it);
-		makeOp(spv::Op::OpCompositeExtract, pResultType, InvalidId, _pComposite);
+		initOp(spv::Op::OpCompositeExtract, pResultType, InvalidId, _pComposite);
 
 		for (auto i : _indices)
 		{
 			addOperand(literal_t{ i });
 		}
 
-		return this;
+		validateOperands();
+
+		return reuseValue();
 	}
 
 	pModule->logError("Invalid index sequence specified for composite type extraction");
@@ -2032,6 +2037,24 @@ bool spvgentwo::Instruction::isErrorInstr() const
 	return getModule()->getErrorInstr() == this;
 }
 
+spvgentwo::Instruction* spvgentwo::Instruction::reuseValue()
+{
+	if (m_parentType == ParentType::BasicBlock && isPureOp(m_Operation))
+	{
+		if (const IConstantFolder* folder = getModule()->getConstantFolder(); folder != nullptr)
+		{
+			if (Instruction* pConstant = folder->fold(*this); pConstant != nullptr)
+			{
+				return m_parent.pBasicBlock->rollback(this, pConstant);
+			}
+		}
+
+		return m_parent.pBasicBlock->numberValue(this);
+	}
+
+	return this;
+}
+
 spvgentwo::Instruction::Iterator spvgentwo::getLiteralString(String& _out, Instruction::Iterator _it, Instruction::Iterator _end)
 {
 	for (; _it != _end; ++_it)
@@ -12,6 +12,26 @@
 namespace
 {
 	static spvgentwo::ITypeInferenceAndVailation sg_DefaultTypeInference{};
+
+	// reads modules written with the opposite endianness
+	class ByteSwapReader : public spvgentwo::IReader
+	{
+	public:
+		ByteSwapReader(spvgentwo::IReader& _reader) : m_reader(_reader) {}
+
+		bool get(unsigned int& _word) final
+		{
+			if (m_reader.get(_word))
+			{
+				_word = spvgentwo::byteSwap(_word);
+				return true;
+			}
+			return false;
+		}
+
+	private:
+		spvgentwo::IReader& m_reader;
+	};
 }
 
 spvgentwo::Module::Module(IAllocator* _pAllocator, ILogger* _pLogger, ITypeInferenceAndVailation* _pTypeInferenceAndVailation) :
@@ -58,9 +78,12 @@ spvgentwo::Module::Module(Module&& _other) noexcept:
 	m_pAllocator(_other.m_pAllocator),
 	m_pLogger(_other.m_pLogger),
 	m_pTypeInferenceAndVailation(_other.m_pTypeInferenceAndVailation),
+	m_pConstantFolder(_other.m_pConstantFolder),
 	m_spvVersion(_other.m_spvVersion),
+	m_spvGenerator(_other.m_spvGenerator),
 	m_spvBound(_other.m_spvBound),
 	m_spvSchema(_other.m_spvSchema),
+	m_sharedFunctions(_other.m_sharedFunctions),
 	m_Functions(stdrep::move(_other.m_Functions)),
 	m_EntryPoints(stdrep::move(_other.m_EntryPoints)),
 	m_Capabilities(stdrep::move(_other.m_Capabilities)),
@@ -93,9 +116,12 @@ spvgentwo::Module& spvgentwo::Module::operator=(Module&& _other) noexcept
 	m_pAllocator = _other.m_pAllocator;
 	m_pLogger = _other.m_pLogger;
 	m_pTypeInferenceAndVailation = _other.m_pTypeInferenceAndVailation;
+	m_pConstantFolder = _other.m_pConstantFolder;
 	m_spvVersion = _other.m_spvVersion;
+	m_spvGenerator = _other.m_spvGenerator;
 	m_spvBound = _other.m_spvBound;
 	m_spvSchema = _other.m_spvSchema;
+	m_sharedFunctions = _other.m_sharedFunctions;
 	m_Functions = stdrep::move(_other.m_Functions);
 	m_EntryPoints = stdrep::move(_other.m_EntryPoints);
 	m_Capabilities = stdrep::move(_other.m_Capabilities);
@@ -129,80 +155,725 @@ void spvgentwo::Module::updateParentPointers()
 		func.m_pModule = this;
 	}
 
-	for (Function& func : m_EntryPoints)
+	for (Function& func : m_EntryPoints)
+	{
+		func.m_pModule = this;
+	}
+
+	auto fixList = [&](List<Instruction>& list)
+	{
+		for (Instruction& instr : list)
+		{
+			instr.m_parent.pModule = this;
+		}
+	};
+
+	auto fixMap = [&](auto& map)
+	{
+		for (auto& [key, instr] : map)
+		{
+			instr.m_parent.pModule = this;
+		}
+	};
+
+	fixMap(m_Capabilities);
+	fixMap(m_Extensions);
+	fixMap(m_ExtInstrImport);
+
+	fixList(m_ExecutionModes);
+	fixList(m_SourceStrings);
+	fixList(m_Names);
+	fixList(m_ModuleProccessed);
+	fixList(m_Decorations);
+	fixList(m_TypesAndConstants);
+	fixList(m_GlobalVariables);
+	fixList(m_Undefs);
+	fixList(m_Lines);
+}
+
+spvgentwo::Module::~Module()
+{
+}
+
+void spvgentwo::Module::reset()
+{
+	m_spvVersion = spv::Version;
+	m_spvGenerator = GeneratorId;
+	m_spvBound = 0u;
+	m_spvSchema = 0u;
+	m_sharedFunctions = 0u;
+
+	m_Functions.clear();
+	m_EntryPoints.clear();
+
+	m_Capabilities.clear();
+	m_Extensions.clear();
+	m_ExtInstrImport.clear();
+
+	setMemoryModel(spv::AddressingModel::Logical, spv::MemoryModel::Simple);
+
+	m_ExecutionModes.clear();
+	m_SourceStrings.clear();
+	m_Names.clear();
+	m_ModuleProccessed.clear();
+	m_Decorations.clear();
+
+	m_TypesAndConstants.clear();
+
+	m_TypeToInstr.clear();
+	m_InstrToType.clear();
+	m_ConstantToInstr.clear();
+	m_InstrToConstant.clear();
+
+	m_NameLookup.clear();
+
+	m_GlobalVariables.clear();
+	m_Undefs.clear();
+	m_Lines.clear();
+}
+
+namespace
+{
+	struct ClonedInstruction
+	{
+		const spvgentwo::Instruction* source;
+		spvgentwo::Instruction* target;
+	};
+
+	// maps instructions of the source module to their clones, uses a dense table indexed by result id
+	// if all result ids are valid and unique (assigned by assignIDs or read), otherwise falls back to a pointer hash map.
+	// the dense table stores the source as well, instructions of other modules with the same id are not mapped
+	class InstructionRemap
+	{
+	public:
+		InstructionRemap(spvgentwo::IAllocator* _pAllocator) : m_pAllocator(_pAllocator), m_pairs(_pAllocator), m_byId(_pAllocator) {}
+
+		void add(const spvgentwo::Instruction& _source, spvgentwo::Instruction& _target)
+		{
+			m_pairs.emplace_back(ClonedInstruction{ &_source, &_target });
+		}
+
+		const spvgentwo::Vector<ClonedInstruction>& getPairs() const { return m_pairs; }
+
+		// call after all instructions were added
+		void build(unsigned int _bound)
+		{
+			using namespace spvgentwo;
+
+			const ClonedInstruction* null = nullptr;
+			bool dense = _bound != 0u && m_byId.resize(_bound, &null);
+
+			for (auto it = m_pairs.begin(), end = m_pairs.end(); dense && it != end; ++it)
+			{
+				if (it->source->getResultIdOperand() != nullptr)
+				{
+					const spv::Id id = it->source->getResultId();
+					const unsigned int index = static_cast<unsigned int>(id);
+					dense = id != InvalidId && index < _bound && m_byId[index] == nullptr;
+					if (dense)
+					{
+						m_byId[index] = it;
+					}
+				}
+			}
+
+			if (dense == false)
+			{
+				m_byId.clear();
+
+				m_byPtr = HashMap<const Instruction*, Instruction*>(m_pAllocator, static_cast<unsigned int>(m_pairs.size() / 2u + 1u));
+				for (const ClonedInstruction& pair : m_pairs)
+				{
+					if (pair.source->getResultIdOperand() != nullptr)
+					{
+						m_byPtr.emplaceUnique(pair.source, pair.target);
+					}
+				}
+			}
+		}
+
+		spvgentwo::Instruction* get(const spvgentwo::Instruction* _pSource) const
+		{
+			if (m_byId.empty() == false)
+			{
+				const unsigned int index = static_cast<unsigned int>(_pSource->getResultId());
+				const ClonedInstruction* pair = index < m_byId.size() ? m_byId[index] : nullptr;
+				return pair != nullptr && pair->source == _pSource ? pair->target : nullptr;
+			}
+
+			spvgentwo::Instruction** target = m_byPtr[_pSource];
+			return target != nullptr ? *target : nullptr;
+		}
+
+	private:
+		spvgentwo::IAllocator* m_pAllocator = nullptr;
+		spvgentwo::Vector<ClonedInstruction> m_pairs;
+		spvgentwo::Vector<const ClonedInstruction*> m_byId;
+		spvgentwo::HashMap<const spvgentwo::Instruction*, spvgentwo::Instruction*> m_byPtr;
+	};
+}
+
+spvgentwo::Module spvgentwo::Module::clone(IAllocator* _pAllocator, bool _shareFunctionBodies) const
+{
+	IAllocator* pAllocator = _pAllocator != nullptr ? _pAllocator : m_pAllocator;
+
+	// shared instructions are matched by result id when a function is unshared
+	bool share = _shareFunctionBodies;
+	if (share)
+	{
+		share = m_spvBound != 0u && iterateInstructions([this](const Instruction& _instr) -> bool
+		{
+			auto it = _instr.getResultIdOperand();
+			return it != nullptr && (it->getId() == InvalidId || static_cast<unsigned int>(it->getId()) >= m_spvBound); // stop at the first invalid id
+		}) == false;
+
+		logInfo(share, "Clone: module has no valid result ids, function bodies are copied");
+	}
+
+	Module module(pAllocator, m_pLogger, m_pTypeInferenceAndVailation);
+	module.m_pConstantFolder = m_pConstantFolder;
+	module.m_spvVersion = m_spvVersion;
+	module.m_spvGenerator = m_spvGenerator;
+	module.m_spvBound = m_spvBound;
+	module.m_spvSchema = m_spvSchema;
+
+	InstructionRemap remap(pAllocator);
+
+	// 1. create empty instructions, functions and basic blocks in the same layout as this module
+
+	auto cloneMap = [&](const auto& _source, auto& _target)
+	{
+		for (unsigned int i = 0u; i < _source.getBucketCount(); ++i)
+		{
+			for (const auto& node : _source.getBucket(i))
+			{
+				auto& n = _target.emplaceWithHash(node.getHash(), node.kv.key, &module, spv::Op::OpNop);
+				remap.add(node.kv.value, n.kv.value);
+			}
+		}
+	};
+
+	auto cloneStringMap = [&](const HashMap<String, Instruction>& _source, HashMap<String, Instruction>& _target)
+	{
+		for (unsigned int i = 0u; i < _source.getBucketCount(); ++i)
+		{
+			for (const auto& node : _source.getBucket(i))
+			{
+				auto& n = _target.emplaceWithHash(node.getHash(), String(pAllocator, node.kv.key.c_str(), node.kv.key.Vector<char>::size()), &module, spv::Op::OpNop);
+				remap.add(node.kv.value, n.kv.value);
+			}
+		}
+	};
+
+	auto cloneList = [&](const List<Instruction>& _source, List<Instruction>& _target)
+	{
+		for (const Instruction& instr : _source)
+		{
+			remap.add(instr, _target.emplace_back(&module, spv::Op::OpNop));
+		}
+	};
+
+	auto cloneFunction = [&](const Function& _source, Function& _target)
+	{
+		_target.m_FunctionType = Type(_source.m_FunctionType, pAllocator);
+
+		remap.add(_source.m_Function, _target.m_Function);
+
+		for (const Instruction& param : _source.m_Parameters)
+		{
+			remap.add(param, _target.m_Parameters.emplace_back(&_target, spv::Op::OpNop));
+		}
+
+		for (const BasicBlock& bb : _source)
+		{
+			BasicBlock& targetBB = _target.emplace_back(&_target);
+			remap.add(bb.m_Label, targetBB.m_Label);
+
+			if (share)
+			{
+				targetBB.m_pBegin = bb.m_pBegin;
+				targetBB.m_pLast = bb.m_pLast;
+				targetBB.m_Elements = bb.m_Elements;
+				targetBB.m_shared = true;
+				if (_target.m_shared == false)
+				{
+					_target.m_shared = true;
+					++module.m_sharedFunctions;
+				}
+				continue;
+			}
+
+			for (const Instruction& instr : bb)
+			{
+				remap.add(instr, targetBB.emplace_back(&targetBB, spv::Op::OpNop));
+			}
+		}
+
+		remap.add(_source.m_FunctionEnd, _target.m_FunctionEnd);
+	};
+
+	cloneMap(m_Capabilities, module.m_Capabilities);
+	cloneStringMap(m_Extensions, module.m_Extensions);
+	cloneStringMap(m_ExtInstrImport, module.m_ExtInstrImport);
+
+	remap.add(m_MemoryModel, module.m_MemoryModel);
+
+	cloneList(m_ExecutionModes, module.m_ExecutionModes);
+	cloneList(m_SourceStrings, module.m_SourceStrings);
+	cloneList(m_Names, module.m_Names);
+	cloneList(m_ModuleProccessed, module.m_ModuleProccessed);
+	cloneList(m_Decorations, module.m_Decorations);
+	cloneList(m_TypesAndConstants, module.m_TypesAndConstants);
+	cloneList(m_GlobalVariables, module.m_GlobalVariables);
+	cloneList(m_Undefs, module.m_Undefs);
+	cloneList(m_Lines, module.m_Lines);
+
+	for (const Function& func : m_Functions)
+	{
+		cloneFunction(func, module.m_Functions.emplace_back(&module));
+	}
+
+	for (const EntryPoint& ep : m_EntryPoints)
+	{
+		EntryPoint& target = module.m_EntryPoints.emplace_back(&module);
+		cloneFunction(ep, target);
+
+		target.m_ExecutionModel = ep.m_ExecutionModel;
+		target.m_nameStorage = String(pAllocator, ep.m_nameStorage.c_str(), ep.m_nameStorage.Vector<char>::size());
+
+		remap.add(ep.m_EntryPoint, target.m_EntryPoint);
+	}
+
+	remap.build(m_spvBound);
+
+	// 2. copy operation and operands, remapping Instruction and BasicBlock operands to the new module
+
+	auto mapInstr = [&](const Instruction* _pSource) -> Instruction*
+	{
+		Instruction* target = remap.get(_pSource);
+		if (target == nullptr)
+		{
+			// instructions of shared basic blocks are referenced directly
+			logError(share && _pSource->getModule() == this, "Clone: operand instruction is not part of the module");
+			return const_cast<Instruction*>(_pSource);
+		}
+		return target;
+	};
+
+	for (const ClonedInstruction& pair : remap.getPairs())
+	{
+		Instruction& target = *pair.target;
+		target.clear();
+		target.m_Operation = pair.source->m_Operation;
+
+		for (const Operand& op : *pair.source)
+		{
+			if (op.isInstruction())
+			{
+				target.addOperand(mapInstr(op.instruction));
+			}
+			else if (op.isBranchTarget())
+			{
+				target.addOperand(mapInstr(op.branchTarget->getLabel())->getBasicBlock());
+			}
+			else
+			{
+				target.addOperand(op);
+			}
+		}
+	}
+
+	// 3. lookup maps
+
+	for (unsigned int i = 0u; i < m_NameLookup.getBucketCount(); ++i)
+	{
+		for (const auto& node : m_NameLookup.getBucket(i))
+		{
+			const MemberName& name = node.kv.value;
+			module.m_NameLookup.emplace(mapInstr(node.kv.key), MemberName{ String(pAllocator, name.name.c_str(), name.name.Vector<char>::size()), name.member });
+		}
+	}
+
+	// type & constant info is stored in the keys of m_TypeToInstr / m_ConstantToInstr, m_InstrToType / m_InstrToConstant point to these keys
+	auto cloneInfo = [&](const auto& _infoToInstr, auto& _targetInfoToInstr, const auto& _instrToInfo, auto& _targetInstrToInfo)
+	{
+		using Info = stdrep::remove_cv_t<stdrep::remove_reference_t<decltype(_infoToInstr.getBucket(0u).front().kv.key)>>;
+
+		HashMap<const Info*, const Info*> infoRemap(pAllocator, _infoToInstr.elements() / 2u + 1u);
+
+		for (unsigned int i = 0u; i < _infoToInstr.getBucketCount(); ++i)
+		{
+			for (const auto& node : _infoToInstr.getBucket(i))
+			{
+				auto& n = _targetInfoToInstr.emplaceWithHash(node.getHash(), Info(node.kv.key, pAllocator), mapInstr(node.kv.value));
+				infoRemap.emplaceUnique(&node.kv.key, &n.kv.key);
+			}
+		}
+
+		for (unsigned int i = 0u; i < _instrToInfo.getBucketCount(); ++i)
+		{
+			for (const auto& node : _instrToInfo.getBucket(i))
+			{
+				Instruction* instr = mapInstr(node.kv.key);
+
+				if (const Info** info = infoRemap[node.kv.value]; info != nullptr)
+				{
+					_targetInstrToInfo.emplaceUnique(instr, *info);
+				}
+				else // info not owned by this module
+				{
+					_targetInstrToInfo.emplaceUnique(instr, &_targetInfoToInstr.emplaceUnique(Info(*node.kv.value, pAllocator), instr).kv.key);
+				}
+			}
+		}
+	};
+
+	cloneInfo(m_TypeToInstr, module.m_TypeToInstr, m_InstrToType, module.m_InstrToType);
+	cloneInfo(m_ConstantToInstr, module.m_ConstantToInstr, m_InstrToConstant, module.m_InstrToConstant);
+
+	return module;
+}
+
+bool spvgentwo::Module::hasSharedFunctions() const
+{
+	if (m_sharedFunctions == 0u)
+	{
+		return false;
+	}
+
+	for (const Function& func : m_Functions)
+	{
+		if (func.m_shared) return true;
+	}
+
+	for (const EntryPoint& ep : m_EntryPoints)
+	{
+		if (ep.m_shared) return true;
+	}
+
+	return false;
+}
+
+bool spvgentwo::Module::unshareAll()
+{
+	bool success = true;
+
+	for (Function& func : m_Functions)
+	{
+		success &= unshare(func);
+	}
+
+	for (EntryPoint& ep : m_EntryPoints)
+	{
+		success &= unshare(ep);
+	}
+
+	return success;
+}
+
+void spvgentwo::Module::getInstructionsById(Vector<Instruction*>& _outInstructions)
+{
+	Instruction* null = nullptr;
+	_outInstructions.clear();
+	_outInstructions.resize(m_spvBound, &null);
+
+	auto add = [&_outInstructions](Instruction& _instr)
+	{
+		if (const unsigned int id = static_cast<unsigned int>(_instr.getResultId()); id < _outInstructions.size())
+		{
+			_outInstructions[id] = &_instr;
+		}
+	};
+
+	auto addList = [&add](List<Instruction>& _list)
+	{
+		for (Instruction& instr : _list)
+		{
+			add(instr);
+		}
+	};
+
+	// only instructions which can be referenced from function bodies
+	for (auto& [name, instr] : m_ExtInstrImport)
+	{
+		add(instr);
+	}
+
+	addList(m_SourceStrings);
+	addList(m_TypesAndConstants);
+	addList(m_GlobalVariables);
+	addList(m_Undefs);
+
+	auto addFunction = [&](Function& _func)
+	{
+		add(_func.m_Function);
+		addList(_func.m_Parameters);
+
+		for (BasicBlock& bb : _func)
+		{
+			add(bb.m_Label);
+
+			if (bb.m_shared == false)
+			{
+				addList(bb);
+			}
+		}
+	};
+
+	for (Function& func : m_Functions)
+	{
+		addFunction(func);
+	}
+
+	for (EntryPoint& ep : m_EntryPoints)
+	{
+		addFunction(ep);
+	}
+}
+
+bool spvgentwo::Module::unshare(Function& _func)
+{
+	if (_func.m_shared == false)
+	{
+		return true;
+	}
+
+	if (_func.m_pModule != this)
+	{
+		logError("Unshare: function is not part of this module");
+		return false;
+	}
+
+	Vector<Instruction*> byId(m_pAllocator);
+	getInstructionsById(byId);
+
+	// 1. copy shared instructions, operands still reference the source module
+	for (BasicBlock& bb : _func)
+	{
+		if (bb.m_shared == false)
+		{
+			continue;
+		}
+
+		const Entry<Instruction>* pShared = bb.m_pBegin;
+		bb.m_pBegin = nullptr;
+		bb.m_pLast = nullptr;
+		bb.m_Elements = 0u;
+
+		for (; pShared != nullptr; pShared = pShared->next())
+		{
+			const Instruction& source = pShared->inner();
+			Instruction& copy = bb.emplace_back(&bb, spv::Op::OpNop);
+			copy.m_Operation = source.m_Operation;
+
+			for (const Operand& op : source)
+			{
+				copy.addOperand(op);
+			}
+
+			if (const unsigned int id = static_cast<unsigned int>(copy.getResultId()); id < byId.size())
+			{
+				byId[id] = &copy;
+			}
+		}
+	}
+
+	auto mapInstr = [this, &byId](Instruction* _pInstr) -> Instruction*
+	{
+		const unsigned int id = static_cast<unsigned int>(_pInstr->getResultId());
+		if (id < byId.size() && byId[id] != nullptr)
+		{
+			return byId[id];
+		}
+
+		logError(_pInstr->getModule() == this, "Unshare: operand %u has no instruction in this module", id);
+		return _pInstr;
+	};
+
+	auto remapOperands = [&mapInstr](Instruction& _instr)
+	{
+		for (Operand& op : _instr)
+		{
+			if (op.isInstruction())
+			{
+				op = mapInstr(op.instruction);
+			}
+			else if (op.isBranchTarget())
+			{
+				op = mapInstr(op.branchTarget->getLabel())->getBasicBlock();
+			}
+		}
+	};
+
+	// 2. remap operands to the instructions of this module
+	for (BasicBlock& bb : _func)
+	{
+		if (bb.m_shared)
+		{
+			for (Instruction& instr : bb)
+			{
+				remapOperands(instr);
+			}
+			bb.m_shared = false;
+		}
+	}
+
+	_func.m_shared = false;
+	--m_sharedFunctions;
+
+	// 3. names, decorations and entry point interfaces might reference the shared instructions
+	auto remapForeign = [this, &remapOperands](Instruction& _instr)
+	{
+		for (const Operand& op : _instr)
+		{
+			if (op.isInstruction() && op.instruction->getModule() != this)
+			{
+				remapOperands(_instr);
+				return;
+			}
+		}
+	};
+
+	for (Instruction& instr : m_Names) remapForeign(instr);
+	for (Instruction& instr : m_Decorations) remapForeign(instr);
+	for (Instruction& instr : m_ExecutionModes) remapForeign(instr);
+	for (EntryPoint& ep : m_EntryPoints) remapForeign(ep.m_EntryPoint);
+
+	List<const Instruction*> foreignKeys(m_pAllocator);
+	for (const auto& [key, name] : m_NameLookup)
+	{
+		if (key->getModule() != this && mapInstr(const_cast<Instruction*>(key)) != key && foreignKeys.contains(key) == false)
+		{
+			foreignKeys.emplace_back(key);
+		}
+	}
+
+	for (const Instruction* key : foreignKeys)
+	{
+		List<MemberName> names(m_pAllocator);
+		for (auto& node : m_NameLookup.getRange(key))
+		{
+			names.emplace_back(stdrep::move(node.kv.value));
+		}
+
+		m_NameLookup.eraseRange(key);
+
+		Instruction* local = mapInstr(const_cast<Instruction*>(key));
+		for (MemberName& name : names)
+		{
+			m_NameLookup.emplace(local, stdrep::move(name));
+		}
+	}
+
+	return true;
+}
+
+spvgentwo::Instruction* spvgentwo::Module::unshare(const Instruction* _pSharedInstr)
+{
+	if (_pSharedInstr == nullptr)
 	{
-		func.m_pModule = this;
+		return nullptr;
 	}
 
-	auto fixList = [&](List<Instruction>& list)
+	// find the basic block and position of _pSharedInstr, its copy is created at the same position
+	auto unshareInstr = [this, _pSharedInstr](Function& _func) -> Instruction*
 	{
-		for (Instruction& instr : list)
+		if (_func.m_shared == false)
 		{
-			instr.m_parent.pModule = this;
+			return nullptr;
 		}
-	};
 
-	auto fixMap = [&](auto& map)
-	{
-		for (auto& [key, instr] : map)
+		for (BasicBlock& bb : _func)
 		{
-			instr.m_parent.pModule = this;
+			if (bb.m_shared == false)
+			{
+				continue;
+			}
+
+			unsigned int index = 0u;
+			for (const Instruction& instr : bb)
+			{
+				if (&instr == _pSharedInstr)
+				{
+					unshare(_func);
+					return (bb.begin() + index).operator->();
+				}
+				++index;
+			}
 		}
+
+		return nullptr;
 	};
 
-	fixMap(m_Capabilities);
-	fixMap(m_Extensions);
-	fixMap(m_ExtInstrImport);
+	for (Function& func : m_Functions)
+	{
+		if (Instruction* copy = unshareInstr(func); copy != nullptr) return copy;
+	}
 
-	fixList(m_ExecutionModes);
-	fixList(m_SourceStrings);
-	fixList(m_Names);
-	fixList(m_ModuleProccessed);
-	fixList(m_Decorations);
-	fixList(m_TypesAndConstants);
-	fixList(m_GlobalVariables);
-	fixList(m_Undefs);
-	fixList(m_Lines);
-}
+	for (EntryPoint& ep : m_EntryPoints)
+	{
+		if (Instruction* copy = unshareInstr(ep); copy != nullptr) return copy;
+	}
 
-spvgentwo::Module::~Module()
-{
+	return nullptr;
 }
 
-void spvgentwo::Module::reset()
+const spvgentwo::Instruction* spvgentwo::Module::unshareUses(const Instruction* _pInstr)
 {
-	m_spvVersion = spv::Version;
-	m_spvGenerator = GeneratorId;
-	m_spvBound = 0u;
-	m_spvSchema = 0u;
-
-	m_Functions.clear();
-	m_EntryPoints.clear();
+	if (_pInstr == nullptr || hasSharedFunctions() == false)
+	{
+		return _pInstr;
+	}
 
-	m_Capabilities.clear();
-	m_Extensions.clear();
-	m_ExtInstrImport.clear();
+	if (_pInstr->getModule() != this)
+	{
+		if (Instruction* copy = unshare(_pInstr); copy != nullptr)
+		{
+			_pInstr = copy;
+		}
+	}
 
-	setMemoryModel(spv::AddressingModel::Logical, spv::MemoryModel::Simple);
+	const spv::Id id = _pInstr->getResultId();
+	if (id == InvalidId) // not referenced by shared instructions
+	{
+		return _pInstr;
+	}
 
-	m_ExecutionModes.clear();
-	m_SourceStrings.clear();
-	m_Names.clear();
-	m_ModuleProccessed.clear();
-	m_Decorations.clear();
+	auto isUsed = [id](const Function& _func) -> bool
+	{
+		for (const BasicBlock& bb : _func)
+		{
+			if (bb.m_shared == false)
+			{
+				continue;
+			}
 
-	m_TypesAndConstants.clear();
+			for (const Instruction& instr : bb)
+			{
+				for (const Operand& op : instr)
+				{
+					if ((op.isInstruction() && op.instruction->getResultId() == id) ||
+						(op.isBranchTarget() && op.branchTarget->getLabel()->getResultId() == id))
+					{
+						return true;
+					}
+				}
+			}
+		}
+		return false;
+	};
 
-	m_TypeToInstr.clear();
-	m_InstrToType.clear();
-	m_ConstantToInstr.clear();
-	m_InstrToConstant.clear();
+	for (Function& func : m_Functions)
+	{
+		if (func.m_shared && isUsed(func)) unshare(func);
+	}
 
-	m_NameLookup.clear();
+	for (EntryPoint& ep : m_EntryPoints)
+	{
+		if (ep.m_shared && isUsed(ep)) unshare(ep);
+	}
 
-	m_GlobalVariables.clear();
-	m_Undefs.clear();
-	m_Lines.clear();
+	return _pInstr;
 }
 
 void spvgentwo::Module::ensureSpvVersion(unsigned char _major, unsigned char _minor)
@@ -228,7 +899,8 @@ spvgentwo::List<spvgentwo::Instruction*> spvgentwo::Module::remove(const Functio
 		return uses;
 	}
 
-	const Instruction* opFunction = _pFunction->getFunction();
+	// shared function calls reference the OpFunction of the source module
+	const Instruction* opFunction = unshareUses(_pFunction->getFunction());
 	Instruction* opFunctionReplacement = _pReplacementToCall != nullptr ? _pReplacementToCall->getFunction() : nullptr;
 
 	// remove from functions if its not an entry point
@@ -267,6 +939,10 @@ spvgentwo::List<spvgentwo::Instruction*> spvgentwo::Module::remove(const Functio
 				{
 					*it = opFunctionReplacement;
 					uses.emplace_back(&instr);
+					if (Function* pCaller = instr.getFunction(); pCaller != nullptr)
+					{
+						pCaller->setDirty();
+					}
 					break;
 				}
 			}
@@ -364,7 +1040,8 @@ spvgentwo::Instruction* spvgentwo::Module::addExtensionInstructionImport(const c
 
 spvgentwo::Instruction* spvgentwo::Module::getExtensionInstructionImport(const char* _pExtName) const
 {
-	return m_ExtInstrImport.get(hash(_pExtName));
+	KeyHasher<String>::Algorithm hasher{};
+	return m_ExtInstrImport.get(hasher(_pExtName));
 }
 
 spvgentwo::Instruction* spvgentwo::Module::addSourceStringInstr()
@@ -427,6 +1104,31 @@ spvgentwo::Instruction* spvgentwo::Module::addDecorationInstr()
 	return &m_Decorations.emplace_back(this, spv::Op::OpNop);
 }
 
+void spvgentwo::Module::copyDecorations(const HashMap<const Instruction*, Instruction*>& _copies)
+{
+	// copies are appended, only visit the decorations present before
+	auto it = m_Decorations.begin();
+	for (sgt_size_t n = m_Decorations.size(); n > 0u; --n, ++it)
+	{
+		const Instruction* target = it->empty() ? nullptr : it->front().getInstruction();
+		if (target == nullptr)
+		{
+			continue;
+		}
+
+		if (Instruction* const* copy = _copies.get(target); copy != nullptr)
+		{
+			Instruction* decoration = addDecorationInstr();
+			decoration->setOperation(it->getOperation());
+			for (const Operand& op : *it)
+			{
+				decoration->addOperand(op);
+			}
+			decoration->front() = *copy;
+		}
+	}
+}
+
 spvgentwo::Instruction* spvgentwo::Module::addConstant(const Constant& _const, const char* _pName)
 {
 	const spv::Op constantOp = _const.getOperation();
@@ -710,12 +1412,24 @@ void spvgentwo::Module::setMemoryModel(const spv::AddressingModel _addressModel,
 	m_MemoryModel.opMemoryModel(_addressModel, _memoryModel);
 }
 
-spvgentwo::spv::Id spvgentwo::Module::assignIDs(const Grammar* _pGrammar)
+spvgentwo::spv::Id spvgentwo::Module::assignIDs(const Grammar* _pGrammar, IdOrder _order)
 {
-	unsigned int maxId = 0u;
+	// ids of shared instructions can't be changed, keep all valid ids and only assign new ones
+	const bool stable = m_spvBound != 0u && _order == IdOrder::Stable;
+	const bool keepIds = stable || (m_spvBound != 0u && hasSharedFunctions());
+	const bool reorder = keepIds == false && _order != IdOrder::Serialization && _order != IdOrder::Stable;
+
+	// ids copied along with their instruction or out of bounds are reassigned
+	Vector<unsigned char> used(m_pAllocator);
+	if (stable)
+	{
+		used.resize(m_spvBound);
+	}
+
+	unsigned int maxId = keepIds ? m_spvBound - 1u : 0u;
 	unsigned int maxVersion = m_spvVersion;
 
-	iterateInstructions([&maxId, &maxVersion, _pGrammar, this](Instruction& instr)
+	iterateInstructions([&maxId, &maxVersion, &used, stable, keepIds, reorder, _pGrammar, this](Instruction& instr)
 	{
 		if (_pGrammar != nullptr) // add missing capabilities, extensions and required version
 		{
@@ -740,18 +1454,151 @@ spvgentwo::spv::Id spvgentwo::Module::assignIDs(const Grammar* _pGrammar)
 		}
 
 		// assign IDs
-		if (auto it = instr.getResultIdOperand(); it != nullptr)
+		if (auto it = instr.getResultIdOperand(); it != nullptr && reorder == false)
 		{
-			*it = spv::Id{ ++maxId };
+			bool keep = keepIds && it->getId() != InvalidId;
+			if (keep && stable)
+			{
+				const unsigned int id = static_cast<unsigned int>(it->getId());
+				keep = id < used.size() && used[id] == 0u;
+				if (keep)
+				{
+					used[id] = 1u;
+				}
+			}
+
+			if (keep == false)
+			{
+				*it = spv::Id{ ++maxId };
+			}
 		}
 	});
 
+	if (reorder)
+	{
+		maxId = static_cast<unsigned int>(reorderIDs(_order));
+	}
+
 	m_spvVersion = maxVersion;
 	m_spvBound = maxId + 1u;
 
 	return spv::Id{ maxId };
 }
 
+spvgentwo::spv::Id spvgentwo::Module::reorderIDs(IdOrder _order)
+{
+	// instruction referenced by _op, branch targets reference the label of the basic block
+	auto referenced = [](const Operand& _op) -> Instruction*
+	{
+		if (_op.isBranchTarget())
+		{
+			return _op.getBranchTarget()->getLabel();
+		}
+		return _op.getInstruction();
+	};
+
+	unsigned int maxId = 0u;
+
+	if (_order == IdOrder::Frequency)
+	{
+		HashMap<const Instruction*, unsigned int> uses(m_pAllocator);
+		Vector<Instruction*> defs(m_pAllocator);
+
+		iterateInstructions([&](Instruction& instr)
+		{
+			if (instr.getResultIdOperand() != nullptr)
+			{
+				defs.emplace_back(&instr);
+			}
+
+			for (const Operand& op : instr)
+			{
+				if (const Instruction* target = referenced(op); target != nullptr)
+				{
+					++uses.emplaceUnique(target, 0u).kv.value;
+				}
+			}
+		});
+
+		auto count = [&uses](const Instruction* _pInstr) -> unsigned int
+		{
+			const unsigned int* n = uses[_pInstr];
+			return n != nullptr ? *n : 0u;
+		};
+
+		unsigned int maxCount = 0u;
+		for (const Instruction* instr : defs)
+		{
+			const unsigned int n = count(instr);
+			maxCount = n > maxCount ? n : maxCount;
+		}
+
+		// stable counting sort by descending use count, ids of instructions with equal counts stay in serialization order
+		Vector<unsigned int> next(m_pAllocator);
+		next.resize(maxCount + 1u); // zero initialized
+		for (const Instruction* instr : defs)
+		{
+			++next[count(instr)];
+		}
+		for (unsigned int n = maxCount + 1u, offset = 0u; n-- > 0u;)
+		{
+			const unsigned int size = next[n];
+			next[n] = offset;
+			offset += size;
+		}
+
+		for (Instruction* instr : defs)
+		{
+			*instr->getResultIdOperand() = spv::Id{ ++next[count(instr)] };
+		}
+
+		maxId = static_cast<unsigned int>(defs.size());
+	}
+	else if (_order == IdOrder::FirstUse)
+	{
+		iterateInstructions([](Instruction& instr)
+		{
+			if (auto it = instr.getResultIdOperand(); it != nullptr)
+			{
+				*it = InvalidId;
+			}
+		});
+
+		auto number = [&maxId](Instruction& _instr)
+		{
+			if (auto it = _instr.getResultIdOperand(); it != nullptr && it->getId() == InvalidId)
+			{
+				*it = spv::Id{ ++maxId };
+			}
+		};
+
+		bool inFunction = false;
+		iterateInstructions([&](Instruction& instr)
+		{
+			inFunction |= instr == spv::Op::OpFunction;
+
+			if (inFunction)
+			{
+				for (const Operand& op : instr)
+				{
+					if (Instruction* target = referenced(op); target != nullptr)
+					{
+						number(*target);
+					}
+				}
+				number(instr);
+			}
+
+			inFunction &= instr != spv::Op::OpFunctionEnd;
+		});
+
+		// types, constants and global variables not used by any function, OpString etc.
+		iterateInstructions(number);
+	}
+
+	return spv::Id{ maxId };
+}
+
 bool spvgentwo::Module::resolveIDs(IAllocator* _pAllocator)
 {
 	bool success = true;
@@ -1162,35 +2009,40 @@ bool spvgentwo::Module::write(IWriter& _writer) const
 	return !iterateInstructions(writeInstr);
 }
 
-spvgentwo::spv::Id spvgentwo::Module::finalize( const Grammar* _pGrammar )
+spvgentwo::spv::Id spvgentwo::Module::finalize( const Grammar* _pGrammar, IdOrder _order )
 {
-	finalizeEntryPoints();
+	finalizeEntryPoints(_order == IdOrder::Stable);
 
-	return assignIDs( _pGrammar ); // overwrites m_spvBound
+	return assignIDs( _pGrammar, _order ); // overwrites m_spvBound
 }
 
-bool spvgentwo::Module::finalizeAndWrite(IWriter& _writer, const Grammar* _pGrammar)
+bool spvgentwo::Module::finalizeAndWrite(IWriter& _writer, const Grammar* _pGrammar, IdOrder _order)
 {
-	finalizeEntryPoints();
+	finalizeEntryPoints(_order == IdOrder::Stable);
 
-	assignIDs(_pGrammar); // overwrites m_spvBound
+	assignIDs(_pGrammar, _order); // overwrites m_spvBound
 
 	return write(_writer);
 }
 
-void spvgentwo::Module::finalizeEntryPoints()
+void spvgentwo::Module::finalizeEntryPoints(bool _incremental)
 {
+	const GlobalInterfaceVersion version = m_spvVersion < makeVersion(1u, 4u) ? GlobalInterfaceVersion::SpirV1_3 : GlobalInterfaceVersion::SpirV14_x;
+
 	// finalize entry points interfaces
 	for (EntryPoint& ep : m_EntryPoints)
 	{
-		if (m_spvVersion < makeVersion(1u, 4u))
-		{
-			ep.finalizeGlobalInterface(GlobalInterfaceVersion::SpirV1_3);
-		}
-		else
-		{
-			ep.finalizeGlobalInterface(GlobalInterfaceVersion::SpirV14_x);
-		}
+		ep.finalizeGlobalInterface(version, _incremental);
+	}
+
+	// callees can be shared by multiple entry points, reset after all interfaces are collected
+	for (Function& func : m_Functions)
+	{
+		func.setDirty(false);
+	}
+	for (EntryPoint& ep : m_EntryPoints)
+	{
+		ep.setDirty(false);
 	}
 }
 
@@ -1198,27 +2050,31 @@ bool spvgentwo::Module::read(IReader& _reader, const Grammar& _grammar)
 {
 	unsigned int word{ 0 };
 
-	if (_reader.get(word) == false || word != spv::MagicNumber)
+	if (_reader.get(word) == false || (word != spv::MagicNumber && word != byteSwap(spv::MagicNumber)))
 	{
 		logError("Failed to parse magic number");
 		return false;
 	}
 
-	if (logError(_reader.get(m_spvVersion), "Failed to parse version") == false) return false;
-	if (logError(_reader.get(m_spvGenerator), "Failed to parse generator") == false) return false;
-	if (logError(_reader.get(m_spvBound), "Failed to parse bounds") == false) return false;
-	if (logError(_reader.get(m_spvSchema), "Failed to parse schema") == false) return false;
+	// all subsequent words need to be swapped if the magic number was
+	ByteSwapReader swapped(_reader);
+	IReader& reader = word == spv::MagicNumber ? _reader : swapped;
+
+	if (logError(reader.get(m_spvVersion), "Failed to parse version") == false) return false;
+	if (logError(reader.get(m_spvGenerator), "Failed to parse generator") == false) return false;
+	if (logError(reader.get(m_spvBound), "Failed to parse bounds") == false) return false;
+	if (logError(reader.get(m_spvSchema), "Failed to parse schema") == false) return false;
 
 	HashMap<spv::Id, EntryPoint*> entryPoints(m_pAllocator);
 
-	while (_reader.get(word))
+	while (reader.get(word))
 	{
 		const spv::Op op = getOperation(word);
 		const unsigned int operands = getOperandCount(word) - 1u;
 
 		if (spv::IsTypeOp(op) || isSpecOrConstantOp(op))
 		{
-			if (m_TypesAndConstants.emplace_back(this, spv::Op::OpNop).readOperands(_reader, _grammar, op, operands) == false)
+			if (m_TypesAndConstants.emplace_back(this, spv::Op::OpNop).readOperands(reader, _grammar, op, operands) == false)
 				return false;
 			continue;
 		}
@@ -1228,7 +2084,7 @@ bool spvgentwo::Module::read(IReader& _reader, const Grammar& _grammar)
 		case spv::Op::OpCapability:
 		{
 			Instruction opCap(this, spv::Op::OpCapability);
-			if (opCap.readOperands(_reader, _grammar, op, operands) == false)
+			if (opCap.readOperands(reader, _grammar, op, operands) == false)
 			{
 				return false;
 			}
@@ -1239,7 +2095,7 @@ bool spvgentwo::Module::read(IReader& _reader, const Grammar& _grammar)
 		case spv::Op::OpExtension:
 		{
 			Instruction opExtension(this, spv::Op::OpExtension);
-			if (opExtension.readOperands(_reader, _grammar, op, operands) == false)
+			if (opExtension.readOperands(reader, _grammar, op, operands) == false)
 			{
 				return false;
 			}
@@ -1259,7 +2115,7 @@ bool spvgentwo::Module::read(IReader& _reader, const Grammar& _grammar)
 		case spv::Op::OpExtInstImport:
 		{
 			Instruction opExtInstrImport(this, spv::Op::OpExtension);
-			if (opExtInstrImport.readOperands(_reader, _grammar, op, operands) == false)
+			if (opExtInstrImport.readOperands(reader, _grammar, op, operands) == false)
 			{
 				return false;
 			}
@@ -1277,13 +2133,13 @@ bool spvgentwo::Module::read(IReader& _reader, const Grammar& _grammar)
 			break;
 		}
 		case spv::Op::OpMemoryModel:
-			if (m_MemoryModel.readOperands(_reader, _grammar, op, operands) == false)
+			if (m_MemoryModel.readOperands(reader, _grammar, op, operands) == false)
 				return false;
 			break;
 		case spv::Op::OpEntryPoint:
 		{
 			EntryPoint* ep = &m_EntryPoints.emplace_back(this);
-			if (ep->getEntryPoint()->readOperands(_reader, _grammar, op, operands) == false)
+			if (ep->getEntryPoint()->readOperands(reader, _grammar, op, operands) == false)
 			{
 				return false;
 			}
@@ -1321,23 +2177,23 @@ bool spvgentwo::Module::read(IReader& _reader, const Grammar& _grammar)
 			break;
 		case spv::Op::OpExecutionMode:
 		case spv::Op::OpExecutionModeId:
-			if (addExtensionModeInstr()->readOperands(_reader, _grammar, op, operands) == false)
+			if (addExtensionModeInstr()->readOperands(reader, _grammar, op, operands) == false)
 				return false;
 			break;
 		case spv::Op::OpString:
 		case spv::Op::OpSourceExtension:
 		case spv::Op::OpSource:
 		case spv::Op::OpSourceContinued:
-			if (addSourceStringInstr()->readOperands(_reader, _grammar, op, operands) == false)
+			if (addSourceStringInstr()->readOperands(reader, _grammar, op, operands) == false)
 				return false;
 			break;
 		case spv::Op::OpName:
 		case spv::Op::OpMemberName:
-			if (addNameInstr()->readOperands(_reader, _grammar, op, operands) == false)
+			if (addNameInstr()->readOperands(reader, _grammar, op, operands) == false)
 				return false;
 			break;
 		case spv::Op::OpModuleProcessed:
-			if (addModuleProccessedInstr()->readOperands(_reader, _grammar, op, operands) == false)
+			if (addModuleProccessedInstr()->readOperands(reader, _grammar, op, operands) == false)
 				return false;
 			break;
 		case spv::Op::OpDecorate:
@@ -1348,11 +2204,11 @@ bool spvgentwo::Module::read(IReader& _reader, const Grammar& _grammar)
 		case spv::Op::OpDecorateId:
 		case spv::Op::OpDecorateString:
 		case spv::Op::OpMemberDecorateString:
-			if (addDecorationInstr()->readOperands(_reader, _grammar, op, operands) == false)
+			if (addDecorationInstr()->readOperands(reader, _grammar, op, operands) == false)
 				return false;
 			break;
 		case spv::Op::OpVariable:
-			if (addGlobalVariableInstr()->readOperands(_reader, _grammar, op, operands) == false)
+			if (addGlobalVariableInstr()->readOperands(reader, _grammar, op, operands) == false)
 				return false;
 			
 			// check if storage type != function
@@ -1364,18 +2220,18 @@ bool spvgentwo::Module::read(IReader& _reader, const Grammar& _grammar)
 
 			break;
 		case spv::Op::OpUndef:
-			if(addUndefInstr()->readOperands(_reader, _grammar, op, operands) == false)
+			if(addUndefInstr()->readOperands(reader, _grammar, op, operands) == false)
 				return false;
 			break;
 		case spv::Op::OpLine:
 		case spv::Op::OpNoLine:
-			if (addLineInstr()->readOperands(_reader, _grammar, op, operands) == false)
+			if (addLineInstr()->readOperands(reader, _grammar, op, operands) == false)
 				return false;
 			break;
 		case spv::Op::OpFunction:
 		{
 			Instruction opFunc(this, spv::Op::OpNop);
-			if (opFunc.readOperands(_reader, _grammar, op, operands) == false)
+			if (opFunc.readOperands(reader, _grammar, op, operands) == false)
 			{
 				return false;
 			}
@@ -1398,7 +2254,7 @@ bool spvgentwo::Module::read(IReader& _reader, const Grammar& _grammar)
 				func = &m_Functions.emplace_back(this);
 			}
 
-			if (func->read(_reader, _grammar, stdrep::move(opFunc)) == false)
+			if (func->read(reader, _grammar, stdrep::move(opFunc)) == false)
 			{
 				return false;
 			}
@@ -1473,6 +2329,8 @@ spvgentwo::Instruction* spvgentwo::Module::getInstructionById(const spv::Id _res
 
 void spvgentwo::Module::gatherUses(const Instruction* _pInstr, List<Instruction*>& _outUses, Instruction* _pReplacement)
 {
+	_pInstr = unshareUses(_pInstr);
+
 	auto gather = [_pInstr, _pReplacement, &_outUses](Instruction& _instr)
 	{
 		for (auto it = _instr.getFirstActualOperand(), end = _instr.end(); it != end; ++it)
@@ -1498,6 +2356,8 @@ void spvgentwo::Module::replaceUses(const Instruction* _pInstr, Instruction* _pR
 		return;
 	}
 
+	_pInstr = unshareUses(_pInstr);
+
 	auto replace = [_pInstr, _pReplacement](Instruction& _instr)
 	{
 		for (auto it = _instr.getFirstActualOperand(), end = _instr.end(); it != end; ++it)
@@ -1525,19 +2385,95 @@ void spvgentwo::Module::removeFromLookupMaps(const Instruction* _pInstr)
 
 	if (auto itc = m_InstrToConstant.find(_pInstr); itc != m_InstrToConstant.end())
 	{
-		if (auto cti = m_ConstantToInstr.find(*itc->value); cti != m_ConstantToInstr.end())
+		const Constant* pConstant = itc->value;
+		m_InstrToConstant.erase(itc);
+
+		// spec constants are not unique, other instructions might still point to the same key
+		const Instruction* pOther = nullptr;
+		if (IsSpecConstantOp(pConstant->getOperation()))
+		{
+			for (const auto& [instr, constant] : m_InstrToConstant)
+			{
+				if (constant == pConstant)
+				{
+					pOther = instr;
+					break;
+				}
+			}
+		}
+
+		if (auto cti = m_ConstantToInstr.find(*pConstant); cti != m_ConstantToInstr.end())
 		{
-			m_ConstantToInstr.erase(cti);
+			if (pOther == nullptr)
+			{
+				m_ConstantToInstr.erase(cti);
+			}
+			else if (cti->value == _pInstr)
+			{
+				cti->value = const_cast<Instruction*>(pOther);
+			}
 		}
-		m_InstrToConstant.erase(itc);
 	}
 
 	m_NameLookup.eraseRange(_pInstr);
 }
 
+void spvgentwo::Module::removeFromLookupMaps(const List<const Instruction*>& _instrs)
+{
+	// keys of spec constants which might still be used by other instructions
+	HashMap<const Constant*, Instruction*> specConstants(m_pAllocator);
+
+	for (const Instruction* pInstr : _instrs)
+	{
+		if (auto itc = m_InstrToConstant.find(pInstr); itc != m_InstrToConstant.end() && IsSpecConstantOp(itc->value->getOperation()))
+		{
+			specConstants.emplaceUnique(itc->value, nullptr);
+			m_InstrToConstant.erase(itc);
+			m_NameLookup.eraseRange(pInstr);
+		}
+		else
+		{
+			removeFromLookupMaps(pInstr);
+		}
+	}
+
+	if (specConstants.elements() == 0u)
+	{
+		return;
+	}
+
+	for (const auto& [instr, constant] : m_InstrToConstant)
+	{
+		if (Instruction** pOther = specConstants.get(constant); pOther != nullptr && *pOther == nullptr)
+		{
+			*pOther = const_cast<Instruction*>(instr);
+		}
+	}
+
+	for (const auto& [pConstant, pOther] : specConstants)
+	{
+		if (auto cti = m_ConstantToInstr.find(*pConstant); cti != m_ConstantToInstr.end())
+		{
+			if (pOther == nullptr)
+			{
+				m_ConstantToInstr.erase(cti);
+			}
+			else if (m_InstrToConstant.find(cti->value) == m_InstrToConstant.end()) // removed
+			{
+				cti->value = pOther;
+			}
+		}
+	}
+}
+
 bool spvgentwo::Module::remove(const Instruction* _pInstr)
 {
-	if (_pInstr == nullptr || _pInstr->getModule() != this)
+	if (_pInstr != nullptr && _pInstr->getModule() != this)
+	{
+		_pInstr = unshare(_pInstr); // remove private copy of a shared instruction
+	}
+
+	if (_pInstr == nullptr)
 	{
 		return false;
 	}
@@ -1594,7 +2530,15 @@ bool spvgentwo::Module::remove(const Instruction* _pInstr)
 		if (erase(m_ModuleProccessed)) return true;
 		if (erase(m_Decorations)) return true;
 		if (erase(m_TypesAndConstants)) return true;
-		if (erase(m_GlobalVariables)) return true;
+		if (erase(m_GlobalVariables))
+		{
+			// the variable might be part of an entry point interface
+			for (EntryPoint& ep : m_EntryPoints)
+			{
+				ep.setDirty();
+			}
+			return true;
+		}
 		if (erase(m_Undefs)) return true;
 		if (erase(m_Lines)) return true;
 
@@ -44,6 +44,25 @@ spvgentwo::Type::Type(const Type& _other) :
 {
 }
 
+spvgentwo::Type::Type(const Type& _other, IAllocator* _pAllocator) :
+	m_Type(_other.m_Type),
+	m_IntWidth(_other.m_IntWidth),
+	m_IntSign(_other.m_IntSign),
+	m_StorageClass(_other.m_StorageClass),
+	m_ImgDimension(_other.m_ImgDimension),
+	m_ImgArray(_other.m_ImgArray),
+	m_ImgMultiSampled(_other.m_ImgMultiSampled),
+	m_ImgSamplerAccess(_other.m_ImgSamplerAccess),
+	m_ImgFormat(_other.m_ImgFormat),
+	m_AccessQualifier(_other.m_AccessQualifier),
+	m_subTypes(_pAllocator)
+{
+	for (const Type& sub : _other.m_subTypes)
+	{
+		m_subTypes.emplace_back(sub, _pAllocator);
+	}
+}
+
 spvgentwo::Type::~Type()
 {
 }
@@ -0,0 +1,258 @@
+#include "spvgentwo/Module.h"
+#include "spvgentwo/Grammar.h"
+
+#include "common/BinaryFileReader.h"
+#include "common/BinaryFileWriter.h"
+#include "common/BinaryVectorWriter.h"
+#include "common/ConsoleLogger.h"
+#include "common/HeapAllocator.h"
+#include "common/HeapList.h"
+#include "common/HeapString.h"
+#include "common/HeapVector.h"
+#include "common/PassManager.h"
+
+#include <cstring> // strcmp
+#include <cstdio> // printf
+#include <cstdlib> // strtoul
+#include <thread>
+#include <atomic>
+
+using namespace spvgentwo;
+
+ConsoleLogger g_logger;
+HeapAllocator g_alloc;
+const Grammar g_gram(&g_alloc);
+
+HeapList<const char*> g_inputs;
+HeapList<const char*> g_passes; // pipelines or single passes, see Pipelines::add
+const char* g_out = nullptr;
+const char* g_suffix = ".opt.spv";
+unsigned int g_threads = 0u;
+bool g_stats = false;
+IdOrder g_idOrder = IdOrder::Serialization;
+
+// counts words read from the input file
+class CountingReader : public IReader
+{
+public:
+	CountingReader(IReader& _reader) : m_reader(_reader) {}
+
+	bool get(unsigned int& _word) final
+	{
+		if (m_reader.get(_word))
+		{
+			++m_words;
+			return true;
+		}
+		return false;
+	}
+
+	sgt_size_t getWords() const { return m_words; }
+
+private:
+	IReader& m_reader;
+	sgt_size_t m_words = 0u;
+};
+
+void printStatistics(const PassStatistics& _stats, void* _pUserData)
+{
+	g_logger.logInfo("%s: %s %.3fms, %u -> %u instructions (%+d), %u allocations (%zu bytes)%s", static_cast<const char*>(_pUserData), _stats.name, _stats.milliseconds,
+		_stats.instructionsBefore, _stats.instructionsAfter, static_cast<int>(_stats.instructionsAfter) - static_cast<int>(_stats.instructionsBefore),
+		_stats.allocations, _stats.allocatedBytes, _stats.changed ? "" : " unchanged");
+}
+
+bool optimize(const char* _in, const char* _out)
+{
+	HeapAllocator alloc; // HeapAllocator statistics are not thread safe, one per file
+
+	BinaryFileReader file(alloc, _in);
+	if (file == false)
+	{
+		g_logger.logError("Failed to open \'%s\'", _in);
+		return false;
+	}
+
+	Module module(&alloc, &g_logger);
+
+	CountingReader reader(file);
+	if (module.readAndInit(reader, g_gram) == false)
+	{
+		g_logger.logError("Failed to parse \'%s\'", _in);
+		return false;
+	}
+
+	PassManager manager(&alloc, 1u); // files are processed in parallel instead
+	for (const char* pass : g_passes)
+	{
+		Pipelines::add(manager, pass);
+	}
+
+	if (g_stats)
+	{
+		manager.setInstrumentation(printStatistics, const_cast<char*>(_in));
+	}
+
+	manager.run(module);
+
+	// assignIDs compacts result ids to [1, bound)
+	Vector<unsigned int> binary(&alloc);
+	BinaryVectorWriter writer(binary);
+	if (module.finalizeAndWrite(writer, nullptr, g_idOrder) == false)
+	{
+		g_logger.logError("Failed to serialize \'%s\'", _in);
+		return false;
+	}
+
+	BinaryFileWriter out(alloc, _out);
+	if (out.isOpen() == false)
+	{
+		g_logger.logError("Failed to open \'%s\'", _out);
+		return false;
+	}
+
+	for (unsigned int word : binary)
+	{
+		out.put(word);
+	}
+
+	const sgt_size_t before = reader.getWords() * sizeof(unsigned int);
+	const sgt_size_t after = binary.size() * sizeof(unsigned int);
+	g_logger.logInfo("%s -> %s: %zu -> %zu bytes (%+.1f%%)", _in, _out, before, after, before != 0u ? 100.0 * (static_cast<double>(after) - static_cast<double>(before)) / static_cast<double>(before) : 0.0);
+
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	g_logger.logInfo("SpvGenTwoOpt by Fabian Wahlster - https://github.com/rAzoR8/SpvGenTwo");
+
+	for (int i = 1; i < argc; ++i)
+	{
+		const char* arg = argv[i];
+
+		if (strcmp(arg, "-o") == 0 || strcmp(arg, "-out") == 0)
+		{
+			if (++i < argc) g_out = argv[i];
+		}
+		else if (strcmp(arg, "-suffix") == 0)
+		{
+			if (++i < argc) g_suffix = argv[i];
+		}
+		else if (strcmp(arg, "-threads") == 0)
+		{
+			if (++i < argc) g_threads = static_cast<unsigned int>(strtoul(argv[i], nullptr, 10));
+		}
+		else if (strcmp(arg, "-stats") == 0)
+		{
+			g_stats = true;
+		}
+		else if (strcmp(arg, "-ids") == 0)
+		{
+			if (++i < argc)
+			{
+				if (strcmp(argv[i], "serialization") == 0) g_idOrder = IdOrder::Serialization;
+				else if (strcmp(argv[i], "frequency") == 0) g_idOrder = IdOrder::Frequency;
+				else if (strcmp(argv[i], "firstuse") == 0) g_idOrder = IdOrder::FirstUse;
+				else if (strcmp(argv[i], "stable") == 0) g_idOrder = IdOrder::Stable;
+				else
+				{
+					g_logger.logError("Unknown id order \'%s\' for -ids, valid orders: serialization, frequency, firstuse, stable", argv[i]);
+					return -1;
+				}
+			}
+		}
+		else if (arg[0] == '-')
+		{
+			PassManager probe(&g_alloc, 1u);
+			if (Pipelines::add(probe, arg))
+			{
+				g_passes.emplace_back(arg);
+			}
+			else
+			{
+				g_logger.logWarning("Unknown option %s", arg);
+			}
+		}
+		else
+		{
+			g_inputs.emplace_back(arg);
+		}
+	}
+
+	if (g_inputs.empty())
+	{
+		g_logger.logInfo("SpvGenTwoOpt [files] <options>");
+		g_logger.logInfo("Passes (applied in order): -O -Os -inline -promote -fold -peephole -licm -unroll -dedup -dce -strip -canonicalize");
+		g_logger.logInfo("-o [file] output file (single input), -suffix [str] appended to input paths otherwise (default .opt.spv)");
+		g_logger.logInfo("-threads [n] number of files optimized in parallel (0 = hardware threads), -stats print per pass timing and size");
+		g_logger.logInfo("-ids [serialization|frequency|firstuse|stable] order of the compacted result ids");
+		return 0;
+	}
+
+	if (g_out != nullptr && g_inputs.size() > 1u)
+	{
+		g_logger.logError("-o can only be used with a single input file, use -suffix");
+		return -1;
+	}
+
+	struct Job
+	{
+		const char* in = nullptr;
+		HeapString out;
+		bool success = false;
+	};
+
+	HeapList<Job> jobs;
+	HeapVector<Job*> queue; // List entries don't move
+	for (const char* in : g_inputs)
+	{
+		Job& job = jobs.emplace_back();
+		queue.emplace_back(&job);
+		job.in = in;
+		if (g_out != nullptr)
+		{
+			job.out = g_out;
+		}
+		else
+		{
+			job.out = in;
+			job.out += g_suffix;
+		}
+	}
+
+	unsigned int threadCount = g_threads != 0u ? g_threads : std::thread::hardware_concurrency();
+	if (threadCount == 0u || threadCount > jobs.size())
+	{
+		threadCount = static_cast<unsigned int>(jobs.size());
+	}
+
+	std::atomic<unsigned int> next{ 0u };
+	auto worker = [&]()
+	{
+		for (unsigned int i = next++; i < queue.size(); i = next++)
+		{
+			Job& job = *queue[i];
+			job.success = optimize(job.in, job.out.c_str());
+		}
+	};
+
+	HeapList<std::thread> threads;
+	for (unsigned int i = 1u; i < threadCount; ++i)
+	{
+		threads.emplace_back(worker);
+	}
+	worker();
+
+	for (std::thread& t : threads)
+	{
+		t.join();
+	}
+
+	int failed = 0;
+	for (const Job& job : jobs)
+	{
+		failed += job.success ? 0 : 1;
+	}
+
+	return failed == 0 ? 0 : -1;
+}
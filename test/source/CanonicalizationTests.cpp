@@ -0,0 +1,103 @@
+#include "common/Canonicalization.h"
+#include "common/BinaryVectorWriter.h"
+#include "common/HeapAllocator.h"
+
+#include "spvgentwo/Module.h"
+#include "spvgentwo/Grammar.h"
+#include "spvgentwo/Templates.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "test/SpvValidator.h"
+#include "test/TestLogger.h"
+
+using namespace spvgentwo;
+
+namespace
+{
+	HeapAllocator g_alloc;
+	test::TestLogger g_logger;
+	Grammar g_gram(&g_alloc);
+	test::SpvValidator g_validator(g_gram);
+
+	// the same module, types, constants, names and decorations are added in a different order if _reversed
+	void build(Module& _module, bool _reversed)
+	{
+		_module.addCapability(spv::Capability::Shader);
+
+		if (_reversed)
+		{
+			_module.constant(make_vector(1.f, 2.f), false, "xy");
+			_module.constant(3u, false, "three");
+			_module.type<array_t<float, 4>>();
+		}
+		else
+		{
+			_module.type<array_t<float, 4>>();
+			_module.constant(3u, false, "three");
+			_module.constant(make_vector(1.f, 2.f), false, "xy");
+		}
+
+		Instruction* a = _module.uniformConstant<float>("a");
+		Instruction* b = _module.uniformConstant<int>("b");
+
+		if (_reversed)
+		{
+			_module.addDecorationInstr()->opDecorate(b, spv::Decoration::Binding, 1u);
+			_module.addDecorationInstr()->opDecorate(a, spv::Decoration::Binding, 0u);
+			_module.addDecorationInstr()->opDecorate(a, spv::Decoration::DescriptorSet, 0u);
+		}
+		else
+		{
+			_module.addDecorationInstr()->opDecorate(a, spv::Decoration::DescriptorSet, 0u);
+			_module.addDecorationInstr()->opDecorate(a, spv::Decoration::Binding, 0u);
+			_module.addDecorationInstr()->opDecorate(b, spv::Decoration::Binding, 1u);
+		}
+
+		Function& func = _module.addFunction<float, float>("func");
+		BasicBlock& bb = *func;
+		Instruction* x = bb->opCompositeExtract(_module.constant(make_vector(1.f, 2.f)), 1u);
+		x = bb.Mul(x, func.getParameter(0));
+		x = bb.Add(x, bb->opLoad(a));
+		bb.returnValue(x);
+	}
+}
+
+TEST_CASE("canonicalize", "[Canonicalization]")
+{
+	Module forward(&g_alloc, &g_logger);
+	Module reversed(&g_alloc, &g_logger);
+	build(forward, false);
+	build(reversed, true);
+
+	const Canonicalization::Result first = Canonicalization::canonicalize(forward);
+	const Canonicalization::Result second = Canonicalization::canonicalize(reversed);
+	CHECK(first.movedTypesAndConstants + second.movedTypesAndConstants > 0u);
+	CHECK(first.movedDecorations + second.movedDecorations > 0u);
+	CHECK(first.movedNames + second.movedNames > 0u);
+
+	Vector<unsigned int> left(&g_alloc), right(&g_alloc);
+	{
+		BinaryVectorWriter<Vector<unsigned int>> writer(left);
+		REQUIRE(forward.finalizeAndWrite(writer, &g_gram));
+	}
+	{
+		BinaryVectorWriter<Vector<unsigned int>> writer(right);
+		REQUIRE(reversed.finalizeAndWrite(writer, &g_gram));
+	}
+
+	REQUIRE(left.size() == right.size());
+	bool equal = true;
+	for (sgt_size_t i = 0u; i < left.size() && equal; ++i)
+	{
+		equal = left[i] == right[i];
+	}
+	CHECK(equal);
+
+	// already canonical
+	const Canonicalization::Result again = Canonicalization::canonicalize(forward);
+	CHECK(again.movedTypesAndConstants + again.movedDecorations + again.movedNames == 0u);
+
+	REQUIRE(g_validator.validate(forward));
+	REQUIRE(g_validator.validate(reversed));
+}
@@ -0,0 +1,145 @@
+#include "common/CompressedBinary.h"
+#include "common/HeapAllocator.h"
+#include "common/BinaryVectorWriter.h"
+#include "common/BinaryVectorReader.h"
+
+#include "spvgentwo/Module.h"
+#include "spvgentwo/Grammar.h"
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+
+#include "test/Modules.h"
+#include "test/TestLogger.h"
+
+using namespace spvgentwo;
+
+namespace
+{
+	HeapAllocator g_alloc;
+	test::TestLogger g_logger;
+	Grammar g_gram(&g_alloc);
+
+	using Binary = Vector<unsigned int>;
+	using ModuleFunc = Module(*)(IAllocator*, ILogger*);
+
+	constexpr ModuleFunc g_modules[] = {
+		test::constants, test::types, test::imageRead, test::computeShader, test::controlFlow, test::expressionGraph,
+		test::extensions, test::fragmentShader, test::functionCall, test::geometryShader, test::physicalStorageTest, test::bitInstructionTest
+	};
+
+	Binary write(ModuleFunc _func)
+	{
+		Binary binary(&g_alloc);
+		BinaryVectorWriter<Binary> writer(binary);
+		_func(&g_alloc, &g_logger).finalizeAndWrite(writer, &g_gram);
+		return binary;
+	}
+
+	Binary compress(const Binary& _binary)
+	{
+		Binary compressed(&g_alloc);
+		BinaryVectorWriter<Binary> vectorWriter(compressed);
+		CompressedWriter writer(vectorWriter, g_gram, &g_alloc);
+
+		for (unsigned int word : _binary)
+		{
+			REQUIRE(writer.put(word));
+		}
+		REQUIRE(writer.flush());
+		return compressed;
+	}
+
+	Binary decompress(const Binary& _compressed)
+	{
+		Binary binary(&g_alloc);
+		BinaryVectorReader<Binary> vectorReader(_compressed);
+		CompressedReader reader(vectorReader, g_gram, &g_alloc);
+
+		for (unsigned int word = 0u; reader.get(word);)
+		{
+			binary.emplace_back(word);
+		}
+		return binary;
+	}
+
+	bool equal(const Binary& _left, const Binary& _right)
+	{
+		if (_left.size() != _right.size())
+		{
+			return false;
+		}
+
+		for (sgt_size_t i = 0u; i < _left.size(); ++i)
+		{
+			if (_left[i] != _right[i])
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+}
+
+TEST_CASE("roundtrip", "[CompressedBinary]")
+{
+	sgt_size_t spvWords = 0u;
+	sgt_size_t compressedWords = 0u;
+
+	for (ModuleFunc func : g_modules)
+	{
+		const Binary binary = write(func);
+		const Binary compressed = compress(binary);
+
+		REQUIRE(compressed[0] == CompressedWriter::Magic);
+		REQUIRE(equal(binary, decompress(compressed)));
+
+		spvWords += binary.size();
+		compressedWords += compressed.size();
+	}
+
+	// small ids and literals take one byte instead of four
+	REQUIRE(compressedWords * 2u < spvWords);
+
+	SECTION("module read")
+	{
+		const Binary compressed = compress(write(test::controlFlow));
+		BinaryVectorReader<Binary> vectorReader(compressed);
+		CompressedReader reader(vectorReader, g_gram, &g_alloc);
+
+		Module module(&g_alloc, &g_logger);
+		REQUIRE(module.readAndInit(reader, g_gram));
+		REQUIRE(module.getEntryPoints().empty() == false);
+	}
+
+	SECTION("pass through")
+	{
+		const Binary binary = write(test::controlFlow);
+		REQUIRE(equal(binary, decompress(binary)));
+	}
+
+	SECTION("truncated")
+	{
+		const Binary binary = write(test::controlFlow);
+		const Binary compressed = compress(binary);
+		const Binary truncated(&g_alloc, compressed.data(), compressed.size() / 2u);
+		REQUIRE(decompress(truncated).size() < binary.size());
+	}
+}
+
+TEST_CASE("compression benchmarks", "[CompressedBinary][!benchmark]")
+{
+	const Binary binary = write(test::fragmentShader);
+	const Binary compressed = compress(binary);
+
+	BENCHMARK("compress")
+	{
+		return compress(binary).size();
+	};
+
+	BENCHMARK("decompress")
+	{
+		return decompress(compressed).size();
+	};
+}
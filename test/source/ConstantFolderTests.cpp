@@ -0,0 +1,80 @@
+#include "spvgentwo/ConstantFolder.h"
+#include "spvgentwo/Module.h"
+#include "spvgentwo/Grammar.h"
+#include "spvgentwo/Templates.h"
+#include "common/HeapAllocator.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "test/SpvValidator.h"
+#include "test/TestLogger.h"
+
+using namespace spvgentwo;
+
+namespace
+{
+	HeapAllocator g_alloc;
+	test::TestLogger g_logger;
+	Grammar g_gram(&g_alloc);
+	test::SpvValidator g_validator(g_gram);
+	IConstantFolder g_folder;
+}
+
+TEST_CASE("fold", "[ConstantFolder]")
+{
+	Module module(&g_alloc, &g_logger);
+	module.addCapability(spv::Capability::Shader);
+	module.addCapability(spv::Capability::Int64);
+	module.setConstantFolder(&g_folder);
+
+	Function& func = module.addFunction<int, int>("func");
+	BasicBlock& bb = *func;
+	Instruction* x = func.getParameter(0);
+
+	// integer
+	REQUIRE(bb->opIAdd(module.constant(2), module.constant(3)) == module.constant(5));
+	REQUIRE(bb->opIMul(module.constant(0x80000000u), module.constant(2u)) == module.constant(0u)); // wraps around
+	REQUIRE(bb->opSDiv(module.constant(-7), module.constant(2)) == module.constant(-3));
+	REQUIRE(bb->opSRem(module.constant(-7), module.constant(3)) == module.constant(-1));
+	REQUIRE(bb->opSMod(module.constant(-7), module.constant(3)) == module.constant(2));
+	REQUIRE(bb->opSNegate(module.constant(4)) == module.constant(-4));
+	REQUIRE(bb->opShiftRightArithmetic(module.constant(-8), module.constant(1u)) == module.constant(-4));
+	REQUIRE(bb->opIAdd(module.constant(0xFFFFFFFFull), module.constant(1ull)) == module.constant(0x100000000ull));
+	REQUIRE(bb->opSLessThan(module.constant(-1), module.constant(1)) == module.constant(true));
+	REQUIRE(bb->opULessThan(module.constant(1u), module.constant(0u)) == module.constant(false));
+
+	// float
+	REQUIRE(bb->opFMul(module.constant(1.5f), module.constant(2.f)) == module.constant(3.f));
+	REQUIRE(bb->opFAdd(module.constant(0.25), module.constant(0.5)) == module.constant(0.75));
+	REQUIRE(bb->opFOrdLessThan(module.constant(1.f), module.constant(2.f)) == module.constant(true));
+
+	// conversion
+	REQUIRE(bb->opConvertSToF(module.constant(-2)) == module.constant(-2.f));
+	REQUIRE(bb->opConvertFToS(module.constant(-2.75f)) == module.constant(-2));
+	REQUIRE(bb->opBitcast(module.type<unsigned int>(), module.constant(1.f)) == module.constant(0x3f800000u));
+
+	// logical and composite
+	REQUIRE(bb->opLogicalAnd(module.constant(true), module.constant(false)) == module.constant(false));
+	REQUIRE(bb->opSelect(module.constant(false), module.constant(1), x) == x);
+	REQUIRE(bb->opIAdd(module.constant(make_vector(1, 2)), module.constant(make_vector(10, 20))) == module.constant(make_vector(11, 22)));
+	REQUIRE(bb->opCompositeExtract(module.constant(make_vector(1.f, 2.f, 3.f)), 2u) == module.constant(3.f));
+	REQUIRE(bb->opCompositeConstruct(module.type<vector_t<int, 2>>(), module.constant(1), module.constant(2)) == module.constant(make_vector(1, 2)));
+	REQUIRE(bb->opVectorShuffle(module.constant(make_vector(1, 2)), module.constant(make_vector(3, 4)), 3u, 0u) == module.constant(make_vector(4, 1)));
+
+	REQUIRE(bb.empty());
+
+	// not folded: non constant operands, spec constants and undefined results
+	REQUIRE(bb->opIAdd(x, module.constant(1))->getOperation() == spv::Op::OpIAdd);
+	REQUIRE(bb->opIAdd(module.specConstant(1), module.constant(1))->getOperation() == spv::Op::OpIAdd);
+	REQUIRE(bb->opSDiv(module.constant(1), module.constant(0))->getOperation() == spv::Op::OpSDiv);
+	REQUIRE(bb->opShiftLeftLogical(module.constant(1), module.constant(32))->getOperation() == spv::Op::OpShiftLeftLogical);
+	REQUIRE(bb.size() == 4u);
+
+	// BasicBlock operators
+	Instruction* sum = bb.Add(module.constant(20), module.constant(22));
+	REQUIRE(sum == module.constant(42));
+	bb.returnValue(bb.Add(x, sum));
+
+	module.finalize(&g_gram);
+	REQUIRE(g_validator.validate(module));
+}
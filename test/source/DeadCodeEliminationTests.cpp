@@ -0,0 +1,114 @@
+#include "common/DeadCodeElimination.h"
+#include "common/HeapAllocator.h"
+#include "common/LinkerHelper.h"
+
+#include "spvgentwo/Module.h"
+#include "spvgentwo/Grammar.h"
+#include "spvgentwo/Templates.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "test/Modules.h"
+#include "test/SpvValidator.h"
+#include "test/TestLogger.h"
+
+using namespace spvgentwo;
+
+namespace
+{
+	HeapAllocator g_alloc;
+	test::TestLogger g_logger;
+	Grammar g_gram(&g_alloc);
+	test::SpvValidator g_validator(g_gram);
+
+	bool contains(const List<Instruction>& _list, const Instruction* _pInstr)
+	{
+		return _list.find_if([_pInstr](const Instruction& _instr) { return &_instr == _pInstr; }) != _list.end();
+	}
+}
+
+TEST_CASE("eliminate", "[DeadCodeElimination]")
+{
+	Module module(&g_alloc, &g_logger);
+	module.addCapability(spv::Capability::Shader);
+	module.addCapability(spv::Capability::Linkage);
+
+	Instruction* usedVar = module.uniformConstant<float>("used");
+	Instruction* unusedVar = module.uniformConstant<vector_t<int, 3>>("unused");
+	module.addDecorationInstr()->opDecorate(usedVar, spv::Decoration::Binding, 0u);
+	module.addDecorationInstr()->opDecorate(unusedVar, spv::Decoration::Binding, 1u);
+	Instruction* unusedConst = module.constant(1234u);
+
+	// reachable from main
+	Function& callee = module.addFunction<float, float>("callee");
+	{
+		BasicBlock& bb = *callee;
+		bb.returnValue(bb.Mul(callee.getParameter(0), module.constant(2.f)));
+	}
+
+	// not reachable
+	Function& dead = module.addFunction<double, double>("dead");
+	{
+		BasicBlock& bb = *dead;
+		bb.returnValue(bb.Add(dead.getParameter(0), module.constant(3.0)));
+	}
+
+	// not reachable but exported
+	Function& exported = module.addFunction<float>("exported");
+	(*exported).returnValue(module.constant(4.f));
+	LinkerHelper::addLinkageDecoration(exported.getFunction(), spv::LinkageType::Export, "exported");
+
+	{
+		EntryPoint& entry = module.addEntryPoint(spv::ExecutionModel::GLCompute, "main");
+		entry.addExecutionMode(spv::ExecutionMode::LocalSize, 1, 1, 1);
+		BasicBlock& bb = *entry;
+		bb->call(&callee, bb->opLoad(usedVar));
+		bb.returnValue();
+	}
+
+	Instruction* doubleType = module.type<double>();
+	REQUIRE(module.getInstructionByName("unused") == unusedVar);
+
+	const DeadCodeElimination::Result result = DeadCodeElimination::eliminate(module);
+
+	REQUIRE(result.removedFunctions == 1u);
+	REQUIRE(result.removedInstructions > 0u);
+	REQUIRE(result.savedBytes > 0u);
+
+	REQUIRE(module.getFunctions().size() == 2u);
+	REQUIRE(module.getInstructionByName("dead") == nullptr);
+	REQUIRE(module.getInstructionByName("unused") == nullptr);
+	REQUIRE(module.getInstructionByName("exported") == exported.getFunction());
+	REQUIRE(contains(module.getGlobalVariables(), usedVar));
+	REQUIRE(contains(module.getGlobalVariables(), unusedVar) == false);
+	REQUIRE(contains(module.getTypesAndConstants(), unusedConst) == false);
+	REQUIRE(contains(module.getTypesAndConstants(), doubleType) == false);
+	REQUIRE(module.getDecorations().size() == 2u); // binding of used and linkage of exported
+
+	// removed from the lookup maps, adding them again creates new instructions
+	Instruction* newConst = module.constant(1234u);
+	REQUIRE(contains(module.getTypesAndConstants(), newConst));
+	REQUIRE(contains(module.getTypesAndConstants(), module.type<double>()));
+
+	module.finalize(&g_gram);
+	REQUIRE(g_validator.validate(module));
+
+	// a module without dead code is left unchanged
+	REQUIRE(DeadCodeElimination::eliminate(module).removedFunctions == 0u);
+}
+
+TEST_CASE("eliminate test modules", "[DeadCodeElimination]")
+{
+	auto check = [](Module&& _module)
+	{
+		DeadCodeElimination::eliminate(_module);
+		_module.finalize(&g_gram);
+		REQUIRE(g_validator.validate(_module));
+	};
+
+	check(test::controlFlow(&g_alloc, &g_logger));
+	check(test::fragmentShader(&g_alloc, &g_logger));
+	check(test::computeShader(&g_alloc, &g_logger));
+	check(test::functionCall(&g_alloc, &g_logger));
+	check(test::linkageLibA(&g_alloc, &g_logger));
+}
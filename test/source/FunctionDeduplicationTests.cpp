@@ -0,0 +1,148 @@
+#include "common/FunctionDeduplication.h"
+#include "common/HeapAllocator.h"
+
+#include "spvgentwo/Module.h"
+#include "spvgentwo/Grammar.h"
+#include "spvgentwo/Templates.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "test/SpvValidator.h"
+#include "test/TestLogger.h"
+
+using namespace spvgentwo;
+
+namespace
+{
+	HeapAllocator g_alloc;
+	test::TestLogger g_logger;
+	Grammar g_gram(&g_alloc);
+	test::SpvValidator g_validator(g_gram);
+
+	// float name(float x, float y) { return x * y + x; }
+	Function& addHelper(Module& _module, const char* _pName, bool _sub = false)
+	{
+		Function& func = _module.addFunction<float, float, float>(_pName, spv::FunctionControlMask::Const);
+		BasicBlock& bb = *func;
+		Instruction* x = func.getParameter(0);
+		Instruction* y = func.getParameter(1);
+		Instruction* z = bb.Mul(x, y);
+		bb.returnValue(_sub ? bb.Sub(z, x) : bb.Add(z, x));
+		return func;
+	}
+
+	// float name(float x) { return callee(x, x); }
+	Function& addWrapper(Module& _module, const char* _pName, Function& _callee)
+	{
+		Function& func = _module.addFunction<float, float>(_pName, spv::FunctionControlMask::Const);
+		BasicBlock& bb = *func;
+		Instruction* x = func.getParameter(0);
+		bb.returnValue(bb->call(&_callee, x, x));
+		return func;
+	}
+}
+
+TEST_CASE("deduplicate", "[FunctionDeduplication]")
+{
+	Module module(&g_alloc, &g_logger);
+	module.addCapability(spv::Capability::Shader);
+
+	Function& a = addHelper(module, "a");
+	Function& b = addHelper(module, "b");
+	Function& c = addHelper(module, "c", true);
+	Function& wrapA = addWrapper(module, "wrapA", a);
+	Function& wrapB = addWrapper(module, "wrapB", b);
+
+	REQUIRE(FunctionDeduplication::hash(a) == FunctionDeduplication::hash(b));
+	REQUIRE(FunctionDeduplication::equal(a, b));
+	REQUIRE(FunctionDeduplication::hash(a) != FunctionDeduplication::hash(c));
+	REQUIRE(FunctionDeduplication::equal(a, c) == false);
+	REQUIRE(FunctionDeduplication::equal(wrapA, wrapB) == false); // different callees
+
+	{
+		EntryPoint& entry = module.addEntryPoint(spv::ExecutionModel::GLCompute, "main");
+		entry.addExecutionMode(spv::ExecutionMode::LocalSize, 1, 1, 1);
+		BasicBlock& bb = *entry;
+		Instruction* one = module.constant(1.f);
+		bb->call(&a, one, one);
+		bb->call(&b, one, one);
+		bb->call(&c, one, one);
+		bb->call(&wrapA, one);
+		bb->call(&wrapB, one);
+		bb.returnValue();
+	}
+
+	const FunctionDeduplication::Result result = FunctionDeduplication::deduplicate(module);
+
+	// b is merged into a, which makes wrapB identical to wrapA in the second round
+	REQUIRE(result.removedFunctions == 2u);
+	REQUIRE(result.rounds == 2u);
+	REQUIRE(result.savedBytes > 0u);
+	REQUIRE(module.getFunctions().size() == 3u);
+	REQUIRE(module.getInstructionByName("b") == nullptr);
+	REQUIRE(module.getInstructionByName("wrapB") == nullptr);
+
+	unsigned int callsToA = 0u;
+	for (const Instruction& instr : *module.getEntryPoints().front())
+	{
+		if (instr.getOperation() == spv::Op::OpFunctionCall && instr.getFirstActualOperand()->getInstruction() == a.getFunction())
+		{
+			++callsToA;
+		}
+	}
+	REQUIRE(callsToA == 2u);
+
+	REQUIRE(FunctionDeduplication::deduplicate(module).removedFunctions == 0u);
+
+	module.finalize(&g_gram);
+	REQUIRE(g_validator.validate(module));
+}
+
+TEST_CASE("decorated instructions", "[FunctionDeduplication]")
+{
+	Module module(&g_alloc, &g_logger);
+	module.addCapability(spv::Capability::Shader);
+
+	auto addDecorated = [&module](const char* _pName) -> Function&
+	{
+		Function& func = addHelper(module, _pName);
+		for (Instruction& instr : func.front())
+		{
+			if (instr.getOperation() == spv::Op::OpFMul)
+			{
+				module.addDecorationInstr()->opDecorate(&instr, spv::Decoration::NoContraction);
+			}
+		}
+		return func;
+	};
+
+	Function& a = addDecorated("a");
+	Function& b = addDecorated("b");
+	Function& c = addHelper(module, "c");
+
+	REQUIRE(FunctionDeduplication::hash(a) == FunctionDeduplication::hash(b));
+	REQUIRE(FunctionDeduplication::equal(a, b));
+	REQUIRE(FunctionDeduplication::hash(a) != FunctionDeduplication::hash(c));
+	REQUIRE(FunctionDeduplication::equal(a, c) == false);
+
+	{
+		EntryPoint& entry = module.addEntryPoint(spv::ExecutionModel::GLCompute, "main");
+		entry.addExecutionMode(spv::ExecutionMode::LocalSize, 1, 1, 1);
+		BasicBlock& bb = *entry;
+		Instruction* one = module.constant(1.f);
+		bb->call(&a, one, one);
+		bb->call(&b, one, one);
+		bb->call(&c, one, one);
+		bb.returnValue();
+	}
+
+	// only b is a duplicate, c lacks NoContraction
+	REQUIRE(FunctionDeduplication::deduplicate(module).removedFunctions == 1u);
+	REQUIRE(module.getFunctions().size() == 2u);
+	REQUIRE(module.getInstructionByName("b") == nullptr);
+	REQUIRE(module.getInstructionByName("c") != nullptr);
+	REQUIRE(module.getDecorations().size() == 1u);
+
+	module.finalize(&g_gram);
+	REQUIRE(g_validator.validate(module));
+}
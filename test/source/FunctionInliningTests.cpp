@@ -0,0 +1,211 @@
+#include "common/FunctionInlining.h"
+#include "common/DeadCodeElimination.h"
+#include "common/HeapAllocator.h"
+
+#include "spvgentwo/Module.h"
+#include "spvgentwo/Grammar.h"
+#include "spvgentwo/Templates.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "test/Modules.h"
+#include "test/SpvValidator.h"
+#include "test/TestLogger.h"
+
+using namespace spvgentwo;
+
+namespace
+{
+	HeapAllocator g_alloc;
+	test::TestLogger g_logger;
+	Grammar g_gram(&g_alloc);
+	test::SpvValidator g_validator(g_gram);
+
+	unsigned int countCalls(const Function& _func)
+	{
+		unsigned int calls = 0u;
+		for (const BasicBlock& bb : _func)
+		{
+			for (const Instruction& instr : bb)
+			{
+				calls += instr == spv::Op::OpFunctionCall ? 1u : 0u;
+			}
+		}
+		return calls;
+	}
+}
+
+TEST_CASE("inline", "[FunctionInlining]")
+{
+	Module module(&g_alloc, &g_logger);
+	module.addCapability(spv::Capability::Shader);
+
+	// float square(float x) { float tmp = 1.0; tmp = x * x; return tmp; }
+	Function& square = module.addFunction<float, float>("square");
+	{
+		BasicBlock& bb = *square;
+		Instruction* tmp = square.variable(1.f, "tmp");
+		Instruction* x2 = bb.Mul(square.getParameter(0), square.getParameter(0));
+		bb->opStore(tmp, x2);
+		bb.returnValue(bb->opLoad(tmp));
+	}
+
+	// float clampPositive(float x) { float r = x; if(x < 0) r = 0; return r; } calls square
+	Function& clampPositive = module.addFunction<float, float>("clampPositive");
+	{
+		BasicBlock& bb = *clampPositive;
+		Instruction* x = clampPositive.getParameter(0);
+		Instruction* r = clampPositive.variable<float>("r");
+		Instruction* sq = bb->call(&square, x);
+		bb->opStore(r, sq);
+		BasicBlock& merge = bb.If(bb.Less(x, module.constant(0.f)), [&](BasicBlock& trueBB)
+		{
+			trueBB->opStore(r, module.constant(0.f));
+		});
+		merge.returnValue(merge->opLoad(r));
+	}
+
+	// never inlined
+	Function& noInline = module.addFunction<float, float>("noInline", spv::FunctionControlMask::DontInline);
+	{
+		BasicBlock& bb = *noInline;
+		bb.returnValue(bb.Add(noInline.getParameter(0), module.constant(1.f)));
+	}
+
+	Instruction* out = module.output<float>("out");
+
+	EntryPoint& entry = module.addEntryPoint(spv::ExecutionModel::Fragment, "main");
+	entry.addExecutionMode(spv::ExecutionMode::OriginUpperLeft);
+	{
+		BasicBlock& bb = *entry;
+		Instruction* a = bb->call(&clampPositive, module.constant(2.f));
+		Instruction* b = bb->call(&square, a);
+		Instruction* c = bb->call(&noInline, b);
+		bb->opStore(out, c);
+		bb.returnValue();
+	}
+
+	const FunctionInlining::Result result = FunctionInlining::inlineCalls(module);
+
+	// square into clampPositive, clampPositive and square into main
+	REQUIRE(result.inlinedCalls == 3u);
+	REQUIRE(countCalls(clampPositive) == 0u);
+	REQUIRE(countCalls(entry) == 1u); // noInline
+	REQUIRE(entry.size() == 9u); // main, clampPositive (entry, square, continuation, true, merge), continuation, square, continuation
+
+	module.finalize(&g_gram);
+	REQUIRE(g_validator.validate(module));
+
+	DeadCodeElimination::eliminate(module);
+	REQUIRE(module.getFunctions().size() == 1u);
+
+	module.finalize(&g_gram);
+	REQUIRE(g_validator.validate(module));
+}
+
+TEST_CASE("inline cost and control", "[FunctionInlining]")
+{
+	auto inlineAll = [](FunctionInlining::Options _options) -> unsigned int
+	{
+		Module module = test::functionCall(&g_alloc, &g_logger);
+		const unsigned int calls = FunctionInlining::inlineCalls(module, _options).inlinedCalls;
+
+		module.finalize(&g_gram);
+		REQUIRE(g_validator.validate(module));
+		return calls;
+	};
+
+	REQUIRE(inlineAll({}) == 1u);
+	REQUIRE(inlineAll({ 1u, true }) == 0u); // add has 2 instructions
+	REQUIRE(inlineAll({ 0u, true }) == 0u); // only FunctionControlMask::Inline
+}
+
+TEST_CASE("inline multiple returns", "[FunctionInlining]")
+{
+	Module module(&g_alloc, spv::AddressingModel::Physical64, spv::MemoryModel::OpenCL, &g_logger);
+	module.addCapability(spv::Capability::Kernel);
+	module.addCapability(spv::Capability::Addresses);
+
+	// int select(bool c) { if(c) return 1; return 2; } without structured control flow
+	Function& select = module.addFunction<int, bool>("select", spv::FunctionControlMask::Inline);
+	{
+		BasicBlock& bb = *select;
+		BasicBlock& trueBB = select.addBasicBlock();
+		BasicBlock& falseBB = select.addBasicBlock();
+		bb->opBranchConditional(select.getParameter(0), &trueBB, &falseBB);
+		trueBB.returnValue(module.constant(1));
+		falseBB.returnValue(module.constant(2));
+	}
+
+	EntryPoint& entry = module.addEntryPoint(spv::ExecutionModel::Kernel, "main");
+	{
+		BasicBlock& bb = *entry;
+		Instruction* var = entry.variable<int>("var");
+		Instruction* value = bb->call(&select, module.constant(true));
+		bb->opStore(var, value);
+		bb.returnValue();
+	}
+
+	REQUIRE(FunctionInlining::inlineCalls(module, { 0u, true }).inlinedCalls == 1u);
+	REQUIRE(countCalls(entry) == 0u);
+
+	const BasicBlock& cont = entry.back();
+	REQUIRE(cont.front().getOperation() == spv::Op::OpPhi);
+	REQUIRE(cont.front().size() == 6u); // type, id, 2 pairs
+	REQUIRE((cont.begin() + 1u)->getOperation() == spv::Op::OpStore);
+
+	module.finalize(&g_gram);
+	REQUIRE(g_validator.validate(module));
+}
+
+TEST_CASE("inline decorated instructions", "[FunctionInlining]")
+{
+	Module module(&g_alloc, &g_logger);
+	module.addCapability(spv::Capability::Shader);
+
+	// float mul(float x) { return x * x; } with a NoContraction multiplication and a RelaxedPrecision parameter
+	Function& mul = module.addFunction<float, float>("mul");
+	{
+		BasicBlock& bb = *mul;
+		Instruction* x = mul.getParameter(0);
+		Instruction* x2 = bb.Mul(x, x);
+		bb.returnValue(x2);
+		module.addDecorationInstr()->opDecorate(x2, spv::Decoration::NoContraction);
+		module.addDecorationInstr()->opDecorate(x, spv::Decoration::RelaxedPrecision);
+	}
+
+	Instruction* out = module.output<float>("out");
+
+	EntryPoint& entry = module.addEntryPoint(spv::ExecutionModel::Fragment, "main");
+	entry.addExecutionMode(spv::ExecutionMode::OriginUpperLeft);
+	{
+		BasicBlock& bb = *entry;
+		Instruction* a = bb->call(&mul, module.constant(2.f));
+		Instruction* b = bb->call(&mul, a);
+		bb->opStore(out, b);
+		bb.returnValue();
+	}
+
+	REQUIRE(FunctionInlining::inlineCalls(module).inlinedCalls == 2u);
+	REQUIRE(countCalls(entry) == 0u);
+
+	unsigned int noContraction = 0u;
+	for (const Instruction& decoration : module.getDecorations())
+	{
+		const Instruction* target = decoration.front().getInstruction();
+		if ((decoration.begin() + 1u)->getLiteral().value == static_cast<unsigned int>(spv::Decoration::NoContraction))
+		{
+			REQUIRE(target->getOperation() == spv::Op::OpFMul);
+			noContraction += target->getFunction() == &entry ? 1u : 0u;
+		}
+		else // the parameter decoration is not copied to the arguments
+		{
+			REQUIRE(target == mul.getParameter(0));
+		}
+	}
+	REQUIRE(noContraction == 2u);
+	REQUIRE(module.getDecorations().size() == 4u);
+
+	module.finalize(&g_gram);
+	REQUIRE(g_validator.validate(module));
+}
@@ -0,0 +1,164 @@
+#include "common/HeapAllocator.h"
+
+#include "spvgentwo/Constant.h"
+#include "spvgentwo/Operand.h"
+#include "spvgentwo/String.h"
+
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+
+using namespace spvgentwo;
+
+namespace
+{
+	HeapAllocator g_alloc;
+
+	Type makeTypeTree()
+	{
+		Type inner(&g_alloc);
+		inner.Struct();
+		inner.FloatM();
+		inner.IntM();
+		inner.Member().VectorElement(3).Float();
+
+		Type type(&g_alloc);
+		type.Struct();
+		type.FloatM();
+		type.Member().VectorElement(4).Float();
+		type.Member(&inner);
+		type.ArrayM(16u, &inner);
+		return type;
+	}
+
+	constexpr const char* g_extensions[] = {
+		"GLSL.std.450",
+		"SPV_KHR_shader_draw_parameters",
+		"SPV_KHR_storage_buffer_storage_class",
+		"SPV_KHR_variable_pointers",
+		"SPV_EXT_descriptor_indexing",
+		"SPV_KHR_physical_storage_buffer",
+		"SPV_KHR_ray_tracing",
+		"SPV_KHR_ray_query",
+	};
+
+	constexpr Hash64 g_constHash = [] { WordHasher h{}; return h("GLSL.std.450"); }();
+}
+
+TEST_CASE("WordHasher", "[Hash]")
+{
+	SECTION("chunking")
+	{
+		unsigned char bytes[37]{};
+		for (unsigned char i = 0u; i < sizeof(bytes); ++i)
+		{
+			bytes[i] = i * 7u;
+		}
+
+		WordHasher whole;
+		whole.add(bytes, sizeof(bytes));
+
+		for (sgt_size_t split = 0u; split <= sizeof(bytes); ++split)
+		{
+			WordHasher parts;
+			parts.add(bytes, split);
+			parts.add(bytes + split, sizeof(bytes) - split);
+			REQUIRE(parts.get() == whole.get());
+		}
+
+		// length is part of the hash
+		WordHasher shorter;
+		REQUIRE(shorter.add(bytes, sizeof(bytes) - 1u) != whole.get());
+
+		WordHasher zeros;
+		const unsigned char zero[2]{};
+		REQUIRE(zeros.add(zero, 1u) != zeros.add(zero + 1u, 1u));
+	}
+
+	SECTION("strings")
+	{
+		String ext(&g_alloc, "GLSL.std.450");
+		REQUIRE(hashKey(ext) == g_constHash);
+
+		WordHasher h;
+		REQUIRE(h("GLSL.std.450") == g_constHash);
+		REQUIRE(hashKey(String(&g_alloc, "GLSL.std.451")) != g_constHash);
+	}
+
+	SECTION("types")
+	{
+		const Type a = makeTypeTree();
+		Type b = makeTypeTree();
+		REQUIRE(hashKey(a) == hashKey(b));
+
+		b.DoubleM();
+		REQUIRE(hashKey(a) != hashKey(b));
+
+		// both hashers go through Hasher<Type>
+		REQUIRE(hash(a) == hash(makeTypeTree()));
+		REQUIRE(hash(a) != hash(b));
+	}
+}
+
+TEST_CASE("hash benchmarks", "[Hash][!benchmark]")
+{
+	const Type type = makeTypeTree();
+
+	Vector<Operand> operands(&g_alloc);
+	for (unsigned int i = 0u; i < 64u; ++i)
+	{
+		operands.emplace_back(literal_t{ i * 3u });
+	}
+
+	BENCHMARK("FNV1a Type tree")
+	{
+		return hash(type);
+	};
+
+	BENCHMARK("WordHasher Type tree")
+	{
+		WordHasher h;
+		return h(type);
+	};
+
+	BENCHMARK("FNV1a operand list")
+	{
+		FNV1aHasher h;
+		for (const Operand& op : operands)
+		{
+			h << op.type << op.literal.value;
+		}
+		return h.get();
+	};
+
+	BENCHMARK("WordHasher operand list")
+	{
+		WordHasher h;
+		for (const Operand& op : operands)
+		{
+			h << op.type << op.literal.value;
+		}
+		return h.get();
+	};
+
+	BENCHMARK("FNV1a extension names")
+	{
+		sgt_uint64_t sum = 0u;
+		for (const char* ext : g_extensions)
+		{
+			FNV1aHasher h;
+			sum ^= h(ext);
+		}
+		return sum;
+	};
+
+	BENCHMARK("WordHasher extension names")
+	{
+		sgt_uint64_t sum = 0u;
+		for (const char* ext : g_extensions)
+		{
+			WordHasher h;
+			sum ^= h(ext);
+		}
+		return sum;
+	};
+}
@@ -0,0 +1,160 @@
+#include "common/InstructionStream.h"
+#include "common/HeapAllocator.h"
+#include "common/BinaryVectorWriter.h"
+#include "common/BinaryVectorReader.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "test/Modules.h"
+#include "test/TestLogger.h"
+
+using namespace spvgentwo;
+
+namespace
+{
+	HeapAllocator g_alloc;
+	test::TestLogger g_logger;
+	Grammar g_gram(&g_alloc);
+
+	using Binary = Vector<unsigned int>;
+
+	Binary write(Module&& _module)
+	{
+		Binary binary(&g_alloc);
+		BinaryVectorWriter<Binary> writer(binary);
+		_module.finalizeAndWrite(writer, &g_gram);
+		return binary;
+	}
+
+	bool run(InstructionStream& _stream, const Binary& _in, Binary& _out)
+	{
+		_out.clear();
+		BinaryVectorReader<Binary> reader(_in);
+		BinaryVectorWriter<Binary> writer(_out);
+		return _stream.run(reader, writer);
+	}
+
+	bool equal(const Binary& _left, const Binary& _right)
+	{
+		if (_left.size() != _right.size())
+		{
+			return false;
+		}
+
+		for (sgt_size_t i = 0u; i < _left.size(); ++i)
+		{
+			if (_left[i] != _right[i])
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	// moves OpName instructions to the end of the stream
+	class DeferNamesFilter : public IInstructionFilter
+	{
+	public:
+		DeferNamesFilter(IAllocator* _pAllocator) : m_names(_pAllocator) {}
+
+		bool filter(StreamInstruction& _instr, IInstructionSink& _next) final
+		{
+			if (_instr.getOperation() != spv::Op::OpName)
+			{
+				return _next.emit(_instr);
+			}
+
+			for (unsigned int i = 0u; i < _instr.wordCount; ++i)
+			{
+				m_names.emplace_back(_instr.pWords[i]);
+			}
+			return true;
+		}
+
+		bool end(IInstructionSink& _next) final
+		{
+			for (sgt_size_t i = 0u; i < m_names.size(); i += m_names[i] >> spv::WordCountShift)
+			{
+				if (_next.emit(m_names.data() + i, m_names[i] >> spv::WordCountShift) == false)
+				{
+					return false;
+				}
+			}
+			return true;
+		}
+
+	private:
+		Binary m_names;
+	};
+}
+
+TEST_CASE("passthrough", "[InstructionStream]")
+{
+	const Binary in = write(test::fragmentShader(&g_alloc, &g_logger));
+
+	InstructionStream stream(&g_alloc, &g_gram, &g_logger);
+	Binary out(&g_alloc);
+	REQUIRE(run(stream, in, out));
+	REQUIRE(equal(in, out));
+
+	// OpNop claiming 3 words at the end of the stream, no logger because TestLogger fails on errors
+	Binary truncated(&g_alloc, in.data(), in.size());
+	truncated.emplace_back((3u << spv::WordCountShift) | static_cast<unsigned int>(spv::Op::OpNop));
+
+	InstructionStream silent(&g_alloc, &g_gram);
+	REQUIRE(run(silent, truncated, out) == false);
+}
+
+TEST_CASE("strip debug", "[InstructionStream]")
+{
+	const Binary in = write(test::controlFlow(&g_alloc, &g_logger));
+
+	StripDebugFilter strip;
+	DeferNamesFilter defer(&g_alloc);
+
+	InstructionStream stream(&g_alloc, &g_gram, &g_logger);
+	stream.add(&defer).add(&strip); // names deferred to the end are still stripped
+
+	Binary out(&g_alloc);
+	REQUIRE(run(stream, in, out));
+	REQUIRE(out.size() < in.size());
+
+	Module module(&g_alloc, &g_logger);
+	BinaryVectorReader<Binary> reader(out);
+	REQUIRE(module.readAndInit(reader, g_gram));
+	REQUIRE(module.getNames().empty());
+	REQUIRE(module.getEntryPoints().empty() == false);
+}
+
+TEST_CASE("remap ids", "[InstructionStream]")
+{
+	const Binary in = write(test::controlFlow(&g_alloc, &g_logger));
+	const unsigned int bound = in[3];
+
+	// reverse all ids
+	Binary table(&g_alloc);
+	for (unsigned int id = 0u; id < bound; ++id)
+	{
+		table.emplace_back(id == 0u ? 0u : bound - id);
+	}
+
+	IdRemapFilter remap(&g_alloc, &g_gram, table.data(), bound);
+
+	InstructionStream stream(&g_alloc, &g_gram, &g_logger);
+	stream.add(&remap);
+
+	Binary reversed(&g_alloc);
+	REQUIRE(run(stream, in, reversed));
+	REQUIRE(reversed.size() == in.size());
+	REQUIRE(equal(in, reversed) == false);
+
+	Module module(&g_alloc, &g_logger);
+	BinaryVectorReader<Binary> reader(reversed);
+	REQUIRE(module.readAndInit(reader, g_gram));
+
+	// the mapping is its own inverse
+	Binary restored(&g_alloc);
+	REQUIRE(run(stream, reversed, restored));
+	REQUIRE(equal(in, restored));
+}
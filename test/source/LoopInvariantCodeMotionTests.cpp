@@ -0,0 +1,234 @@
+#include "common/LoopInvariantCodeMotion.h"
+#include "common/HeapAllocator.h"
+
+#include "spvgentwo/Module.h"
+#include "spvgentwo/Grammar.h"
+#include "spvgentwo/Templates.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "test/SpvValidator.h"
+#include "test/TestLogger.h"
+
+using namespace spvgentwo;
+
+namespace
+{
+	HeapAllocator g_alloc;
+	test::TestLogger g_logger;
+	Grammar g_gram(&g_alloc);
+	test::SpvValidator g_validator(g_gram);
+}
+
+TEST_CASE("hoist", "[LoopInvariantCodeMotion]")
+{
+	Module module(&g_alloc, &g_logger);
+	module.addCapability(spv::Capability::Shader);
+
+	Instruction* scale = module.uniform<float>("u_scale");
+	module.addDecorationInstr()->opDecorate(scale, spv::Decoration::NonWritable);
+	Instruction* offset = module.uniform<float>("u_offset"); // writable
+	Instruction* counter = module.variable<float>(spv::StorageClass::Private, "counter");
+	Instruction* out = module.output<float>("out");
+
+	EntryPoint& entry = module.addEntryPoint(spv::ExecutionModel::Fragment, "main");
+	entry.addExecutionMode(spv::ExecutionMode::OriginUpperLeft);
+
+	Instruction* sum = entry.variable<float>("sum");
+	Instruction* i = entry.variable<int>("i");
+
+	BasicBlock& bb = *entry;
+	bb->opStore(sum, module.constant(0.f));
+	bb->opStore(i, module.constant(0));
+
+	Instruction* scaled = nullptr;
+	BasicBlock* body = nullptr;
+
+	BasicBlock& merge = bb.Loop([&](BasicBlock& cond) -> Instruction*
+	{
+		Instruction* iv = cond->opLoad(i);
+		return cond.Less(iv, module.constant(4));
+	}, [&](BasicBlock& inc)
+	{
+		Instruction* iv = inc->opLoad(i);
+		iv = inc.Add(iv, module.constant(1));
+		inc->opStore(i, iv);
+	}, [&](BasicBlock& loopBody)
+	{
+		body = &loopBody;
+
+		Instruction* s = loopBody->opLoad(scale); // read only: hoisted
+		scaled = loopBody.Mul(s, module.constant(2.f)); // invariant: hoisted
+
+		Instruction* o = loopBody->opLoad(offset); // written in the loop
+		Instruction* c = loopBody->opLoad(counter); // written in the loop
+		loopBody->opStore(offset, scaled);
+		loopBody->opStore(counter, c);
+
+		Instruction* x = loopBody.Add(scaled, o);
+		x = loopBody.Add(x, loopBody->opLoad(sum));
+		loopBody->opStore(sum, x);
+	});
+
+	Instruction* result = merge->opLoad(sum);
+	merge->opStore(out, result);
+	merge.returnValue();
+
+	const LoopInvariantCodeMotion::Result res = LoopInvariantCodeMotion::hoist(module);
+
+	CHECK(res.hoistedInstructions == 2u);
+	CHECK(res.hoistedLoads == 1u);
+
+	// pre-header: 2 variables, 2 stores, 2 hoisted instructions, branch
+	CHECK(bb.size() == 7u);
+	CHECK(*bb.getTerminator()->getFirstActualOperand()->getBranchTarget()->getTerminator() == spv::Op::OpBranch);
+
+	const Instruction& hoistedMul = *bb.last().prev();
+	CHECK(hoistedMul == spv::Op::OpFMul);
+	CHECK(hoistedMul.getBasicBlock() == &bb);
+
+	unsigned int bodyLoads = 0u;
+	for (const Instruction& instr : *body)
+	{
+		bodyLoads += instr == spv::Op::OpLoad ? 1u : 0u;
+		CHECK(instr != spv::Op::OpFMul);
+	}
+	CHECK(bodyLoads == 3u);
+
+	module.finalize(&g_gram);
+	REQUIRE(g_validator.validate(module));
+}
+
+TEST_CASE("hoist into branch only pre-header", "[LoopInvariantCodeMotion]")
+{
+	Module module(&g_alloc, &g_logger);
+	module.addCapability(spv::Capability::Shader);
+
+	Instruction* scale = module.uniform<float>("u_scale");
+	module.addDecorationInstr()->opDecorate(scale, spv::Decoration::NonWritable);
+	Instruction* out = module.output<float>("out");
+
+	EntryPoint& entry = module.addEntryPoint(spv::ExecutionModel::Fragment, "main");
+	entry.addExecutionMode(spv::ExecutionMode::OriginUpperLeft);
+
+	Instruction* sum = entry.variable<float>("sum");
+	Instruction* i = entry.variable<int>("i");
+
+	BasicBlock& bb = *entry;
+	bb->opStore(sum, module.constant(0.f));
+	bb->opStore(i, module.constant(0));
+
+	// the pre-header only consists of the branch to the loop header
+	BasicBlock& preHeader = entry.addBasicBlock();
+	bb->opBranch(&preHeader);
+
+	BasicBlock& merge = preHeader.Loop([&](BasicBlock& cond) -> Instruction*
+	{
+		Instruction* iv = cond->opLoad(i);
+		return cond.Less(iv, module.constant(4));
+	}, [&](BasicBlock& inc)
+	{
+		Instruction* iv = inc->opLoad(i);
+		iv = inc.Add(iv, module.constant(1));
+		inc->opStore(i, iv);
+	}, [&](BasicBlock& loopBody)
+	{
+		Instruction* s = loopBody->opLoad(scale);
+		Instruction* x = loopBody.Add(s, loopBody->opLoad(sum));
+		loopBody->opStore(sum, x);
+	});
+
+	Instruction* result = merge->opLoad(sum);
+	merge->opStore(out, result);
+	merge.returnValue();
+
+	REQUIRE(preHeader.size() == 1u);
+
+	const LoopInvariantCodeMotion::Result res = LoopInvariantCodeMotion::hoist(module);
+
+	CHECK(res.hoistedInstructions == 1u);
+	CHECK(res.hoistedLoads == 1u);
+	CHECK(preHeader.size() == 2u);
+	CHECK(preHeader.front() == spv::Op::OpLoad);
+
+	module.finalize(&g_gram);
+	REQUIRE(g_validator.validate(module));
+}
+
+TEST_CASE("keep guarded division in the loop", "[LoopInvariantCodeMotion]")
+{
+	Module module(&g_alloc, &g_logger);
+	module.addCapability(spv::Capability::Shader);
+
+	Instruction* numerator = module.uniform<int>("u_numerator");
+	module.addDecorationInstr()->opDecorate(numerator, spv::Decoration::NonWritable);
+	Instruction* divisor = module.uniform<int>("u_divisor");
+	module.addDecorationInstr()->opDecorate(divisor, spv::Decoration::NonWritable);
+	Instruction* out = module.output<int>("out");
+
+	EntryPoint& entry = module.addEntryPoint(spv::ExecutionModel::Fragment, "main");
+	entry.addExecutionMode(spv::ExecutionMode::OriginUpperLeft);
+
+	Instruction* sum = entry.variable<int>("sum");
+	Instruction* i = entry.variable<int>("i");
+
+	BasicBlock& bb = *entry;
+	bb->opStore(sum, module.constant(0));
+	bb->opStore(i, module.constant(0));
+
+	// the Loop template terminates the body itself, build the loop by hand to nest a selection in it
+	BasicBlock& header = entry.addBasicBlock("LoopEntry");
+	BasicBlock& cond = entry.addBasicBlock("LoopCondition");
+	BasicBlock& body = entry.addBasicBlock("LoopBody");
+	BasicBlock& guarded = entry.addBasicBlock("Guarded");
+	BasicBlock& ifMerge = entry.addBasicBlock("IfMerge");
+	BasicBlock& inc = entry.addBasicBlock("LoopContinue");
+	BasicBlock& merge = entry.addBasicBlock("LoopMerge");
+
+	bb->opBranch(&header);
+	header->opLoopMerge(&merge, &inc, spv::LoopControlMask::MaskNone);
+	header->opBranch(&cond);
+
+	Instruction* iv = cond->opLoad(i);
+	Instruction* less = cond.Less(iv, module.constant(4));
+	cond->opBranchConditional(less, &body, &merge);
+
+	Instruction* n = body->opLoad(numerator);
+	Instruction* d = body->opLoad(divisor);
+	Instruction* nonZero = body.NotEqual(d, module.constant(0));
+	body->opSelectionMerge(&ifMerge, spv::SelectionControlMask::MaskNone);
+	body->opBranchConditional(nonZero, &guarded, &ifMerge);
+
+	// if (d != 0) sum += n / d; the division is invariant but must not execute for d == 0
+	Instruction* q = guarded->opSDiv(n, d);
+	Instruction* s = guarded->opLoad(sum);
+	guarded->opStore(sum, guarded.Add(s, q));
+	guarded->opBranch(&ifMerge);
+
+	ifMerge->opBranch(&inc);
+
+	iv = inc->opLoad(i);
+	iv = inc.Add(iv, module.constant(1));
+	inc->opStore(i, iv);
+	inc->opBranch(&header);
+
+	Instruction* result = merge->opLoad(sum);
+	merge->opStore(out, result);
+	merge.returnValue();
+
+	const LoopInvariantCodeMotion::Result res = LoopInvariantCodeMotion::hoist(module);
+
+	// both loads and the comparison
+	CHECK(res.hoistedInstructions == 3u);
+	CHECK(res.hoistedLoads == 2u);
+
+	for (const Instruction& instr : bb)
+	{
+		CHECK(instr != spv::Op::OpSDiv);
+	}
+
+	CHECK(guarded.front() == spv::Op::OpSDiv);
+
+	module.finalize(&g_gram);
+	REQUIRE(g_validator.validate(module));
+}
@@ -0,0 +1,214 @@
+#include "common/LoopUnrolling.h"
+#include "common/VariablePromotion.h"
+#include "common/HeapAllocator.h"
+
+#include "spvgentwo/Module.h"
+#include "spvgentwo/Grammar.h"
+#include "spvgentwo/Templates.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "test/SpvValidator.h"
+#include "test/TestLogger.h"
+
+using namespace spvgentwo;
+
+namespace
+{
+	HeapAllocator g_alloc;
+	test::TestLogger g_logger;
+	Grammar g_gram(&g_alloc);
+	test::SpvValidator g_validator(g_gram);
+
+	unsigned int count(const Function& _func, spv::Op _op)
+	{
+		unsigned int n = 0u;
+		for (const BasicBlock& bb : _func)
+		{
+			for (const Instruction& instr : bb)
+			{
+				n += instr == _op ? 1u : 0u;
+			}
+		}
+		return n;
+	}
+
+	// float sum = 0; for(int i = 0; i < _count; ++i) { sum += in * float(i); } out = sum;
+	EntryPoint& makeLoop(Module& _module, int _count)
+	{
+		_module.addCapability(spv::Capability::Shader);
+
+		Instruction* in = _module.input<float>("in");
+		Instruction* out = _module.output<float>("out");
+
+		EntryPoint& entry = _module.addEntryPoint(spv::ExecutionModel::Fragment, "main");
+		entry.addExecutionMode(spv::ExecutionMode::OriginUpperLeft);
+
+		Instruction* sum = entry.variable<float>("sum");
+		Instruction* i = entry.variable<int>("i");
+
+		BasicBlock& bb = *entry;
+		bb->opStore(sum, _module.constant(0.f));
+		bb->opStore(i, _module.constant(0));
+
+		BasicBlock& merge = bb.Loop([&](BasicBlock& cond) -> Instruction*
+		{
+			Instruction* iv = cond->opLoad(i);
+			return cond.Less(iv, _module.constant(_count));
+		}, [&](BasicBlock& inc)
+		{
+			Instruction* iv = inc->opLoad(i);
+			iv = inc.Add(iv, _module.constant(1));
+			inc->opStore(i, iv);
+		}, [&](BasicBlock& body)
+		{
+			Instruction* iv = body->opLoad(i);
+			Instruction* x = body->opConvertSToF(iv);
+			x = body.Mul(x, body->opLoad(in));
+			x = body.Add(x, body->opLoad(sum));
+			body->opStore(sum, x);
+		});
+
+		Instruction* result = merge->opLoad(sum);
+		merge->opStore(out, result);
+		merge.returnValue();
+
+		return entry;
+	}
+}
+
+TEST_CASE("unroll", "[LoopUnrolling]")
+{
+	SECTION("variables")
+	{
+		Module module(&g_alloc, &g_logger);
+		EntryPoint& entry = makeLoop(module, 4);
+
+		const LoopUnrolling::Result result = LoopUnrolling::unroll(module);
+
+		CHECK(result.fullyUnrolled == 1u);
+		CHECK(result.partiallyUnrolled == 0u);
+		CHECK(count(entry, spv::Op::OpLoopMerge) == 0u);
+		CHECK(count(entry, spv::Op::OpBranchConditional) == 0u);
+		CHECK(count(entry, spv::Op::OpConvertSToF) == 4u);
+
+		module.finalize(&g_gram);
+		REQUIRE(g_validator.validate(module));
+	}
+
+	SECTION("ssa")
+	{
+		Module module(&g_alloc, &g_logger);
+		EntryPoint& entry = makeLoop(module, 3);
+
+		const VariablePromotion::Result promoted = VariablePromotion::promote(module);
+		REQUIRE(promoted.insertedPhis == 2u);
+
+		const LoopUnrolling::Result result = LoopUnrolling::unroll(module);
+
+		CHECK(result.fullyUnrolled == 1u);
+		CHECK(count(entry, spv::Op::OpLoopMerge) == 0u);
+		CHECK(count(entry, spv::Op::OpPhi) == 0u);
+		CHECK(count(entry, spv::Op::OpConvertSToF) == 3u);
+
+		module.finalize(&g_gram);
+		REQUIRE(g_validator.validate(module));
+	}
+
+	SECTION("partial")
+	{
+		Module module(&g_alloc, &g_logger);
+		EntryPoint& entry = makeLoop(module, 16);
+
+		VariablePromotion::promote(module);
+
+		LoopUnrolling::Options options;
+		options.maxSize = 64u;
+		options.maxFactor = 4u;
+		options.markUnroll = true;
+
+		const LoopUnrolling::Result result = LoopUnrolling::unroll(module, options);
+
+		CHECK(result.fullyUnrolled == 0u);
+		CHECK(result.partiallyUnrolled == 1u);
+		CHECK(result.markedLoops == 1u);
+		CHECK(count(entry, spv::Op::OpLoopMerge) == 1u);
+		CHECK(count(entry, spv::Op::OpBranchConditional) == 1u);
+		CHECK(count(entry, spv::Op::OpConvertSToF) == 4u);
+
+		module.finalize(&g_gram);
+		REQUIRE(g_validator.validate(module));
+	}
+
+	SECTION("decorations")
+	{
+		Module module(&g_alloc, &g_logger);
+		EntryPoint& entry = makeLoop(module, 4);
+
+		for (BasicBlock& bb : entry)
+		{
+			for (Instruction& instr : bb)
+			{
+				if (instr == spv::Op::OpFMul)
+				{
+					module.addDecorationInstr()->opDecorate(&instr, spv::Decoration::NoContraction);
+				}
+			}
+		}
+
+		VariablePromotion::promote(module);
+
+		REQUIRE(LoopUnrolling::unroll(module).fullyUnrolled == 1u);
+		REQUIRE(count(entry, spv::Op::OpFMul) == 4u);
+
+		// every copy of the multiplication keeps NoContraction
+		REQUIRE(module.getDecorations().size() == 4u);
+		for (const Instruction& decoration : module.getDecorations())
+		{
+			const Instruction* target = decoration.front().getInstruction();
+			REQUIRE(target->getOperation() == spv::Op::OpFMul);
+			REQUIRE(target->getFunction() == &entry);
+		}
+
+		module.finalize(&g_gram);
+		REQUIRE(g_validator.validate(module));
+	}
+
+	SECTION("dynamic")
+	{
+		Module module(&g_alloc, &g_logger);
+		module.addCapability(spv::Capability::Shader);
+
+		Function& func = module.addFunction<int, int>("func");
+		Instruction* i = func.variable<int>("i");
+
+		BasicBlock& bb = *func;
+		bb->opStore(i, module.constant(0));
+
+		BasicBlock& merge = bb.Loop([&](BasicBlock& cond) -> Instruction*
+		{
+			Instruction* iv = cond->opLoad(i);
+			return cond.Less(iv, func.getParameter(0)); // not constant
+		}, [&](BasicBlock& inc)
+		{
+			Instruction* iv = inc->opLoad(i);
+			iv = inc.Add(iv, module.constant(1));
+			inc->opStore(i, iv);
+		}, [&](BasicBlock& body)
+		{
+			body->opNop();
+		});
+
+		merge.returnValue(merge->opLoad(i));
+
+		LoopUnrolling::Options options;
+		options.markUnroll = true;
+
+		const LoopUnrolling::Result result = LoopUnrolling::unroll(module, options);
+
+		CHECK(result.fullyUnrolled == 0u);
+		CHECK(result.partiallyUnrolled == 0u);
+		CHECK(result.markedLoops == 0u);
+		CHECK(count(func, spv::Op::OpLoopMerge) == 1u);
+	}
+}
@@ -0,0 +1,151 @@
+#include "common/ModuleCache.h"
+#include "common/HeapAllocator.h"
+#include "common/BinaryVectorWriter.h"
+
+#include "spvgentwo/Module.h"
+#include "spvgentwo/Grammar.h"
+#include "spvgentwo/Templates.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "test/TestLogger.h"
+
+#include <cstdio>
+
+using namespace spvgentwo;
+
+namespace
+{
+	HeapAllocator g_alloc;
+	test::TestLogger g_logger;
+	Grammar g_gram(&g_alloc);
+
+	constexpr const char* PackPath = "ModuleCacheTest.pack";
+
+	void makeVariant(Module& _module, unsigned int _variant)
+	{
+		_module.addCapability(spv::Capability::Shader);
+
+		Instruction* uniVec = _module.uniform<vector_t<float, 4>>("u_Vec");
+
+		EntryPoint& entry = _module.addEntryPoint(spv::ExecutionModel::Fragment, "main");
+		entry.addExecutionMode(spv::ExecutionMode::OriginUpperLeft);
+		BasicBlock& bb = *entry;
+
+		Instruction* v = bb->opLoad(uniVec);
+		for (unsigned int i = 0u; i < _variant; ++i)
+		{
+			v = bb.Add(v, v);
+		}
+		bb.returnValue();
+	}
+}
+
+TEST_CASE("hit", "[ModuleCache]")
+{
+	remove(PackPath);
+
+	const Hash64 inputs = hash("makeVariant");
+
+	Vector<unsigned int> first(&g_alloc);
+	Hash64 key = 0u;
+	{
+		ModuleCache cache(&g_alloc, PackPath);
+		REQUIRE(cache.isOpen());
+
+		Module module(&g_alloc, &g_logger);
+		makeVariant(module, 2u);
+		key = ModuleCache::hashModule(module, inputs);
+
+		BinaryVectorWriter<Vector<unsigned int>> writer(first);
+		REQUIRE(cache.finalizeAndWrite(module, inputs, writer, &g_gram));
+		REQUIRE(module.getSpvBound() != 0u);
+		REQUIRE(cache.contains(key));
+
+		Module other(&g_alloc, &g_logger);
+		makeVariant(other, 3u);
+		REQUIRE(ModuleCache::hashModule(other, inputs) != key);
+		REQUIRE(ModuleCache::hashModule(other, inputs + 1u) != ModuleCache::hashModule(other, inputs));
+
+		const ModuleCacheStats stats = cache.getStats();
+		REQUIRE(stats.misses == 1u);
+		REQUIRE(stats.stores == 1u);
+		REQUIRE(stats.entries == 1u);
+	}
+
+	// reopen, identical module built from a different allocator hits without being finalized
+	ModuleCache cache(&g_alloc, PackPath);
+	REQUIRE(cache.contains(key));
+
+	HeapAllocator alloc;
+	Module module(&alloc, &g_logger);
+	makeVariant(module, 2u);
+	REQUIRE(ModuleCache::hashModule(module, inputs) == key);
+
+	Vector<unsigned int> second(&g_alloc);
+	BinaryVectorWriter<Vector<unsigned int>> writer(second);
+	REQUIRE(cache.finalizeAndWrite(module, inputs, writer, &g_gram));
+	REQUIRE(module.getSpvBound() == 0u);
+	REQUIRE(cache.getStats().hits == 1u);
+
+	REQUIRE(first.size() == second.size());
+	for (sgt_size_t i = 0u; i < first.size(); ++i)
+	{
+		REQUIRE(first[i] == second[i]);
+	}
+
+	cache.close();
+	remove(PackPath);
+}
+
+TEST_CASE("eviction", "[ModuleCache]")
+{
+	remove(PackPath);
+
+	Vector<unsigned int> words(&g_alloc);
+	for (unsigned int i = 0u; i < 256u; ++i)
+	{
+		words.emplace_back(i);
+	}
+
+	// room for about 8 records of 1KB
+	ModuleCache cache(&g_alloc, PackPath, 8u * 1024u + 512u);
+
+	for (unsigned int i = 0u; i < 8u; ++i)
+	{
+		words[0] = i;
+		REQUIRE(cache.store(Hash64{ i }, words.data(), words.size()));
+	}
+	REQUIRE(cache.getStats().evictions == 0u);
+
+	// touch the oldest entry
+	Vector<unsigned int> loaded(&g_alloc);
+	BinaryVectorWriter<Vector<unsigned int>> writer(loaded);
+	REQUIRE(cache.load(Hash64{ 0u }, writer));
+	REQUIRE(loaded.size() == words.size());
+	REQUIRE(loaded[0] == 0u);
+
+	words[0] = 8u;
+	REQUIRE(cache.store(Hash64{ 8u }, words.data(), words.size()));
+
+	const ModuleCacheStats stats = cache.getStats();
+	REQUIRE(stats.evictions != 0u);
+	REQUIRE(stats.packBytes <= cache.getMaxBytes());
+	REQUIRE(stats.entries + stats.evictions == 9u);
+	REQUIRE(cache.contains(Hash64{ 0u }));
+	REQUIRE(cache.contains(Hash64{ 8u }));
+	REQUIRE(cache.contains(Hash64{ 1u }) == false);
+
+	// survivors are readable after compaction and reopening
+	cache.close();
+	REQUIRE(cache.open(PackPath));
+	REQUIRE(cache.getStats().entries == stats.entries);
+
+	loaded.clear();
+	REQUIRE(cache.load(Hash64{ 8u }, writer));
+	REQUIRE(loaded.size() == words.size());
+	REQUIRE(loaded[0] == 8u);
+
+	cache.close();
+	remove(PackPath);
+}
@@ -0,0 +1,102 @@
+#include "common/ModulePool.h"
+#include "common/HeapAllocator.h"
+#include "common/BinaryVectorWriter.h"
+
+#include "spvgentwo/Grammar.h"
+#include "spvgentwo/Templates.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "test/TestLogger.h"
+
+using namespace spvgentwo;
+
+namespace
+{
+	HeapAllocator g_alloc;
+	test::TestLogger g_logger;
+	Grammar g_gram(&g_alloc);
+
+	bool makeVariant(Module& _module, const Grammar* _pGrammar, unsigned int _variant)
+	{
+		_module.addCapability(spv::Capability::Shader);
+
+		Instruction* uniVec = _module.uniform<vector_t<float, 4>>("u_Vec");
+
+		EntryPoint& entry = _module.addEntryPoint(spv::ExecutionModel::Fragment, "main");
+		entry.addExecutionMode(spv::ExecutionMode::OriginUpperLeft);
+		BasicBlock& bb = *entry;
+
+		Instruction* v = bb->opLoad(uniVec);
+		for (unsigned int i = 0u; i < _variant; ++i)
+		{
+			v = bb.Add(v, v);
+		}
+		bb.returnValue();
+
+		Vector<unsigned int> binary(_module.getAllocator());
+		BinaryVectorWriter<Vector<unsigned int>> writer(binary);
+		return _module.finalizeAndWrite(writer, _pGrammar) && binary.empty() == false;
+	}
+}
+
+TEST_CASE("reuse", "[ModulePool]")
+{
+	ModulePool pool(&g_alloc, &g_gram, &g_logger);
+
+	{
+		auto mod = pool.acquire();
+		REQUIRE(mod);
+		REQUIRE(makeVariant(*mod, mod.getGrammar(), 8u));
+	} // returned to pool
+
+	const sgt_size_t reserved = pool.getStats().reservedBytes;
+	REQUIRE(reserved != 0u);
+
+	for (unsigned int i = 0u; i < 8u; ++i)
+	{
+		auto mod = pool.acquire();
+		REQUIRE(mod->getFunctions().empty());
+		REQUIRE(mod->getEntryPoints().empty());
+		REQUIRE(makeVariant(*mod, mod.getGrammar(), i));
+	}
+
+	const ModulePoolStats& stats = pool.getStats();
+	REQUIRE(stats.acquired == 9u);
+	REQUIRE(stats.reused == 8u);
+	REQUIRE(stats.slots == 1u);
+	REQUIRE(stats.peakModuleBytes != 0u);
+	REQUIRE(stats.reservedBytes == reserved); // smaller variants fit into the memory of the first one
+	REQUIRE(stats.peakReservedBytes >= reserved);
+	REQUIRE(stats.peakReservedBytes < 2u * reserved); // a single slot is never counted twice
+}
+
+TEST_CASE("slots", "[ModulePool]")
+{
+	ModulePool pool(&g_alloc, &g_gram, &g_logger);
+	pool.reserve(2u);
+
+	{
+		auto a = pool.acquire();
+		auto b = pool.acquire();
+		auto c = pool.acquire();
+
+		REQUIRE(a.get() != b.get());
+		REQUIRE(b.get() != c.get());
+		REQUIRE(makeVariant(*c, c.getGrammar(), 1u));
+
+		auto d = stdrep::move(c);
+		REQUIRE(c.get() == nullptr);
+		REQUIRE(d);
+	}
+
+	REQUIRE(pool.getStats().slots == 3u);
+	REQUIRE(pool.getStats().peakSlotsInUse == 3u);
+
+	pool.shrink();
+	REQUIRE(pool.getStats().slots == 0u);
+	REQUIRE(pool.getStats().reservedBytes == 0u);
+
+	auto e = pool.acquire();
+	REQUIRE(makeVariant(*e, e.getGrammar(), 2u));
+}
@@ -1,5 +1,9 @@
 #include "spvgentwo/Grammar.h"
 #include "common/HeapAllocator.h"
+#include "common/BinaryVectorWriter.h"
+#include "common/BinaryVectorReader.h"
+#include "common/ByteSwap.h"
+#include "common/ModulePool.h"
 
 #include <catch2/catch_test_macros.hpp>
 #include <catch2/reporters/catch_reporter_console.hpp>
@@ -124,4 +128,373 @@ TEST_CASE( "linking", "[Modules]" )
 
 	REQUIRE( test::linkageLinked( libA, libB, consumer, &g_alloc, &g_gram ) );
 	REQUIRE( valid( consumer ) );
-}
\ No newline at end of file
+}
+
+TEST_CASE( "clone", "[Modules]" )
+{
+	auto write = [](const Module& _module, Vector<unsigned int>& _out) -> bool
+	{
+		BinaryVectorWriter<Vector<unsigned int>> writer(_out);
+		return _module.write(writer);
+	};
+
+	auto check = [&write](Module&& _module)
+	{
+		HeapAllocator cloneAlloc;
+
+		// clone unresolved module, result ids are assigned by finalize
+		Module unresolved = _module.clone(&cloneAlloc);
+		REQUIRE( valid( unresolved ) );
+		REQUIRE( valid( _module ) );
+
+		// clone finalized module, result ids are preserved
+		Module finalized = _module.clone();
+
+		Vector<unsigned int> original(&g_alloc), a(&g_alloc), b(&g_alloc);
+		REQUIRE( write( _module, original ) );
+		REQUIRE( write( unresolved, a ) );
+		REQUIRE( write( finalized, b ) );
+
+		REQUIRE( original.size() == a.size() );
+		REQUIRE( original.size() == b.size() );
+
+		bool equal = true;
+		for (sgt_size_t i = 0u; i < original.size() && equal; ++i)
+		{
+			equal = original[i] == a[i] && original[i] == b[i];
+		}
+		REQUIRE( equal );
+
+		// clones are independent of the original
+		_module.reset();
+		REQUIRE( valid( finalized ) );
+	};
+
+	check( test::types( &g_alloc, &g_logger ) );
+	check( test::constants( &g_alloc, &g_logger ) );
+	check( test::controlFlow( &g_alloc, &g_logger ) );
+	check( test::functionCall( &g_alloc, &g_logger ) );
+	check( test::fragmentShader( &g_alloc, &g_logger ) );
+	check( test::computeShader( &g_alloc, &g_logger ) );
+	check( test::linkageLibA( &g_alloc, &g_logger ) );
+}
+
+TEST_CASE( "clone shared", "[Modules]" )
+{
+	Module original = test::functionCall( &g_alloc, &g_logger );
+	REQUIRE( valid( original ) );
+
+	Vector<unsigned int> expected(&g_alloc);
+	BinaryVectorWriter<Vector<unsigned int>> writer(expected);
+	REQUIRE( original.write( writer ) );
+
+	auto equal = [&expected](const Module& _module) -> bool
+	{
+		Vector<unsigned int> binary(&g_alloc);
+		BinaryVectorWriter<Vector<unsigned int>> writer(binary);
+
+		bool same = _module.write( writer ) && binary.size() == expected.size();
+		for (sgt_size_t i = 0u; i < binary.size() && same; ++i)
+		{
+			same = binary[i] == expected[i];
+		}
+		return same;
+	};
+
+	ModuleArena deepArena(&g_alloc), sharedArena(&g_alloc);
+	Module deep = original.clone( &deepArena );
+	Module shared = original.clone( &sharedArena, true );
+
+	REQUIRE( deep.hasSharedFunctions() == false );
+	REQUIRE( shared.hasSharedFunctions() );
+	REQUIRE( sharedArena.getUsedBytes() < deepArena.getUsedBytes() );
+	REQUIRE( equal( deep ) );
+	REQUIRE( equal( shared ) );
+
+	{
+		Module unshared = original.clone( &g_alloc, true );
+		REQUIRE( unshared.unshareAll() );
+		REQUIRE( unshared.hasSharedFunctions() == false );
+		REQUIRE( valid( unshared ) );
+		REQUIRE( equal( unshared ) );
+	}
+
+	{
+		// splitting a shared block splits its private copy
+		Module split = original.clone( &g_alloc, true );
+		EntryPoint& entry = split.getEntryPoints().front();
+		BasicBlock& bb = *entry;
+		const Instruction* load = &bb.front(); // owned by original
+
+		BasicBlock* tail = bb.split( load );
+		REQUIRE( tail != nullptr );
+		REQUIRE( entry.isShared() == false );
+		REQUIRE( bb.size() == 1u );
+		REQUIRE( bb.front() == spv::Op::OpLoad );
+		REQUIRE( tail->size() == 3u );
+
+		bb->opBranch( tail );
+		REQUIRE( valid( split ) );
+		REQUIRE( equal( original ) );
+	}
+
+	// modifying a function copies its instructions, other functions stay shared
+	Function& add = shared.getFunctions().front();
+	add.variable<float>( "copied" );
+	REQUIRE( add.isShared() == false );
+	REQUIRE( shared.getEntryPoints().front().isShared() );
+
+	REQUIRE( valid( shared ) );
+	REQUIRE( equal( shared ) == false );
+	REQUIRE( equal( original ) );
+
+	// redirecting the call to add() copies the entry point
+	Function& mul = shared.addFunction<float, float, float>( "mul", spv::FunctionControlMask::Const );
+	{
+		BasicBlock& bb = *mul;
+		Instruction* z = bb.Mul( mul.getParameter( 0 ), mul.getParameter( 1 ) );
+		bb.returnValue( z );
+	}
+
+	shared.replaceUses( add.getFunction(), mul.getFunction() );
+	REQUIRE( shared.hasSharedFunctions() == false );
+
+	REQUIRE( valid( shared ) );
+	REQUIRE( equal( original ) );
+}
+
+TEST_CASE( "byte swapped", "[Modules]" )
+{
+	Vector<unsigned int> native(&g_alloc);
+	{
+		BinaryVectorWriter<Vector<unsigned int>> writer(native);
+		REQUIRE( test::controlFlow( &g_alloc, &g_logger ).finalizeAndWrite( writer, &g_gram ) );
+	}
+
+	// odd word count to cover the scalar tail of the vectorized path
+	Vector<unsigned int> swapped(&g_alloc, native.data(), native.size() - 1u + native.size() % 2u);
+	ByteSwap::swap( swapped.data(), swapped.size() );
+
+	bool equal = true;
+	for (sgt_size_t i = 0u; i < swapped.size() && equal; ++i)
+	{
+		equal = swapped[i] == byteSwap( native[i] );
+	}
+	REQUIRE( equal );
+
+	swapped = Vector<unsigned int>(&g_alloc, native.data(), native.size());
+	ByteSwap::swap( swapped.data(), swapped.size() );
+
+	// per word swapping in Module::read
+	Module module(&g_alloc, &g_logger);
+	BinaryVectorReader<Vector<unsigned int>> reader(swapped);
+	REQUIRE( module.readAndInit( reader, g_gram ) );
+	REQUIRE( module.getSpvBound() == native[3] );
+	REQUIRE( valid( module ) );
+
+	// bulk swapping
+	REQUIRE( ByteSwap::toNative( swapped.data(), swapped.size() ) );
+	REQUIRE( ByteSwap::toNative( swapped.data(), swapped.size() ) == false );
+	REQUIRE( swapped[0] == spv::MagicNumber );
+}
+
+TEST_CASE( "value numbering", "[Modules]" )
+{
+	Module module(&g_alloc, &g_logger);
+	module.addCapability(spv::Capability::Shader);
+
+	Function& func = module.addFunction<float, float, float>("func", spv::FunctionControlMask::Const);
+	BasicBlock& bb = *func;
+	bb.setValueNumbering(true);
+
+	Instruction* x = func.getParameter(0);
+	Instruction* y = func.getParameter(1);
+
+	Instruction* mul = bb->opFMul(x, y);
+	const sgt_size_t size = bb.size();
+
+	REQUIRE(bb->opFMul(x, y) == mul);
+	REQUIRE(bb.Mul(x, y) == mul); // conversion to Instruction* returns the reused instruction
+	REQUIRE(bb.size() == size);
+
+	REQUIRE(bb->opFMul(y, x) != mul); // operand order is part of the value
+	Instruction* shuffle = bb->opVectorShuffle(module.constant(make_vector(1.f, 2.f)), module.constant(make_vector(3.f, 4.f)), 0u, 3u);
+	REQUIRE(bb->opVectorShuffle(module.constant(make_vector(1.f, 2.f)), module.constant(make_vector(3.f, 4.f)), 0u, 3u) == shuffle);
+
+	Instruction* extract = bb->opCompositeExtract(shuffle, 1u);
+	REQUIRE(bb->opCompositeExtract(shuffle, 1u) == extract);
+	REQUIRE(bb.size() == size + 3u);
+
+	// stack like operations use the reused instruction
+	bb.Mul(x, y).Add(x);
+	Instruction* add = bb;
+	REQUIRE(add->getOperation() == spv::Op::OpFAdd);
+	REQUIRE(add->getFirstActualOperand()->getInstruction() == mul);
+
+	// removed instructions are not reused
+	REQUIRE(bb.remove(add));
+	bb.Mul(x, y).Add(x);
+	REQUIRE(bb.size() == size + 4u);
+
+	Instruction* sub = bb->opFSub(x, y);
+	REQUIRE(bb.removeIf([sub](const Instruction& _instr) { return &_instr == sub; }) == 1u);
+	REQUIRE(bb.size() == size + 4u);
+	bb->opFSub(x, y);
+	REQUIRE(bb.size() == size + 5u);
+
+	// dynamic composites are numbered once, after their last operand
+	Instruction* vec2 = module.type<vector_t<float, 2>>();
+	List<Instruction*> xyList(&g_alloc), yxList(&g_alloc);
+	xyList.emplace_back(x); xyList.emplace_back(y);
+	yxList.emplace_back(y); yxList.emplace_back(x);
+
+	Instruction* xy = bb->opCompositeConstructDynamic(vec2, xyList);
+	REQUIRE(bb->opCompositeConstructDynamic(vec2, xyList) == xy);
+	Instruction* yx = bb->opCompositeConstructDynamic(vec2, yxList);
+	REQUIRE(yx != xy);
+	REQUIRE(bb->opCompositeConstructDynamic(vec2, yxList) == yx);
+	REQUIRE(bb.size() == size + 7u);
+
+	bb.setValueNumbering(false);
+	REQUIRE(bb->opFMul(x, y) != mul);
+
+	bb.returnValue(bb.Add(extract, mul));
+
+	REQUIRE(valid(module));
+}
+
+TEST_CASE( "id order", "[Modules]" )
+{
+	Module module = test::controlFlow( &g_alloc, &g_logger );
+	const spv::Id bound = module.finalize( &g_gram );
+
+	SECTION( "frequency" )
+	{
+		REQUIRE( module.finalize( &g_gram, IdOrder::Frequency ) == bound );
+
+		// references per id
+		Vector<unsigned int> uses(&g_alloc);
+		uses.resize( static_cast<unsigned int>( bound ) + 1u );
+		module.iterateInstructions( [&uses]( const Instruction& _instr )
+		{
+			for (const Operand& op : _instr)
+			{
+				if (op.isInstruction())
+				{
+					++uses[static_cast<unsigned int>( op.getInstruction()->getResultId() )];
+				}
+				else if (op.isBranchTarget())
+				{
+					++uses[static_cast<unsigned int>( op.getBranchTarget()->getLabel()->getResultId() )];
+				}
+			}
+		} );
+
+		bool descending = true;
+		for (unsigned int id = 2u; id <= static_cast<unsigned int>( bound ) && descending; ++id)
+		{
+			descending = uses[id - 1u] >= uses[id];
+		}
+		REQUIRE( descending );
+	}
+
+	SECTION( "first use" )
+	{
+		REQUIRE( module.finalize( &g_gram, IdOrder::FirstUse ) == bound );
+
+		const Instruction* func = nullptr;
+		module.iterateInstructions( [&func]( const Instruction& _instr ) -> bool
+		{
+			func = &_instr;
+			return _instr == spv::Op::OpFunction;
+		} );
+
+		// result type, function type, function
+		REQUIRE( func->getResultTypeInstr()->getResultId() == spv::Id{ 1u } );
+		REQUIRE( func->getResultId() == spv::Id{ 3u } );
+	}
+
+	REQUIRE( module.getSpvBound() == static_cast<unsigned int>( bound ) + 1u );
+	REQUIRE( g_validator.validate( module ) );
+}
+
+TEST_CASE( "incremental finalize", "[Modules]" )
+{
+	Module module(&g_alloc, &g_logger);
+	module.addCapability(spv::Capability::Shader);
+
+	Instruction* in = module.input<float>("in");
+	Instruction* out = module.output<float>("out");
+
+	Function& scale = module.addFunction<float, float>("scale");
+	BasicBlock& bb = *scale;
+	Instruction* load = bb->opLoad(in);
+	Instruction* mul = bb->opFMul(scale.getParameter(0), load);
+	bb.returnValue(mul);
+
+	EntryPoint& entry = module.addEntryPoint(spv::ExecutionModel::Fragment, "main");
+	entry.addExecutionMode(spv::ExecutionMode::OriginUpperLeft);
+	{
+		BasicBlock& main = *entry;
+		Instruction* x = main->call(&scale, module.constant(2.f));
+		main->opStore(out, x);
+		main.returnValue();
+	}
+
+	auto interfaceSize = [&entry]() -> unsigned int
+	{
+		unsigned int n = 0u;
+		for (const Operand& op : entry.getInterfaceVariables())
+		{
+			n += op.isInstruction() ? 1u : 0u;
+		}
+		return n;
+	};
+
+	const spv::Id bound = module.finalize(&g_gram, IdOrder::Stable);
+	REQUIRE( scale.isDirty() == false );
+	REQUIRE( entry.isDirty() == false );
+	REQUIRE( interfaceSize() == 2u );
+
+	const spv::Id mulId = mul->getResultId();
+	const spv::Id funcId = scale.getFunction()->getResultId();
+
+	// nothing changed
+	REQUIRE( module.finalize(&g_gram, IdOrder::Stable) == bound );
+	REQUIRE( mul->getResultId() == mulId );
+
+	// edit the callee only, the entry point is re-finalized through its call tree
+	Instruction* in2 = module.input<float>("in2");
+	BasicBlock* tail = bb.split(load);
+	REQUIRE( tail != nullptr );
+	Instruction* load2 = bb->opLoad(in2);
+	bb->opBranch(tail);
+	REQUIRE( scale.isDirty() );
+	REQUIRE( entry.isDirty() == false );
+
+	const spv::Id newBound = module.finalize(&g_gram, IdOrder::Stable);
+	REQUIRE( static_cast<unsigned int>(newBound) > static_cast<unsigned int>(bound) );
+	REQUIRE( static_cast<unsigned int>(load2->getResultId()) > static_cast<unsigned int>(bound) );
+	REQUIRE( static_cast<unsigned int>(tail->getLabel()->getResultId()) > static_cast<unsigned int>(bound) );
+	REQUIRE( mul->getResultId() == mulId );
+	REQUIRE( scale.getFunction()->getResultId() == funcId );
+	REQUIRE( interfaceSize() == 3u );
+
+	// moved entry points reference their own OpFunction and recollect the interface
+	{
+		EntryPoint moved(&module, stdrep::move(entry));
+		REQUIRE( (moved.getEntryPoint()->begin() + 1u)->getInstruction() == moved.getFunction() );
+		REQUIRE( moved.getExecutionModel() == spv::ExecutionModel::Fragment );
+		REQUIRE( moved.isGlobalInterfaceDirty(GlobalInterfaceVersion::SpirV1_3) );
+
+		entry = stdrep::move(moved);
+	}
+
+	REQUIRE( (entry.getEntryPoint()->begin() + 1u)->getInstruction() == entry.getFunction() );
+	REQUIRE( entry.isGlobalInterfaceDirty(GlobalInterfaceVersion::SpirV1_3) );
+	REQUIRE( module.finalize(&g_gram, IdOrder::Stable) == newBound );
+	REQUIRE( entry.isDirty() == false );
+	REQUIRE( interfaceSize() == 3u );
+
+	REQUIRE( g_validator.validate(module) );
+}
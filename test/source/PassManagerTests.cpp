@@ -0,0 +1,252 @@
+#include "common/PassManager.h"
+#include "common/DominatorTree.h"
+#include "common/HeapAllocator.h"
+
+#include "spvgentwo/Module.h"
+#include "spvgentwo/Grammar.h"
+#include "spvgentwo/Templates.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "test/SpvValidator.h"
+#include "test/TestLogger.h"
+
+#include <atomic>
+
+using namespace spvgentwo;
+
+namespace
+{
+	HeapAllocator g_alloc;
+	test::TestLogger g_logger;
+	Grammar g_gram(&g_alloc);
+	test::SpvValidator g_validator(g_gram);
+
+	unsigned int count(const Module& _module, spv::Op _op)
+	{
+		unsigned int n = 0u;
+		auto add = [&n, _op](const Function& _func)
+		{
+			for (const BasicBlock& bb : _func)
+			{
+				for (const Instruction& instr : bb)
+				{
+					n += instr == _op ? 1u : 0u;
+				}
+			}
+		};
+
+		for (const Function& func : _module.getFunctions())
+		{
+			add(func);
+		}
+		for (const EntryPoint& ep : _module.getEntryPoints())
+		{
+			add(ep);
+		}
+		return n;
+	}
+
+	// float scale(float x) { return x * 2.0; }
+	Function& makeScale(Module& _module)
+	{
+		Function& func = _module.addFunction<float, float>("scale", spv::FunctionControlMask::Inline);
+		BasicBlock& bb = *func;
+		bb.returnValue(bb->opFMul(func.getParameter(0), _module.constant(2.f)));
+		return func;
+	}
+
+	// float sum = 0; for(int i = 0; i < 4; ++i) { sum += scale(in * float(i)); } out = sum;
+	EntryPoint& makeEntry(Module& _module, Function& _scale)
+	{
+		Instruction* in = _module.input<float>("in");
+		Instruction* out = _module.output<float>("out");
+
+		EntryPoint& entry = _module.addEntryPoint(spv::ExecutionModel::Fragment, "main");
+		entry.addExecutionMode(spv::ExecutionMode::OriginUpperLeft);
+
+		Instruction* sum = entry.variable<float>("sum");
+		Instruction* i = entry.variable<int>("i");
+
+		BasicBlock& bb = *entry;
+		bb->opStore(sum, _module.constant(0.f));
+		bb->opStore(i, _module.constant(0));
+
+		BasicBlock& merge = bb.Loop([&](BasicBlock& cond) -> Instruction*
+		{
+			Instruction* iv = cond->opLoad(i);
+			return cond.Less(iv, _module.constant(4));
+		}, [&](BasicBlock& inc)
+		{
+			Instruction* iv = inc->opLoad(i);
+			iv = inc.Add(iv, _module.constant(1));
+			inc->opStore(i, iv);
+		}, [&](BasicBlock& body)
+		{
+			Instruction* iv = body->opLoad(i);
+			Instruction* x = body->opConvertSToF(iv);
+			x = body.Mul(x, body->opLoad(in));
+			x = body->call(&_scale, x);
+			x = body.Add(x, body->opLoad(sum));
+			body->opStore(sum, x);
+		});
+
+		Instruction* result = merge->opLoad(sum);
+		merge->opStore(out, result);
+		merge.returnValue();
+
+		return entry;
+	}
+
+	struct Record
+	{
+		unsigned int passes = 0u;
+		unsigned int changed = 0u;
+		int instructionDelta = 0;
+	};
+
+	void record(const PassStatistics& _stats, void* _pUserData)
+	{
+		Record* r = static_cast<Record*>(_pUserData);
+		++r->passes;
+		r->changed += _stats.changed ? 1u : 0u;
+		r->instructionDelta += static_cast<int>(_stats.instructionsAfter) - static_cast<int>(_stats.instructionsBefore);
+	}
+}
+
+TEST_CASE("analyses", "[PassManager]")
+{
+	Module module(&g_alloc, &g_logger);
+	module.addCapability(spv::Capability::Shader);
+
+	Function& scale = makeScale(module);
+	EntryPoint& entry = makeEntry(module, scale);
+
+	PassManager manager(&g_alloc, 1u);
+
+	// queries analyses, changes nothing
+	manager.addFunctionPass("query", [](Function& _func, FunctionAnalyses& _analyses, IAllocator*, void*) -> bool
+	{
+		const DominatorTree& domTree = _analyses.getDominatorTree();
+		REQUIRE(domTree.getBlocks().size() == _func.size());
+
+		const Instruction* param = _func.getParameters().empty() ? nullptr : &_func.getParameters().front();
+		if (param != nullptr)
+		{
+			const List<Instruction*>* uses = _analyses.getUses(param);
+			REQUIRE(uses != nullptr);
+			CHECK(uses->size() == 1u);
+		}
+		return false;
+	});
+
+	SECTION("cached")
+	{
+		manager.run(module);
+
+		CHECK(manager.getAnalyses(scale).getValid().all(AnalysisBits::Dominators, AnalysisBits::DefUse));
+		CHECK(manager.getAnalyses(entry).getValid().all(AnalysisBits::Dominators));
+		CHECK(manager.getAnalyses(entry).getValid().none(AnalysisBits::DefUse)); // no parameters
+	}
+
+	SECTION("invalidated")
+	{
+		// claims a change that only preserves the dominator tree
+		manager.addFunctionPass("touch", [](Function&, FunctionAnalyses&, IAllocator*, void*) -> bool { return true; }, AnalysisBits::Dominators);
+
+		manager.run(module);
+
+		CHECK(static_cast<unsigned int>(manager.getAnalyses(scale).getValid()) == static_cast<unsigned int>(AnalysisBits::Dominators));
+	}
+
+	SECTION("module pass")
+	{
+		// functions might be removed and others allocated at their address, nothing is kept even if preserved
+		manager.addModulePass("touch", [](Module&, PassManager&, IAllocator*, void*) -> bool { return true; }, AnalysisBits::All);
+
+		manager.run(module);
+
+		CHECK(static_cast<unsigned int>(manager.getAnalyses(scale).getValid()) == 0u);
+		CHECK(static_cast<unsigned int>(manager.getAnalyses(entry).getValid()) == 0u);
+	}
+}
+
+TEST_CASE("pipelines", "[PassManager]")
+{
+	Module module(&g_alloc, &g_logger);
+	module.addCapability(spv::Capability::Shader);
+
+	Function& scale = makeScale(module);
+	makeEntry(module, scale);
+
+	PassManager manager(&g_alloc);
+	CHECK_FALSE(Pipelines::add(manager, "-O3"));
+
+	Record rec;
+	manager.setInstrumentation(record, &rec);
+
+	SECTION("O")
+	{
+		REQUIRE(Pipelines::add(manager, "-O"));
+		CHECK(manager.run(module));
+
+		CHECK(rec.passes == manager.getPasses().size());
+		CHECK(rec.changed > 0u);
+		CHECK(count(module, spv::Op::OpFunctionCall) == 0u);
+		CHECK(count(module, spv::Op::OpLoopMerge) == 0u);
+		CHECK(module.getFunctions().size() == 0u); // scale was inlined and removed
+	}
+
+	SECTION("Os")
+	{
+		REQUIRE(Pipelines::add(manager, "Os"));
+		CHECK(manager.run(module));
+
+		CHECK(rec.passes == manager.getPasses().size());
+		CHECK(count(module, spv::Op::OpFunctionCall) == 1u);
+		CHECK(count(module, spv::Op::OpLoopMerge) == 1u);
+		CHECK(count(module, spv::Op::OpPhi) == 2u);
+		CHECK(rec.instructionDelta < 0);
+	}
+
+	SECTION("passes")
+	{
+		REQUIRE(Pipelines::add(manager, "-promote"));
+		REQUIRE(Pipelines::add(manager, "dce"));
+		REQUIRE(Pipelines::add(manager, "strip"));
+		CHECK(manager.run(module));
+
+		CHECK(rec.passes == 3u);
+		CHECK(module.getNames().empty());
+		CHECK(count(module, spv::Op::OpPhi) == 2u);
+	}
+
+	module.finalize(&g_gram);
+	REQUIRE(g_validator.validate(module));
+}
+
+TEST_CASE("parallel", "[PassManager]")
+{
+	Module module(&g_alloc, &g_logger);
+	module.addCapability(spv::Capability::Shader);
+
+	for (unsigned int i = 0u; i < 16u; ++i)
+	{
+		makeScale(module);
+	}
+
+	std::atomic<unsigned int> visited{ 0u };
+
+	PassManager manager(&g_alloc, 4u);
+	manager.addFunctionPass("count", [](Function& _func, FunctionAnalyses& _analyses, IAllocator*, void* _pUserData) -> bool
+	{
+		if (_analyses.getUses(&_func.getParameters().front()) != nullptr)
+		{
+			++*static_cast<std::atomic<unsigned int>*>(_pUserData);
+		}
+		return false;
+	}, {}, true, &visited);
+
+	CHECK_FALSE(manager.run(module));
+	CHECK(visited == 16u);
+}
@@ -0,0 +1,151 @@
+#include "common/PatchTable.h"
+#include "common/HeapAllocator.h"
+#include "common/BinaryVectorWriter.h"
+#include "common/BinaryVectorReader.h"
+
+#include "spvgentwo/Module.h"
+#include "spvgentwo/Grammar.h"
+#include "spvgentwo/Templates.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "test/TestLogger.h"
+
+using namespace spvgentwo;
+
+namespace
+{
+	HeapAllocator g_alloc;
+	test::TestLogger g_logger;
+	Grammar g_gram(&g_alloc);
+
+	using Binary = Vector<unsigned int>;
+
+	struct Ids
+	{
+		unsigned int image = 0u;
+		unsigned int color = 0u;
+		unsigned int count = 0u;
+		unsigned int enabled = 0u;
+		unsigned int offset = 0u;
+	};
+
+	Binary write(Ids& _ids)
+	{
+		Module module(&g_alloc, &g_logger);
+		module.addCapability(spv::Capability::Shader);
+		module.addCapability(spv::Capability::Int64);
+
+		Instruction* image = module.uniformConstant<dyn_image_t>("img", dyn_image_t{ dyn_scalar_t{ spv::Op::OpTypeFloat, 32u }, spv::Dim::Dim2D });
+		module.addDecorationInstr()->opDecorate(image, spv::Decoration::DescriptorSet, 1u);
+		module.addDecorationInstr()->opDecorate(image, spv::Decoration::Binding, 2u);
+
+		Instruction* color = module.input<vector_t<float, 4>>("color");
+		module.addDecorationInstr()->opDecorate(color, spv::Decoration::Location, 3u);
+
+		Instruction* count = module.specConstant(4u);
+		Instruction* enabled = module.specConstant(true);
+		Instruction* offset = module.specConstant(sgt_uint64_t{ 5u });
+		module.addDecorationInstr()->opDecorate(count, spv::Decoration::SpecId, 10u);
+		module.addDecorationInstr()->opDecorate(enabled, spv::Decoration::SpecId, 11u);
+		module.addDecorationInstr()->opDecorate(offset, spv::Decoration::SpecId, 12u);
+
+		EntryPoint& entry = module.addEntryPoint(spv::ExecutionModel::Fragment, "main");
+		entry.addExecutionMode(spv::ExecutionMode::OriginUpperLeft);
+		BasicBlock& bb = *entry;
+		bb->opLoad(color);
+		bb.returnValue();
+
+		Binary binary(&g_alloc);
+		BinaryVectorWriter<Binary> writer(binary);
+		module.finalizeAndWrite(writer, &g_gram);
+
+		auto id = [](const Instruction* _pInstr) { return static_cast<unsigned int>(_pInstr->getResultId()); };
+		_ids = Ids{ id(image), id(color), id(count), id(enabled), id(offset) };
+
+		return binary;
+	}
+}
+
+TEST_CASE("scan", "[PatchTable]")
+{
+	Ids ids;
+	const Binary binary = write(ids);
+
+	PatchTable table(&g_alloc);
+	REQUIRE(table.scan(binary.data(), binary.size()));
+	REQUIRE(table.getPatches().size() == 9u);
+
+	REQUIRE(PatchTable::get(binary.data(), table[table.find(PatchTable::Slot::DescriptorSet, ids.image)]) == 1u);
+	REQUIRE(PatchTable::get(binary.data(), table[table.find(PatchTable::Slot::Binding, ids.image)]) == 2u);
+	REQUIRE(PatchTable::get(binary.data(), table[table.find(PatchTable::Slot::Location, ids.color)]) == 3u);
+	REQUIRE(table.find(PatchTable::Slot::Binding, ids.color) == PatchTable::InvalidIndex);
+
+	REQUIRE(table.findSpecConstant(10u) == table.find(PatchTable::Slot::SpecConstant, ids.count));
+	REQUIRE(table.findSpecConstant(11u) == table.find(PatchTable::Slot::SpecConstantBool, ids.enabled));
+	REQUIRE(table[table.findSpecConstant(12u)].wordCount == 2u);
+	REQUIRE(PatchTable::get(binary.data(), table[table.findSpecConstant(11u)]) == 1u);
+	REQUIRE(table.findSpecConstant(13u) == PatchTable::InvalidIndex);
+
+	// truncated header and instruction
+	REQUIRE(table.scan(binary.data(), 4u) == false);
+	REQUIRE(table.scan(binary.data(), 6u) == false);
+	REQUIRE(table.getPatches().empty());
+}
+
+TEST_CASE("patch", "[PatchTable]")
+{
+	Ids ids;
+	Binary binary = write(ids);
+
+	PatchTable table(&g_alloc);
+	REQUIRE(table.scan(binary.data(), binary.size()));
+
+	REQUIRE(table.set(binary.data(), PatchTable::Slot::DescriptorSet, ids.image, 7u));
+	REQUIRE(table.set(binary.data(), PatchTable::Slot::Binding, ids.image, 8u));
+	REQUIRE(table.set(binary.data(), PatchTable::Slot::Location, ids.color, 9u));
+	REQUIRE(table.set(binary.data(), PatchTable::Slot::Location, ids.image, 9u) == false);
+	REQUIRE(table.setSpecConstant(binary.data(), 10u, 64u));
+	REQUIRE(table.setSpecConstant(binary.data(), 11u, 0u));
+	PatchTable::apply64(binary.data(), table[table.findSpecConstant(12u)], 0x100000002ull);
+
+	// patched binary is still valid and carries the new values
+	Module module(&g_alloc, &g_logger);
+	BinaryVectorReader<Binary> reader(binary);
+	REQUIRE(module.readAndInit(reader, g_gram));
+
+	unsigned int found = 0u;
+	for (const Instruction& decoration : module.getDecorations())
+	{
+		const unsigned int target = static_cast<unsigned int>(decoration.front().getInstruction()->getResultId());
+		const unsigned int value = decoration.back().getLiteral().value;
+
+		switch (static_cast<spv::Decoration>(decoration.begin().next()->getLiteral().value))
+		{
+		case spv::Decoration::DescriptorSet: REQUIRE((target == ids.image && value == 7u)); ++found; break;
+		case spv::Decoration::Binding: REQUIRE((target == ids.image && value == 8u)); ++found; break;
+		case spv::Decoration::Location: REQUIRE((target == ids.color && value == 9u)); ++found; break;
+		default: break;
+		}
+	}
+	REQUIRE(found == 3u);
+
+	for (const Instruction& constant : module.getTypesAndConstants())
+	{
+		const unsigned int id = static_cast<unsigned int>(constant.getResultId());
+		if (id == ids.count)
+		{
+			REQUIRE(constant.getOperation() == spv::Op::OpSpecConstant);
+			REQUIRE(constant.back().getLiteral().value == 64u);
+		}
+		else if (id == ids.enabled)
+		{
+			REQUIRE(constant.getOperation() == spv::Op::OpSpecConstantFalse);
+		}
+		else if (id == ids.offset)
+		{
+			REQUIRE(constant.last().prev()->getLiteral().value == 2u);
+			REQUIRE(constant.back().getLiteral().value == 1u);
+		}
+	}
+}
@@ -0,0 +1,192 @@
+#include "common/PeepholeOptimizer.h"
+#include "common/HeapAllocator.h"
+
+#include "spvgentwo/Module.h"
+#include "spvgentwo/Grammar.h"
+#include "spvgentwo/Templates.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "test/SpvValidator.h"
+#include "test/TestLogger.h"
+
+using namespace spvgentwo;
+
+namespace
+{
+	HeapAllocator g_alloc;
+	test::TestLogger g_logger;
+	Grammar g_gram(&g_alloc);
+	test::SpvValidator g_validator(g_gram);
+
+	unsigned int count(const Function& _func, spv::Op _op)
+	{
+		unsigned int n = 0u;
+		for (const BasicBlock& bb : _func)
+		{
+			for (const Instruction& instr : bb)
+			{
+				n += instr == _op ? 1u : 0u;
+			}
+		}
+		return n;
+	}
+
+	// replaces OpIAdd x + x with OpIMul x * 2
+	Instruction* addSelf(PeepholeOptimizer::Context& _context, Instruction& _instr)
+	{
+		Instruction* x = PeepholeOptimizer::Context::getOperand(_instr, 0u);
+		if (x == nullptr || x != PeepholeOptimizer::Context::getOperand(_instr, 1u))
+		{
+			return nullptr;
+		}
+
+		Instruction* two = _context.getModule().constant(2u);
+		return _context.insertBefore(_instr)->opIMul(x, two);
+	}
+}
+
+TEST_CASE("peephole", "[PeepholeOptimizer]")
+{
+	Module module(&g_alloc, &g_logger);
+	module.addCapability(spv::Capability::Shader);
+
+	PeepholeOptimizer::Rules rules(&g_alloc);
+	PeepholeOptimizer::addDefaultRules(rules);
+
+	SECTION("integer")
+	{
+		Function& func = module.addFunction<unsigned int, unsigned int>("func");
+		Instruction* x = func.getParameter(0);
+
+		BasicBlock& bb = *func;
+		Instruction* a = bb->opIMul(x, module.constant(8u)); // x << 3
+		Instruction* b = bb->opUDiv(a, module.constant(4u)); // a >> 2
+		Instruction* c = bb->opUMod(b, module.constant(16u)); // b & 15
+		Instruction* d = bb->opIAdd(c, module.constant(0u)); // c
+		Instruction* e = bb->opIMul(module.constant(1u), d); // d
+		Instruction* f = bb->opNot(e);
+		Instruction* g = bb->opNot(f); // e
+		bb.returnValue(g);
+
+		const PeepholeOptimizer::Result result = PeepholeOptimizer::optimize(module, rules);
+
+		CHECK(result.rewritten == 3u);
+		CHECK(result.replaced == 3u);
+		CHECK(count(func, spv::Op::OpIMul) == 0u);
+		CHECK(count(func, spv::Op::OpUDiv) == 0u);
+		CHECK(count(func, spv::Op::OpUMod) == 0u);
+		CHECK(count(func, spv::Op::OpIAdd) == 0u);
+		CHECK(count(func, spv::Op::OpShiftLeftLogical) == 1u);
+		CHECK(count(func, spv::Op::OpShiftRightLogical) == 1u);
+		CHECK(count(func, spv::Op::OpBitwiseAnd) == 1u);
+		CHECK(count(func, spv::Op::OpNot) == 1u); // inner OpNot is left to dead code elimination
+
+		Instruction* ret = bb.getTerminator();
+		REQUIRE(ret != nullptr);
+		CHECK(*ret->getFirstActualOperand()->getInstruction() == spv::Op::OpBitwiseAnd);
+
+		module.finalize(&g_gram);
+		REQUIRE(g_validator.validate(module));
+	}
+
+	SECTION("float")
+	{
+		Function& func = module.addFunction<float, float, bool>("func");
+		Instruction* x = func.getParameter(0);
+
+		BasicBlock& bb = *func;
+		Instruction* a = bb->opFMul(x, module.constant(1.f));
+		Instruction* b = bb->opFAdd(a, module.constant(-0.f));
+		Instruction* c = bb->opFAdd(b, module.constant(0.f)); // kept, x + 0.0 is not x for x = -0.0
+		Instruction* d = bb->opFSub(c, module.constant(0.f));
+		Instruction* e = bb->opSelect(module.constant(true), d, x);
+		Instruction* f = bb->opSelect(func.getParameter(1), e, e);
+		bb.returnValue(f);
+
+		const PeepholeOptimizer::Result result = PeepholeOptimizer::optimize(func, rules);
+
+		CHECK(result.replaced == 5u);
+		CHECK(result.rewritten == 0u);
+		CHECK(count(func, spv::Op::OpFAdd) == 1u);
+		CHECK(count(func, spv::Op::OpFMul) == 0u);
+		CHECK(count(func, spv::Op::OpFSub) == 0u);
+		CHECK(count(func, spv::Op::OpSelect) == 0u);
+
+		module.finalize(&g_gram);
+		REQUIRE(g_validator.validate(module));
+	}
+
+	SECTION("composite")
+	{
+		Function& func = module.addFunction<float, float, float>("func");
+		Instruction* x = func.getParameter(0);
+		Instruction* y = func.getParameter(1);
+
+		BasicBlock& bb = *func;
+		Instruction* xy = bb->opCompositeConstruct(module.type<vector_t<float, 2>>(), x, y);
+		Instruction* xyx = bb->opCompositeConstruct(module.type<vector_t<float, 3>>(), xy, x);
+		Instruction* a = bb->opCompositeExtract(xyx, 1u); // y
+		Instruction* cast = bb->opBitcast(module.type<unsigned int>(), a);
+		Instruction* castBack = bb->opBitcast(module.type<int>(), cast); // bitcast(y)
+		Instruction* b = bb->opBitcast(module.type<float>(), castBack); // bitcast(y) -> y
+		bb.returnValue(b);
+
+		const PeepholeOptimizer::Result result = PeepholeOptimizer::optimize(func, rules);
+
+		CHECK(result.rewritten == 3u);
+		CHECK(result.replaced == 2u);
+		CHECK(count(func, spv::Op::OpCompositeExtract) == 0u);
+
+		Instruction* ret = bb.getTerminator();
+		REQUIRE(ret != nullptr);
+		CHECK(ret->getFirstActualOperand()->getInstruction() == y);
+
+		module.finalize(&g_gram);
+		REQUIRE(g_validator.validate(module));
+	}
+
+	SECTION("custom rule")
+	{
+		Function& func = module.addFunction<unsigned int, unsigned int>("func");
+		Instruction* x = func.getParameter(0);
+
+		BasicBlock& bb = *func;
+		bb.returnValue(bb->opIAdd(x, x));
+
+		rules.add(spv::Op::OpIAdd, addSelf);
+
+		const PeepholeOptimizer::Result result = PeepholeOptimizer::optimize(func, rules);
+
+		// x + x -> x * 2 -> x << 1
+		CHECK(result.replaced == 1u);
+		CHECK(result.rewritten == 1u);
+		CHECK(count(func, spv::Op::OpIAdd) == 0u);
+		CHECK(count(func, spv::Op::OpShiftLeftLogical) == 1u);
+
+		module.finalize(&g_gram);
+		REQUIRE(g_validator.validate(module));
+	}
+
+	SECTION("fold")
+	{
+		Function& func = module.addFunction<unsigned int, unsigned int>("func");
+
+		BasicBlock& bb = *func;
+		Instruction* a = bb->opIAdd(module.constant(2u), module.constant(3u));
+		Instruction* b = bb->opIMul(a, func.getParameter(0));
+		bb.returnValue(b);
+
+		PeepholeOptimizer::Rules folding(&g_alloc);
+		PeepholeOptimizer::addFoldingRules(folding);
+
+		const PeepholeOptimizer::Result result = PeepholeOptimizer::optimize(func, folding);
+
+		CHECK(result.replaced == 1u);
+		CHECK(count(func, spv::Op::OpIAdd) == 0u);
+		CHECK(b->getFirstActualOperand()->getInstruction() == module.constant(5u));
+
+		module.finalize(&g_gram);
+		REQUIRE(g_validator.validate(module));
+	}
+}
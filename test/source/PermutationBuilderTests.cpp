@@ -0,0 +1,111 @@
+#include "common/PermutationBuilder.h"
+#include "common/HeapAllocator.h"
+
+#include "spvgentwo/Module.h"
+#include "spvgentwo/Grammar.h"
+#include "spvgentwo/Templates.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+using namespace spvgentwo;
+
+namespace
+{
+	HeapAllocator g_alloc;
+	Grammar g_gram(&g_alloc);
+
+	bool fragment(Module& _module, const PermutationKey& _key)
+	{
+		_module.addCapability(spv::Capability::Shader);
+
+		Instruction* uniVec = _module.uniform<vector_t<float, 4>>("u_Vec");
+		_module.specConstant(1.f, "s_Scale");
+
+		EntryPoint& entry = _module.addEntryPoint(spv::ExecutionModel::Fragment, "main");
+		entry.addExecutionMode(spv::ExecutionMode::OriginUpperLeft);
+		BasicBlock& bb = *entry;
+
+		Instruction* v = bb->opLoad(uniVec);
+
+		// odd values produce the same code as the next lower even value
+		const unsigned int adds = _key.getUInt("Adds") / 2u;
+		for (unsigned int i = 0u; i < adds; ++i)
+		{
+			v = bb.Add(v, v);
+		}
+
+		if (_key.getBool("Mul"))
+		{
+			bb.Mul(v, v);
+		}
+
+		bb.returnValue();
+		return true;
+	}
+}
+
+TEST_CASE("dedup", "[PermutationBuilder]")
+{
+	PermutationBuilder builder(&g_alloc, &g_gram, nullptr, nullptr, 4u);
+	REQUIRE(builder.getThreadCount() == 4u);
+
+	Vector<PermutationKey> keys(&g_alloc);
+	for (unsigned int adds = 0u; adds < 8u; ++adds)
+	{
+		keys.emplace_back(&g_alloc)->set("Adds", adds).set("Mul", false);
+		keys.emplace_back(&g_alloc)->set("Adds", adds).set("Mul", true);
+	}
+
+	REQUIRE(builder.build(keys, fragment));
+
+	const Vector<PermutationResult>& results = builder.getResults();
+	REQUIRE(results.size() == keys.size());
+	REQUIRE(builder.getBinaries().elements() == keys.size() / 2u);
+
+	for (sgt_size_t i = 0u; i < results.size(); ++i)
+	{
+		REQUIRE(results[i].pBinary != nullptr);
+		REQUIRE(results[i].pBinary->empty() == false);
+		REQUIRE(results[i].pBinary->front() == spv::MagicNumber);
+	}
+
+	// Adds 0 and 1 generate the same module, Mul changes it
+	REQUIRE(results[0].pBinary == results[2].pBinary);
+	REQUIRE(results[0].hash == results[2].hash);
+	REQUIRE(results[0].pBinary != results[1].pBinary);
+
+	// results of further builds are appended and deduplicated against previous ones
+	REQUIRE(builder.build(keys, fragment));
+	REQUIRE(builder.getResults().size() == keys.size() * 2u);
+	REQUIRE(builder.getBinaries().elements() == keys.size() / 2u);
+
+	builder.clear();
+	REQUIRE(builder.getResults().empty());
+	REQUIRE(builder.getBinaries().elements() == 0u);
+}
+
+TEST_CASE("specConstant", "[PermutationBuilder]")
+{
+	PermutationBuilder builder(&g_alloc, &g_gram, nullptr, nullptr, 2u);
+
+	Vector<PermutationKey> keys(&g_alloc);
+	keys.emplace_back(&g_alloc)->specConstant("s_Scale", 1.f);
+	keys.emplace_back(&g_alloc)->specConstant("s_Scale", 2.f);
+	keys.emplace_back(&g_alloc)->specConstant("s_Scale", 2.f).specConstant("s_Scale", 1.f); // overwritten
+	keys.emplace_back(&g_alloc)->specConstant("s_Missing", 1u);
+
+	REQUIRE(builder.build(keys, fragment) == false);
+
+	const Vector<PermutationResult>& results = builder.getResults();
+	REQUIRE(results[0].pBinary != nullptr);
+	REQUIRE(results[1].pBinary != nullptr);
+	REQUIRE(results[0].pBinary != results[1].pBinary);
+	REQUIRE(results[0].pBinary == results[2].pBinary);
+	REQUIRE(results[3].pBinary == nullptr);
+
+	// switches and spec constants don't share names
+	const PermutationKey& key = keys[0];
+	REQUIRE(key.find("s_Scale") == nullptr);
+	REQUIRE(key.find("s_Scale", PermutationValue::Kind::SpecConstant) != nullptr);
+	REQUIRE(key.getUInt("s_Scale", 7u) == 7u);
+}
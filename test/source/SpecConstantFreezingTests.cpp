@@ -0,0 +1,97 @@
+#include "common/SpecConstantFreezing.h"
+#include "common/HeapAllocator.h"
+
+#include "spvgentwo/Module.h"
+#include "spvgentwo/Grammar.h"
+#include "spvgentwo/Templates.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "test/SpvValidator.h"
+#include "test/TestLogger.h"
+
+using namespace spvgentwo;
+
+namespace
+{
+	HeapAllocator g_alloc;
+	test::TestLogger g_logger;
+	Grammar g_gram(&g_alloc);
+	test::SpvValidator g_validator(g_gram);
+
+	bool contains(const List<Instruction>& _list, const Instruction* _pInstr)
+	{
+		return _list.find_if([_pInstr](const Instruction& _instr) { return &_instr == _pInstr; }) != _list.end();
+	}
+}
+
+TEST_CASE("freeze", "[SpecConstantFreezing]")
+{
+	Module module(&g_alloc, &g_logger);
+	module.addCapability(spv::Capability::Shader);
+
+	Instruction* count = module.specConstant(4u, "count");
+	Instruction* scale = module.specConstant(1.f, "scale");
+	Instruction* enabled = module.specConstant(false, "enabled");
+	Instruction* other = module.specConstant(7u, "other");
+	module.addDecorationInstr()->opDecorate(count, spv::Decoration::SpecId, 0u);
+	module.addDecorationInstr()->opDecorate(scale, spv::Decoration::SpecId, 1u);
+	module.addDecorationInstr()->opDecorate(enabled, spv::Decoration::SpecId, 2u);
+	module.addDecorationInstr()->opDecorate(other, spv::Decoration::SpecId, 3u);
+
+	Instruction* sum = module.addConstantInstr()->opSpecConstantOp(module.type<unsigned int>(), spv::Op::OpIAdd, count, module.constant(1u));
+	Instruction* partial = module.addConstantInstr()->opSpecConstantOp(module.type<unsigned int>(), spv::Op::OpIMul, other, module.constant(2u));
+	Instruction* mixed = module.addConstantInstr()->opSpecConstantOp(module.type<unsigned int>(), spv::Op::OpIAdd, count, other); // uses frozen count declared after it
+
+	Instruction* uintOut = module.output<unsigned int>("uintOut");
+	Instruction* floatOut = module.output<float>("floatOut");
+
+	EntryPoint& entry = module.addEntryPoint(spv::ExecutionModel::Fragment, "main");
+	entry.addExecutionMode(spv::ExecutionMode::OriginUpperLeft);
+	BasicBlock& bb = *entry;
+	bb->opStore(floatOut, scale);
+	bb->opStore(uintOut, partial);
+	bb->opStore(uintOut, mixed);
+
+	BasicBlock& merge = bb.If(enabled, [&](BasicBlock& trueBB)
+	{
+		trueBB->opStore(uintOut, sum);
+	});
+	merge.returnValue();
+
+	REQUIRE(entry.size() == 3u);
+
+	SpecConstantFreezing::Values values(&g_alloc);
+	values.emplaceUnique(0u, 10u);
+	values.emplaceUnique(1u, 0x40000000u); // 2.f
+	values.emplaceUnique(2u, 0u);
+
+	const SpecConstantFreezing::Result result = SpecConstantFreezing::freeze(module, values);
+
+	REQUIRE(result.frozenConstants == 3u);
+	REQUIRE(result.foldedConstants == 1u); // partial depends on other which has no value
+	REQUIRE(result.foldedBranches == 1u);
+	REQUIRE(result.removedBlocks == 1u);
+
+	REQUIRE(entry.size() == 2u);
+	REQUIRE(bb.getTerminator()->getOperation() == spv::Op::OpBranch);
+	REQUIRE(bb.front().getFirstActualOperand().next()->getInstruction() == module.constant(2.f));
+
+	const List<Instruction>& constants = module.getTypesAndConstants();
+	REQUIRE(contains(constants, module.constant(11u)));
+	REQUIRE(contains(constants, other));
+	REQUIRE(contains(constants, partial));
+	REQUIRE(mixed->getFirstActualOperand().next()->getInstruction() == module.constant(10u));
+	REQUIRE(module.getConstantInfo(other)->getOperation() == spv::Op::OpSpecConstant);
+	REQUIRE(module.getInstructionByName("count") == nullptr);
+	REQUIRE(module.getInstructionByName("other") == other);
+	REQUIRE(module.getDecorations().size() == 1u); // SpecId of other
+
+	module.finalize(&g_gram);
+	REQUIRE(g_validator.validate(module));
+
+	// nothing left to freeze
+	const SpecConstantFreezing::Result again = SpecConstantFreezing::freeze(module, values);
+	REQUIRE(again.frozenConstants == 0u);
+	REQUIRE(again.removedBlocks == 0u);
+}
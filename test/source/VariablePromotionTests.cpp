@@ -0,0 +1,186 @@
+#include "common/VariablePromotion.h"
+#include "common/DominatorTree.h"
+#include "common/HeapAllocator.h"
+
+#include "spvgentwo/Module.h"
+#include "spvgentwo/Grammar.h"
+#include "spvgentwo/Templates.h"
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "test/SpvValidator.h"
+#include "test/TestLogger.h"
+
+using namespace spvgentwo;
+
+namespace
+{
+	HeapAllocator g_alloc;
+	test::TestLogger g_logger;
+	Grammar g_gram(&g_alloc);
+	test::SpvValidator g_validator(g_gram);
+
+	unsigned int count(const Function& _func, spv::Op _op)
+	{
+		unsigned int n = 0u;
+		for (const BasicBlock& bb : _func)
+		{
+			for (const Instruction& instr : bb)
+			{
+				n += instr == _op ? 1u : 0u;
+			}
+		}
+		return n;
+	}
+}
+
+TEST_CASE("dominator tree", "[VariablePromotion]")
+{
+	Module module(&g_alloc, &g_logger);
+	module.addCapability(spv::Capability::Shader);
+
+	Function& func = module.addFunction<void, bool>("func");
+	BasicBlock& entry = *func;
+	BasicBlock& trueBB = func.addBasicBlock("true");
+	BasicBlock& falseBB = func.addBasicBlock("false");
+	BasicBlock& merge = func.addBasicBlock("merge");
+	BasicBlock& dead = func.addBasicBlock("dead");
+
+	entry.If(func.getParameter(0), trueBB, falseBB, &merge);
+	trueBB->opBranch(&merge);
+	falseBB->opBranch(&merge);
+	merge.returnValue();
+	dead->opBranch(&merge);
+
+	const DominatorTree domTree(func, &g_alloc);
+
+	REQUIRE(domTree.getBlocks().size() == 4u);
+	REQUIRE(domTree.getBlocks().front() == &entry);
+	REQUIRE(domTree.isReachable(&dead) == false);
+	REQUIRE(domTree.getImmediateDominator(&entry) == nullptr);
+	REQUIRE(domTree.getImmediateDominator(&trueBB) == &entry);
+	REQUIRE(domTree.getImmediateDominator(&merge) == &entry);
+	REQUIRE(domTree.dominates(&entry, &merge));
+	REQUIRE(domTree.dominates(&trueBB, &merge) == false);
+	REQUIRE(domTree.getChildren(&entry)->size() == 3u);
+	REQUIRE(domTree.getFrontier(&trueBB)->size() == 1u);
+	REQUIRE(domTree.getFrontier(&trueBB)->front() == &merge);
+	REQUIRE(domTree.getFrontier(&entry)->empty());
+	REQUIRE(domTree.getFrontier(&dead) == nullptr);
+	REQUIRE(domTree.getPredecessors(&merge)->size() == 2u);
+}
+
+TEST_CASE("promote", "[VariablePromotion]")
+{
+	Module module(&g_alloc, &g_logger);
+	module.addCapability(spv::Capability::Shader);
+
+	Instruction* in = module.input<float>("in");
+	Instruction* out = module.output<float>("out");
+
+	EntryPoint& entry = module.addEntryPoint(spv::ExecutionModel::Fragment, "main");
+	entry.addExecutionMode(spv::ExecutionMode::OriginUpperLeft);
+	{
+		BasicBlock& bb = *entry;
+
+		// float x = 1.0; if(in < 0) x = in; else x = in * 2; out = x;
+		Instruction* x = entry.variable(1.f, "x");
+		Instruction* value = bb->opLoad(in);
+
+		BasicBlock& merge = bb.If(bb.Less(value, module.constant(0.f)), [&](BasicBlock& trueBB)
+		{
+			trueBB->opStore(x, value);
+		}, [&](BasicBlock& falseBB)
+		{
+			Instruction* x2 = falseBB.Mul(value, module.constant(2.f));
+			falseBB->opStore(x, x2);
+		});
+
+		// int i = 0; while(i < 4) { i++; } not stored after the loop: the loop phi stays
+		Instruction* i = entry.variable<int>("i");
+		merge->opStore(i, module.constant(0));
+
+		BasicBlock& end = merge.Loop([&](BasicBlock& cond) -> Instruction*
+		{
+			Instruction* iv = cond->opLoad(i);
+			return cond.Less(iv, module.constant(4));
+		}, [&](BasicBlock& inc)
+		{
+			Instruction* iv = inc->opLoad(i);
+			iv = inc.Add(iv, module.constant(1));
+			inc->opStore(i, iv);
+		}, [&](BasicBlock& body)
+		{
+			body->opNop();
+		});
+
+		Instruction* result = end->opLoad(x);
+		Instruction* iv = end->opConvertSToF(end->opLoad(i));
+		result = end.Add(result, iv);
+		end->opStore(out, result);
+		end.returnValue();
+	}
+
+	const VariablePromotion::Result result = VariablePromotion::promote(module);
+
+	CHECK(result.promotedVariables == 2u);
+	CHECK(result.removedStores == 4u);
+	CHECK(result.removedLoads == 4u);
+	CHECK(result.insertedPhis == 2u);
+
+	CHECK(count(entry, spv::Op::OpVariable) == 0u);
+	CHECK(count(entry, spv::Op::OpLoad) == 1u); // load of in
+	CHECK(count(entry, spv::Op::OpStore) == 1u); // store to out
+	CHECK(count(entry, spv::Op::OpPhi) == 2u);
+
+	module.finalize(&g_gram);
+	REQUIRE(g_validator.validate(module));
+}
+
+TEST_CASE("promote escaped", "[VariablePromotion]")
+{
+	Module module(&g_alloc, &g_logger);
+	module.addCapability(spv::Capability::Shader);
+
+	// void modify(inout float v) { v = 1.0; }
+	Function& modify = module.addFunction<void, float*>("modify");
+	{
+		BasicBlock& bb = *modify;
+		bb->opStore(modify.getParameter(0), module.constant(1.f));
+		bb.returnValue();
+	}
+
+	Instruction* out = module.output<float>("out");
+
+	EntryPoint& entry = module.addEntryPoint(spv::ExecutionModel::Fragment, "main");
+	entry.addExecutionMode(spv::ExecutionMode::OriginUpperLeft);
+	{
+		BasicBlock& bb = *entry;
+
+		Instruction* v = entry.variable<float>("v"); // passed to a call
+		Instruction* vec = entry.variable<vector_t<float, 3>>("vec"); // accessed with OpAccessChain
+		Instruction* s = entry.variable<float>("s"); // promoted
+
+		bb->call(&modify, v);
+		Instruction* x = bb->opAccessChain(vec, 0u);
+		bb->opStore(x, module.constant(2.f));
+		bb->opStore(s, module.constant(3.f));
+
+		Instruction* vx = bb->opLoad(x);
+		Instruction* sum = bb.Add(bb->opLoad(v), vx);
+		sum = bb.Add(sum, bb->opLoad(s));
+		bb->opStore(out, sum);
+		bb.returnValue();
+	}
+
+	const VariablePromotion::Result result = VariablePromotion::promote(module);
+
+	CHECK(result.promotedVariables == 1u);
+	CHECK(result.removedLoads == 1u);
+	CHECK(result.removedStores == 1u);
+	CHECK(result.insertedPhis == 0u);
+	CHECK(count(entry, spv::Op::OpVariable) == 2u);
+
+	module.finalize(&g_gram);
+	REQUIRE(g_validator.validate(module));
+}